@@ -3,12 +3,14 @@
 #include "util.hh"
 
 #include <map>
+#include <memory>
 #include <string>
 
 
 namespace uvgrtp {
 
     class session;
+    class io_runtime;
 
     class context {
         public:
@@ -72,6 +74,33 @@ namespace uvgrtp {
              */
             rtp_error_t destroy_session(uvgrtp::session *session);
 
+            /**
+             * \brief Serve all media streams of this context from a shared pool of I/O threads
+             *
+             * \details By default every media stream runs its own threads for receiving packets,
+             * sending RTCP reports and holepunching. With many media streams, this means a lot of
+             * threads that are mostly asleep. When the I/O runtime is enabled, a fixed number of
+             * worker threads wait for packets and timers of all media streams created
+             * after this call and run the media streams' work on their behalf.
+             *
+             * All work of one media stream is done by the same worker. The receive hooks
+             * and RTCP hooks of the media stream are called from that worker so they must not block.
+             * With the I/O runtime, ::RRO_BLOCK drops packets instead of blocking the worker.
+             *
+             * The I/O runtime is only available on Linux and it must be enabled
+             * before any session is created.
+             *
+             * \param workers Number of worker threads
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK             On success
+             * \retval RTP_INVALID_VALUE  If workers is 0 or the runtime has already been enabled
+             * \retval RTP_NOT_SUPPORTED  If the I/O runtime is not available on this platform
+             * \retval RTP_GENERIC_ERROR  If the worker threads could not be started
+             */
+            rtp_error_t enable_io_runtime(size_t workers);
+
             /// \cond DO_NOT_DOCUMENT
             std::string& get_cname();
             /// \endcond
@@ -84,6 +113,9 @@ namespace uvgrtp {
 
             /* CNAME is the same for all connections */
             std::string cname_;
+
+            /* Shared I/O runtime, nullptr if it has not been enabled */
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
         };
 }
 
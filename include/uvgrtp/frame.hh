@@ -90,12 +90,23 @@ namespace uvgrtp {
 
             uint8_t *dgram = nullptr;      /* pointer to the UDP datagram (for internal use only) */
             size_t   dgram_size = 0; /* size of the UDP datagram */
+            void    *dgram_ref = nullptr;  /* reference to the reception buffer of "dgram" (for internal use only) */
+
+            void    *pool = nullptr;         /* frame pool the frame was allocated from (for internal use only) */
+            uint8_t *pool_buffer = nullptr;  /* buffer holding the payload (for internal use only) */
 
             rtp_format_t format = RTP_FORMAT_GENERIC;
             int  type = 0;
             sockaddr_in src_addr;
         };
 
+        /* One NAL unit of a frame given to media_stream::push_frame() as a list of NAL units.
+         * The NAL unit may be given with or without its start code */
+        struct nal_unit {
+            uint8_t *data = nullptr;
+            size_t len = 0;
+        };
+
         struct rtcp_header {
             uint8_t version = 0;
             uint8_t padding = 0;
@@ -191,6 +202,11 @@ namespace uvgrtp {
          *    RTP_INVALID_VALUE if "payload_size" is 0 */
         zrtp_frame *alloc_zrtp_frame(size_t payload_size);
 
+        /* Return true if "ptr" points to the UDP datagram the frame was received in.
+         * Such memory belongs to the reception buffer and must not be freed separately,
+         * see RCE_ZERO_COPY_RECEIVE */
+        bool points_to_dgram(const rtp_frame *frame, const uint8_t *ptr);
+
         /* Deallocate RTP frame
          *
          * Return RTP_OK on successs
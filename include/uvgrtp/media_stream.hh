@@ -26,9 +26,12 @@ namespace uvgrtp {
     class reception_flow;
     class holepuncher;
     class socket;
+    class io_runtime;
+    class pacer;
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
     }
 
     namespace formats {
@@ -38,8 +41,10 @@ namespace uvgrtp {
     class media_stream {
         public:
             /// \cond DO_NOT_DOCUMENT
-            media_stream(std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags);
-            media_stream(std::string remote_addr, std::string local_addr, int src_port, int dst_port, rtp_format_t fmt, int flags);
+            media_stream(std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags,
+                std::shared_ptr<uvgrtp::io_runtime> runtime = nullptr);
+            media_stream(std::string remote_addr, std::string local_addr, int src_port, int dst_port, rtp_format_t fmt, int flags,
+                std::shared_ptr<uvgrtp::io_runtime> runtime = nullptr);
             ~media_stream();
 
             /* Initialize traditional RTP session
@@ -194,6 +199,117 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, int flags);
 
+            /**
+             * \brief Send a frame that is given as a list of NAL units
+             *
+             * \details Encoders that already know the NAL unit boundaries can give the NAL units
+             * of a frame in separate buffers. uvgRTP then neither needs the NAL units to be
+             * concatenated with start codes nor has to search for the start codes. The NAL units
+             * are aggregated and fragmented as if they had been given to push_frame() in one buffer.
+             *
+             * The NAL units must stay valid until push_frame() returns. With ::RCE_SYSTEM_CALL_DISPATCHER
+             * the frame is sent after push_frame() has returned so ::RTP_COPY must be given.
+             *
+             * Only H.264, H.265 and H.266 support this
+             *
+             * \param nals Array of NAL units
+             * \param nal_count Number of NAL units in "nals"
+             * \param flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid
+             * \retval  RTP_MEMORY_ERROR  If the frame has too many packets, see ::RCC_MAX_FRAME_PACKETS
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not support this
+             */
+            rtp_error_t push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags);
+
+            /**
+             * \brief Send a frame that is given as a list of NAL units with a custom timestamp
+             *
+             * \details See push_frame(const uvgrtp::frame::nal_unit *, size_t, int) and
+             * push_frame(uint8_t *, size_t, uint32_t, int)
+             *
+             * \param nals Array of NAL units
+             * \param nal_count Number of NAL units in "nals"
+             * \param ts 32-bit timestamp value for the frame
+             * \param flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid
+             * \retval  RTP_MEMORY_ERROR  If the frame has too many packets, see ::RCC_MAX_FRAME_PACKETS
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not support this
+             */
+            rtp_error_t push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, uint32_t ts, int flags);
+
+            /**
+             * \brief Start sending a frame one NAL unit at a time
+             *
+             * \details Encoders that produce slices or tiles before the whole frame is ready can
+             * give each NAL unit to push_nal() as soon as it has been encoded, and the NAL unit is
+             * packetized and sent right away. All NAL units get the RTP timestamp of the frame and
+             * the marker bit is set only on the final packet of the frame, when end_frame() is called.
+             *
+             * The last packet of each NAL unit is held back until the next NAL unit or end_frame()
+             * so that the marker bit can be set on it. Its payload is copied, so the memory of a
+             * NAL unit can be released as soon as push_nal() returns.
+             *
+             * Only H.264, H.265 and H.266 support this and it cannot be used with ::RCE_SYSTEM_CALL_DISPATCHER
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the previous frame has not been ended
+             * \retval  RTP_NOT_SUPPORTED If the media format or the flags of the stream do not support this
+             */
+            rtp_error_t begin_frame();
+
+            /**
+             * \brief Start sending a frame one NAL unit at a time with a custom timestamp
+             *
+             * \details See begin_frame() and push_frame(uint8_t *, size_t, uint32_t, int)
+             *
+             * \param ts 32-bit timestamp value for the frame
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the previous frame has not been ended
+             * \retval  RTP_NOT_SUPPORTED If the media format or the flags of the stream do not support this
+             */
+            rtp_error_t begin_frame(uint32_t ts);
+
+            /**
+             * \brief Send a NAL unit of the frame started with begin_frame()
+             *
+             * \param data NAL unit, with or without a start code
+             * \param data_len Length of the NAL unit
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If no frame has been started or one of the parameters is invalid
+             * \retval  RTP_MEMORY_ERROR  If the frame has too many packets, see ::RCC_MAX_FRAME_PACKETS
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote. The frame is discarded
+             */
+            rtp_error_t push_nal(uint8_t *data, size_t data_len);
+
+            /**
+             * \brief End the frame started with begin_frame() and send its last packet with the marker bit set
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If no frame has been started or no NAL units were pushed
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             */
+            rtp_error_t end_frame();
+
             /**
              * \brief Poll a frame indefinitely from the media stream object
              *
@@ -237,27 +353,46 @@ namespace uvgrtp {
              * \retval RTP_INVALID_VALUE If hook is nullptr */
             rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *));
 
-            /// \cond DO_NOT_DOCUMENT
-            /* 
+            /**
+             * \brief Install a deallocation hook for frames given to push_frame()
              *
-             * Return RTP_OK on success
-             * Return RTP_INVALID_VALUE if "hook" is nullptr */
+             * \details uvgRTP calls the hook with the pointer given to push_frame() when it
+             * no longer needs the frame, i.e., when the packets of the frame have been sent.
+             * This is needed with ::RCE_SYSTEM_CALL_DISPATCHER where push_frame() returns
+             * before the frame has been sent. Frames given as std::unique_ptr are released
+             * by uvgRTP and are not given to the hook
+             *
+             * \param hook Function pointer to the deallocation hook
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
             rtp_error_t install_deallocation_hook(void (*hook)(void *));
 
-            /* If needed, a notification hook can be installed to uvgRTP that can be used as
-             * an information side channel to the internal state of the library.
+            /**
+             * \brief Install a notification hook for events of the receiver
              *
-             * When uvgRTP encouters a situation it doesn't know how to react to,
-             * it calls the notify hook with certain notify reason number (src/util.hh).
-             * Upon receiving a notification, application may ignore it or act on it somehow
+             * \details uvgRTP calls the hook with a ::NOTIFY_REASON when something happens to the
+             * received media that the application may want to react to, for example when a fragmented
+             * frame could not be completed within ::RCC_PKT_MAX_DELAY and was dropped.
+             * The hook is called from the thread that processes the received packets
+             * so it should return quickly.
              *
-             * Currently only one notification type is supported and only receiver uses notifications
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the notification hook
              *
-             * "arg" is optional argument that is passed to hook when it is called. It may be nullptr
+             * \return RTP error code
              *
-             * Return RTP_OK on success
-             * Return RTP_INVALID_VALUE if "hook" is nullptr */
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
             rtp_error_t install_notify_hook(void *arg, void (*hook)(void *, int));
+
+            /// \cond DO_NOT_DOCUMENT
+            /* Pace the outgoing packets of the media stream with "pacer" shared by the media streams
+             * of the session, unless the media stream has its own budget set with RCC_PACING_RATE.
+             * Used by uvgrtp::session::enable_pacing() */
+            void set_session_pacer(std::shared_ptr<uvgrtp::pacer> pacer);
             /// \endcond
 
             /**
@@ -298,6 +433,53 @@ namespace uvgrtp {
 
             uint32_t get_ssrc() const;
 
+            /**
+             * \brief Get the number of received packets dropped by uvgRTP
+             *
+             * \details Packets are dropped when the reception ring is full and the overflow
+             * policy is either RRO_DROP_NEWEST or RRO_DROP_OLDEST, see ::RCC_RING_OVERFLOW_POLICY.
+             * Packets dropped by the operating system are not included
+             *
+             * \return Number of dropped packets
+             */
+            uint64_t get_dropped_packets() const;
+
+            /**
+             * \brief Send the media stream also to another receiver
+             *
+             * \details Each frame is packetized and, with SRTP, encrypted once and the same packets
+             * are then sent to the remote participant given to uvgrtp::session::create_stream() and
+             * to every added destination. This way one encoder can feed many receivers at the cost
+             * of one media stream.
+             *
+             * All destinations receive the same SSRC and sequence numbers and with SRTP they must
+             * use the same keys. RTCP and ZRTP are only used with the remote participant given to
+             * uvgrtp::session::create_stream(). Destinations can be added and removed while frames
+             * are being sent.
+             *
+             * \param remote_address IPv4 address of the receiver
+             * \param remote_port Port of the receiver
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the address is not valid or it already is a destination
+             */
+            rtp_error_t add_destination(std::string remote_address, uint16_t remote_port);
+
+            /**
+             * \brief Stop sending the media stream to a destination added with add_destination()
+             *
+             * \param remote_address IPv4 address of the receiver
+             * \param remote_port Port of the receiver
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the address is not a destination
+             */
+            rtp_error_t remove_destination(std::string remote_address, uint16_t remote_port);
+
         private:
             /* Initialize the connection by initializing the socket
              * and binding ourselves to specified interface and creating
@@ -315,6 +497,10 @@ namespace uvgrtp {
 
             rtp_error_t start_components();
 
+            /* Pace the outgoing packets with "pacer", nullptr disables pacing.
+             * Audio streams are given priority over others */
+            void set_pacer(std::shared_ptr<uvgrtp::pacer> pacer);
+
             uint32_t key_;
 
             std::shared_ptr<uvgrtp::srtp>   srtp_;
@@ -352,6 +538,15 @@ namespace uvgrtp {
 
             /* Thread that keeps the holepunched connection open for unidirectional streams */
             std::unique_ptr<uvgrtp::holepuncher> holepuncher_;
+
+            /* Shared I/O runtime of the context, nullptr if the media stream runs its own threads */
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
+
+            /* Pacer of the outgoing packets, nullptr if pacing is disabled */
+            std::shared_ptr<uvgrtp::pacer> pacer_;
+
+            /* Pacer shared by the media streams of the session, used when RCC_PACING_RATE is 0 */
+            std::shared_ptr<uvgrtp::pacer> session_pacer_;
     };
 }
 
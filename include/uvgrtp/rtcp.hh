@@ -18,6 +18,8 @@ namespace uvgrtp {
 
     class rtp;
     class srtcp;
+    class io_runtime;
+    struct io_source;
 
     /// \cond DO_NOT_DOCUMENT
     enum RTCP_ROLE {
@@ -191,6 +193,10 @@ namespace uvgrtp {
 
             /* Return SSRCs of all participants */
             std::vector<uint32_t> get_participants() const;
+
+            /* Generate the reports and receive the reports of the participants on
+             * worker "worker" of "runtime" instead of own thread. Must be called before start() */
+            void set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker);
             /// \endcond
 
             /**
@@ -280,7 +286,7 @@ namespace uvgrtp {
             static rtp_error_t recv_packet_handler(void *arg, int flags, frame::rtp_frame **out);
 
             /* Update RTCP-related sender statistics */
-            static rtp_error_t send_packet_handler_vec(void *arg, uvgrtp::buf_vec& buffers);
+            static rtp_error_t send_packet_handler_vec(void *arg, struct iovec *buffers, size_t count);
             /// \endcond
 
         private:
@@ -457,6 +463,14 @@ namespace uvgrtp {
 
             std::unique_ptr<std::thread> report_generator_;
 
+            /* Handlers of the I/O runtime, see set_io_runtime() */
+            void on_report_timer();
+            bool on_socket_readable(size_t index);
+
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
+            size_t runtime_worker_;
+            std::vector<uvgrtp::io_source *> runtime_sources_;
+
             bool is_active() const
             {
                 return active_;
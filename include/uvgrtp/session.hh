@@ -12,12 +12,14 @@ namespace uvgrtp {
 
     class media_stream;
     class zrtp;
+    class io_runtime;
+    class pacer;
 
     class session {
         public:
             /// \cond DO_NOT_DOCUMENT
-            session(std::string addr);
-            session(std::string remote_addr, std::string local_addr);
+            session(std::string addr, std::shared_ptr<uvgrtp::io_runtime> runtime = nullptr);
+            session(std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::io_runtime> runtime = nullptr);
             ~session();
             /// \endcond
 
@@ -66,6 +68,27 @@ namespace uvgrtp {
              */
             rtp_error_t destroy_stream(uvgrtp::media_stream *stream);
 
+            /**
+             * \brief Pace the outgoing RTP packets of all media streams of this session with one budget
+             *
+             * \details The packets of all media streams of the session, including the ones created
+             * after this call, are sent at most at the given rate in total so that the frames are
+             * spread over time instead of sending them in bursts. Packets of audio streams
+             * are never delayed but they consume the budget so that video streams are delayed instead.
+             *
+             * Media streams that have their own budget set with ::RCC_PACING_RATE keep it.
+             * See ::RCE_PACE_TXTIME for giving the departure times to the kernel.
+             *
+             * \param rate  Pacing rate in kilobits per second, 0 disables pacing
+             * \param burst How many bytes can be sent at once without pacing,
+             * 0 selects the default described in ::RCC_PACING_BURST
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             */
+            rtp_error_t enable_pacing(size_t rate, size_t burst = 0);
+
             /// \cond DO_NOT_DOCUMENT
             /* Get unique key of the session
              * Used by context to index sessions */
@@ -86,6 +109,12 @@ namespace uvgrtp {
             std::unordered_map<uint32_t, uvgrtp::media_stream *> streams_;
 
             std::mutex session_mtx_;
+
+            /* I/O runtime of the context, passed on to all media streams of this session */
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
+
+            /* Pacing budget shared by all media streams of this session, see enable_pacing() */
+            std::shared_ptr<uvgrtp::pacer> pacer_;
     };
 }
 
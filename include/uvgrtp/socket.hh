@@ -14,12 +14,42 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <mutex>
 
 
 namespace uvgrtp {
 
+    class uring;
+    class pacer;
+    struct zerocopy_state;
+
 #ifdef _WIN32
     typedef unsigned int socklen_t;
+
+    /* Windows has no scatter/gather message structures so these stand in for them.
+     * The socket converts them to WSABUFs when the messages are sent */
+    struct iovec {
+        void  *iov_base;
+        size_t iov_len;
+    };
+
+    struct msghdr {
+        void         *msg_name;
+        socklen_t     msg_namelen;
+        struct iovec *msg_iov;
+        size_t        msg_iovlen;
+        void         *msg_control;
+        size_t        msg_controllen;
+        int           msg_flags;
+    };
+
+    struct mmsghdr {
+        struct msghdr msg_hdr;
+        unsigned int  msg_len;
+    };
 #endif
 
     const int MAX_BUFFER_COUNT = 256;
@@ -30,7 +60,8 @@ namespace uvgrtp {
     /* Vector of RTP frames constructed from buf_vec entries */
     typedef std::vector<std::vector<std::pair<size_t, uint8_t *>>> pkt_vec;
 
-    typedef rtp_error_t (*packet_handler_vec)(void *, buf_vec&);
+    /* Called with the "count" buffers of one outgoing packet */
+    typedef rtp_error_t (*packet_handler_vec)(void *, struct iovec *buffers, size_t count);
 
     struct socket_packet_handler {
         void *arg = nullptr;
@@ -76,16 +107,29 @@ namespace uvgrtp {
             rtp_error_t sendto(uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
             rtp_error_t sendto(buf_vec& buffers, int flags);
             rtp_error_t sendto(buf_vec& buffers, int flags, int *bytes_sent);
-            rtp_error_t sendto(pkt_vec& buffers, int flags);
-            rtp_error_t sendto(pkt_vec& buffers, int flags, int *bytes_sent);
 
             /* Same as sendto() but the remote address given as parameter */
             rtp_error_t sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags);
             rtp_error_t sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
             rtp_error_t sendto(sockaddr_in& addr, buf_vec& buffers, int flags);
             rtp_error_t sendto(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent);
-            rtp_error_t sendto(sockaddr_in& addr, pkt_vec& buffers, int flags);
-            rtp_error_t sendto(sockaddr_in& addr, pkt_vec& buffers, int flags, int *bytes_sent);
+
+            /* Send the "count" messages of "headers" as one batch. The remote address of each
+             * message is its "msg_name" and its buffers are given to the packet handlers as is.
+             * "msg_control" of the headers must be empty, the socket may use it while sending
+             *
+             * The messages are also sent to the destinations added with add_destination()
+             *
+             * The arrays are used for sending without copying them to other structures so the
+             * caller can build them once and reuse the storage for the following batches
+             *
+             * Any thread may send with the vector-based operations. They are serialized,
+             * so a batch waiting for its departure times delays the batches of other threads
+             *
+             * Return RTP_OK on success and write the amount of bytes sent to "bytes_sent"
+             * Return RTP_SEND_ERROR on error and set "bytes_sent" to -1 */
+            rtp_error_t sendto(struct mmsghdr *headers, size_t count, int flags);
+            rtp_error_t sendto(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent);
 
             /* Same as recv(2), receives a message from socket (remote address not known)
              *
@@ -110,6 +154,31 @@ namespace uvgrtp {
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags, int *bytes_read);
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int flags);
 
+            /* Same as recvmmsg(2), receives up to "buffers.size()" datagrams with one system call
+             *
+             * Each entry of "buffers" is a scatter list for one datagram. The size of each
+             * received datagram is written to "bytes_read" which must have room for
+             * "buffers.size()" entries and the number of received datagrams is written to "packets_read"
+             *
+             * On platforms without recvmmsg(2), the datagrams are read one by one
+             *
+             * If "segment_sizes" is not NULL, the segment size of each datagram coalesced with UDP GRO
+             * is written to it, or 0 if the datagram was not coalesced. See enable_gro()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INTERRUPTED if there was nothing to read and set "packets_read" to 0
+             * Return RTP_GENERIC_ERROR on error and set "packets_read" to -1 */
+            rtp_error_t recvfrom(pkt_vec& buffers, int flags, int *bytes_read, int *packets_read);
+            rtp_error_t recvfrom(pkt_vec& buffers, int flags, int *bytes_read, int *packets_read, int *segment_sizes);
+
+            /* Let the kernel coalesce consecutive datagrams of the same size from one sender
+             * into one large datagram (UDP GRO). Coalesced datagrams must be received with
+             * recvfrom() that returns the segment sizes
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if UDP GRO is not available */
+            rtp_error_t enable_gro();
+
             /* Create sockaddr_in object using the provided information
              * NOTE: "family" must be AF_INET */
             sockaddr_in create_sockaddr(short family, unsigned host, short port);
@@ -137,15 +206,99 @@ namespace uvgrtp {
              * "arg" is an optional parameter that can be passed to the handler when it's called */
             rtp_error_t install_handler(void *arg, packet_handler_vec handler);
 
+            /* Pace the packets sent with the vector-based send operations using "pacer".
+             * If "priority" is true, the packets are not delayed but they consume the budget
+             * of the pacer. nullptr removes the pacer
+             *
+             * If RCE_PACE_TXTIME has been given, the departure times are given to the kernel
+             * with SO_TXTIME instead of waiting for them in the sending thread */
+            void set_pacer(std::shared_ptr<uvgrtp::pacer> pacer, bool priority);
+
+            /* Send the messages given to sendto() with message headers also to "addr". The packet
+             * handlers are called once per message and the same buffers are then sent to every
+             * destination with one batch per destination
+             *
+             * Destinations can be added and removed while another thread is sending
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "addr" already is a destination */
+            rtp_error_t add_destination(const sockaddr_in& addr);
+
+            /* Stop sending to a destination added with add_destination()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "addr" is not a destination */
+            rtp_error_t remove_destination(const sockaddr_in& addr);
+
+            /* Let the vector-based send operations be given MSG_ZEROCOPY on Linux.
+             * The kernel then sends the packets directly from the given buffers and
+             * they must stay valid until the kernel has reported the sends completed,
+             * see get_zerocopy_id() and install_zerocopy_handler()
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if MSG_ZEROCOPY is not available */
+            rtp_error_t enable_zerocopy();
+
+            /* Each message sent with MSG_ZEROCOPY gets an ID that increases by one.
+             * Return the ID the next such message gets */
+            uint32_t get_zerocopy_id();
+
+            /* Install a handler that is called with ID "completed" when the kernel has completed all
+             * messages sent with MSG_ZEROCOPY that have a smaller ID. The handler is called by the
+             * thread that calls process_zerocopy(). nullptr removes the handler and when this
+             * returns, the old handler is not running */
+            void install_zerocopy_handler(std::function<void(uint32_t completed)> handler);
+
+            /* Read the completion notifications of MSG_ZEROCOPY from the error queue of the socket.
+             * Must be called when the socket polls with POLLERR as the notifications are kept there */
+            void process_zerocopy();
+
         private:
             /* helper function for sending UPD packets, see documentation for sendto() above */
             rtp_error_t __sendto(sockaddr_in& addr, uint8_t *buf, size_t buf_len, int flags, int *bytes_sent);
             rtp_error_t __recv(uint8_t *buf, size_t buf_len, int flags, int *bytes_read);
             rtp_error_t __recvfrom(uint8_t *buf, size_t buf_len, int flags, sockaddr_in *sender, int *bytes_read);
+            rtp_error_t __recvmmsg(uvgrtp::pkt_vec& buffers, int flags, int *bytes_read, int *packets_read,
+                int *segment_sizes);
 
-            /* __sendtov() does the same as __sendto but it combines multiple buffers into one frame and sends them */
+            /* __sendtov() does the same as __sendto but it combines multiple buffers into one frame and sends them.
+             * It holds "send_mtx_" while sending, see __sendmsgs_locked() */
             rtp_error_t __sendtov(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent);
-            rtp_error_t __sendtov(sockaddr_in& addr, uvgrtp::pkt_vec& buffers, int flags, int *bytes_sent);
+            rtp_error_t __sendtov(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent, bool fan_out);
+
+            /* Send the messages given to __sendtov(). Must be called with "send_mtx_" held */
+            rtp_error_t __sendmsgs_locked(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent,
+                bool fan_out);
+
+#ifndef _WIN32
+            /* Send "count" messages with io_uring if RCE_IO_URING has been given
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if io_uring is not available and the messages must be sent otherwise
+             * Return RTP_SEND_ERROR if sending failed, the index of the first failed message is written to
+             * "failed_index" and the messages after it are not sent */
+            rtp_error_t __sendmsgs_uring(struct mmsghdr *headers, size_t count, int flags, size_t *failed_index);
+
+            /* Coalesce runs of equally sized messages of "headers" to UDP GSO datagrams
+             * if RCE_UDP_GSO has been given. The coalesced datagrams and the messages
+             * that could not be coalesced are written in order to "gso_headers_".
+             * If "copy" is false, the datagrams point to the buffers of the messages
+             *
+             * Return the number of messages in "gso_headers_" */
+            size_t __coalesce_gso(struct mmsghdr *headers, const size_t *sizes, size_t count, bool copy);
+
+            /* Send "count" messages of "headers" with io_uring or sendmmsg(2), coalescing
+             * them with UDP GSO first if "gso" is true
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t __sendmsgs(struct mmsghdr *headers, const size_t *sizes, size_t count, int flags, bool gso);
+
+            /* Send "count" messages of "headers" at the departure times given by "pacer",
+             * see set_pacer() */
+            rtp_error_t __sendmsgs_paced(uvgrtp::pacer *pacer, bool priority, struct mmsghdr *headers,
+                const size_t *sizes, size_t count, int flags);
+#endif
 
             socket_t socket_;
             sockaddr_in addr_;
@@ -157,16 +310,70 @@ namespace uvgrtp {
             /* __sendtov() calls these handlers in order before sending the packet */
             std::vector<socket_packet_handler> vec_handlers_;
 
+            /* Created on first send if RCE_IO_URING has been given */
+            std::shared_ptr<uvgrtp::uring> send_ring_;
+            bool send_ring_failed_;
+
+            /* Pacer of the outgoing packets, see set_pacer(). Accessed with
+             * std::atomic_load() and std::atomic_store() as it can be changed while sending */
+            std::shared_ptr<uvgrtp::pacer> pacer_;
+            bool pacer_priority_;
+
+            /* True if the departure times are given to the kernel with SO_TXTIME */
+            bool txtime_;
+
+            /* Destinations added with add_destination(). The vector is never modified, it's replaced
+             * with std::atomic_compare_exchange_strong() so that it can be changed while sending */
+            std::shared_ptr<const std::vector<sockaddr_in>> destinations_;
+
+            /* Created by enable_zerocopy() */
+            std::shared_ptr<uvgrtp::zerocopy_state> zerocopy_;
+
 #ifndef NDEBUG
             uint64_t sent_packets_ = 0;
             uint64_t received_packets_ = 0;
+            uint64_t recv_syscalls_ = 0;
 #endif // !NDEBUG
 
-#ifdef _WIN32
-            WSABUF buffers_[MAX_BUFFER_COUNT];
-#else
+            /* Both the application thread and the thread of the system call dispatcher may send
+             * with the same socket, so the vector-based send operations are serialized with this.
+             * It protects the send state below, from "header_" to "txtime_control_", as well as
+             * "send_ring_", and it's held while a paced batch waits for its departure times.
+             * Shared by the copies of the socket like "zerocopy_" */
+            std::shared_ptr<std::mutex> send_mtx_;
+
+            /* Message built by the buf_vec variant of __sendtov() */
             struct mmsghdr header_;
             struct iovec   chunks_[MAX_BUFFER_COUNT];
+
+            /* Sizes of the messages given to __sendtov(), grown when a larger batch is sent */
+            std::vector<size_t> send_sizes_;
+
+            /* Remote addresses of the messages given to __sendtov(), restored after fan-out */
+            std::vector<void *> send_names_;
+
+            /* Departure times of the messages given to __sendmsgs_paced(), grown like "send_sizes_" */
+            std::vector<std::chrono::steady_clock::time_point> departures_;
+
+#ifndef _WIN32
+            /* Headers and chunks used by __recvmmsg(), grown when a larger batch is requested */
+            std::vector<struct mmsghdr> recv_headers_;
+            std::vector<struct iovec>   recv_chunks_;
+
+            /* Control messages of __recvmmsg(), used only for the UDP GRO segment sizes */
+            std::vector<uint8_t> recv_control_;
+
+            /* Messages built by __coalesce_gso(). "gso_ranges_" tells which messages
+             * of the original batch each of them holds so they can be resent without GSO */
+            std::vector<struct mmsghdr> gso_headers_;
+            std::vector<struct iovec>   gso_chunks_;
+            std::vector<uint8_t>        gso_control_;
+            std::vector<uint8_t>        gso_buffer_;
+            std::vector<std::pair<size_t, size_t>> gso_ranges_;
+            bool gso_failed_ = false;
+
+            /* SCM_TXTIME control messages of the paced messages */
+            std::vector<uint8_t> txtime_control_;
 #endif
     };
 }
@@ -118,7 +118,12 @@ typedef enum RTP_FLAGS {
 enum RTP_CTX_ENABLE_FLAGS {
     RCE_NO_FLAGS                  = 0 << 0,
 
-    /* Obsolete */
+    /** Send the packets from a separate dispatcher thread
+     *
+     * push_frame() creates the packets of the frame and returns without sending them.
+     * A frame given as a raw pointer must stay valid until uvgRTP calls the deallocation hook
+     * (see uvgrtp::media_stream::install_deallocation_hook()) unless ::RTP_COPY is given,
+     * frames given as std::unique_ptr are released by uvgRTP */
     RCE_SYSTEM_CALL_DISPATCHER    = 1 << 2,
 
     /** Use SRTP for this connection */
@@ -235,7 +240,100 @@ enum RTP_CTX_ENABLE_FLAGS {
     /** Use 256-bit keys with SRTP */
     RCE_SRTP_KEYSIZE_256          = 1 << 17,
 
-    RCE_LAST                      = 1 << 18,
+    /** Do not copy the payloads of received RTP packets.
+     *
+     * By default, uvgRTP copies the payload of every received packet to a separately
+     * allocated buffer. If this flag is given, the payload of a returned frame points
+     * directly to the memory the packet was received to and the memory is released
+     * back to uvgRTP when the frame is deallocated with uvgrtp::frame::dealloc_frame().
+     *
+     * Frames that are held by the application occupy space in the reception ring so they
+     * should be deallocated promptly, otherwise the ring fills up and incoming packets are
+     * dropped according to ::RCC_RING_OVERFLOW_POLICY */
+    RCE_ZERO_COPY_RECEIVE         = 1 << 18,
+
+    /** Send and receive packets using io_uring(7) on Linux.
+     *
+     * Packets are received with a multishot receive directly to the reception ring
+     * and the packets of a frame are sent with one io_uring_enter(2) call.
+     * Datagrams larger than the MTU (see ::RCC_MTU_SIZE) are dropped by the receiver.
+     *
+     * If io_uring is not available, because the kernel is too old or uvgRTP
+     * has been compiled without it, uvgRTP falls back to the regular system calls.
+     * The flag has no effect on streams served by the I/O runtime of the context */
+    RCE_IO_URING                  = 1 << 19,
+
+    /** Let the kernel coalesce received packets with UDP GRO on Linux.
+     *
+     * Consecutive packets of the same size from one sender are received as one large datagram
+     * and uvgRTP splits it back to individual RTP packets in the reception ring, which reduces
+     * the number of receive system calls at high packet rates.
+     *
+     * Has no effect if the kernel does not support UDP GRO or if packets are received with ::RCE_IO_URING */
+    RCE_UDP_GRO                   = 1 << 20,
+
+    /** Send runs of equally sized packets with UDP GSO on Linux.
+     *
+     * The fragments of a frame are copied back to back into one buffer which is
+     * given to the kernel as one datagram that it segments to the individual packets,
+     * so the UDP/IP stack is traversed once per run of packets instead of once per packet.
+     *
+     * If the kernel or the network device does not support UDP GSO, uvgRTP falls back to sending
+     * the packets one by one, with sendmmsg(2) or with ::RCE_IO_URING if it has been given */
+    RCE_UDP_GSO                   = 1 << 21,
+
+    /** Give the departure times of paced packets to the kernel with SO_TXTIME on Linux.
+     *
+     * By default the sending thread waits until each packet may depart, see ::RCC_PACING_RATE.
+     * With this flag the packets are handed to the kernel at once and it holds them until
+     * their departure times, which requires the fq or etf queueing discipline on the network device.
+     * Without one of them the departure times are ignored and the packets are not paced.
+     *
+     * If SO_TXTIME is not available, uvgRTP falls back to waiting in the sending thread */
+    RCE_PACE_TXTIME               = 1 << 22,
+
+    /** Send large frames with MSG_ZEROCOPY on Linux.
+     *
+     * The kernel sends the packets directly from the memory of the frame instead of copying
+     * every byte to its own buffers, which reduces the CPU usage of sending large frames.
+     * Frames smaller than ::RCC_ZEROCOPY_THRESHOLD are still copied.
+     *
+     * As the kernel reads the frame after push_frame() has returned, only frames given as
+     * std::unique_ptr, or as raw pointers with a deallocation hook installed, are sent without
+     * copying, and they are released only after the kernel has reported the sends completed.
+     * This also applies to a frame whose push_frame() fails after some of its packets have been sent.
+     * Works best together with ::RCE_UDP_GSO which lets the kernel send large datagrams.
+     *
+     * If MSG_ZEROCOPY is not available, the frames are copied as usual */
+    RCE_ZEROCOPY_SEND             = 1 << 23,
+
+    /** Return whole access units instead of individual NAL units when receiving H26X stream.
+     *
+     * The NAL units of one RTP timestamp, whether they arrive in their own packets, in aggregation
+     * packets or in fragmentation units, are collected until the packet with the marker bit and
+     * every packet before it have been received. They are then returned as one frame in which each
+     * NAL unit is preceded by a 4-byte start code (0x00000001), so ::RCE_H26X_PREPEND_SC is implied.
+     *
+     * Access units that are not complete within ::RCC_PKT_MAX_DELAY are dropped and reported to
+     * the notify hook with ::NR_FRAME_DROPPED, so the sender must set the marker bit on the last
+     * packet of each access unit */
+    RCE_H26X_ACCESS_UNITS         = 1 << 24,
+
+    /** Discard the H.26x frames the decoder cannot decode because a picture they depend on has been lost.
+     *
+     * The receiver follows the NAL unit types and temporal IDs of the frames. When it drops a frame,
+     * the frames of the same temporal sub-layer and the sub-layers above it are discarded until a
+     * random access point (IDR, CRA, BLA or GDR picture) or, for higher sub-layers, a TSA or STSA
+     * picture is received. The loss of a base sub-layer picture is reported to the notify hook
+     * with ::NR_KEYFRAME_NEEDED.
+     *
+     * Only the frames dropped by the receiver are noticed as losses, so a lost packet of a frame that
+     * is not fragmented goes unnoticed unless ::RCE_H26X_ACCESS_UNITS is used as well. Streams that use
+     * intra refresh instead of random access points stay discarded after a loss, so the flag is not
+     * suitable for them */
+    RCE_H26X_DROP_UNDECODABLE     = 1 << 25,
+
+    RCE_LAST                      = 1 << 26,
 };
 
 /**
@@ -269,7 +367,8 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
      * Default is 100 milliseconds
      *
      * This is valid only for fragmented frames,
-     * i.e. RTP_FORMAT_H26X and RTP_FORMAT_GENERIC with RCE_FRAGMENT_GENERIC (TODO) */
+     * i.e. RTP_FORMAT_H26X and RTP_FORMAT_GENERIC with RCE_FRAGMENT_GENERIC.
+     * Dropped frames are reported to the notify hook with ::NR_FRAME_DROPPED */
     RCC_PKT_MAX_DELAY    = 3,
 
     /** Overwrite uvgRTP's own payload type in RTP packets and specify your own
@@ -286,16 +385,115 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
      * to use jumbo frames, it can set the MTU size to 9000 bytes */
     RCC_MTU_SIZE         = 5,
 
+    /** How many datagrams the receiver reads from the socket with one system call
+     *
+     * Default is 32
+     *
+     * On Linux the datagrams are read using recvmmsg(2) which reduces the
+     * number of system calls needed per packet when the incoming bitrate is high.
+     * Setting this to 1 makes the receiver read one datagram per system call.
+     * At most 256 datagrams are read at once */
+    RCC_UDP_RCV_BATCH_SIZE = 6,
+
+    /** What the receiver does when the reception ring is full, see ::RTP_RING_OVERFLOW_POLICY
+     *
+     * Default is RRO_DROP_NEWEST
+     *
+     * The size of the reception ring is determined by RCC_UDP_RCV_BUF_SIZE */
+    RCC_RING_OVERFLOW_POLICY = 7,
+
+    /** Pace the outgoing RTP packets to this rate in kilobits per second
+     *
+     * Default is 0 which means that the packets of a frame are sent as fast as possible
+     *
+     * The packets of large frames are spread over time instead of sending them in
+     * one burst that can overflow the buffers of switches and receivers.
+     * Without ::RCE_PACE_TXTIME, push_frame() blocks until the last packet of the frame
+     * has been sent unless ::RCE_SYSTEM_CALL_DISPATCHER is used.
+     *
+     * This gives the media stream its own budget, see uvgrtp::session::enable_pacing
+     * for sharing one budget between the media streams of a session.
+     * Setting this to 0 removes the budget of the media stream so that it is paced with
+     * the budget of the session if pacing has been enabled for the session, otherwise not at all */
+    RCC_PACING_RATE      = 8,
+
+    /** How many bytes can be sent at once without pacing, see ::RCC_PACING_RATE
+     *
+     * Default is the amount of data sent in 2 milliseconds at the pacing rate, but at least 1500 bytes */
+    RCC_PACING_BURST     = 9,
+
+    /** Size of the smallest frame in bytes that is sent without copying, see ::RCE_ZEROCOPY_SEND
+     *
+     * Default is 16 kB. Small frames, such as audio, are cheaper to copy than to send with MSG_ZEROCOPY */
+    RCC_ZEROCOPY_THRESHOLD = 10,
+
+    /** Maximum number of RTP packets one frame can be split into
+     *
+     * The packet arrays of a frame are sized from the frame and grow as needed up to this limit.
+     * Default is 5000 packets, which is about 7 MB at the default MTU */
+    RCC_MAX_FRAME_PACKETS = 11,
+
+    /** How many packet arrays of sent frames are kept for reuse by the following frames
+     *
+     * Default is 10. A smaller value reduces the memory kept by media streams that are mostly idle,
+     * such as thousands of audio streams. 0 frees the arrays after each frame */
+    RCC_FRAME_CACHE_SIZE  = 12,
+
+    /** Send the packets of a frame in batches of this many packets while the frame is still being packetized
+     *
+     * By default every packet of a frame is built before the first one is sent. With batches, the first
+     * packets are sent sooner, packetization overlaps with sending and the memory used for the packets
+     * of a frame is bounded by the batch size, so frames are not limited by ::RCC_MAX_FRAME_PACKETS.
+     *
+     * Frames sent with ::RCE_SYSTEM_CALL_DISPATCHER are not sent in batches, and frames sent with
+     * ::RCE_ZEROCOPY_SEND keep their packets until the kernel has completed the sends so they are
+     * still limited by ::RCC_MAX_FRAME_PACKETS. Default is 0 which disables batches */
+    RCC_SEND_BATCH_SIZE   = 13,
+
     RCC_LAST
 };
 
-/// \cond DO_NOT_DOCUMENT
-enum NOTIFY_REASON {
+/**
+ * \enum RTP_RING_OVERFLOW_POLICY
+ *
+ * \brief Overflow policies of the reception ring
+ *
+ * \details These values are given to uvgrtp::media_stream::configure_ctx with ::RCC_RING_OVERFLOW_POLICY.
+ * Packets dropped by the policy can be queried with uvgrtp::media_stream::get_dropped_packets
+ */
+enum RTP_RING_OVERFLOW_POLICY {
+    /** Discard the packets that arrive while the ring is full */
+    RRO_DROP_NEWEST = 0,
+
+    /** Discard the oldest packets that have not yet been processed to make room for new ones */
+    RRO_DROP_OLDEST = 1,
+
+    /** Stop reading the socket until the processing thread has freed space in the ring
+     *
+     * Packets are not dropped by uvgRTP but the operating system may drop them
+     * if its receive buffer fills up while the receiver is blocked */
+    RRO_BLOCK       = 2,
+};
 
-    /* Timer for the active frame has expired and it has been dropped */
+/**
+ * \enum NOTIFY_REASON
+ *
+ * \brief Reasons given to the notify hook
+ *
+ * \details See uvgrtp::media_stream::install_notify_hook
+ */
+enum NOTIFY_REASON {
+    /** A fragmented frame was not completed within ::RCC_PKT_MAX_DELAY or it was
+     * pushed out by newer frames, and it has been dropped */
     NR_FRAME_DROPPED = 0,
+
+    /** A reference picture was lost and the frames depending on it are discarded until the next
+     * random access point, so the application should ask the sender for a keyframe.
+     * Reported once per loss with ::RCE_H26X_DROP_UNDECODABLE */
+    NR_KEYFRAME_NEEDED = 1,
 };
 
+/// \cond DO_NOT_DOCUMENT
 /* see src/util.hh for more information */
 typedef struct rtp_ctx_conf {
     int flags = 0;
@@ -6,6 +6,7 @@
 #include "uvgrtp/crypto.hh"
 
 #include "hostname.hh"
+#include "io_runtime.hh"
 #include "random.hh"
 
 #include <cstdlib>
@@ -43,7 +44,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr)
     if (remote_addr == "")
         return nullptr;
 
-    return new uvgrtp::session(remote_addr);
+    return new uvgrtp::session(remote_addr, runtime_);
 }
 
 uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::string local_addr)
@@ -51,7 +52,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string remote_addr, std::s
     if (remote_addr == "" || local_addr == "")
         return nullptr;
 
-    return new uvgrtp::session(remote_addr, local_addr);
+    return new uvgrtp::session(remote_addr, local_addr, runtime_);
 }
 
 rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
@@ -64,6 +65,21 @@ rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::context::enable_io_runtime(size_t workers)
+{
+    if (workers == 0 || runtime_)
+        return RTP_INVALID_VALUE;
+
+    auto runtime = std::shared_ptr<uvgrtp::io_runtime>(new uvgrtp::io_runtime(workers));
+    rtp_error_t ret = RTP_OK;
+
+    if ((ret = runtime->start()) != RTP_OK)
+        return ret;
+
+    runtime_ = runtime;
+    return RTP_OK;
+}
+
 std::string uvgrtp::context::generate_cname() const
 {
     std::string host = uvgrtp::hostname::get_hostname();
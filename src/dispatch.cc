@@ -0,0 +1,76 @@
+#include "dispatch.hh"
+
+#include "frame_queue.hh"
+
+#include "uvgrtp/socket.hh"
+#include "uvgrtp/debug.hh"
+
+uvgrtp::dispatcher::dispatcher(std::shared_ptr<uvgrtp::socket> socket):
+    socket_(socket),
+    should_stop_(false),
+    runner_(nullptr)
+{
+}
+
+uvgrtp::dispatcher::~dispatcher()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::dispatcher::start()
+{
+    should_stop_ = false;
+    runner_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::dispatcher::runner, this));
+
+    return RTP_OK;
+}
+
+void uvgrtp::dispatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        should_stop_ = true;
+    }
+    cond_.notify_one();
+
+    if (runner_ && runner_->joinable())
+        runner_->join();
+    runner_ = nullptr;
+}
+
+void uvgrtp::dispatcher::trigger_send(uvgrtp::transaction *transaction)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        queue_.push_back(transaction);
+    }
+    cond_.notify_one();
+}
+
+void uvgrtp::dispatcher::runner()
+{
+    std::deque<uvgrtp::transaction *> sending;
+    std::unique_lock<std::mutex> lk(mtx_);
+
+    while (true) {
+        cond_.wait(lk, [this] { return should_stop_ || !queue_.empty(); });
+
+        // the queue is drained before exiting so that every frame gets sent and released
+        if (queue_.empty())
+            break;
+
+        // take everything queued so far so the application is not blocked while we send
+        sending.swap(queue_);
+        lk.unlock();
+
+        for (auto& transaction : sending) {
+            if (socket_->sendto(transaction->headers, transaction->hdr_ptr, transaction->send_flags) != RTP_OK)
+                LOG_ERROR("Failed to send the packets of a transaction");
+
+            transaction->fqueue->complete_transaction(transaction);
+        }
+        sending.clear();
+
+        lk.lock();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace uvgrtp {
+
+    class socket;
+    struct transaction;
+
+    /* The system call dispatcher (SCD) sends the transactions of a frame queue from its own
+     * thread so that push_frame() returns as soon as the packets of the frame have been
+     * created, without entering the kernel.
+     *
+     * When the packets of a transaction have been sent, the transaction is given back to its
+     * frame queue which releases the memory of the frame (see install_dealloc_hook()) */
+    class dispatcher {
+        public:
+            dispatcher(std::shared_ptr<uvgrtp::socket> socket);
+            ~dispatcher();
+
+            /* Create the dispatcher thread
+             *
+             * Return RTP_OK on success */
+            rtp_error_t start();
+
+            /* Send the transactions that are still queued and stop the dispatcher thread */
+            void stop();
+
+            /* Queue "transaction" for sending and wake up the dispatcher thread */
+            void trigger_send(uvgrtp::transaction *transaction);
+
+        private:
+            void runner();
+
+            std::shared_ptr<uvgrtp::socket> socket_;
+
+            std::mutex mtx_;
+            std::condition_variable cond_;
+            std::deque<uvgrtp::transaction *> queue_;
+            bool should_stop_;
+
+            std::unique_ptr<std::thread> runner_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,347 @@
+#include "access_unit.hh"
+
+#include "reassembly.hh"
+
+#include "../frame_pool.hh"
+
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+#include <cstring>
+
+/* number of 64-bit words needed for one bit per sequence number */
+constexpr size_t SEEN_WORDS = 65536 / 64;
+
+static const uint8_t START_CODE[4] = { 0, 0, 0, 1 };
+
+uvgrtp::formats::access_units::access_units(uvgrtp::formats::reassembly& fragments):
+    fragments_(fragments),
+    units_(),
+    used_(),
+    seen_(SEEN_WORDS, 0),
+    has_finished_(false),
+    finished_seq_(0),
+    next_start_known_(false),
+    dropped_(),
+    dropped_count_(0),
+    dropped_head_(0),
+    timers_(nullptr),
+    notify_arg_(nullptr),
+    notify_hook_(nullptr),
+    drop_arg_(nullptr),
+    drop_hook_(nullptr)
+{}
+
+uvgrtp::formats::access_units::~access_units()
+{
+    for (size_t i = 0; i < MAX_UNITS; ++i) {
+        if (used_[i])
+            release(&units_[i], false, false);
+    }
+}
+
+void uvgrtp::formats::access_units::set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers)
+{
+    timers_ = timers;
+}
+
+void uvgrtp::formats::access_units::install_notify_hook(void *arg, void (*hook)(void *, int))
+{
+    notify_arg_  = arg;
+    notify_hook_ = hook;
+}
+
+void uvgrtp::formats::access_units::install_drop_hook(void *arg,
+    void (*hook)(void *, const uvgrtp::formats::access_unit *))
+{
+    drop_arg_  = arg;
+    drop_hook_ = hook;
+}
+
+void uvgrtp::formats::access_units::deadline_expired(void *arg, size_t index)
+{
+    auto units = (uvgrtp::formats::access_units *)arg;
+    auto au    = &units->units_[index];
+
+    LOG_WARN("Access unit was not completed in time, dropping it. Ts: %u, received %zu packets",
+        au->ts, au->packets);
+
+    units->release(au, true, true);
+}
+
+uvgrtp::formats::access_unit *uvgrtp::formats::access_units::find(uint32_t ts)
+{
+    for (size_t i = 0; i < MAX_UNITS; ++i) {
+        if (used_[i] && units_[i].ts == ts)
+            return &units_[i];
+    }
+
+    return nullptr;
+}
+
+bool uvgrtp::formats::access_units::is_late(uint16_t seq) const
+{
+    return has_finished_ && (uint16_t)(finished_seq_ - seq) < LATE_WINDOW;
+}
+
+bool uvgrtp::formats::access_units::is_dropped(uint32_t ts) const
+{
+    for (size_t i = 0; i < dropped_count_; ++i) {
+        if (dropped_[i] == ts)
+            return true;
+    }
+
+    return false;
+}
+
+void uvgrtp::formats::access_units::clear_seen(uint16_t first, uint16_t last)
+{
+    for (uint16_t seq = first; ; ++seq) {
+        seen_[seq >> 6] &= ~((uint64_t)1 << (seq & 63));
+
+        if (seq == last)
+            break;
+    }
+}
+
+uvgrtp::formats::access_unit *uvgrtp::formats::access_units::receive(const uvgrtp::frame::rtp_header& header,
+    size_t deadline_ms)
+{
+    uint16_t seq = header.seq;
+    uint64_t bit = (uint64_t)1 << (seq & 63);
+
+    if (is_late(seq) || is_dropped(header.timestamp)) {
+        LOG_DEBUG("Late packet of a finished access unit received, seq: %u", seq);
+        return nullptr;
+    }
+
+    if (seen_[seq >> 6] & bit) {
+        LOG_DEBUG("Duplicate packet received, seq: %u", seq);
+        return nullptr;
+    }
+
+    access_unit *au = find(header.timestamp);
+
+    if (!au) {
+        size_t index  = MAX_UNITS;
+        size_t oldest = 0;
+
+        for (size_t i = 0; i < MAX_UNITS; ++i) {
+            if (!used_[i]) {
+                index = i;
+                break;
+            }
+
+            if ((int16_t)(units_[i].first_seq - units_[oldest].first_seq) < 0)
+                oldest = i;
+        }
+
+        if (index == MAX_UNITS) {
+            LOG_WARN("Too many access units are being collected, dropping the oldest one. Ts: %u", units_[oldest].ts);
+            release(&units_[oldest], true, true);
+            index = oldest;
+        }
+
+        /* the fields are reset one by one so that the NAL unit list keeps its capacity */
+        au             = &units_[index];
+        au->ts         = header.timestamp;
+        au->first_seq  = seq;
+        au->last_seq   = seq;
+        au->packets    = 0;
+        au->has_marker = false;
+        au->size       = 0;
+        au->extended   = false;
+        au->picture    = uvgrtp::formats::picture_info();
+        used_[index]   = true;
+
+        if (timers_) {
+            au->deadline.callback = deadline_expired;
+            au->deadline.arg      = this;
+            au->deadline.tag      = index;
+
+            timers_->schedule(&au->deadline, deadline_ms);
+        }
+    }
+
+    seen_[seq >> 6] |= bit;
+
+    if ((int16_t)(seq - au->first_seq) < 0)
+        au->first_seq = seq;
+
+    if ((int16_t)(seq - au->last_seq) > 0)
+        au->last_seq = seq;
+
+    au->packets += 1;
+
+    if (header.marker) {
+        au->has_marker = true;
+        au->header     = header;
+    }
+
+    return au;
+}
+
+void uvgrtp::formats::access_units::extend(uvgrtp::formats::access_unit *au, size_t deadline_ms)
+{
+    if (au->extended || !timers_)
+        return;
+
+    timers_->schedule(&au->deadline, deadline_ms);
+    au->extended = true;
+}
+
+void uvgrtp::formats::access_units::add(uvgrtp::formats::access_unit *au, uvgrtp::frame::rtp_frame *frame,
+    size_t offset, size_t len, uint16_t seq, uint16_t index, bool owner)
+{
+    au_nal nal;
+
+    nal.frame  = frame;
+    nal.offset = offset;
+    nal.len    = len;
+    nal.seq    = seq;
+    nal.index  = index;
+    nal.owner  = owner;
+
+    au->nals.push_back(nal);
+    au->size += len;
+}
+
+void uvgrtp::formats::access_units::release(uvgrtp::formats::access_unit *au, bool dropped, bool notify)
+{
+    if (timers_)
+        timers_->cancel(&au->deadline);
+
+    if (dropped && drop_hook_)
+        drop_hook_(drop_arg_, au);
+
+    for (auto& nal : au->nals) {
+        if (nal.owner && nal.frame)
+            (void)uvgrtp::frame::dealloc_frame(nal.frame);
+    }
+
+    au->nals.clear();
+
+    if (au->packets > 0)
+        clear_seen(au->first_seq, au->last_seq);
+
+    if (dropped) {
+        dropped_[dropped_head_] = au->ts;
+        dropped_head_  = (dropped_head_ + 1) % DROPPED_HISTORY;
+        dropped_count_ = std::min(dropped_count_ + 1, DROPPED_HISTORY);
+
+        // the access unit ends with its marker packet. Without it, the packets
+        // after the last one received may still belong to this access unit
+        uint16_t last = au->has_marker ? au->header.seq : au->last_seq;
+
+        if (!has_finished_ || (int16_t)(last - finished_seq_) > 0) {
+            finished_seq_     = last;
+            has_finished_     = true;
+            next_start_known_ = au->has_marker;
+        }
+
+        // the NAL unit still being reassembled is dropped too and the reassembly reports it.
+        // If the reassembly has dropped it already, the loss has been reported
+        if (auto rf = fragments_.find(au->ts)) {
+            (void)fragments_.release(rf, true);
+            notify = false;
+        } else if (fragments_.is_dropped(au->ts)) {
+            notify = false;
+        }
+    }
+
+    used_[au - units_] = false;
+
+    if (dropped && notify && notify_hook_)
+        notify_hook_(notify_arg_, NR_FRAME_DROPPED);
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::access_units::merge(uvgrtp::formats::access_unit *au)
+{
+    uint16_t first_seq = au->first_seq;
+
+    std::sort(au->nals.begin(), au->nals.end(), [first_seq](const au_nal& a, const au_nal& b) {
+        uint16_t a_pos = a.seq - first_seq;
+        uint16_t b_pos = b.seq - first_seq;
+
+        return a_pos != b_pos ? a_pos < b_pos : a.index < b.index;
+    });
+
+    au_nal& only = au->nals.front();
+
+    // an access unit of one NAL unit that owns its frame is returned as is. The start code is written
+    // in front of the payload only if that does not overwrite the header extension, see frame_pool::headroom()
+    if (au->nals.size() == 1 && only.owner && only.offset == 0 && only.len == only.frame->payload_len) {
+        uvgrtp::frame::rtp_frame *frame = only.frame;
+
+        only.frame = nullptr;
+        uvgrtp::frame_pool::prepend_payload(frame, START_CODE, sizeof(START_CODE));
+        frame->header = au->header;
+
+        return frame;
+    }
+
+    uvgrtp::frame::rtp_frame *frame = uvgrtp::frame_pool::alloc_frame(au->size + au->nals.size() * sizeof(START_CODE));
+
+    if (!frame)
+        return nullptr;
+
+    frame->header = au->header;
+
+    uint8_t *ptr = frame->payload;
+
+    for (auto& nal : au->nals) {
+        std::memcpy(ptr, START_CODE, sizeof(START_CODE));
+        std::memcpy(ptr + sizeof(START_CODE), nal.frame->payload + nal.offset, nal.len);
+
+        ptr += sizeof(START_CODE) + nal.len;
+    }
+
+    return frame;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::access_units::finish(uvgrtp::formats::access_unit *au)
+{
+    // a fragmented NAL unit of the access unit has been dropped and reported by the reassembly
+    if (fragments_.is_dropped(au->ts)) {
+        release(au, true, false);
+        return nullptr;
+    }
+
+    if (!au->has_marker)
+        return nullptr;
+
+    uint16_t start = next_start_known_ ? (uint16_t)(finished_seq_ + 1) : au->first_seq;
+
+    if (au->packets != (size_t)(uint16_t)(au->header.seq - start) + 1 || fragments_.find(au->ts))
+        return nullptr;
+
+    if (au->nals.empty()) {
+        LOG_WARN("Access unit does not contain any valid NAL units, dropping it. Ts: %u", au->ts);
+        release(au, true, true);
+        return nullptr;
+    }
+
+    // the access units before this one can no longer be delivered in decoding order
+    for (size_t i = 0; i < MAX_UNITS; ++i) {
+        if (used_[i] && &units_[i] != au && (int16_t)(units_[i].first_seq - au->first_seq) < 0) {
+            LOG_WARN("Dropping an incomplete access unit since a later one is complete. Ts: %u", units_[i].ts);
+            release(&units_[i], true, true);
+        }
+    }
+
+    uvgrtp::frame::rtp_frame *frame = merge(au);
+
+    if (!frame) {
+        LOG_ERROR("Failed to allocate memory for the access unit");
+        release(au, true, true);
+        return nullptr;
+    }
+
+    finished_seq_     = au->header.seq;
+    has_finished_     = true;
+    next_start_known_ = true;
+
+    release(au, false, false);
+
+    return frame;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "references.hh"
+#include "../timer_wheel.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace formats {
+
+        class reassembly;
+
+        /* One NAL unit of an access unit, "len" bytes at "offset" of the payload of "frame" */
+        struct au_nal {
+            uvgrtp::frame::rtp_frame *frame = nullptr;
+            size_t offset = 0;
+            size_t len    = 0;
+
+            /* decoding order: sequence number of the (first) packet carrying the NAL unit
+             * and the position of the NAL unit in that packet */
+            uint16_t seq   = 0;
+            uint16_t index = 0;
+
+            /* The NAL units of an aggregation packet share the packet and only one of them releases it */
+            bool owner = false;
+        };
+
+        /* NAL units received so far for one RTP timestamp */
+        struct access_unit {
+            uint32_t ts = 0;
+
+            /* smallest and largest sequence number received for the access unit */
+            uint16_t first_seq = 0;
+            uint16_t last_seq  = 0;
+
+            /* how many distinct packets have been received */
+            size_t packets = 0;
+
+            /* header of the packet with the marker bit, valid if "has_marker" is set */
+            bool has_marker = false;
+            uvgrtp::frame::rtp_header header;
+
+            /* total size of the NAL units without start codes */
+            size_t size = 0;
+
+            std::vector<au_nal> nals;
+
+            /* drops the access unit if it has not been completed by its deadline */
+            uvgrtp::timer_wheel::timer deadline;
+
+            /* true if the deadline has been extended with access_units::extend() */
+            bool extended = false;
+
+            /* the picture of the access unit, set by the H.26x formats from the first slice received */
+            uvgrtp::formats::picture_info picture;
+        };
+
+        /* Collects the NAL units of each RTP timestamp into one access unit, see RCE_H26X_ACCESS_UNITS.
+         *
+         * An access unit is complete when the packet with the marker bit and every packet before it,
+         * counted from the marker packet of the previous access unit, have been received. If the previous
+         * access unit was dropped without its marker packet, the count starts from the first packet received.
+         * The NAL units are then copied in decoding order into one pooled buffer, each preceded
+         * by a 4-byte start code.
+         *
+         * Fragmented NAL units are reassembled by "fragments" and given to the access unit when they
+         * are complete. If an access unit is not completed by its deadline, it is dropped together
+         * with the fragmented NAL unit still being reassembled and the drop is reported to the
+         * notify hook with NR_FRAME_DROPPED.
+         *
+         * Access units are delivered in decoding order: when an access unit is completed,
+         * the unfinished access units before it are dropped and late packets of delivered
+         * and dropped access units are discarded */
+        class access_units {
+            public:
+                static constexpr size_t MAX_UNITS       = 8;
+                static constexpr size_t DROPPED_HISTORY = 16;
+
+                /* Sequence numbers at most this far behind the last completed access unit are late */
+                static constexpr uint16_t LATE_WINDOW   = 2048;
+
+                access_units(uvgrtp::formats::reassembly& fragments);
+                ~access_units();
+
+                /* Use the timer wheel of the reception flow for the deadlines of the access units */
+                void set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers);
+
+                /* Report dropped access units to "hook", see media_stream::install_notify_hook() */
+                void install_notify_hook(void *arg, void (*hook)(void *, int));
+
+                /* Call "hook" with each dropped access unit before it's released */
+                void install_drop_hook(void *arg, void (*hook)(void *, const access_unit *));
+
+                /* Account the packet with "header" to the access unit of its timestamp. A new access unit
+                 * must be completed in "deadline_ms" milliseconds. If MAX_UNITS access units are already
+                 * being collected, the oldest of them is dropped
+                 *
+                 * Return the access unit of the packet
+                 * Return nullptr if the packet is a duplicate or its access unit has already been delivered or dropped */
+                access_unit *receive(const uvgrtp::frame::rtp_header& header, size_t deadline_ms);
+
+                /* Give the access unit "deadline_ms" milliseconds from now to complete. Done only once per access unit */
+                void extend(access_unit *au, size_t deadline_ms);
+
+                /* Add the NAL unit at "offset" of "frame" to the access unit.
+                 * If "owner" is true, the access unit takes the ownership of "frame" */
+                void add(access_unit *au, uvgrtp::frame::rtp_frame *frame, size_t offset, size_t len,
+                    uint16_t seq, uint16_t index, bool owner);
+
+                /* Return the access unit as one frame if all of its packets have been received,
+                 * nullptr if it's not complete yet. An access unit whose fragmented NAL unit has been
+                 * dropped by the reassembly is released without reporting the drop again */
+                uvgrtp::frame::rtp_frame *finish(access_unit *au);
+
+            private:
+                /* Return the access unit of timestamp "ts", nullptr if it's not being collected */
+                access_unit *find(uint32_t ts);
+
+                /* Called by the timer wheel when access unit "index" has not been completed by its deadline */
+                static void deadline_expired(void *arg, size_t index);
+
+                /* Release the access unit and its NAL units. If "dropped" is true, late packets of the
+                 * access unit are discarded and the drop is reported to the notify hook if "notify" is true */
+                void release(access_unit *au, bool dropped, bool notify);
+
+                /* Copy the NAL units to one buffer in decoding order with start codes between them */
+                uvgrtp::frame::rtp_frame *merge(access_unit *au);
+
+                bool is_late(uint16_t seq) const;
+                bool is_dropped(uint32_t ts) const;
+
+                /* Mark the packets "first" to "last" as not received */
+                void clear_seen(uint16_t first, uint16_t last);
+
+                uvgrtp::formats::reassembly& fragments_;
+
+                access_unit units_[MAX_UNITS];
+                bool used_[MAX_UNITS];
+
+                /* one bit for every sequence number of the packets of the access units being collected */
+                std::vector<uint64_t> seen_;
+
+                /* the last packet of the previous delivered or dropped access unit, valid if "has_finished_" is set */
+                bool has_finished_;
+                uint16_t finished_seq_;
+
+                /* true if "finished_seq_" is the marker packet of a delivered or dropped access unit,
+                 * so the next access unit starts right after it */
+                bool next_start_known_;
+
+                uint32_t dropped_[DROPPED_HISTORY];
+                size_t dropped_count_;
+                size_t dropped_head_;
+
+                std::shared_ptr<uvgrtp::timer_wheel> timers_;
+
+                void *notify_arg_;
+                void (*notify_hook_)(void *, int);
+
+                void *drop_arg_;
+                void (*drop_hook_)(void *, const access_unit *);
+        };
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,6 +1,7 @@
 #include "h264.hh"
 
 #include "../frame_queue.hh"
+#include "../frame_pool.hh"
 #include "../rtp.hh"
 
 #include "uvgrtp/debug.hh"
@@ -40,11 +41,6 @@ uint8_t uvgrtp::formats::h264::get_fu_header_size() const
     return uvgrtp::frame::HEADER_SIZE_H264_FU;
 }
 
-uint8_t uvgrtp::formats::h264::get_start_code_range() const
-{
-    return 1; // H264 can have three byte start codes and therefore we must scan one byte at a time
-}
-
 int uvgrtp::formats::h264::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
 {
     bool first_frag = frame->payload[1] & 0x80;
@@ -68,15 +64,20 @@ int uvgrtp::formats::h264::get_fragment_type(uvgrtp::frame::rtp_frame* frame) co
     return uvgrtp::formats::FT_MIDDLE;
 }
 
-uvgrtp::formats::NAL_TYPES uvgrtp::formats::h264::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
+uvgrtp::formats::picture_info uvgrtp::formats::h264::get_picture_info(const uint8_t* nal_header) const
 {
-    switch (frame->payload[1] & 0x1f) {
-    case 19: return uvgrtp::formats::NT_INTRA;
-    case 1:  return uvgrtp::formats::NT_INTER;
-    default: break;
-    }
+    uvgrtp::formats::picture_info info;
+    uint8_t nal_type = nal_header[0] & 0x1f;
+
+    // coded slices, including the data partitions and IDR slices
+    if (nal_type < 1 || nal_type > 5)
+        return info;
 
-    return uvgrtp::formats::NT_OTHER;
+    info.vcl       = true;
+    info.irap      = (nal_type == 5);
+    info.reference = ((nal_header[0] >> 5) & 0x3) != 0; // nal_ref_idc
+
+    return info;
 }
 
 uint8_t uvgrtp::formats::h264::get_nal_type(uint8_t* data) const
@@ -132,7 +133,9 @@ rtp_error_t uvgrtp::formats::h264::finalize_aggregation_pkt()
         }
     }
 
-    if ((ret = fqueue_->enqueue_message(aggr_pkt_info_.aggr_pkt)) != RTP_OK) {
+    /* the aggregation info is cleared after push_frame() so the packet must be copied
+     * if it is sent by the system call dispatcher */
+    if ((ret = fqueue_->enqueue_message(aggr_pkt_info_.aggr_pkt, true)) != RTP_OK) {
         LOG_ERROR("Failed to enqueue NALUs of an aggregation packet!");
     }
 
@@ -163,15 +166,13 @@ void uvgrtp::formats::h264::get_nal_header_from_fu_headers(size_t fptr, uint8_t*
 uvgrtp::frame::rtp_frame* uvgrtp::formats::h264::allocate_rtp_frame_with_startcode(bool add_start_code,
     uvgrtp::frame::rtp_header& header, size_t payload_size_without_startcode, size_t& fptr)
 {
-    uvgrtp::frame::rtp_frame* complete = uvgrtp::frame::alloc_rtp_frame();
-
-    complete->payload_len = payload_size_without_startcode;
+    size_t payload_len = payload_size_without_startcode;
 
     if (add_start_code) {
-        complete->payload_len += 3;
+        payload_len += 3;
     }
 
-    complete->payload = new uint8_t[complete->payload_len];
+    uvgrtp::frame::rtp_frame* complete = uvgrtp::frame_pool::alloc_frame(payload_len);
 
     if (add_start_code) {
         complete->payload[0] = 0;
@@ -188,16 +189,11 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h264::allocate_rtp_frame_with_startco
 void uvgrtp::formats::h264::prepend_start_code(int flags, uvgrtp::frame::rtp_frame** out)
 {
     if (flags & RCE_H26X_PREPEND_SC) {
-        uint8_t* pl = new uint8_t[(*out)->payload_len + 3];
-
-        pl[0] = 0;
-        pl[1] = 0;
-        pl[2] = 1;
-
-        std::memcpy(pl + 3, (*out)->payload, (*out)->payload_len);
-        delete[](*out)->payload;
+        uint8_t start_code[3] = { 0, 0, 1 };
 
-        (*out)->payload = pl;
-        (*out)->payload_len += 3;
+        /* Done in place if the payload buffer has room for the start code in front of the payload:
+         * pooled payload buffers reserve room for it and with RCE_ZERO_COPY_RECEIVE the start code
+         * is written over the already parsed RTP header */
+        uvgrtp::frame_pool::prepend_payload(*out, start_code, 3);
     }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include "uvgrtp/debug.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -43,11 +44,6 @@ uint8_t uvgrtp::formats::h265::get_fu_header_size() const
     return uvgrtp::frame::HEADER_SIZE_H265_FU;
 }
 
-uint8_t uvgrtp::formats::h265::get_start_code_range() const
-{
-    return 4;
-}
-
 uint8_t uvgrtp::formats::h265::get_nal_type(uint8_t* data) const
 {
     return (data[0] >> 1) & 0x3f;
@@ -76,15 +72,27 @@ int uvgrtp::formats::h265::get_fragment_type(uvgrtp::frame::rtp_frame* frame) co
     return uvgrtp::formats::FT_MIDDLE;
 }
 
-uvgrtp::formats::NAL_TYPES uvgrtp::formats::h265::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
+uvgrtp::formats::picture_info uvgrtp::formats::h265::get_picture_info(const uint8_t* nal_header) const
 {
-    switch (frame->payload[2] & 0x3f) {
-    case 19: return uvgrtp::formats::NT_INTRA;
-    case 1:  return uvgrtp::formats::NT_INTER;
-    default: break;
-    }
+    uvgrtp::formats::picture_info info;
+    uint8_t nal_type = (nal_header[0] >> 1) & 0x3f;
+
+    // VCL NAL unit types are 0 - 31 and the random access points are 16 - 23
+    if (nal_type > 31)
+        return info;
+
+    info.vcl         = true;
+    info.irap        = (nal_type >= 16 && nal_type <= 23);
+    info.broken_link = (nal_type >= 16 && nal_type <= 18);
+    info.rasl        = (nal_type == 8 || nal_type == 9);
+    info.tsa         = (nal_type == 2 || nal_type == 3);
+    info.stsa        = (nal_type == 4 || nal_type == 5);
+    info.temporal_id = (uint8_t)std::max(0, (nal_header[1] & 0x7) - 1);
+
+    // the even types below 16 (TRAIL_N, TSA_N, ...) are sub-layer non-reference pictures
+    info.reference   = (nal_type >= 16 || (nal_type & 1));
 
-    return uvgrtp::formats::NT_OTHER;
+    return info;
 }
 
 void uvgrtp::formats::h265::clear_aggregation_info()
@@ -137,7 +145,9 @@ rtp_error_t uvgrtp::formats::h265::finalize_aggregation_pkt()
         }
     }
 
-    if ((ret = fqueue_->enqueue_message(aggr_pkt_info_.aggr_pkt)) != RTP_OK) {
+    /* the aggregation info is cleared after push_frame() so the packet must be copied
+     * if it is sent by the system call dispatcher */
+    if ((ret = fqueue_->enqueue_message(aggr_pkt_info_.aggr_pkt, true)) != RTP_OK) {
         LOG_ERROR("Failed to enqueue buffers of an aggregation packet!");
         return ret;
     }
@@ -63,9 +63,8 @@ namespace uvgrtp {
                 virtual uint8_t get_payload_header_size() const;
                 virtual uint8_t get_nal_header_size() const;
                 virtual uint8_t get_fu_header_size() const;
-                virtual uint8_t get_start_code_range() const;
                 virtual int get_fragment_type(uvgrtp::frame::rtp_frame* frame) const;
-                virtual uvgrtp::formats::NAL_TYPES get_nal_type(uvgrtp::frame::rtp_frame* frame) const;
+                virtual uvgrtp::formats::picture_info get_picture_info(const uint8_t* nal_header) const;
 
             private:
                 h265_aggregation_packet aggr_pkt_info_;
@@ -6,6 +6,7 @@
 #include "uvgrtp/frame.hh"
 #include "uvgrtp/debug.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -44,11 +45,6 @@ uint8_t uvgrtp::formats::h266::get_fu_header_size() const
     return uvgrtp::frame::HEADER_SIZE_H266_FU;
 }
 
-uint8_t uvgrtp::formats::h266::get_start_code_range() const
-{
-    return 4;
-}
-
 uint8_t uvgrtp::formats::h266::get_nal_type(uint8_t* data) const
 {
     return (data[1] >> 3) & 0x1f;
@@ -74,15 +70,31 @@ int uvgrtp::formats::h266::get_fragment_type(uvgrtp::frame::rtp_frame* frame) co
     return uvgrtp::formats::FT_MIDDLE;
 }
 
-uvgrtp::formats::NAL_TYPES uvgrtp::formats::h266::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
+uvgrtp::formats::picture_info uvgrtp::formats::h266::get_picture_info(const uint8_t* nal_header) const
 {
-    switch (frame->payload[2] & 0x3f) {
-    case 19: return uvgrtp::formats::NT_INTRA;
-    case 1:  return uvgrtp::formats::NT_INTER;
-    default: break;
-    }
+    uvgrtp::formats::picture_info info;
+    uint8_t nal_type = (nal_header[1] >> 3) & 0x1f;
+
+    // VCL NAL unit types are 0 - 11 and the random access points are 7 - 11 (GDR is 10)
+    if (nal_type > 11)
+        return info;
+
+    /* Whether a picture is a sub-layer non-reference picture is signaled in
+     * the picture header, so every picture is considered a reference picture */
+    info.vcl         = true;
+    info.irap        = (nal_type >= 7);
+    info.rasl        = (nal_type == 3);
+    info.stsa        = (nal_type == 1);
+    info.temporal_id = (uint8_t)std::max(0, (nal_header[1] & 0x7) - 1);
+
+    return info;
+}
 
-    return uvgrtp::formats::NT_OTHER;
+void uvgrtp::formats::h266::get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload)
+{
+    // the NAL unit type is in the FU header and the rest of the NAL unit header is in the payload header
+    complete_payload[fptr]     = frame_payload[0];
+    complete_payload[fptr + 1] = (uint8_t)(((frame_payload[2] & 0x1f) << 3) | (frame_payload[1] & 0x7));
 }
 
 rtp_error_t uvgrtp::formats::h266::construct_format_header_divide_fus(uint8_t* data, size_t data_len,
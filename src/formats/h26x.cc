@@ -1,5 +1,8 @@
 #include "h26x.hh"
 
+#include "scl.hh"
+
+#include "../frame_pool.hh"
 #include "../rtp.hh"
 #include "../frame_queue.hh"
 
@@ -7,6 +10,7 @@
 #include "uvgrtp/debug.hh"
 
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -19,247 +23,32 @@
 #endif
 
 
-#define PTR_DIFF(a, b)  ((ptrdiff_t)((char *)(a) - (char *)(b)))
-
-#define haszero64_le(v) (((v) - 0x0101010101010101) & ~(v) & 0x8080808080808080UL)
-#define haszero32_le(v) (((v) - 0x01010101)         & ~(v) & 0x80808080UL)
-
-#define haszero64_be(v) (((v) - 0x1010101010101010) & ~(v) & 0x0808080808080808UL)
-#define haszero32_be(v) (((v) - 0x10101010)         & ~(v) & 0x08080808UL)
-
-#ifndef __LITTLE_ENDIAN
-#define __LITTLE_ENDIAN 1337
-#endif
-
-#ifndef __BYTE_ORDER
-#define __BYTE_ORDER __LITTLE_ENDIAN
-#endif
-
-constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
-constexpr int LOST_FRAME_TIMEOUT_MS = 500;
-
-static inline unsigned __find_h26x_start(uint32_t value,bool& additional_byte)
-{
-    additional_byte = false;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-    uint16_t u = (value >> 16) & 0xffff;
-    uint16_t l = (value >>  0) & 0xffff;
-
-    bool t1 = (l == 0);
-    bool t2 = ((u & 0xff) == 0x01);
-    bool t3 = (u == 0x0100);
-    bool t4 = (((l >> 8) & 0xff) == 0);
-#else
-    uint16_t u = (value >>  0) & 0xffff;
-    uint16_t l = (value >> 16) & 0xffff;
-
-    bool t1 = (l == 0);
-    bool t2 = (((u >> 8) & 0xff) == 0x01);
-    bool t3 = (u == 0x0001);
-    bool t4 = ((l & 0xff) == 0);
-#endif
-
-    if (t1) {
-        /* 0x00000001 */
-        if (t3)
-            return 4;
-
-        /* "value" definitely has a start code (0x000001XX), but at this
-         * point we can't know for sure whether it's 3 or 4 bytes long.
-         *
-         * Return 5 to indicate that start length could not be determined
-         * and that caller must check previous dword's last byte for 0x00 */
-        if (t2)
-            return 5;
-    } else if (t4 && t3) {
-        /* 0xXX000001 */
-        additional_byte = true;
-        return 4;
-    }
-
-    return 0;
-}
+/* How long an incomplete intra frame is waited for at least, see RCE_NO_H26X_INTRA_DELAY */
+constexpr int INTRA_TIMEOUT_MS = 500;
 
 uvgrtp::formats::h26x::h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int flags) :
     media(socket, rtp, flags), 
     queued_(), 
-    frames_(), 
-    dropped_(), 
     rtp_ctx_(rtp),
-    last_garbage_collection_(uvgrtp::clock::hrc::now())
-{}
+    access_units_(minfo_.frames),
+    nal_frame_(false),
+    intra_ts_(INVALID_TS),
+    references_()
+{
+    minfo_.frames.install_drop_hook(this, frame_dropped);
+    access_units_.install_drop_hook(this, access_unit_dropped);
+}
 
 uvgrtp::formats::h26x::~h26x()
 {
     for (auto& frame : queued_)
     {
-        delete[] frame;
+        (void)uvgrtp::frame::dealloc_frame(frame);
     }
 
     queued_.clear();
 }
 
-/* NOTE: the area 0 - len (ie data[0] - data[len - 1]) must be addressable
- * Do not add offset to "data" ptr before passing it to find_h26x_start_code()! */
-ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
-    uint8_t *data,
-    size_t len,
-    size_t offset,
-    uint8_t& start_len
-)
-{
-    bool prev_z   = false;
-    bool cur_z    = false;
-    size_t pos    = offset;
-    size_t rpos   = len - (len % 8) - 1;
-    uint8_t *ptr  = data + offset;
-    uint8_t *tmp  = nullptr;
-    uint8_t lb    = 0;
-    uint32_t prev = UINT32_MAX;
-
-    uint64_t prefetch = UINT64_MAX;
-    uint32_t value    = UINT32_MAX;
-    unsigned ret      = 0;
-
-    /* We can get rid of the bounds check when looping through
-     * non-zero 8 byte chunks by setting the last byte to zero.
-     *
-     * This added zero will make the last 8 byte zero check to fail
-     * and when we get out of the loop we can check if we've reached the end */
-    lb = data[rpos];
-    data[rpos] = 0;
-
-    while (pos + 8 < len) {
-        prefetch = *(uint64_t *)ptr;
-
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        if (!prev_z && !(cur_z = haszero64_le(prefetch))) {
-#else
-        if (!prev_z && !(cur_z = haszero64_be(prefetch))) {
-#endif
-            /* pos is not used in the following loop so it makes little sense to
-             * update it on every iteration. Faster way to do the loop is to save
-             * ptr's current value before loop, update only ptr in the loop and when
-             * the loop is exited, calculate the difference between tmp and ptr to get
-             * the number of iterations done * 8 */
-            tmp = ptr;
-
-            do {
-                ptr      += 8;
-                prefetch  = *(uint64_t *)ptr;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-                cur_z     = haszero64_le(prefetch);
-#else
-                cur_z     = haszero64_be(prefetch);
-#endif
-            } while (!cur_z);
-
-            pos += PTR_DIFF(ptr, tmp);
-
-            if (pos + 8 >= len)
-                break;
-        }
-
-        value = *(uint32_t *)ptr;
-
-        if (cur_z)
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            cur_z = haszero32_le(value);
-#else
-            cur_z = haszero32_be(value);
-#endif
-
-        if (!prev_z && !cur_z)
-            goto end;
-
-        /* Previous dword had zeros but this doesn't. The only way there might be a start code
-         * is if the most significant byte of current dword is 0x01 */
-        if (prev_z && !cur_z) {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            /* previous dword: 0xXX000000 or 0xXXXX0000 and current dword 0x01XXXXXX */
-            if (((value  >> 0) & 0xff) == 0x01 && ((prev >> 16) & 0xffff) == 0) {
-                start_len = (((prev >>  8) & 0xffffff) == 0) ? 4 : 3;
-#else
-            if (((value >> 24) & 0xff) == 0x01 && ((prev >>  0) & 0xffff) == 0) {
-                start_len = (((prev >>  0) & 0xffffff) == 0) ? 4 : 3;
-#endif
-                data[rpos] = lb;
-                return pos + 1;
-            }
-        }
-
-
-        {
-            bool additional_byte =  false;
-            if ((ret = start_len = __find_h26x_start(value,additional_byte)) > 0) {
-                if (ret == 5) {
-                    ret = 3;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-                    start_len = (((prev >> 24) & 0xff) == 0) ? 4 : 3;
-#else
-                    start_len = (((prev >>  0) & 0xff) == 0) ? 4 : 3;
-#endif
-                }
-                if (additional_byte) start_len--;
-                data[rpos] = lb;
-                return pos + ret;
-            }
-
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            uint16_t u = (value >> 16) & 0xffff;
-            uint16_t l = (value >>  0) & 0xffff;
-            uint16_t p = (prev  >> 16) & 0xffff;
-
-            bool t1 = ((p & 0xffff) == 0);
-            bool t2 = (((p >> 8) & 0xff) == 0);
-            bool t4 = (l == 0x0100);
-            bool t5 = (l == 0x0000 && u == 0x01);
-#else
-            uint16_t u = (value >>  0) & 0xffff;
-            uint16_t l = (value >> 16) & 0xffff;
-            uint16_t p = (prev  >>  0) & 0xffff;
-
-            bool t1 = ((p & 0xffff) == 0);
-            bool t2 = ((p & 0xff) == 0);
-            bool t4 = (l == 0x0001);
-            bool t5 = (l == 0x0000 && u == 0x01);
-#endif
-            if (t1 && t4) {
-                /* previous dword 0xxxxx0000 and current dword is 0x0001XXXX */
-                if (t4) {
-                    start_len = 4;
-                    data[rpos] = lb;
-                    return pos + 2;
-                }
-            /* Previous dwod was 0xXXXXXX00 */
-            } else if (t2) {
-                /* Current dword is 0x000001XX */
-                if (t5) {
-                    start_len = 4;
-                    data[rpos] = lb;
-                    return pos + 3;
-                }
-
-                /* Current dword is 0x0001XXXX */
-                else if (t4) {
-                    start_len = 3;
-                    data[rpos] = lb;
-                    return pos + 2;
-                }
-            }
-
-        }
-end:
-        prev_z = cur_z;
-        pos += get_start_code_range();
-        ptr += get_start_code_range();
-        prev = value;
-    }
-
-    data[rpos] = lb;
-    return -1;
-}
-
 rtp_error_t uvgrtp::formats::h26x::frame_getter(uvgrtp::frame::rtp_frame** frame)
 {
     if (queued_.size()) {
@@ -278,7 +67,12 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
-    if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
+    if (nal_frame_) {
+        LOG_ERROR("The frame started with begin_frame() must be ended before pushing another frame");
+        return RTP_INVALID_VALUE;
+    }
+
+    if ((ret = fqueue_->init_transaction(data, data_len)) != RTP_OK) {
         LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
     }
@@ -295,6 +89,7 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
         nal.prefix_len = 0;
         nal.size = data_len;
         nal.aggregate = false;
+        nal.data = data;
 
         nals.push_back(nal);
     }
@@ -305,9 +100,55 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
     if (nals.empty())
     {
         LOG_ERROR("Did not find any NAL units in frame. Cannot send.");
+        (void)fqueue_->deinit_transaction();
+        return RTP_INVALID_VALUE;
+    }
+
+    return send_nal_units(nals, should_aggregate, payload_size);
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_media_nal_units(const uvgrtp::frame::nal_unit *units, size_t unit_count, int flags)
+{
+    (void)flags;
+
+    rtp_error_t ret = RTP_OK;
+
+    if (nal_frame_) {
+        LOG_ERROR("The frame started with begin_frame() must be ended before pushing another frame");
         return RTP_INVALID_VALUE;
     }
 
+    // the NAL units are known so they are used as is, without searching for start codes
+    std::vector<nal_info> nals(unit_count);
+    size_t frame_size = 0;
+
+    for (size_t i = 0; i < unit_count; ++i) {
+        uint8_t *data   = units[i].data;
+        size_t data_len = units[i].len;
+
+        if (!data || !data_len || !strip_start_code(data, data_len))
+            return RTP_INVALID_VALUE;
+
+        nals[i].data = data;
+        nals[i].size = data_len;
+        frame_size  += data_len;
+    }
+
+    if ((ret = fqueue_->init_transaction(frame_size)) != RTP_OK) {
+        LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    size_t payload_size   = rtp_ctx_->get_payload_size();
+    bool should_aggregate = mark_aggregatable(nals, payload_size);
+
+    return send_nal_units(nals, should_aggregate, payload_size);
+}
+
+rtp_error_t uvgrtp::formats::h26x::send_nal_units(std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size)
+{
+    rtp_error_t ret = RTP_OK;
+
     if (should_aggregate) // an aggregate packet is possible
     {
         // use aggregation function that also may just send the packets as Single NAL units 
@@ -317,7 +158,7 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
         {
             if (nal.aggregate)
             {
-                if ((ret = add_aggregate_packet(data + nal.offset, nal.size)) != RTP_OK)
+                if ((ret = add_aggregate_packet(nal.data, nal.size)) != RTP_OK)
                 {
                     clear_aggregation_info();
                     fqueue_->deinit_transaction();
@@ -337,11 +178,11 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
             // add anything extra to the packet and we can just compare the NAL size with the payload size allowed
             if (nal.size <= payload_size) // send as a single NAL unit packet
             {
-                ret = single_nal_unit(data + nal.offset, nal.size);
+                ret = single_nal_unit(nal.data, nal.size);
             }
             else // send divided based on payload_size
             {
-                ret = fu_division(&data[nal.offset], nal.size, payload_size);
+                ret = fu_division(nal.data, nal.size, payload_size);
             }
 
             if (ret != RTP_OK)
@@ -360,6 +201,77 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(uint8_t* data, size_t data_l
     return ret;
 }
 
+rtp_error_t uvgrtp::formats::h26x::begin_frame()
+{
+    if (nal_frame_) {
+        LOG_ERROR("The previous frame has not been ended with end_frame()");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* The dispatcher sends whole transactions so the NAL units could not be sent right away */
+    if (flags_ & RCE_SYSTEM_CALL_DISPATCHER) {
+        LOG_ERROR("Frames cannot be sent one NAL unit at a time with RCE_SYSTEM_CALL_DISPATCHER");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    rtp_error_t ret = RTP_OK;
+
+    // the transaction gets the timestamp of the frame so all NAL units share it
+    if ((ret = fqueue_->init_transaction((size_t)0)) != RTP_OK) {
+        LOG_ERROR("Failed to initialize transaction!");
+        return ret;
+    }
+
+    nal_frame_ = true;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_nal(uint8_t *data, size_t data_len)
+{
+    if (!nal_frame_) {
+        LOG_ERROR("The frame must be started with begin_frame() before pushing NAL units");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (!data || !data_len)
+        return RTP_INVALID_VALUE;
+
+    if (!strip_start_code(data, data_len))
+        return RTP_INVALID_VALUE;
+
+    size_t payload_size = rtp_ctx_->get_payload_size();
+    rtp_error_t ret     = RTP_OK;
+
+    if (data_len <= payload_size)
+        ret = single_nal_unit(data, data_len);
+    else
+        ret = fu_division(data, data_len, payload_size);
+
+    if (ret == RTP_OK)
+        ret = fqueue_->flush_partial();
+
+    if (ret != RTP_OK) {
+        (void)fqueue_->deinit_transaction();
+        nal_frame_ = false;
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::h26x::end_frame()
+{
+    if (!nal_frame_) {
+        LOG_ERROR("No frame has been started with begin_frame()");
+        return RTP_INVALID_VALUE;
+    }
+
+    nal_frame_ = false;
+
+    // the marker bit tells the receiver that the access unit is complete
+    fqueue_->set_marker();
+    return fqueue_->flush_queue();
+}
+
 rtp_error_t uvgrtp::formats::h26x::fu_division(uint8_t *data, size_t data_len, size_t payload_size)
 {
     if (data_len == 0 || data_len <= payload_size)
@@ -380,6 +292,9 @@ rtp_error_t uvgrtp::formats::h26x::fu_division(uint8_t *data, size_t data_len, s
         return RTP_GENERIC_ERROR;
     }
 
+    // the vector still holds the fragments of the previous NAL unit of the frame
+    buffers->clear();
+
     rtp_error_t ret = RTP_OK;
     if ((ret = construct_format_header_divide_fus(data, data_len, payload_size, *buffers)) != RTP_OK)
         return ret;
@@ -477,15 +392,13 @@ void uvgrtp::formats::h26x::initialize_fu_headers(uint8_t nal_type, uint8_t fu_h
 uvgrtp::frame::rtp_frame* uvgrtp::formats::h26x::allocate_rtp_frame_with_startcode(bool add_start_code,
     uvgrtp::frame::rtp_header& header, size_t payload_size_without_startcode, size_t& fptr)
 {
-    uvgrtp::frame::rtp_frame* complete = uvgrtp::frame::alloc_rtp_frame();
-
-    complete->payload_len = payload_size_without_startcode;
+    size_t payload_len = payload_size_without_startcode;
 
     if (add_start_code) {
-        complete->payload_len += 4;
-    } 
-    
-    complete->payload = new uint8_t[complete->payload_len];
+        payload_len += 4;
+    }
+
+    uvgrtp::frame::rtp_frame* complete = uvgrtp::frame_pool::alloc_frame(payload_len);
 
     if (add_start_code) {
         complete->payload[0] = 0;
@@ -503,100 +416,144 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h26x::allocate_rtp_frame_with_startco
 void uvgrtp::formats::h26x::prepend_start_code(int flags, uvgrtp::frame::rtp_frame** out)
 {
     if (flags & RCE_H26X_PREPEND_SC) {
-        uint8_t* pl = new uint8_t[(*out)->payload_len + 4];
+        uint8_t start_code[4] = { 0, 0, 0, 1 };
 
-        pl[0] = 0;
-        pl[1] = 0;
-        pl[2] = 0;
-        pl[3] = 1;
+        /* Done in place if the payload buffer has room for the start code in front of the payload:
+         * pooled payload buffers reserve room for it and with RCE_ZERO_COPY_RECEIVE the start code
+         * is written over the already parsed RTP header */
+        uvgrtp::frame_pool::prepend_payload(*out, start_code, 4);
+    }
+}
 
-        std::memcpy(pl + 4, (*out)->payload, (*out)->payload_len);
-        delete[](*out)->payload;
+uint32_t uvgrtp::formats::h26x::drop_frame(uvgrtp::formats::reassembly_frame *rf)
+{
+    LOG_INFO("Dropping frame. Ts: %u, Seq: %u - %u, expected/received: %zu/%zu",
+        rf->ts, rf->has_start ? rf->s_seq : 0, rf->has_end ? rf->e_seq : 0,
+        minfo_.frames.expected(rf), rf->pkts_received);
 
-        (*out)->payload = pl;
-        (*out)->payload_len += 4;
-    }
+    return minfo_.frames.release(rf, true);
 }
 
-bool uvgrtp::formats::h26x::is_frame_late(uvgrtp::formats::h26x_info_t& hinfo, size_t max_delay)
+uvgrtp::formats::picture_info uvgrtp::formats::h26x::packet_picture(uvgrtp::frame::rtp_frame *frame)
 {
-    return (uvgrtp::clock::hrc::diff_now(hinfo.sframe_time) >= max_delay);
+    int frag_type = get_fragment_type(frame);
+
+    if (frag_type == FT_NOT_FRAG)
+        return get_picture_info(frame->payload);
+
+    if (frag_type == FT_AGGR || frag_type == FT_INVALID)
+        return uvgrtp::formats::picture_info();
+
+    // the NAL unit header of a fragmented NAL unit is carried in the FU headers of every fragment
+    uint8_t nal_header[2] = { 0, 0 };
+    get_nal_header_from_fu_headers(0, frame->payload, nal_header);
+
+    return get_picture_info(nal_header);
 }
 
-uint32_t uvgrtp::formats::h26x::drop_frame(uint32_t ts)
+bool uvgrtp::formats::h26x::decodable(uint32_t ts, uint16_t seq, const uvgrtp::formats::picture_info& info)
 {
-    uint16_t s_seq = frames_.at(ts).s_seq;
-    uint16_t e_seq = frames_.at(ts).e_seq;
+    if (!(flags_ & RCE_H26X_DROP_UNDECODABLE) || !info.vcl || references_.decodable(ts, seq, info))
+        return true;
 
-    if (s_seq == INVALID_SEQ)
-    {
-        s_seq = 0;
-    }
-    if (e_seq == INVALID_SEQ)
-    {
-        e_seq = 0;
-    }
+    LOG_DEBUG("Discarding a frame that depends on a lost picture. Ts: %u, Seq: %u", ts, seq);
+    return false;
+}
 
-    LOG_INFO("Dropping frame. Ts: %lu, Seq: %u - %u, expected/received: %li/%li", 
-        ts, s_seq, e_seq, calculate_expected_fus(ts), frames_[ts].pkts_received);
+void uvgrtp::formats::h26x::frame_dropped(void *arg, const uvgrtp::formats::reassembly_frame *rf)
+{
+    auto format = (uvgrtp::formats::h26x *)arg;
 
-    if (frames_.find(ts) == frames_.end())
-    {
-        LOG_ERROR("Tried to drop a non-existing frame");
-        return 0;
-    }
+    if (rf->ts == format->intra_ts_)
+        format->intra_ts_ = INVALID_TS;
 
-    uint32_t total_cleaned = 0;
+    if (!(format->flags_ & RCE_H26X_DROP_UNDECODABLE))
+        return;
 
-    // clean fragments
-    for (auto& fragment : frames_[ts].fragments) {
-        total_cleaned += fragment.second->payload_len + sizeof(uvgrtp::frame::rtp_frame);
-        (void)uvgrtp::frame::dealloc_frame(fragment.second);
-    }
-    frames_[ts].fragments.clear();
+    uint16_t seq = rf->s_seq;
 
-    // clean fragments that have no place
-    for (auto& temporary : frames_[ts].temporary) {
-        total_cleaned += temporary->payload_len + sizeof(uvgrtp::frame::rtp_frame);;
-        (void)uvgrtp::frame::dealloc_frame(temporary);
-    }
+    if (!rf->has_start && rf->frame)
+        seq = rf->frame->header.seq;
+
+    format->references_.lost(rf->ts, seq, rf->picture.vcl ? &rf->picture : nullptr);
+}
+
+void uvgrtp::formats::h26x::access_unit_dropped(void *arg, const uvgrtp::formats::access_unit *au)
+{
+    auto format = (uvgrtp::formats::h26x *)arg;
+
+    if (format->flags_ & RCE_H26X_DROP_UNDECODABLE)
+        format->references_.lost(au->ts, au->first_seq, au->picture.vcl ? &au->picture : nullptr);
+}
+
+rtp_error_t uvgrtp::formats::h26x::reserve_frame(uvgrtp::formats::reassembly_frame *rf, int flags,
+    uvgrtp::frame::rtp_frame *fragment)
+{
+    size_t reserve = minfo_.frames.reserve_hint(fragment->payload_len - rf->header_size);
+    size_t fptr    = 0;
 
-    // lastly, remove the frame structure from map
-    frames_[ts].temporary.clear();
-    frames_.erase(ts);
+    rf->frame = allocate_rtp_frame_with_startcode((flags & RCE_H26X_PREPEND_SC),
+        fragment->header, get_nal_header_size() + reserve, fptr);
 
-    dropped_.insert(ts);
+    if (!rf->frame)
+        return RTP_MEMORY_ERROR;
 
-    return total_cleaned;
+    rf->data_off = fptr + get_nal_header_size();
+    return RTP_OK;
 }
 
 rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_frame** out, 
-    uint8_t payload_header_size, int flags)
+    uint8_t payload_header_size, int flags, uvgrtp::formats::access_unit *au)
 {
     uvgrtp::buf_vec nalus;
 
-    size_t size = 0;
     auto* frame = *out;
 
     for (size_t i = payload_header_size; i < frame->payload_len; 
         i += ntohs(*(uint16_t*)&frame->payload[i]) + sizeof(uint16_t)) {
 
-        uint16_t packet_size = ntohs(*(uint16_t*)&frame->payload[i]);
-        size += packet_size;
-
-        if (size <= (*out)->payload_len) {
-            nalus.push_back(std::make_pair(packet_size, &frame->payload[i] + sizeof(uint16_t)));
-        }
-        else {
+        // both the size field and the NAL unit must be inside the packet
+        if (i + sizeof(uint16_t) > frame->payload_len ||
+            i + sizeof(uint16_t) + ntohs(*(uint16_t*)&frame->payload[i]) > frame->payload_len) {
             LOG_ERROR("The received aggregation packet claims to be larger than packet!");
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            *out = nullptr;
+
+            if (au)
+                (void)deliver_access_unit(au, out);
+
             return RTP_GENERIC_ERROR;
         }
+
+        uint16_t packet_size = ntohs(*(uint16_t*)&frame->payload[i]);
+        nalus.push_back(std::make_pair(packet_size, &frame->payload[i] + sizeof(uint16_t)));
+    }
+
+    if (au) {
+        // the NAL units point to the packet which is released with the first of them
+        for (size_t i = 0; i < nalus.size(); ++i) {
+            access_units_.add(au, frame, nalus[i].second - frame->payload, nalus[i].first,
+                frame->header.seq, (uint16_t)i, i == 0);
+
+            if (!au->picture.vcl && nalus[i].first >= get_nal_header_size())
+                au->picture = get_picture_info(nalus[i].second);
+        }
+
+        if (nalus.empty())
+            (void)uvgrtp::frame::dealloc_frame(frame);
+
+        *out = nullptr;
+        return deliver_access_unit(au, out);
     }
 
     for (size_t i = 0; i < nalus.size(); ++i) {
+        if (nalus[i].first >= get_nal_header_size() &&
+            !decodable(frame->header.timestamp, frame->header.seq, get_picture_info(nalus[i].second)))
+            continue;
+
         size_t fptr = 0;
         uvgrtp::frame::rtp_frame* retframe = 
-            allocate_rtp_frame_with_startcode(flags, (*out)->header, nalus[i].first, fptr);
+            allocate_rtp_frame_with_startcode((flags & RCE_H26X_PREPEND_SC), frame->header, nalus[i].first, fptr);
         
         std::memcpy(
             retframe->payload + fptr,
@@ -607,7 +564,11 @@ rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_
         queued_.push_back(retframe);
     }
 
-    return RTP_MULTIPLE_PKTS_READY;
+    // the NAL units have been copied out of the packet
+    (void)uvgrtp::frame::dealloc_frame(frame);
+    *out = nullptr;
+
+    return queued_.empty() ? RTP_OK : RTP_MULTIPLE_PKTS_READY;
 }
 
 rtp_error_t uvgrtp::formats::h26x::packet_handler(int flags, uvgrtp::frame::rtp_frame** out)
@@ -615,29 +576,53 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(int flags, uvgrtp::frame::rtp_
     uvgrtp::frame::rtp_frame* frame;
     bool enable_idelay = !(flags & RCE_NO_H26X_INTRA_DELAY);
 
-    /* Use "intra" to keep track of intra frames
-     *
-     * If uvgRTP is in the process of receiving fragments of an incomplete intra frame,
-     * "intra" shall be the timestamp value of that intra frame.
-     * This means that when we're receiving packets out of order and an inter frame is complete
-     * while "intra" contains value other than INVALID_TS, we drop the inter frame and wait for
-     * the intra frame to complete.
-     *
-     * If "intra" contains INVALID_TS and all packets of an inter frame have been received,
-     * the inter frame is returned to user.  If intra contains a value other than INVALID_TS
-     * (meaning an intra frame is in progress) and a new intra frame is received, the old intra frame
-     * pointed to by "intra" and new intra frame shall take the place of active intra frame */
-    uint32_t intra = INVALID_TS;
-
     frame = *out;
 
+    /* intra frames are random access points and inter frames the other slices */
+    uvgrtp::formats::picture_info picture = packet_picture(frame);
+    bool is_intra = picture.vcl && picture.irap;
+    bool is_inter = picture.vcl && !picture.irap;
+
+    /* With RCE_H26X_ACCESS_UNITS every packet belongs to the access unit of its timestamp
+     * and the NAL units are given to the access unit instead of the user */
+    uvgrtp::formats::access_unit *au = nullptr;
+
+    if (flags & RCE_H26X_ACCESS_UNITS) {
+        if (!(au = access_units_.receive(frame->header, rtp_ctx_->get_pkt_max_delay()))) {
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+            return RTP_OK;
+        }
+
+        if (picture.vcl && !au->picture.vcl)
+            au->picture = picture;
+
+        if (is_intra && enable_idelay)
+            access_units_.extend(au, INTRA_TIMEOUT_MS);
+
+        // the start codes are added when the access unit is complete
+        flags &= ~RCE_H26X_PREPEND_SC;
+    }
+
     int frag_type = get_fragment_type(frame);
     
     if (frag_type == FT_AGGR) {
         // handle aggregate packets (packets with multiple NAL units in them)
-        return handle_aggregation_packet(out, get_payload_header_size(), flags);
+        return handle_aggregation_packet(out, get_payload_header_size(), flags, au);
     }
     else if (frag_type == FT_NOT_FRAG) {
+        if (au) {
+            access_units_.add(au, frame, 0, frame->payload_len, frame->header.seq, 0, true);
+            *out = nullptr;
+            return deliver_access_unit(au, out);
+        }
+
+        if (!decodable(frame->header.timestamp, frame->header.seq, picture)) {
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+            return RTP_OK;
+        }
+
         // handle single NAL unit packet by doing nothing
         prepend_start_code(flags, out);
         return RTP_PKT_READY;
@@ -647,208 +632,190 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(int flags, uvgrtp::frame::rtp_
         LOG_WARN("invalid frame received!");
         (void)uvgrtp::frame::dealloc_frame(*out);
         *out = nullptr;
+
+        if (au)
+            (void)deliver_access_unit(au, out);
+
         return RTP_GENERIC_ERROR;
     }
 
     // rest of the function deals with fragmented frames
 
     uint32_t c_ts = frame->header.timestamp;
-    uint32_t c_seq = frame->header.seq;
-    
-    uint8_t nal_type = get_nal_type(frame);
+    uint16_t c_seq = frame->header.seq;
+
+    uvgrtp::formats::reassembly_frame *rf = minfo_.frames.find(c_ts);
 
     /* initialize new frame if this is the first packet with this timestamp */
-    if (frames_.find(c_ts) == frames_.end()) {
+    if (!rf) {
 
         /* make sure we haven't discarded the frame "c_ts" before */
-        if (dropped_.find(c_ts) != dropped_.end()) {
+        if (minfo_.frames.is_dropped(c_ts)) {
             LOG_WARN("packet belonging to a dropped frame was received!");
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+
+            // the access unit can no longer be completed, the drop has been reported by the reassembly
+            if (au)
+                (void)deliver_access_unit(au, out);
+
             return RTP_GENERIC_ERROR;
         }
 
         /* drop old intra if a new one is received */
-        if (nal_type == NT_INTRA) {
-            if (intra != INVALID_TS && enable_idelay) {
+        if (is_intra) {
+            if (intra_ts_ != INVALID_TS && enable_idelay) {
                 LOG_WARN("Dropping old h26x intra since new one has arrived");
-                drop_frame(intra);
+
+                if (auto old = minfo_.frames.find(intra_ts_))
+                    drop_frame(old);
             }
-            intra = c_ts;
+            intra_ts_ = c_ts;
         }
 
-        initialize_new_fragmented_frame(c_ts);
-    }
-
-    const size_t sizeof_fu_headers = get_payload_header_size() + get_fu_header_size();
+        /* Intra frames are waited for longer because the following inter frames depend on them */
+        size_t deadline = rtp_ctx_->get_pkt_max_delay();
 
-    frames_[c_ts].pkts_received += 1;
-    frames_[c_ts].total_size += (frame->payload_len - sizeof_fu_headers);
+        if (is_intra && enable_idelay)
+            deadline = std::max(deadline, (size_t)INTRA_TIMEOUT_MS);
 
-    if (frag_type == FT_START) {
-        frames_[c_ts].s_seq = c_seq;
-        frames_[c_ts].fragments[c_seq] = frame;
+        rf = minfo_.frames.create(c_ts, get_payload_header_size() + get_fu_header_size(), deadline);
+        rf->picture = picture;
 
-        for (auto& fragment : frames_[c_ts].temporary) {
-            uint16_t fseq = fragment->header.seq;
-            uint32_t seq = (c_seq > fseq) ? 0x10000 + fseq : fseq;
-
-            frames_[c_ts].fragments[seq] = fragment;
+        if (reserve_frame(rf, flags, frame) != RTP_OK) {
+            LOG_ERROR("Failed to allocate memory for the fragmented frame");
+            (void)minfo_.frames.release(rf, false);
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+            return RTP_MEMORY_ERROR;
         }
-        frames_[c_ts].temporary.clear();
     }
 
-    if (frag_type == FT_END)
-        frames_[c_ts].e_seq = c_seq;
+    /* the fragment is released once its payload has been written to the frame */
+    uvgrtp::frame::rtp_header header = frame->header;
+
+    rf->pkts_received += 1;
+
+    if (frag_type == FT_END) {
+        rf->e_seq   = c_seq;
+        rf->has_end = true;
+    }
 
     /* Out-of-order nature poses an interesting problem when reconstructing the frame:
-     * how to store the fragments such that we mustn't shuffle them around when frame reconstruction takes place?
+     * the fragments should be written to their final place in the frame as they arrive
+     * but the place of a fragment is known only after all fragments before it have been received.
      *
-     * std::map is an option but the overflow of 16-bit sequence number counter makes that a little harder because
-     * if the first few fragments of a frame are near 65535, the rest of the fragments are going to have sequence
-     * numbers less than that and thus our frame reconstruction breaks.
-     *
-     * This can be solved by checking if current fragment's sequence is less than start fragment's sequence number
-     * (overflow has occurred) and correcting the current sequence by adding 0x10000 to its value so it appears
-     * in order with other fragments */
-    if (frag_type != FT_START) {
-        if (frames_[c_ts].s_seq != INVALID_SEQ) {
-            /* overflow has occurred, adjust the sequence number of current
-             * fragment so it appears in order with other fragments of the frame
-             *
-             * Note: if the frame is huge (~94 MB), this will not work but it's not a realistic scenario */
-            frames_[c_ts].fragments[((frames_[c_ts].s_seq > c_seq) ? 0x10000 + c_seq : c_seq)] = frame;
-        }
-        else {
-            /* position for the fragment cannot be calculated so move the fragment to a temporary storage */
-            frames_[c_ts].temporary.push_back(frame);
-        }
-    }
+     * The reassembly writes the fragments that arrive in order right away. The ones that arrive
+     * after a gap in sequence numbers or before the start fragment are kept aside until their
+     * place is known, see uvgrtp::formats::reassembly */
+    if (frag_type == FT_START && !rf->has_start) {
+        rf->s_seq     = c_seq;
+        rf->has_start = true;
 
-    // have the first and last fragment arrived so we can possible start reconstructing the frame?
-    if (frames_[c_ts].s_seq != INVALID_SEQ && frames_[c_ts].e_seq != INVALID_SEQ) {
-        size_t received = calculate_expected_fus(c_ts);
+        get_nal_header_from_fu_headers(rf->data_off - get_nal_header_size(), frame->payload, rf->frame->payload); // NAL header
+    }
 
-        /* we've received every fragment and the frame can be reconstructed */
-        if (received == frames_[c_ts].pkts_received) {
+    minfo_.frames.place(rf, frame);
+    *out = nullptr;
 
-            /* intra is still in progress, do not return the inter */
-            if (nal_type == NT_INTER && intra != INVALID_TS && enable_idelay) {
-                LOG_WARN("Got h26x Inter frame while intra is still in progress");
-                drop_frame(c_ts);
-                return RTP_OK;
-            }
+    // have all fragments from the first to the last fragment been written to the frame?
+    if (minfo_.frames.complete(rf)) {
 
-            size_t fptr = 0;
-            uvgrtp::frame::rtp_frame* complete = allocate_rtp_frame_with_startcode((flags & RCE_H26X_PREPEND_SC), 
-                (*out)->header, get_nal_header_size() + frames_[c_ts].total_size, fptr);
-
-            get_nal_header_from_fu_headers(fptr, frame->payload, complete->payload); // NAL header
-            fptr += get_nal_header_size();
-
-            for (auto& fragment : frames_.at(c_ts).fragments) {
-                // copy everything expect fu headers (which repeat for every fu)
-                std::memcpy(
-                    &complete->payload[fptr],
-                    &fragment.second->payload[sizeof_fu_headers], 
-                    fragment.second->payload_len - sizeof_fu_headers
-                );
-                fptr += fragment.second->payload_len - sizeof_fu_headers;
-                (void)uvgrtp::frame::dealloc_frame(fragment.second);
-            }
+        /* intra is still in progress, do not return the inter */
+        if (is_inter && intra_ts_ != INVALID_TS && enable_idelay) {
+            LOG_WARN("Got h26x Inter frame while intra is still in progress");
+            drop_frame(rf);
+            return RTP_OK;
+        }
 
+        if (c_ts == intra_ts_)
+            intra_ts_ = INVALID_TS;
 
-            if (nal_type == NT_INTRA)
-                intra = INVALID_TS;
+        uint16_t s_seq = rf->s_seq;
+        *out = minfo_.frames.finish(rf, header);
 
-            *out = complete;
-            frames_.erase(c_ts);
-            return RTP_PKT_READY;
+        if (au) {
+            access_units_.add(au, *out, 0, (*out)->payload_len, s_seq, 0, true);
+            *out = nullptr;
+            return deliver_access_unit(au, out);
         }
-    }
 
-    if (is_frame_late(frames_.at(c_ts), rtp_ctx_->get_pkt_max_delay())) {
-        if (nal_type != NT_INTRA || (nal_type == NT_INTRA && !enable_idelay)) {
-            LOG_WARN("Received a packet that is too late!");
-            drop_frame(c_ts);
+        if (!decodable(c_ts, s_seq, picture)) {
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            *out = nullptr;
+            return RTP_OK;
         }
+
+        return RTP_PKT_READY;
     }
 
-    garbage_collect_lost_frames();
     return RTP_OK;
 }
 
-void uvgrtp::formats::h26x::get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload)
-{
-    uint8_t payload_header[2] = {
-        (uint8_t)((frame_payload[0] & 0x81) | ((frame_payload[2] & 0x3f) << 1)),
-        (uint8_t)frame_payload[1]
-    };
-
-    std::memcpy(&complete_payload[fptr], payload_header, get_payload_header_size());
-}
-
-void uvgrtp::formats::h26x::garbage_collect_lost_frames()
+rtp_error_t uvgrtp::formats::h26x::deliver_access_unit(uvgrtp::formats::access_unit *au, uvgrtp::frame::rtp_frame** out)
 {
-    if (uvgrtp::clock::hrc::diff_now(last_garbage_collection_) >= GARBAGE_COLLECTION_INTERVAL_MS) {
-        uint32_t total_cleaned = 0;
-        std::vector<uint32_t> to_remove;
+    // the access unit is released when it's finished
+    uvgrtp::formats::picture_info picture = au->picture;
+    uint32_t ts  = au->ts;
+    uint16_t seq = au->first_seq;
 
-        // first find all frames that have been waiting for too long
-        for (auto& gc_frame : frames_) {
-            if (uvgrtp::clock::hrc::diff_now(gc_frame.second.sframe_time) > LOST_FRAME_TIMEOUT_MS) {
-                LOG_WARN("Found an old frame that has not been completed");
-                to_remove.push_back(gc_frame.first);
-            }
-        }
+    if ((*out = access_units_.finish(au)) == nullptr)
+        return RTP_OK;
 
-        // remove old frames
-        for (auto& old_frame : to_remove) {
+    if (!decodable(ts, seq, picture)) {
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_OK;
+    }
 
-            total_cleaned += drop_frame(old_frame);
-        }
+    return RTP_PKT_READY;
+}
 
-        if (total_cleaned > 0) {
-            LOG_INFO("Garbage collection cleaned %d bytes!", total_cleaned);
-        }
+void uvgrtp::formats::h26x::set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers)
+{
+    media::set_timer_wheel(timers);
+    access_units_.set_timer_wheel(timers);
+}
 
-        last_garbage_collection_ = uvgrtp::clock::hrc::now();
-    }
+void uvgrtp::formats::h26x::install_notify_hook(void *arg, void (*hook)(void *, int))
+{
+    media::install_notify_hook(arg, hook);
+    access_units_.install_notify_hook(arg, hook);
+    references_.install_notify_hook(arg, hook);
 }
 
-void uvgrtp::formats::h26x::initialize_new_fragmented_frame(uint32_t ts)
+void uvgrtp::formats::h26x::get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload)
 {
-    frames_[ts].s_seq = INVALID_SEQ;
-    frames_[ts].e_seq = INVALID_SEQ;
+    uint8_t payload_header[2] = {
+        (uint8_t)((frame_payload[0] & 0x81) | ((frame_payload[2] & 0x3f) << 1)),
+        (uint8_t)frame_payload[1]
+    };
 
-    frames_[ts].sframe_time = uvgrtp::clock::hrc::now();
-    frames_[ts].total_size = 0;
-    frames_[ts].pkts_received = 0;
+    std::memcpy(&complete_payload[fptr], payload_header, get_payload_header_size());
 }
 
-size_t uvgrtp::formats::h26x::calculate_expected_fus(uint32_t ts)
+bool uvgrtp::formats::h26x::strip_start_code(uint8_t*& data, size_t& data_len)
 {
-    if (frames_[ts].s_seq == INVALID_SEQ || frames_[ts].e_seq == INVALID_SEQ)
-    {
-        return 0;
-    }
-    size_t s_seq = frames_[ts].s_seq;
-    size_t e_seq = frames_[ts].e_seq;
-    size_t expected = 0;
+    if (data_len >= 3 && data[0] == 0 && data[1] == 0) {
+        size_t prefix_len = 0;
 
-    if (s_seq > e_seq)
-        expected = 0xffff - s_seq + e_seq + 2;
-    else
-        expected = e_seq - s_seq + 1;
+        if (data[2] == 1)
+            prefix_len = 3;
+        else if (data_len >= 4 && data[2] == 0 && data[3] == 1)
+            prefix_len = 4;
 
-    return expected;
+        data     += prefix_len;
+        data_len -= prefix_len;
+    }
+
+    return data_len > 0;
 }
 
 void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_size, 
     std::vector<nal_info>& nals, bool& can_be_aggregated)
 {
     uint8_t start_len = 0;
-    ssize_t offset = find_h26x_start_code(data, data_len, 0, start_len);
-
-    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
+    ssize_t offset = uvgrtp::formats::scl::find_start_code(data, data_len, 0, start_len);
 
     while (offset > -1) {
         nal_info nal;
@@ -859,12 +826,9 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
 
 
         nals.push_back(nal);
-        offset = find_h26x_start_code(data, data_len, offset, start_len);
+        offset = uvgrtp::formats::scl::find_start_code(data, data_len, offset, start_len);
     }
 
-    size_t aggregate_size = 0;
-    int aggregatable_packets = 0;
-
     // calculate the sizes of NAL units
     for (size_t i = 0; i < nals.size(); ++i)
     {
@@ -880,6 +844,21 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
             nals.at(i).size = data_len - nals[i].offset;
         }
 
+        nals.at(i).data = data + nals[i].offset;
+    }
+
+    can_be_aggregated = mark_aggregatable(nals, packet_size);
+}
+
+bool uvgrtp::formats::h26x::mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size)
+{
+    size_t aggregate_size = 0;
+    int aggregatable_packets = 0;
+
+    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
+
+    for (size_t i = 0; i < nals.size(); ++i)
+    {
         // each NAL unit added to aggregate packet needs the size added which has to be taken into account
         // when calculating the aggregate packet 
         // (NOTE: This is not enough for MTAP in h264, but I doubt uvgRTP will support it)
@@ -891,5 +870,5 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
         }
     }
 
-    can_be_aggregated = (aggregatable_packets >= 2);
+    return aggregatable_packets >= 2;
 }
\ No newline at end of file
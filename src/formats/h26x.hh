@@ -1,6 +1,9 @@
 #pragma once
 
 #include "media.hh"
+#include "access_unit.hh"
+#include "reassembly.hh"
+#include "references.hh"
 #include "uvgrtp/util.hh"
 #include "uvgrtp/socket.hh"
 #include "uvgrtp/clock.hh"
@@ -16,7 +19,6 @@ namespace uvgrtp {
 
     namespace formats {
 
-        #define INVALID_SEQ           0x13371338
         #define RTP_HDR_SIZE  12
 
         enum FRAG_TYPES {
@@ -28,42 +30,15 @@ namespace uvgrtp {
             FT_AGGR = 4  /* aggregation packet */
         };
 
-        enum NAL_TYPES {
-            NT_INTRA = 0x00,
-            NT_INTER = 0x01,
-            NT_OTHER = 0xff
-        };
-
-        typedef struct h26x_info {
-            /* clock reading when the first fragment is received */
-            uvgrtp::clock::hrc::hrc_t sframe_time;
-
-            /* sequence number of the frame with s-bit */
-            uint32_t s_seq = 0;
-
-            /* sequence number of the frame with e-bit */
-            uint32_t e_seq = 0;
-
-            /* how many fragments have been received */
-            size_t pkts_received = 0;
-
-            /* total size of all fragments */
-            size_t total_size = 0;
-
-            /* map of frame's fragments,
-             * allows out-of-order insertion and loop-through in order */
-            std::map<uint32_t, uvgrtp::frame::rtp_frame*> fragments;
-
-            /* storage for fragments that require relocation */
-            std::vector<uvgrtp::frame::rtp_frame*> temporary;
-        } h26x_info_t;
-
         struct nal_info
         {
             size_t offset = 0;
             size_t prefix_len = 0;
             size_t size = 0;
             bool aggregate = false;
+
+            /* start of the NAL unit, after the start code */
+            uint8_t *data = nullptr;
         };
 
         class h26x : public media {
@@ -71,13 +46,6 @@ namespace uvgrtp {
                 h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int flags);
                 virtual ~h26x();
 
-                /* Find H26x start code from "data"
-                 * This process is the same for H26{4,5,6}
-                 *
-                 * Return the offset of the start code on success
-                 * Return -1 if no start code was found */
-                ssize_t find_h26x_start_code(uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
-
                 /* Top-level push_frame() called by the Media class
                  * Sets up the frame queue for the send operation
                  *
@@ -85,6 +53,26 @@ namespace uvgrtp {
                  * Return RTP_INVALID_VALUE if one of the parameters is invalid */
                 rtp_error_t push_media_frame(uint8_t *data, size_t data_len, int flags);
 
+                /* Send a frame given as a list of NAL units. The NAL units are aggregated and
+                 * fragmented the same way as the NAL units found by push_media_frame()
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if one of the NAL units is empty */
+                rtp_error_t push_media_nal_units(const uvgrtp::frame::nal_unit *units, size_t unit_count, int flags);
+
+                /* Send a frame one NAL unit at a time. begin_frame() starts a transaction that gets the
+                 * timestamp of the frame and push_nal() sends the packets of each NAL unit right away,
+                 * except the last packet which is held back until the next NAL unit or end_frame()
+                 * so that the marker bit can be set on the final packet of the frame
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if the calls are not in order or a parameter is invalid
+                 * Return RTP_NOT_SUPPORTED if RCE_SYSTEM_CALL_DISPATCHER is used
+                 * Return RTP_SEND_ERROR if sending failed */
+                rtp_error_t begin_frame();
+                rtp_error_t push_nal(uint8_t *data, size_t data_len);
+                rtp_error_t end_frame();
+
                 /* If the packet handler must return more than one frame, it can install a frame getter
                  * that is called by the auxiliary handler caller if packet_handler() returns RTP_MULTIPLE_PKTS_READY
                  *
@@ -113,6 +101,11 @@ namespace uvgrtp {
                  * Return RTP_GENERIC_ERROR if the packet was corrupted in some way */
                 rtp_error_t packet_handler(int flags, frame::rtp_frame** frame);
 
+                /* The access units share the timer wheel and the notify hook with the reassembly
+                 * and the reference tracker reports NR_KEYFRAME_NEEDED to the same hook */
+                void set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers) override;
+                void install_notify_hook(void *arg, void (*hook)(void *, int)) override;
+
             protected:
 
                 /* Handles small packets. May support aggregate packets or not*/
@@ -135,7 +128,10 @@ namespace uvgrtp {
 
                 void initialize_fu_headers(uint8_t nal_type, uint8_t fu_headers[]);
 
-                rtp_error_t handle_aggregation_packet(uvgrtp::frame::rtp_frame** out, uint8_t nal_header_size, int flags);
+                /* Return the NAL units of the aggregation packet to the user one by one or,
+                 * if "au" is not nullptr, add them to the access unit without copying */
+                rtp_error_t handle_aggregation_packet(uvgrtp::frame::rtp_frame** out, uint8_t nal_header_size, int flags,
+                    uvgrtp::formats::access_unit *au);
 
                 /* Gets the format specific nal type from data*/
                 virtual uint8_t get_nal_type(uint8_t* data) const = 0;
@@ -143,9 +139,10 @@ namespace uvgrtp {
                 virtual uint8_t get_payload_header_size() const = 0;
                 virtual uint8_t get_nal_header_size() const = 0;
                 virtual uint8_t get_fu_header_size() const = 0;
-                virtual uint8_t get_start_code_range() const = 0;
                 virtual int get_fragment_type(uvgrtp::frame::rtp_frame* frame) const = 0;
-                virtual uvgrtp::formats::NAL_TYPES get_nal_type(uvgrtp::frame::rtp_frame* frame) const = 0;
+
+                /* Classify the picture of the NAL unit with the NAL unit header "nal_header" */
+                virtual uvgrtp::formats::picture_info get_picture_info(const uint8_t* nal_header) const = 0;
 
                 virtual void get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload);
 
@@ -158,26 +155,64 @@ namespace uvgrtp {
 
 
 
-            bool is_frame_late(uvgrtp::formats::h26x_info_t& hinfo, size_t max_delay);
-            uint32_t drop_frame(uint32_t ts);
+            uint32_t drop_frame(uvgrtp::formats::reassembly_frame *rf);
+
+            /* Return the picture of the NAL unit or fragmentation unit in "frame" */
+            uvgrtp::formats::picture_info packet_picture(uvgrtp::frame::rtp_frame *frame);
+
+            /* Return false if the NAL unit of picture "info" cannot be decoded and must be discarded,
+             * see RCE_H26X_DROP_UNDECODABLE */
+            bool decodable(uint32_t ts, uint16_t seq, const uvgrtp::formats::picture_info& info);
+
+            /* Called by the reassembly and the access units with each dropped frame */
+            static void frame_dropped(void *arg, const uvgrtp::formats::reassembly_frame *rf);
+            static void access_unit_dropped(void *arg, const uvgrtp::formats::access_unit *au);
+
+            /* Return RTP_PKT_READY and the access unit in "out" if it's complete, RTP_OK otherwise */
+            rtp_error_t deliver_access_unit(uvgrtp::formats::access_unit *au, uvgrtp::frame::rtp_frame** out);
 
-            inline size_t calculate_expected_fus(uint32_t ts);
-            inline void initialize_new_fragmented_frame(uint32_t ts);
+            /* Reserve the frame buffer for a new fragmented frame
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if allocation fails */
+            rtp_error_t reserve_frame(uvgrtp::formats::reassembly_frame *rf, int flags,
+                uvgrtp::frame::rtp_frame *fragment);
 
             void scl(uint8_t* data, size_t data_len, size_t packet_size, 
                 std::vector<nal_info>& nals, bool& can_be_aggregated);
 
+            /* Mark the NAL units that fit into one aggregation packet of "packet_size" bytes.
+             * Return true if at least two NAL units can be aggregated */
+            bool mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size);
+
+            /* Skip the 3- or 4-byte start code in front of a NAL unit if it has one.
+             * Return false if nothing is left of the NAL unit */
+            bool strip_start_code(uint8_t*& data, size_t& data_len);
+
+            // aggregates, fragments and sends the NAL units of the active transaction
+            rtp_error_t send_nal_units(std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size);
+
             // constructs and sends the RTP packets with format specific stuff
             rtp_error_t fu_division(uint8_t* data, size_t data_len, size_t payload_size);
 
-            void garbage_collect_lost_frames();
-
             std::deque<uvgrtp::frame::rtp_frame*> queued_;
-            std::unordered_map<uint32_t, h26x_info_t> frames_;
-            std::unordered_set<uint32_t> dropped_;
             std::shared_ptr<uvgrtp::rtp> rtp_ctx_;
 
-            uvgrtp::clock::hrc::hrc_t last_garbage_collection_;
+            /* NAL units collected into access units, see RCE_H26X_ACCESS_UNITS */
+            uvgrtp::formats::access_units access_units_;
+
+            /* True between begin_frame() and end_frame() */
+            bool nal_frame_;
+
+            /* Timestamp of the intra frame being reassembled, INVALID_TS if there is none.
+             *
+             * When an inter frame is complete while an intra frame is still in progress (packets received
+             * out of order), the inter frame is dropped since it cannot be decoded without the intra frame.
+             * If a new intra frame is received, the old one is dropped and the new one takes its place */
+            uint32_t intra_ts_;
+
+            /* Pictures that cannot be decoded after a loss, see RCE_H26X_DROP_UNDECODABLE */
+            uvgrtp::formats::reference_tracker references_;
         };
     }
 }
@@ -1,21 +1,20 @@
 #include "media.hh"
 
+#include "../frame_pool.hh"
 #include "../rtp.hh"
 #include "../frame_queue.hh"
 
 #include "uvgrtp/socket.hh"
 #include "uvgrtp/debug.hh"
 
-#include <map>
-#include <unordered_map>
-
-
-
-#define INVALID_SEQ 0xffffffff
+#include <cstring>
+#include <vector>
 
 uvgrtp::formats::media::media(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp_ctx, int flags):
     socket_(socket), rtp_ctx_(rtp_ctx), flags_(flags), fqueue_(new uvgrtp::frame_queue(socket, rtp_ctx, flags)), minfo_()
-{}
+{
+    minfo_.rtp_ctx = rtp_ctx.get();
+}
 
 uvgrtp::formats::media::~media()
 {
@@ -27,6 +26,23 @@ rtp_error_t uvgrtp::formats::media::push_frame(uint8_t *data, size_t data_len, i
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
+    /* With the system call dispatcher the frame is sent after push_frame() has returned
+     * so uvgRTP must either have its own copy or the application must be told when the
+     * frame can be released. Without it the frame has been sent when this returns */
+    if (flags_ & RCE_SYSTEM_CALL_DISPATCHER) {
+        if (flags & RTP_COPY) {
+            std::unique_ptr<uint8_t[]> copy(new uint8_t[data_len]);
+            memcpy(copy.get(), data, data_len);
+
+            return push_frame(std::move(copy), data_len, flags);
+        }
+
+        if (!fqueue_->has_dealloc_hook()) {
+            LOG_ERROR("RCE_SYSTEM_CALL_DISPATCHER requires RTP_COPY or a deallocation hook for raw pointers");
+            return RTP_INVALID_VALUE;
+        }
+    }
+
     return push_media_frame(data, data_len, flags);
 }
 
@@ -35,7 +51,72 @@ rtp_error_t uvgrtp::formats::media::push_frame(std::unique_ptr<uint8_t[]> data,
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
-    return push_media_frame(data.get(), data_len, flags);
+    uint8_t *frame = data.get();
+
+    /* the transaction frees the frame once it has been sent */
+    fqueue_->set_owned_data(std::move(data));
+
+    rtp_error_t ret = push_media_frame(frame, data_len, flags);
+
+    /* the frame was not given to a transaction if pushing it failed early */
+    fqueue_->set_owned_data(nullptr);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::media::push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags)
+{
+    if (!nals || !nal_count)
+        return RTP_INVALID_VALUE;
+
+    if (!(flags_ & RCE_SYSTEM_CALL_DISPATCHER))
+        return push_media_nal_units(nals, nal_count, flags);
+
+    /* The dispatcher sends the frame after push_frame() has returned and there is no
+     * single frame that could be given to the deallocation hook, so the NAL units
+     * are copied to one buffer which the transaction owns */
+    if (!(flags & RTP_COPY)) {
+        LOG_ERROR("RCE_SYSTEM_CALL_DISPATCHER requires RTP_COPY for frames given as NAL units");
+        return RTP_INVALID_VALUE;
+    }
+
+    size_t total = 0;
+
+    for (size_t i = 0; i < nal_count; ++i) {
+        if (!nals[i].data || !nals[i].len)
+            return RTP_INVALID_VALUE;
+
+        total += nals[i].len;
+    }
+
+    std::unique_ptr<uint8_t[]> copy(new uint8_t[total]);
+    std::vector<uvgrtp::frame::nal_unit> copies(nal_count);
+    uint8_t *ptr = copy.get();
+
+    for (size_t i = 0; i < nal_count; ++i) {
+        memcpy(ptr, nals[i].data, nals[i].len);
+        copies[i].data = ptr;
+        copies[i].len  = nals[i].len;
+        ptr += nals[i].len;
+    }
+
+    fqueue_->set_owned_data(std::move(copy));
+
+    rtp_error_t ret = push_media_nal_units(copies.data(), nal_count, flags);
+
+    /* the copy was not given to a transaction if pushing it failed early */
+    fqueue_->set_owned_data(nullptr);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::media::push_media_nal_units(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags)
+{
+    (void)nals;
+    (void)nal_count;
+    (void)flags;
+
+    return RTP_NOT_SUPPORTED;
 }
 
 rtp_error_t uvgrtp::formats::media::push_media_frame(uint8_t *data, size_t data_len, int flags)
@@ -44,7 +125,7 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(uint8_t *data, size_t data_
 
     rtp_error_t ret;
 
-    if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
+    if ((ret = fqueue_->init_transaction(data, data_len)) != RTP_OK) {
         LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
     }
@@ -73,6 +154,7 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(uint8_t *data, size_t data_
     while (data_left > (ssize_t)payload_size) {
         if ((ret = fqueue_->enqueue_message(data + data_pos, payload_size, set_marker)) != RTP_OK) {
             LOG_ERROR("Failed to enqueue packet when fragmenting generic frame");
+            (void)fqueue_->deinit_transaction();
             return ret;
         }
 
@@ -83,6 +165,7 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(uint8_t *data, size_t data_
 
     if ((ret = fqueue_->enqueue_message(data + data_pos, data_left, true)) != RTP_OK) {
         LOG_ERROR("Failed to enqueue packet when fragmenting generic frame");
+        (void)fqueue_->deinit_transaction();
         return ret;
     }
 
@@ -94,72 +177,110 @@ uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_inf
     return &minfo_;
 }
 
+void uvgrtp::formats::media::install_dealloc_hook(void (*dealloc_hook)(void *))
+{
+    fqueue_->install_dealloc_hook(dealloc_hook);
+}
+
+void uvgrtp::formats::media::set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers)
+{
+    minfo_.frames.set_timer_wheel(timers);
+}
+
+void uvgrtp::formats::media::install_notify_hook(void *arg, void (*hook)(void *, int))
+{
+    minfo_.frames.install_notify_hook(arg, hook);
+}
+
+void uvgrtp::formats::media::set_zerocopy_threshold(size_t threshold)
+{
+    fqueue_->set_zerocopy_threshold(threshold);
+}
+
+rtp_error_t uvgrtp::formats::media::set_max_frame_packets(size_t packets)
+{
+    return fqueue_->set_max_packets(packets);
+}
+
+void uvgrtp::formats::media::set_frame_cache_size(size_t frames)
+{
+    fqueue_->set_cache_size(frames);
+}
+
+void uvgrtp::formats::media::set_send_batch_size(size_t packets)
+{
+    fqueue_->set_batch_size(packets);
+}
+
+rtp_error_t uvgrtp::formats::media::begin_frame()
+{
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::push_nal(uint8_t *data, size_t data_len)
+{
+    (void)data;
+    (void)data_len;
+
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::end_frame()
+{
+    return RTP_NOT_SUPPORTED;
+}
+
 rtp_error_t uvgrtp::formats::media::packet_handler(void *arg, int flags, uvgrtp::frame::rtp_frame **out)
 {
     auto minfo   = (uvgrtp::formats::media_frame_info_t *)arg;
     auto frame   = *out;
     uint32_t ts  = frame->header.timestamp;
-    uint32_t seq = frame->header.seq;
-    size_t recv  = 0;
+    uint16_t seq = frame->header.seq;
 
     /* If fragmentation of generic frame has not been enabled, we can just return the frame
      * in "out" because RTP packet handler has done all the necessasry stuff for small RTP packets */
     if (!(flags & RCE_FRAGMENT_GENERIC))
         return RTP_PKT_READY;
 
-    if (minfo->frames.find(ts) != minfo->frames.end()) {
-        minfo->frames[ts].npkts++;
-        minfo->frames[ts].size += frame->payload_len;
-
-        if (seq < minfo->frames[ts].s_seq)
-            minfo->frames[ts].fragments[seq + 0x10000] = frame;
-        else
-            minfo->frames[ts].fragments[seq] = frame;
-
-        *out = nullptr;
-
-        if (frame->header.marker)
-            minfo->frames[ts].e_seq = seq;
-
-        if (minfo->frames[ts].e_seq != INVALID_SEQ && minfo->frames[ts].s_seq != INVALID_SEQ) {
-            if (minfo->frames[ts].s_seq > minfo->frames[ts].e_seq)
-                recv = 0xffff - minfo->frames[ts].s_seq + minfo->frames[ts].e_seq + 2;
-            else
-                recv = minfo->frames[ts].e_seq - minfo->frames[ts].s_seq + 1;
-
-            if (recv == minfo->frames[ts].npkts) {
-                auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
-                size_t ptr    = 0;
-
-                std::memcpy(&retframe->header, &frame->header, sizeof(frame->header));
-
-                for (auto& frag : minfo->frames[ts].fragments) {
-                    std::memcpy(
-                        retframe->payload + ptr,
-                        frag.second->payload,
-                        frag.second->payload_len
-                    );
-                    ptr += frag.second->payload_len;
-                    (void)uvgrtp::frame::dealloc_frame(frag.second);
-                }
-
-                minfo->frames.erase(ts);
-                (void)uvgrtp::frame::dealloc_frame(*out);
-                *out = retframe;
-                return RTP_PKT_READY;
-            }
+    uvgrtp::formats::reassembly_frame *rf = minfo->frames.find(ts);
+
+    if (!rf) {
+        /* the first fragment of a frame has the marker bit set, other packets are complete frames */
+        if (!frame->header.marker)
+            return RTP_PKT_READY;
+
+        if (minfo->frames.is_dropped(ts)) {
+            LOG_WARN("packet belonging to a dropped frame was received!");
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            *out = nullptr;
+            return RTP_GENERIC_ERROR;
         }
-    } else {
-        if (frame->header.marker) {
-            minfo->frames[ts].npkts          = 1;
-            minfo->frames[ts].s_seq          = seq;
-            minfo->frames[ts].e_seq          = INVALID_SEQ;
-            minfo->frames[ts].fragments[seq] = frame;
-            minfo->frames[ts].size           = frame->payload_len;
-            *out                             = nullptr;
-        } else {
+
+        rf = minfo->frames.create(ts, 0, minfo->rtp_ctx->get_pkt_max_delay());
+        rf->s_seq     = seq;
+        rf->has_start = true;
+        rf->frame     = uvgrtp::frame_pool::alloc_frame(minfo->frames.reserve_hint(frame->payload_len));
+
+        if (!rf->frame) {
+            LOG_ERROR("Failed to allocate memory for the fragmented frame");
+            (void)minfo->frames.release(rf, false);
             return RTP_PKT_READY;
         }
+    } else if (frame->header.marker && seq != rf->s_seq) {
+        rf->e_seq   = seq;
+        rf->has_end = true;
+    }
+
+    /* the fragment is released once its payload has been written to the frame */
+    uvgrtp::frame::rtp_header header = frame->header;
+
+    rf->pkts_received++;
+    minfo->frames.place(rf, frame);
+    *out = nullptr;
+
+    if (minfo->frames.complete(rf)) {
+        *out = minfo->frames.finish(rf, header);
+        return RTP_PKT_READY;
     }
 
     return RTP_OK;
@@ -1,11 +1,10 @@
 #pragma once
 
+#include "reassembly.hh"
+
 #include "uvgrtp/util.hh"
 
-#include <map>
 #include <memory>
-#include <unordered_map>
-#include <unordered_set>
 
 namespace uvgrtp {
 
@@ -15,23 +14,18 @@ namespace uvgrtp {
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
     }
 
     namespace formats {
 
         #define INVALID_TS            0xffffffff
 
-        typedef struct media_info {
-            uint32_t s_seq = 0;
-            uint32_t e_seq = 0;
-            size_t npkts = 0;
-            size_t size = 0;
-            std::map<uint32_t, uvgrtp::frame::rtp_frame *> fragments;
-        } media_info_t;
-
         typedef struct media_frame_info {
-            std::unordered_map<uint32_t, media_info> frames;
-            std::unordered_set<uint32_t> dropped;
+            uvgrtp::formats::reassembly frames;
+
+            /* RTP context of the media stream, the frames must be completed in RCC_PKT_MAX_DELAY */
+            uvgrtp::rtp *rtp_ctx = nullptr;
         } media_frame_info_t;
 
         class media {
@@ -47,6 +41,14 @@ namespace uvgrtp {
                 rtp_error_t push_frame(uint8_t *data, size_t data_len, int flags);
                 rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, int flags);
 
+                /* Send a frame given as a list of NAL units. With RCE_SYSTEM_CALL_DISPATCHER the
+                 * NAL units are copied to one buffer owned by the transaction and RTP_COPY is required
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if one of the parameters is invalid
+                 * Return RTP_NOT_SUPPORTED if the media format does not have NAL units */
+                rtp_error_t push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags);
+
                 /* Media-specific packet handler. The default handler, depending on what "flags_" contains,
                  * may only return the received RTP packet or it may merge multiple packets together before
                  * returning a complete frame to the user.
@@ -62,15 +64,46 @@ namespace uvgrtp {
                 /* Return pointer to the internal frame info structure which is relayed to packet handler */
                 media_frame_info_t *get_media_frame_info();
 
+                /* Install a hook that is called with the frame given to push_frame()
+                 * when uvgRTP no longer needs it, see frame_queue::install_dealloc_hook() */
+                void install_dealloc_hook(void (*dealloc_hook)(void *));
+
+                /* Use the timer wheel of the reception flow to drop the frames that are not completed in time */
+                virtual void set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers);
+
+                /* Report the frames dropped by the receiver to "hook", see media_stream::install_notify_hook() */
+                virtual void install_notify_hook(void *arg, void (*hook)(void *, int));
+
+                /* Set the size of the smallest frame sent with MSG_ZEROCOPY, see RCC_ZEROCOPY_THRESHOLD */
+                void set_zerocopy_threshold(size_t threshold);
+
+                /* Set the maximum number of packets per frame, see RCC_MAX_FRAME_PACKETS */
+                rtp_error_t set_max_frame_packets(size_t packets);
+
+                /* Set how many packet arrays are kept for reuse, see RCC_FRAME_CACHE_SIZE */
+                void set_frame_cache_size(size_t frames);
+
+                /* Send the packets of a frame in batches, see RCC_SEND_BATCH_SIZE */
+                void set_send_batch_size(size_t packets);
+
+                /* Send a frame one NAL unit at a time, see media_stream::begin_frame().
+                 * Only H26x formats support this, the default implementation returns RTP_NOT_SUPPORTED */
+                virtual rtp_error_t begin_frame();
+                virtual rtp_error_t push_nal(uint8_t *data, size_t data_len);
+                virtual rtp_error_t end_frame();
+
             protected:
                 virtual rtp_error_t push_media_frame(uint8_t *data, size_t data_len, int flags);
 
+                /* Only H26x formats have NAL units, the default implementation returns RTP_NOT_SUPPORTED */
+                virtual rtp_error_t push_media_nal_units(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags);
+
                 std::shared_ptr<uvgrtp::socket> socket_;
                 std::shared_ptr<uvgrtp::rtp> rtp_ctx_;
                 int flags_;
                 std::unique_ptr<uvgrtp::frame_queue> fqueue_;
 
-            private:
+                /* Reassembly state of the received fragmented frames */
                 media_frame_info_t minfo_;
         };
     }
@@ -0,0 +1,329 @@
+#include "reassembly.hh"
+
+#include "../frame_pool.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+#include <cstring>
+
+/* Until the size of a frame is known, room is reserved for at least this many fragments */
+constexpr size_t INITIAL_FRAGMENTS = 16;
+
+static_assert((uvgrtp::formats::reassembly::FRAGMENT_SLOTS & (uvgrtp::formats::reassembly::FRAGMENT_SLOTS - 1)) == 0,
+    "the number of fragment slots must be a power of two");
+
+uvgrtp::formats::reassembly::reassembly():
+    frames_(),
+    used_(),
+    fragments_(),
+    dropped_(),
+    dropped_count_(0),
+    dropped_head_(0),
+    size_hint_(0),
+    timers_(nullptr),
+    notify_arg_(nullptr),
+    notify_hook_(nullptr),
+    drop_arg_(nullptr),
+    drop_hook_(nullptr)
+{
+    std::memset(table_, EMPTY, sizeof(table_));
+}
+
+uvgrtp::formats::reassembly::~reassembly()
+{
+    for (size_t i = 0; i < MAX_FRAMES; ++i) {
+        if (used_[i])
+            (void)release(&frames_[i], false);
+    }
+
+    for (auto& fragment : fragments_) {
+        if (fragment)
+            (void)uvgrtp::frame::dealloc_frame(fragment);
+    }
+}
+
+void uvgrtp::formats::reassembly::set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers)
+{
+    timers_ = timers;
+}
+
+void uvgrtp::formats::reassembly::install_notify_hook(void *arg, void (*hook)(void *, int))
+{
+    notify_arg_  = arg;
+    notify_hook_ = hook;
+}
+
+void uvgrtp::formats::reassembly::install_drop_hook(void *arg,
+    void (*hook)(void *, const uvgrtp::formats::reassembly_frame *))
+{
+    drop_arg_  = arg;
+    drop_hook_ = hook;
+}
+
+void uvgrtp::formats::reassembly::deadline_expired(void *arg, size_t index)
+{
+    auto reasm = (uvgrtp::formats::reassembly *)arg;
+    auto rf    = &reasm->frames_[index];
+
+    LOG_WARN("Frame was not completed in time, dropping it. Ts: %u, received %zu fragments",
+        rf->ts, rf->pkts_received);
+
+    (void)reasm->release(rf, true);
+}
+
+size_t uvgrtp::formats::reassembly::table_pos(uint32_t ts) const
+{
+    // timestamps of consecutive frames differ by a constant so they are scattered with a multiplicative hash
+    return ((ts * 2654435761u) >> 16) & (TABLE_SIZE - 1);
+}
+
+uvgrtp::formats::reassembly_frame *uvgrtp::formats::reassembly::find(uint32_t ts)
+{
+    for (size_t i = table_pos(ts); table_[i] != EMPTY; i = (i + 1) & (TABLE_SIZE - 1)) {
+        if (frames_[table_[i]].ts == ts)
+            return &frames_[table_[i]];
+    }
+
+    return nullptr;
+}
+
+uvgrtp::formats::reassembly_frame *uvgrtp::formats::reassembly::create(uint32_t ts, size_t header_size,
+    size_t deadline_ms)
+{
+    size_t index = MAX_FRAMES;
+    size_t oldest = 0;
+
+    for (size_t i = 0; i < MAX_FRAMES; ++i) {
+        if (!used_[i]) {
+            index = i;
+            break;
+        }
+
+        if (frames_[i].sframe_time < frames_[oldest].sframe_time)
+            oldest = i;
+    }
+
+    if (index == MAX_FRAMES) {
+        LOG_WARN("Too many frames are being reassembled, dropping the oldest one. Ts: %u", frames_[oldest].ts);
+        (void)release(&frames_[oldest], true);
+        index = oldest;
+    }
+
+    frames_[index]             = reassembly_frame();
+    frames_[index].ts          = ts;
+    frames_[index].header_size = header_size;
+    frames_[index].sframe_time = uvgrtp::clock::hrc::now();
+    used_[index]               = true;
+
+    if (timers_) {
+        frames_[index].deadline.callback = deadline_expired;
+        frames_[index].deadline.arg      = this;
+        frames_[index].deadline.tag      = index;
+
+        timers_->schedule(&frames_[index].deadline, deadline_ms);
+    }
+
+    size_t pos = table_pos(ts);
+
+    while (table_[pos] != EMPTY)
+        pos = (pos + 1) & (TABLE_SIZE - 1);
+
+    table_[pos] = (uint8_t)index;
+
+    return &frames_[index];
+}
+
+void uvgrtp::formats::reassembly::table_remove(const uvgrtp::formats::reassembly_frame *rf)
+{
+    size_t index = rf - frames_;
+    size_t hole  = table_pos(rf->ts);
+
+    while (table_[hole] != index)
+        hole = (hole + 1) & (TABLE_SIZE - 1);
+
+    table_[hole] = EMPTY;
+
+    /* Shift the entries after the hole backwards so that every entry
+     * can still be reached from its home position without tombstones */
+    for (size_t pos = (hole + 1) & (TABLE_SIZE - 1); table_[pos] != EMPTY; pos = (pos + 1) & (TABLE_SIZE - 1)) {
+        size_t home = table_pos(frames_[table_[pos]].ts);
+
+        // can the entry be moved to the hole without moving it in front of its home position?
+        if (((pos - home) & (TABLE_SIZE - 1)) >= ((pos - hole) & (TABLE_SIZE - 1))) {
+            table_[hole] = table_[pos];
+            table_[pos]  = EMPTY;
+            hole         = pos;
+        }
+    }
+}
+
+uint32_t uvgrtp::formats::reassembly::release(uvgrtp::formats::reassembly_frame *rf, bool dropped)
+{
+    uint32_t total_cleaned = 0;
+
+    if (timers_)
+        timers_->cancel(&rf->deadline);
+
+    if (dropped && drop_hook_)
+        drop_hook_(drop_arg_, rf);
+
+    if (rf->frame) {
+        total_cleaned += rf->frame->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+        (void)uvgrtp::frame::dealloc_frame(rf->frame);
+        rf->frame = nullptr;
+    }
+
+    // the fragments waiting in the ring are not indexed by frame so they have to be searched for
+    for (size_t i = 0; rf->held > 0 && i < FRAGMENT_SLOTS; ++i) {
+        if (fragments_[i] && fragments_[i]->header.timestamp == rf->ts) {
+            total_cleaned += fragments_[i]->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+            (void)uvgrtp::frame::dealloc_frame(fragments_[i]);
+            fragments_[i] = nullptr;
+            --rf->held;
+        }
+    }
+
+    if (dropped) {
+        dropped_[dropped_head_] = rf->ts;
+        dropped_head_  = (dropped_head_ + 1) % DROPPED_HISTORY;
+        dropped_count_ = std::min(dropped_count_ + 1, DROPPED_HISTORY);
+    }
+
+    table_remove(rf);
+    used_[rf - frames_] = false;
+
+    if (dropped && notify_hook_)
+        notify_hook_(notify_arg_, NR_FRAME_DROPPED);
+
+    return total_cleaned;
+}
+
+bool uvgrtp::formats::reassembly::is_dropped(uint32_t ts) const
+{
+    for (size_t i = 0; i < dropped_count_; ++i) {
+        if (dropped_[i] == ts)
+            return true;
+    }
+
+    return false;
+}
+
+void uvgrtp::formats::reassembly::write(uvgrtp::formats::reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment)
+{
+    size_t len = fragment->payload_len - rf->header_size;
+    size_t end = rf->data_off + rf->filled + len;
+
+    if (end > rf->frame->payload_len)
+        (void)uvgrtp::frame_pool::resize_payload(rf->frame, std::max(end, 2 * rf->frame->payload_len));
+
+    std::memcpy(&rf->frame->payload[rf->data_off + rf->filled], &fragment->payload[rf->header_size], len);
+
+    rf->filled += len;
+    rf->next   += 1;
+
+    (void)uvgrtp::frame::dealloc_frame(fragment);
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::reassembly::take(uint32_t ts, uint16_t seq)
+{
+    auto& slot = fragments_[seq & (FRAGMENT_SLOTS - 1)];
+    auto fragment = slot;
+
+    if (!fragment || fragment->header.seq != seq || fragment->header.timestamp != ts)
+        return nullptr;
+
+    slot = nullptr;
+    return fragment;
+}
+
+void uvgrtp::formats::reassembly::hold(uvgrtp::formats::reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment)
+{
+    auto& slot = fragments_[fragment->header.seq & (FRAGMENT_SLOTS - 1)];
+
+    if (slot) {
+        if (slot->header.seq == fragment->header.seq && slot->header.timestamp == fragment->header.timestamp) {
+            LOG_DEBUG("Duplicate fragment received, seq: %u", fragment->header.seq);
+            (void)uvgrtp::frame::dealloc_frame(fragment);
+            return;
+        }
+
+        /* The fragment in the slot is FRAGMENT_SLOTS sequence numbers older
+         * so its frame cannot be completed anymore and will be dropped later */
+        auto owner = find(slot->header.timestamp);
+
+        if (owner)
+            --owner->held;
+
+        (void)uvgrtp::frame::dealloc_frame(slot);
+    }
+
+    slot = fragment;
+    ++rf->held;
+}
+
+void uvgrtp::formats::reassembly::place(uvgrtp::formats::reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment)
+{
+    if (!rf->has_start) {
+        hold(rf, fragment);
+        return;
+    }
+
+    /* The distance is calculated in 16 bits so it stays correct when the sequence number wraps around */
+    uint16_t distance = (uint16_t)(fragment->header.seq - rf->s_seq);
+
+    if (distance < rf->next) {
+        LOG_DEBUG("Duplicate fragment received, seq: %u", fragment->header.seq);
+        (void)uvgrtp::frame::dealloc_frame(fragment);
+        return;
+    }
+
+    if (distance > rf->next) {
+        hold(rf, fragment);
+        return;
+    }
+
+    write(rf, fragment);
+
+    // the fragment may have filled a gap, write the fragments that were waiting for it
+    while (rf->held > 0 && (fragment = take(rf->ts, (uint16_t)(rf->s_seq + rf->next))) != nullptr) {
+        --rf->held;
+        write(rf, fragment);
+    }
+}
+
+size_t uvgrtp::formats::reassembly::expected(const uvgrtp::formats::reassembly_frame *rf) const
+{
+    if (!rf->has_start || !rf->has_end)
+        return 0;
+
+    return (size_t)(uint16_t)(rf->e_seq - rf->s_seq) + 1;
+}
+
+bool uvgrtp::formats::reassembly::complete(const uvgrtp::formats::reassembly_frame *rf) const
+{
+    return rf->has_start && rf->has_end && rf->next == expected(rf);
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::reassembly::finish(uvgrtp::formats::reassembly_frame *rf,
+    const uvgrtp::frame::rtp_header& header)
+{
+    uvgrtp::frame::rtp_frame *complete = rf->frame;
+
+    complete->header      = header;
+    complete->payload_len = rf->data_off + rf->filled;
+    size_hint_            = rf->filled;
+
+    rf->frame = nullptr;
+    (void)release(rf, false);
+
+    return complete;
+}
+
+size_t uvgrtp::formats::reassembly::reserve_hint(size_t fragment_len) const
+{
+    /* The fragments of a frame are usually equally large so the frame is at least INITIAL_FRAGMENTS
+     * fragments large or as large as the previous frame. The buffer grows if the guess is too small */
+    return std::max(size_hint_, INITIAL_FRAGMENTS * fragment_len);
+}
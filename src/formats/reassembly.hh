@@ -0,0 +1,175 @@
+#pragma once
+
+#include "references.hh"
+#include "../timer_wheel.hh"
+
+#include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+        struct rtp_header;
+    }
+
+    namespace formats {
+
+        /* Reassembly state of one fragmented frame */
+        struct reassembly_frame {
+            uint32_t ts = 0;
+
+            /* clock reading when the first fragment is received */
+            uvgrtp::clock::hrc::hrc_t sframe_time;
+
+            /* sequence numbers of the first and the last fragment, valid if "has_start"/"has_end" is set */
+            uint16_t s_seq = 0;
+            uint16_t e_seq = 0;
+            bool has_start = false;
+            bool has_end   = false;
+
+            /* how many fragments have been received */
+            size_t pkts_received = 0;
+
+            /* how many bytes in front of every fragment payload are not part of the frame (e.g., FU headers) */
+            size_t header_size = 0;
+
+            /* the frame being reassembled. The fragment payloads are written directly to their
+             * final place in its payload and the payload length is the capacity reserved so far */
+            uvgrtp::frame::rtp_frame *frame = nullptr;
+
+            /* where the fragment payloads start in the payload of "frame" */
+            size_t data_off = 0;
+
+            /* how many bytes of fragment payloads have been written to "frame" */
+            size_t filled = 0;
+
+            /* how many fragments, counted from the first fragment, have been written to "frame" */
+            size_t next = 0;
+
+            /* how many fragments of the frame wait in the fragment ring */
+            size_t held = 0;
+
+            /* drops the frame if it has not been completed by its deadline */
+            uvgrtp::timer_wheel::timer deadline;
+
+            /* the picture of the frame, set by the H.26x formats */
+            uvgrtp::formats::picture_info picture;
+        };
+
+        /* Bookkeeping of fragmented frames with bounded memory.
+         *
+         * At most MAX_FRAMES frames are reassembled at the same time. They are found by their
+         * timestamp from a small open-addressed table and if a new frame does not fit,
+         * the oldest one is dropped.
+         *
+         * Fragments are written to their frame as soon as all fragments before them have
+         * been received. The ones that arrive after a gap in sequence numbers (or before
+         * the first fragment) wait in a ring indexed by the low bits of their sequence number.
+         *
+         * Every frame is given a deadline when its first fragment is received. If the frame has
+         * not been completed by then, the timer wheel of the reception flow drops it.
+         *
+         * The timestamps of the last DROPPED_HISTORY dropped frames are remembered
+         * so that the late fragments of those frames can be discarded. Dropped frames
+         * are reported to the notify hook with NR_FRAME_DROPPED */
+        class reassembly {
+            public:
+                static constexpr size_t MAX_FRAMES      = 32;
+                static constexpr size_t FRAGMENT_SLOTS  = 2048;
+                static constexpr size_t DROPPED_HISTORY = 64;
+
+                reassembly();
+                ~reassembly();
+
+                /* Return the frame with timestamp "ts", nullptr if it's not being reassembled */
+                reassembly_frame *find(uint32_t ts);
+
+                /* Use the timer wheel of the reception flow for the deadlines of the frames */
+                void set_timer_wheel(std::shared_ptr<uvgrtp::timer_wheel> timers);
+
+                /* Report dropped frames to "hook", see media_stream::install_notify_hook() */
+                void install_notify_hook(void *arg, void (*hook)(void *, int));
+
+                /* Call "hook" with each dropped frame before it's released so that the format can react to the loss */
+                void install_drop_hook(void *arg, void (*hook)(void *, const reassembly_frame *));
+
+                /* Start reassembling frame "ts" that must be completed in "deadline_ms" milliseconds.
+                 * The caller allocates "frame" of the returned state.
+                 * If MAX_FRAMES frames are already being reassembled, the oldest of them is dropped */
+                reassembly_frame *create(uint32_t ts, size_t header_size, size_t deadline_ms);
+
+                /* Release the frame and its fragments. If "dropped" is true, the timestamp
+                 * is added to the dropped history. Return how many bytes were released */
+                uint32_t release(reassembly_frame *rf, bool dropped);
+
+                /* Return true if frame "ts" has been dropped recently */
+                bool is_dropped(uint32_t ts) const;
+
+                /* Write "fragment" to its place in the frame or keep it in the fragment ring
+                 * until its place is known. Takes the ownership of "fragment" */
+                void place(reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment);
+
+                /* Return how many fragments the frame has, 0 if the first or last fragment is missing */
+                size_t expected(const reassembly_frame *rf) const;
+
+                /* Return true if all fragments from the first to the last one have been written */
+                bool complete(const reassembly_frame *rf) const;
+
+                /* Give the completed frame to the caller and forget about it */
+                uvgrtp::frame::rtp_frame *finish(reassembly_frame *rf, const uvgrtp::frame::rtp_header& header);
+
+                /* How many bytes of payload to reserve for a new frame whose first received
+                 * fragment carries "fragment_len" bytes of the frame */
+                size_t reserve_hint(size_t fragment_len) const;
+
+            private:
+                static constexpr size_t TABLE_SIZE = 2 * MAX_FRAMES;
+                static constexpr uint8_t EMPTY     = 0xff;
+
+                /* Called by the timer wheel when frame "index" has not been completed by its deadline */
+                static void deadline_expired(void *arg, size_t index);
+
+                size_t table_pos(uint32_t ts) const;
+                void table_remove(const reassembly_frame *rf);
+
+                /* Copy the payload of "fragment" to the end of the frame and release the fragment */
+                void write(reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment);
+
+                /* Take the fragment "seq" of frame "ts" out of the fragment ring, nullptr if it's not there */
+                uvgrtp::frame::rtp_frame *take(uint32_t ts, uint16_t seq);
+
+                /* Store "fragment" to the ring, releasing the fragment it replaces */
+                void hold(reassembly_frame *rf, uvgrtp::frame::rtp_frame *fragment);
+
+                reassembly_frame frames_[MAX_FRAMES];
+                bool used_[MAX_FRAMES];
+
+                /* open-addressed table of frame indices, EMPTY if the position is free */
+                uint8_t table_[TABLE_SIZE];
+
+                uvgrtp::frame::rtp_frame *fragments_[FRAGMENT_SLOTS];
+
+                uint32_t dropped_[DROPPED_HISTORY];
+                size_t dropped_count_;
+                size_t dropped_head_;
+
+                /* size of the previous completed frame */
+                size_t size_hint_;
+
+                std::shared_ptr<uvgrtp::timer_wheel> timers_;
+
+                void *notify_arg_;
+                void (*notify_hook_)(void *, int);
+
+                void *drop_arg_;
+                void (*drop_hook_)(void *, const reassembly_frame *);
+        };
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,85 @@
+#include "references.hh"
+
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+
+uvgrtp::formats::reference_tracker::reference_tracker():
+    broken_tid_(NOT_BROKEN),
+    broken_seq_(0),
+    skip_rasl_(false),
+    has_last_(false),
+    last_ts_(0),
+    last_decodable_(true),
+    notify_arg_(nullptr),
+    notify_hook_(nullptr)
+{}
+
+void uvgrtp::formats::reference_tracker::install_notify_hook(void *arg, void (*hook)(void *, int))
+{
+    notify_arg_  = arg;
+    notify_hook_ = hook;
+}
+
+void uvgrtp::formats::reference_tracker::lost(uint32_t ts, uint16_t seq, const uvgrtp::formats::picture_info *info)
+{
+    // the slices of the picture that have not been given to the decoder yet are useless now
+    if (has_last_ && ts == last_ts_)
+        last_decodable_ = false;
+
+    // only the other RASL pictures of the same random access point may reference a RASL picture
+    if (info && info->rasl) {
+        skip_rasl_ = true;
+        return;
+    }
+
+    // without the NAL unit header the picture is assumed to be a reference picture of the base sub-layer
+    uint8_t tid = info ? (uint8_t)(info->temporal_id + (info->reference ? 0 : 1)) : 0;
+    bool base_broken = (broken_tid_ == 0);
+
+    if (broken_tid_ == NOT_BROKEN || (int16_t)(seq - broken_seq_) > 0)
+        broken_seq_ = seq;
+
+    broken_tid_ = std::min(broken_tid_, tid);
+
+    if (broken_tid_ == 0 && !base_broken) {
+        LOG_WARN("A reference picture was lost, dropping the pictures that depend on it until the next keyframe");
+
+        if (notify_hook_)
+            notify_hook_(notify_arg_, NR_KEYFRAME_NEEDED);
+    }
+}
+
+bool uvgrtp::formats::reference_tracker::decodable(uint32_t ts, uint16_t seq, const uvgrtp::formats::picture_info& info)
+{
+    if (has_last_ && ts == last_ts_)
+        return last_decodable_;
+
+    // a picture completed late may be before the lost picture in decoding order
+    bool after_loss = (broken_tid_ == NOT_BROKEN || (int16_t)(seq - broken_seq_) > 0);
+    bool decodable  = true;
+
+    if (info.irap) {
+        if (after_loss) {
+            skip_rasl_  = (broken_tid_ != NOT_BROKEN || info.broken_link);
+            broken_tid_ = NOT_BROKEN;
+        }
+    } else if (info.rasl && skip_rasl_) {
+        decodable = false;
+    } else if (after_loss) {
+        if (broken_tid_ != NOT_BROKEN) {
+            if (info.tsa && info.temporal_id <= broken_tid_)
+                broken_tid_ = NOT_BROKEN;
+            else if (info.stsa && info.temporal_id == broken_tid_)
+                broken_tid_ = info.temporal_id + 1;
+        }
+
+        decodable = (broken_tid_ == NOT_BROKEN || info.temporal_id < broken_tid_);
+    }
+
+    has_last_       = true;
+    last_ts_        = ts;
+    last_decodable_ = decodable;
+
+    return decodable;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    namespace formats {
+
+        /* What the NAL unit header tells about the picture a NAL unit belongs to */
+        struct picture_info {
+            /* true if the NAL unit is a slice of a picture, the other fields are valid only then */
+            bool vcl = false;
+
+            /* random access point (IDR, CRA, BLA or GDR), decodable without the earlier pictures */
+            bool irap = false;
+
+            /* BLA picture, its RASL pictures are never decodable */
+            bool broken_link = false;
+
+            /* false if no later picture of the same temporal sub-layer references the picture */
+            bool reference = true;
+
+            /* leading picture that references pictures before its random access point */
+            bool rasl = false;
+
+            /* the pictures of the temporal sub-layer of the picture and the sub-layers above it (TSA) or
+             * only the sub-layer of the picture (STSA) do not reference the pictures before this one */
+            bool tsa  = false;
+            bool stsa = false;
+
+            uint8_t temporal_id = 0;
+        };
+
+        /* Keeps track of which pictures the decoder can decode when some of them have been lost.
+         *
+         * A lost picture breaks its own temporal sub-layer and the sub-layers above it if it's a reference
+         * picture and only the sub-layers above it if it's not. Pictures of broken sub-layers are not
+         * decodable until a random access point, or a TSA or STSA picture, restores them. The RASL pictures
+         * of a random access point that ends a loss reference pictures before it and are not decodable either.
+         *
+         * The pictures are identified by their timestamp and ordered by their sequence numbers, so a random
+         * access point that is completed after a later picture has been lost does not restore the stream.
+         *
+         * When the base sub-layer breaks, NR_KEYFRAME_NEEDED is reported to the notify hook once
+         * so that the application can ask the sender for a new random access point */
+        class reference_tracker {
+            public:
+                reference_tracker();
+
+                /* Report NR_KEYFRAME_NEEDED to "hook", see media_stream::install_notify_hook() */
+                void install_notify_hook(void *arg, void (*hook)(void *, int));
+
+                /* Picture "ts" starting at sequence number "seq" has been lost. "info"
+                 * is nullptr if the receiver does not know what kind of picture it was */
+                void lost(uint32_t ts, uint16_t seq, const picture_info *info);
+
+                /* Return true if the decoder can decode picture "ts" starting at sequence number "seq".
+                 * Called for every slice, the slices of one picture get the same answer */
+                bool decodable(uint32_t ts, uint16_t seq, const picture_info& info);
+
+            private:
+                static constexpr uint8_t NOT_BROKEN = 0xff;
+
+                /* the lowest broken temporal sub-layer, NOT_BROKEN if every picture is decodable */
+                uint8_t broken_tid_;
+
+                /* sequence number of the latest lost picture, valid if "broken_tid_" is set */
+                uint16_t broken_seq_;
+
+                /* true if the RASL pictures of the current random access point are not decodable */
+                bool skip_rasl_;
+
+                /* the previous picture and whether it was decodable */
+                bool has_last_;
+                uint32_t last_ts_;
+                bool last_decodable_;
+
+                void *notify_arg_;
+                void (*notify_hook_)(void *, int);
+        };
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,244 @@
+#include "scl.hh"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define UVGRTP_SCL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UVGRTP_SCL_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* The SIMD implementations are compiled for their instruction sets function by function
+ * so that the rest of the library does not require them from the CPU */
+#if defined(__GNUC__) || defined(__clang__)
+#define SCL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCL_TARGET(isa)
+#endif
+
+static inline unsigned ctz32(uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(value);
+#endif
+}
+
+static inline unsigned ctz64(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(value);
+#endif
+}
+
+/* "pos" is the offset of the 0x000001 sequence. A zero byte in front of it makes the start code 4 bytes long */
+static inline ssize_t start_code_at(const uint8_t *data, size_t len, size_t offset, size_t pos, uint8_t& start_len)
+{
+    // there is no NAL unit after a start code at the end of the buffer
+    if (pos + 3 >= len)
+        return -1;
+
+    start_len = (pos > offset && data[pos - 1] == 0) ? 4 : 3;
+    return (ssize_t)(pos + 3);
+}
+
+/* Scan one byte at a time starting from "pos". If the third byte of the window is larger than one,
+ * none of the three positions ending at it can start a start code so the window skips over it */
+static inline ssize_t scan_bytes(const uint8_t *data, size_t len, size_t offset, size_t pos, uint8_t& start_len)
+{
+    while (pos + 2 < len) {
+        uint8_t third = data[pos + 2];
+
+        if (third > 1) {
+            pos += 3;
+            continue;
+        }
+
+        if (third == 1 && data[pos + 1] == 0 && data[pos] == 0)
+            return start_code_at(data, len, offset, pos, start_len);
+
+        ++pos;
+    }
+
+    return -1;
+}
+
+static ssize_t find_scalar(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    return scan_bytes(data, len, offset, offset, start_len);
+}
+
+/* The vector implementations compare the bytes at "pos", "pos + 1" and "pos + 2" of a whole
+ * vector at once and the lowest set bit of the result is the first start code */
+#ifdef UVGRTP_SCL_X86
+SCL_TARGET("sse2")
+static ssize_t find_sse2(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    size_t pos         = offset;
+
+    for (; pos + 16 + 2 <= len; pos += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(data + pos));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(data + pos + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(data + pos + 2));
+
+        __m128i match = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+            _mm_cmpeq_epi8(b2, one)
+        );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+
+        if (mask)
+            return start_code_at(data, len, offset, pos + ctz32(mask), start_len);
+    }
+
+    return scan_bytes(data, len, offset, pos, start_len);
+}
+
+SCL_TARGET("avx2")
+static ssize_t find_avx2(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+    size_t pos         = offset;
+
+    for (; pos + 32 + 2 <= len; pos += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(data + pos));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(data + pos + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i *)(data + pos + 2));
+
+        __m256i match = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+            _mm256_cmpeq_epi8(b2, one)
+        );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+
+        if (mask)
+            return start_code_at(data, len, offset, pos + ctz32(mask), start_len);
+    }
+
+    return scan_bytes(data, len, offset, pos, start_len);
+}
+
+SCL_TARGET("avx512f,avx512bw")
+static ssize_t find_avx512(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one  = _mm512_set1_epi8(1);
+    size_t pos         = offset;
+
+    for (; pos + 64 + 2 <= len; pos += 64) {
+        __m512i b0 = _mm512_loadu_si512((const void *)(data + pos));
+        __m512i b1 = _mm512_loadu_si512((const void *)(data + pos + 1));
+        __m512i b2 = _mm512_loadu_si512((const void *)(data + pos + 2));
+
+        __mmask64 mask = _mm512_cmpeq_epi8_mask(b0, zero);
+        mask = _mm512_mask_cmpeq_epi8_mask(mask, b1, zero);
+        mask = _mm512_mask_cmpeq_epi8_mask(mask, b2, one);
+
+        if (mask)
+            return start_code_at(data, len, offset, pos + ctz64((uint64_t)mask), start_len);
+    }
+
+    return scan_bytes(data, len, offset, pos, start_len);
+}
+
+static bool cpu_has_avx2()
+{
+#ifdef _MSC_VER
+    int regs[4];
+
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 0x06) != 0x06)
+        return false;
+
+    __cpuidex(regs, 7, 0);
+    return regs[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool cpu_has_avx512bw()
+{
+#ifdef _MSC_VER
+    int regs[4];
+
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 0xe6) != 0xe6)
+        return false;
+
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 16)) && (regs[1] & (1 << 30));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+}
+#endif
+
+#ifdef UVGRTP_SCL_NEON
+static ssize_t find_neon(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    size_t pos           = offset;
+
+    for (; pos + 16 + 2 <= len; pos += 16) {
+        uint8x16_t b0 = vld1q_u8(data + pos);
+        uint8x16_t b1 = vld1q_u8(data + pos + 1);
+        uint8x16_t b2 = vld1q_u8(data + pos + 2);
+
+        uint8x16_t match = vandq_u8(vandq_u8(vceqzq_u8(b0), vceqzq_u8(b1)), vceqq_u8(b2, one));
+
+        /* NEON has no movemask, narrowing each 16-bit lane by four bits
+         * packs the result to a 64-bit mask with four bits per byte */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+
+        if (mask)
+            return start_code_at(data, len, offset, pos + ctz64(mask) / 4, start_len);
+    }
+
+    return scan_bytes(data, len, offset, pos, start_len);
+}
+#endif
+
+std::vector<uvgrtp::formats::scl::implementation> uvgrtp::formats::scl::implementations()
+{
+    std::vector<implementation> impls = { { "scalar", find_scalar } };
+
+#ifdef UVGRTP_SCL_X86
+    impls.push_back({ "sse2", find_sse2 });
+
+    if (cpu_has_avx2())
+        impls.push_back({ "avx2", find_avx2 });
+
+    if (cpu_has_avx512bw())
+        impls.push_back({ "avx512", find_avx512 });
+#endif
+
+#ifdef UVGRTP_SCL_NEON
+    impls.push_back({ "neon", find_neon });
+#endif
+
+    return impls;
+}
+
+ssize_t uvgrtp::formats::scl::find_start_code(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    static const finder_t finder = implementations().back().find;
+
+    return finder(data, len, offset, start_len);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uvgrtp {
+    namespace formats {
+        namespace scl {
+
+            /* Find the next Annex B start code (0x000001 or 0x00000001) of "data" at or after "offset".
+             * The input is only read so the same buffer can be scanned from many threads.
+             *
+             * Start codes that are not followed by any data are ignored
+             *
+             * Return the offset of the first byte after the start code and set "start_len" to 3 or 4
+             * Return -1 if no start code was found */
+            typedef ssize_t (*finder_t)(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+
+            struct implementation {
+                const char *name;
+                finder_t find;
+            };
+
+            /* Find the next start code with the fastest implementation the CPU supports.
+             * The implementation is selected on first use, see finder_t for the semantics */
+            ssize_t find_start_code(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+
+            /* Return all implementations the CPU supports, the portable one first and the
+             * one used by find_start_code() last. Used for testing and benchmarking */
+            std::vector<implementation> implementations();
+        }
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
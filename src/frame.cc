@@ -1,5 +1,8 @@
 #include "uvgrtp/frame.hh"
 
+#include "frame_pool.hh"
+#include "reception_flow.hh"
+
 #include "uvgrtp/util.hh"
 #include "uvgrtp/debug.hh"
 
@@ -49,6 +52,14 @@ uvgrtp::frame::rtp_frame *uvgrtp::frame::alloc_rtp_frame(size_t payload_len, siz
     return frame;
 }
 
+bool uvgrtp::frame::points_to_dgram(const uvgrtp::frame::rtp_frame *frame, const uint8_t *ptr)
+{
+    if (!frame->dgram_ref || !ptr)
+        return false;
+
+    return ptr >= frame->dgram && ptr < frame->dgram + frame->dgram_size;
+}
+
 rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
 {
     if (!frame)
@@ -58,19 +69,23 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
         delete[] frame->csrc;
 
     if (frame->ext) {
-        delete[] frame->ext->data;
+        if (!points_to_dgram(frame, frame->ext->data))
+            delete[] frame->ext->data;
         delete frame->ext;
     }
 
     if (frame->probation)
         delete[] frame->probation;
 
-    else if (frame->payload)
-        delete[] frame->payload;
+    else
+        uvgrtp::frame_pool::release_payload(frame);
+
+    if (frame->dgram_ref)
+        uvgrtp::release_recv_buffer(frame->dgram_ref);
 
     //LOG_DEBUG("Deallocating frame, type %u", frame->type);
 
-    delete frame;
+    uvgrtp::frame_pool::release_frame(frame);
     return RTP_OK;
 }
 
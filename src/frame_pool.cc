@@ -0,0 +1,336 @@
+#include "frame_pool.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr size_t MIN_SIZE_CLASS_SHIFT = 8;  // 256 bytes
+constexpr size_t MAX_SIZE_CLASS_SHIFT = 20; // 1 MB
+constexpr size_t NUM_SIZE_CLASSES     = MAX_SIZE_CLASS_SHIFT - MIN_SIZE_CLASS_SHIFT + 1;
+constexpr size_t NO_SIZE_CLASS        = SIZE_MAX;
+
+constexpr size_t MAX_CACHED_FRAMES       = 1024;
+constexpr size_t MAX_CACHED_CLASS_BYTES  = 2 * 1024 * 1024;
+constexpr size_t MIN_CACHED_CLASS_BUFFERS = 4;
+
+/* Every payload buffer is preceded by this header. The header is padded
+ * to 16 bytes so that the payloads are suitably aligned for any copy routine */
+struct payload_buffer_header {
+    size_t sclass;
+    size_t capacity;
+};
+
+constexpr size_t PAYLOAD_BUFFER_HEADER_SIZE = 16;
+
+static_assert(sizeof(payload_buffer_header) <= PAYLOAD_BUFFER_HEADER_SIZE, "payload buffer header is too large");
+
+static thread_local uvgrtp::frame_pool *bound_pool = nullptr;
+
+static inline payload_buffer_header *get_payload_buffer_header(uint8_t *buffer)
+{
+    return (payload_buffer_header *)(buffer - PAYLOAD_BUFFER_HEADER_SIZE);
+}
+
+uvgrtp::frame_pool::frame_pool() :
+    refs_(1),
+    frames_(),
+    buffers_(NUM_SIZE_CLASSES),
+    frame_hits_(0),
+    frame_misses_(0),
+    buffer_hits_(0),
+    buffer_misses_(0),
+    frames_out_(0),
+    frames_high_water_(0),
+    buffers_out_(0),
+    buffers_high_water_(0)
+{
+}
+
+uvgrtp::frame_pool::~frame_pool()
+{
+    LOG_DEBUG("Frame pool: frames %lu hits, %lu misses, %zu at most in use",
+        frame_hits_, frame_misses_, frames_high_water_);
+    LOG_DEBUG("Frame pool: payload buffers %lu hits, %lu misses, %zu at most in use",
+        buffer_hits_, buffer_misses_, buffers_high_water_);
+
+    for (auto& frame : frames_)
+        delete frame;
+
+    for (auto& sclass : buffers_) {
+        for (auto& buffer : sclass)
+            delete[] buffer;
+    }
+}
+
+void uvgrtp::frame_pool::bind(uvgrtp::frame_pool *pool)
+{
+    bound_pool = pool;
+}
+
+void uvgrtp::frame_pool::unref()
+{
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+size_t uvgrtp::frame_pool::size_class(size_t len)
+{
+    size_t total = len + PAYLOAD_BUFFER_HEADER_SIZE;
+
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+        if (total <= ((size_t)1 << (MIN_SIZE_CLASS_SHIFT + i)))
+            return i;
+    }
+
+    return NO_SIZE_CLASS;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::frame_pool::get_frame()
+{
+    uvgrtp::frame::rtp_frame *frame = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+
+        if (!frames_.empty()) {
+            frame = frames_.back();
+            frames_.pop_back();
+            ++frame_hits_;
+        } else {
+            ++frame_misses_;
+        }
+
+        if (++frames_out_ > frames_high_water_)
+            frames_high_water_ = frames_out_;
+    }
+
+    if (!frame)
+        frame = new uvgrtp::frame::rtp_frame;
+
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+void uvgrtp::frame_pool::put_frame(uvgrtp::frame::rtp_frame *frame)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+
+        --frames_out_;
+
+        if (frames_.size() < MAX_CACHED_FRAMES) {
+            frames_.push_back(frame);
+            frame = nullptr;
+        }
+    }
+
+    delete frame;
+    unref();
+}
+
+uint8_t *uvgrtp::frame_pool::get_buffer(size_t sclass)
+{
+    uint8_t *buffer = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+
+        if (!buffers_[sclass].empty()) {
+            buffer = buffers_[sclass].back();
+            buffers_[sclass].pop_back();
+            ++buffer_hits_;
+        } else {
+            ++buffer_misses_;
+        }
+
+        if (++buffers_out_ > buffers_high_water_)
+            buffers_high_water_ = buffers_out_;
+    }
+
+    if (!buffer)
+        buffer = new uint8_t[(size_t)1 << (MIN_SIZE_CLASS_SHIFT + sclass)];
+
+    return buffer;
+}
+
+void uvgrtp::frame_pool::put_buffer(uint8_t *buffer, size_t sclass)
+{
+    size_t max_cached = MAX_CACHED_CLASS_BYTES >> (MIN_SIZE_CLASS_SHIFT + sclass);
+
+    if (max_cached < MIN_CACHED_CLASS_BUFFERS)
+        max_cached = MIN_CACHED_CLASS_BUFFERS;
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+
+        --buffers_out_;
+
+        if (buffers_[sclass].size() < max_cached) {
+            buffers_[sclass].push_back(buffer);
+            buffer = nullptr;
+        }
+    }
+
+    delete[] buffer;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::frame_pool::alloc_frame()
+{
+    if (!bound_pool)
+        return uvgrtp::frame::alloc_rtp_frame();
+
+    uvgrtp::frame::rtp_frame *frame = bound_pool->get_frame();
+
+    *frame      = uvgrtp::frame::rtp_frame();
+    frame->pool = bound_pool;
+
+    return frame;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::frame_pool::alloc_frame(size_t payload_len)
+{
+    uvgrtp::frame::rtp_frame *frame = nullptr;
+
+    if ((frame = alloc_frame()) == nullptr)
+        return nullptr;
+
+    if (!alloc_payload(frame, payload_len)) {
+        release_frame(frame);
+        return nullptr;
+    }
+
+    return frame;
+}
+
+uint8_t *uvgrtp::frame_pool::alloc_payload(uvgrtp::frame::rtp_frame *frame, size_t len)
+{
+    auto pool     = (uvgrtp::frame_pool *)frame->pool;
+    size_t sclass = pool ? size_class(PAYLOAD_HEADROOM + len) : NO_SIZE_CLASS;
+    size_t total  = PAYLOAD_BUFFER_HEADER_SIZE + PAYLOAD_HEADROOM + len;
+    uint8_t *mem  = nullptr;
+
+    if (sclass != NO_SIZE_CLASS) {
+        mem   = pool->get_buffer(sclass);
+        total = (size_t)1 << (MIN_SIZE_CLASS_SHIFT + sclass);
+    } else {
+        mem   = new uint8_t[total];
+    }
+
+    uint8_t *buffer = mem + PAYLOAD_BUFFER_HEADER_SIZE;
+
+    get_payload_buffer_header(buffer)->sclass   = sclass;
+    get_payload_buffer_header(buffer)->capacity = total - PAYLOAD_BUFFER_HEADER_SIZE;
+
+    frame->pool_buffer = buffer;
+    frame->payload     = buffer + PAYLOAD_HEADROOM;
+    frame->payload_len = len;
+
+    return frame->payload;
+}
+
+size_t uvgrtp::frame_pool::headroom(const uvgrtp::frame::rtp_frame *frame)
+{
+    if (uvgrtp::frame::points_to_dgram(frame, frame->payload)) {
+        const uint8_t *start = frame->dgram;
+
+        // the header extension may point to the datagram too and must not be overwritten
+        if (frame->ext && uvgrtp::frame::points_to_dgram(frame, frame->ext->data))
+            start = frame->ext->data + frame->ext->len;
+
+        return frame->payload > start ? frame->payload - start : 0;
+    }
+
+    if (frame->pool_buffer && frame->payload >= frame->pool_buffer &&
+        frame->payload < frame->pool_buffer + get_payload_buffer_header(frame->pool_buffer)->capacity)
+        return frame->payload - frame->pool_buffer;
+
+    return 0;
+}
+
+void uvgrtp::frame_pool::prepend_payload(uvgrtp::frame::rtp_frame *frame, const uint8_t *data, size_t len)
+{
+    if (headroom(frame) >= len) {
+        frame->payload     -= len;
+        frame->payload_len += len;
+        std::memcpy(frame->payload, data, len);
+        return;
+    }
+
+    uint8_t *old_payload = frame->payload;
+    uint8_t *old_buffer  = frame->pool_buffer;
+    size_t old_len       = frame->payload_len;
+
+    (void)alloc_payload(frame, len + old_len);
+
+    std::memcpy(frame->payload,       data,        len);
+    std::memcpy(frame->payload + len, old_payload, old_len);
+
+    release_storage(frame, old_payload, old_buffer);
+}
+
+size_t uvgrtp::frame_pool::tailroom(const uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame->pool_buffer && frame->payload >= frame->pool_buffer &&
+        frame->payload < frame->pool_buffer + get_payload_buffer_header(frame->pool_buffer)->capacity)
+        return frame->pool_buffer + get_payload_buffer_header(frame->pool_buffer)->capacity - frame->payload;
+
+    return 0;
+}
+
+uint8_t *uvgrtp::frame_pool::resize_payload(uvgrtp::frame::rtp_frame *frame, size_t len)
+{
+    if (tailroom(frame) >= len) {
+        frame->payload_len = len;
+        return frame->payload;
+    }
+
+    uint8_t *old_payload = frame->payload;
+    uint8_t *old_buffer  = frame->pool_buffer;
+    size_t old_len       = frame->payload_len;
+
+    (void)alloc_payload(frame, len);
+
+    if (old_payload)
+        std::memcpy(frame->payload, old_payload, std::min(old_len, len));
+
+    release_storage(frame, old_payload, old_buffer);
+    return frame->payload;
+}
+
+void uvgrtp::frame_pool::release_storage(uvgrtp::frame::rtp_frame *frame, uint8_t *payload, uint8_t *buffer)
+{
+    bool in_buffer = false;
+
+    if (buffer) {
+        auto header = get_payload_buffer_header(buffer);
+
+        in_buffer = payload >= buffer && payload < buffer + header->capacity;
+
+        if (header->sclass == NO_SIZE_CLASS)
+            delete[] (uint8_t *)header;
+        else
+            ((uvgrtp::frame_pool *)frame->pool)->put_buffer((uint8_t *)header, header->sclass);
+    }
+
+    /* the payload was allocated separately, e.g., by the application */
+    if (payload && !in_buffer && !uvgrtp::frame::points_to_dgram(frame, payload))
+        delete[] payload;
+}
+
+void uvgrtp::frame_pool::release_payload(uvgrtp::frame::rtp_frame *frame)
+{
+    release_storage(frame, frame->payload, frame->pool_buffer);
+
+    frame->payload     = nullptr;
+    frame->pool_buffer = nullptr;
+}
+
+void uvgrtp::frame_pool::release_frame(uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame->pool)
+        ((uvgrtp::frame_pool *)frame->pool)->put_frame(frame);
+    else
+        delete frame;
+}
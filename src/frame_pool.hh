@@ -0,0 +1,121 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    /* Frame pool recycles the RTP frames and payload buffers that are allocated
+     * for every received packet.
+     *
+     * Frame headers are kept on a free list and payload buffers on per size class
+     * free lists (powers of two from 256 bytes to 1 MB). Larger buffers are allocated
+     * from the heap as before.
+     *
+     * Frames are allocated from the pool that has been bound to the calling thread with bind().
+     * Reception flow binds its own pool to the processor thread so every media stream has a pool
+     * of its own. If no pool has been bound, the frames are allocated from the heap and
+     * everything works as before.
+     *
+     * The frame remembers which pool it came from so it can be deallocated from any thread.
+     * The pool is reference counted: its owner holds one reference and every frame
+     * allocated from it holds another so frames may outlive the media stream */
+    class frame_pool {
+        public:
+            /* How many bytes are reserved in front of payload buffers so that
+             * a start code can be prepended without reallocating the payload */
+            static constexpr size_t PAYLOAD_HEADROOM = 4;
+
+            frame_pool();
+
+            /* Make "pool" the pool of the calling thread, nullptr unbinds the current pool */
+            static void bind(frame_pool *pool);
+
+            /* Allocate an empty frame from the pool of the calling thread
+             *
+             * Return pointer to the frame on success
+             * Return nullptr if allocation fails */
+            static uvgrtp::frame::rtp_frame *alloc_frame();
+
+            /* Allocate a frame with a "payload_len"-byte payload from the pool of the calling thread
+             *
+             * Return pointer to the frame on success
+             * Return nullptr if allocation fails */
+            static uvgrtp::frame::rtp_frame *alloc_frame(size_t payload_len);
+
+            /* Allocate a "len"-byte payload buffer for "frame" from the pool of the frame.
+             * The current payload of the frame must have been released with release_payload()
+             *
+             * Return pointer to the payload on success
+             * Return nullptr if allocation fails */
+            static uint8_t *alloc_payload(uvgrtp::frame::rtp_frame *frame, size_t len);
+
+            /* Prepend "len" bytes of "data" to the payload of "frame". This is done in place
+             * if there is enough room in front of the payload, otherwise the payload is reallocated */
+            static void prepend_payload(uvgrtp::frame::rtp_frame *frame, const uint8_t *data, size_t len);
+
+            /* Change the payload length of "frame" to "len" bytes keeping its current content.
+             * This is done in place if the payload buffer is large enough, otherwise the payload is reallocated
+             *
+             * Return pointer to the payload */
+            static uint8_t *resize_payload(uvgrtp::frame::rtp_frame *frame, size_t len);
+
+            /* Release the payload of "frame". A payload that points to the received datagram
+             * (RCE_ZERO_COPY_RECEIVE) is left alone */
+            static void release_payload(uvgrtp::frame::rtp_frame *frame);
+
+            /* Release "frame" itself. The payload must have been released first */
+            static void release_frame(uvgrtp::frame::rtp_frame *frame);
+
+            /* Called by the owner of the pool when it no longer needs the pool */
+            void unref();
+
+        private:
+            ~frame_pool();
+
+            /* Return the size class of "len"-byte buffer, NO_SIZE_CLASS if it's too large to be pooled */
+            static size_t size_class(size_t len);
+
+            /* Return how many bytes there are in front of the payload of "frame" in its buffer.
+             * In a received datagram, only the bytes after the header extension are counted */
+            static size_t headroom(const uvgrtp::frame::rtp_frame *frame);
+
+            /* Return how many bytes there are from the start of the payload of "frame" to the end of its buffer */
+            static size_t tailroom(const uvgrtp::frame::rtp_frame *frame);
+
+            /* Free "payload" and "buffer" which were the payload and payload buffer of "frame" */
+            static void release_storage(uvgrtp::frame::rtp_frame *frame, uint8_t *payload, uint8_t *buffer);
+
+            uvgrtp::frame::rtp_frame *get_frame();
+            void put_frame(uvgrtp::frame::rtp_frame *frame);
+
+            uint8_t *get_buffer(size_t sclass);
+            void put_buffer(uint8_t *buffer, size_t sclass);
+
+            std::atomic<size_t> refs_;
+
+            std::mutex mtx_;
+            std::vector<uvgrtp::frame::rtp_frame *> frames_;
+            std::vector<std::vector<uint8_t *>> buffers_;
+
+            /* Statistics, protected by "mtx_" */
+            uint64_t frame_hits_;
+            uint64_t frame_misses_;
+            uint64_t buffer_hits_;
+            uint64_t buffer_misses_;
+
+            size_t frames_out_;
+            size_t frames_high_water_;
+            size_t buffers_out_;
+            size_t buffers_high_water_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,5 +1,6 @@
 #include "frame_queue.hh"
 
+#include "dispatch.hh"
 #include "formats/h264.hh"
 #include "formats/h265.hh"
 #include "formats/h266.hh"
@@ -11,6 +12,10 @@
 
 #include "uvgrtp/debug.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <windows.h>
@@ -21,33 +26,78 @@
 #include <cstring>
 #endif
 
+/* How long the destructor waits for the kernel to complete the zero-copy sends */
+constexpr int ZEROCOPY_DRAIN_MS = 1000;
+
 
 uvgrtp::frame_queue::frame_queue(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int flags):
-    rtp_(rtp), socket_(socket), flags_(flags)
+    dealloc_hook_(nullptr), zerocopy_(false), zerocopy_threshold_(ZEROCOPY_THRESHOLD),
+    zerocopy_completed_(0), rtp_(rtp), socket_(socket), flags_(flags)
 {
     active_     = nullptr;
 
     max_queued_ = MAX_QUEUED_MSGS;
     max_mcount_ = MAX_MSG_COUNT;
-    max_ccount_ = MAX_CHUNK_COUNT * max_mcount_;
+    batch_size_ = 0;
+
+    if ((flags_ & RCE_ZEROCOPY_SEND) && socket_->enable_zerocopy() == RTP_OK) {
+        zerocopy_ = true;
+        socket_->install_zerocopy_handler(std::bind(&uvgrtp::frame_queue::reap_zerocopy, this, std::placeholders::_1));
+    }
+
+    if (flags_ & RCE_SYSTEM_CALL_DISPATCHER) {
+        dispatcher_ = std::unique_ptr<uvgrtp::dispatcher>(new uvgrtp::dispatcher(socket_));
+        dispatcher_->start();
+    }
 }
 
 uvgrtp::frame_queue::~frame_queue()
 {
+    // the dispatcher sends the frames it still has and gives the transactions back
+    if (dispatcher_)
+        dispatcher_->stop();
+
+    if (zerocopy_) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ZEROCOPY_DRAIN_MS);
+
+        for (;;) {
+            socket_->process_zerocopy();
+
+            {
+                std::lock_guard<std::mutex> lock(transaction_mtx_);
+
+                if (zerocopy_pending_.empty())
+                    break;
+            }
+
+            if (std::chrono::steady_clock::now() > deadline) {
+                LOG_WARN("The kernel did not complete all zero-copy sends, releasing the frames anyway");
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        socket_->install_zerocopy_handler(nullptr);
+    }
+
+    returned_frames returned;
+
     transaction_mtx_.lock();
+    for (auto& i : zerocopy_pending_) {
+        release_transaction_data(i, true, returned);
+        (void)destroy_transaction(i);
+    }
+    zerocopy_pending_.clear();
+
     for (auto& i : free_) {
         (void)destroy_transaction(i);
     }
     free_.clear();
 
-    /*
-    * 
-    * TODO: Deleting this crashes at exit
     for (auto& i : queued_) {
         (void)destroy_transaction(i.second);
     }
     queued_.clear();
-    */
 
     if (active_)
     {
@@ -56,10 +106,16 @@ uvgrtp::frame_queue::~frame_queue()
     }
 
     transaction_mtx_.unlock();
+
+    return_frames(returned);
 }
 
-rtp_error_t uvgrtp::frame_queue::init_transaction()
+rtp_error_t uvgrtp::frame_queue::init_transaction(size_t frame_size)
 {
+    // the receiver may not be running so the completions are also read here
+    if (zerocopy_)
+        socket_->process_zerocopy();
+
     std::lock_guard<std::mutex> lock(transaction_mtx_);
 
     if (active_ != nullptr)
@@ -69,15 +125,6 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
         active_      = new transaction_t;
         active_->key = uvgrtp::random::generate_32();
 
-#ifndef _WIN32
-        active_->headers     = new struct mmsghdr[max_mcount_];
-        active_->chunks      = new struct iovec[max_ccount_];
-#else
-        active_->headers     = nullptr;
-        active_->chunks      = nullptr;
-#endif
-        active_->rtp_headers = new uvgrtp::frame::rtp_header[max_mcount_];
-
         switch (rtp_->get_payload()) {
             case RTP_FORMAT_H264:
                 active_->media_headers = new uvgrtp::formats::h264_headers;
@@ -104,16 +151,22 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
     active_->hdr_ptr     = 0;
     active_->rtphdr_ptr  = 0;
     active_->rtpauth_ptr = 0;
+    active_->sent_ptr    = 0;
+    active_->flushed     = 0;
+    active_->frame_size  = frame_size;
     active_->fqueue      = this;
 
     active_->data_raw     = nullptr;
-    active_->data_smart   = nullptr;
+    active_->data_smart   = std::move(owned_data_);
     active_->dealloc_hook = dealloc_hook_;
 
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-        active_->rtp_auth_tags = new uint8_t[10 * max_mcount_];
-    else
-        active_->rtp_auth_tags = nullptr;
+    /* Small frames, such as audio, need only a few entries. Recycled transactions
+     * keep their arrays so they are grown only if this frame needs more */
+    size_t messages = std::min(frame_size / rtp_->get_payload_size() + 1, (size_t)max_mcount_);
+
+    if (batch_size_ && !dispatcher_)
+        messages = std::min(messages, batch_size_);
+    (void)reserve(active_, messages, MAX_CHUNK_COUNT * messages);
 
     active_->out_addr = socket_->get_out_address();
     rtp_->fill_header((uint8_t *)&active_->rtp_common);
@@ -122,28 +175,30 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::frame_queue::init_transaction(uint8_t *data)
+rtp_error_t uvgrtp::frame_queue::init_transaction(uint8_t *data, size_t frame_size)
 {
     if (!data)
         return RTP_INVALID_VALUE;
 
-    if (init_transaction() != RTP_OK) {
+    if (init_transaction(frame_size) != RTP_OK) {
         LOG_ERROR("Failed to initialize transaction");
         return RTP_GENERIC_ERROR;
     }
 
-    /* The transaction has been initialized to "active_" */
-    active_->data_raw = data;
+    /* The transaction has been initialized to "active_". If it owns the frame
+     * (see set_owned_data()), the frame is not given to the deallocation hook */
+    if (!active_->data_smart)
+        active_->data_raw = data;
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::frame_queue::init_transaction(std::unique_ptr<uint8_t[]> data)
+rtp_error_t uvgrtp::frame_queue::init_transaction(std::unique_ptr<uint8_t[]> data, size_t frame_size)
 {
     if (!data)
         return RTP_INVALID_VALUE;
 
-    if (init_transaction() != RTP_OK) {
+    if (init_transaction(frame_size) != RTP_OK) {
         LOG_ERROR("Failed to initialize transaction");
         return RTP_GENERIC_ERROR;
     }
@@ -171,10 +226,12 @@ rtp_error_t uvgrtp::frame_queue::destroy_transaction(uvgrtp::transaction_t *t)
     if (t->rtp_auth_tags)
         delete[] t->rtp_auth_tags;
 
-    t->headers       = nullptr;
-    t->chunks        = nullptr;
-    t->rtp_headers   = nullptr;
-    t->rtp_auth_tags = nullptr;
+    t->headers        = nullptr;
+    t->chunks         = nullptr;
+    t->rtp_headers    = nullptr;
+    t->rtp_auth_tags  = nullptr;
+    t->msg_capacity   = 0;
+    t->chunk_capacity = 0;
 
     if (t->media_headers)
     {
@@ -208,77 +265,297 @@ rtp_error_t uvgrtp::frame_queue::destroy_transaction(uvgrtp::transaction_t *t)
 
 rtp_error_t uvgrtp::frame_queue::deinit_transaction(uint32_t key)
 {
-    std::lock_guard<std::mutex> lock(transaction_mtx_);
+    // read before locking the transactions, see complete_transaction()
+    uint32_t zerocopy_end = zerocopy_ ? socket_->get_zerocopy_id() : 0;
+    returned_frames returned;
+
+    {
+        std::lock_guard<std::mutex> lock(transaction_mtx_);
+
+        uvgrtp::transaction_t *t = nullptr;
 
-    auto transaction_it = queued_.find(key);
+        /* The frame has been sent (or sending it failed) so uvgRTP no longer needs it */
+        bool handed_over = true;
+        auto transaction_it = queued_.find(key);
+
+        if (transaction_it != queued_.end()) {
+            t = transaction_it->second;
+            queued_.erase(transaction_it);
 
-    if (transaction_it == queued_.end()) {
         /* It's possible that the transaction has not been queued yet because
-         * the chunk given by the application was smaller than MTU */
-        if (active_ && active_->key == key) {
-            free_.push_back(active_);
+         * the chunk given by the application was smaller than MTU. Then the frame
+         * is given back to the application unless some of it has already been sent */
+        } else if (active_ && active_->key == key) {
+            t = active_;
+            handed_over = t->zerocopy && t->sent_ptr > 0;
+        } else {
+            return RTP_INVALID_VALUE;
+        }
+
+        if (active_ == t)
             active_ = nullptr;
+
+        /* The kernel may still read the batches that were sent with MSG_ZEROCOPY,
+         * so the transaction waits for the sends the same way as in complete_transaction() */
+        if (t->zerocopy && t->sent_ptr > 0 && (int32_t)(zerocopy_completed_ - zerocopy_end) < 0) {
+            t->zerocopy_end = zerocopy_end;
+            zerocopy_pending_.push_back(t);
             return RTP_OK;
         }
 
-        return RTP_INVALID_VALUE;
+        release_transaction_data(t, handed_over, returned);
+        recycle_transaction(t);
     }
 
-    if (active_ && active_->key == key) {
-        /* free all temporary buffers */
-        if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP) {
-            for (auto& packet : active_->packets) {
-                for (size_t i = 1; i < packet.size(); ++i) {
-                    delete[] packet[i].second;
-                }
-            }
+    return_frames(returned);
+    return RTP_OK;
+}
+
+void uvgrtp::frame_queue::complete_transaction(uvgrtp::transaction_t *transaction)
+{
+    // the kernel may still be reading the buffers even if sending failed half way
+    uint32_t zerocopy_end = transaction->zerocopy ? socket_->get_zerocopy_id() : 0;
+    returned_frames returned;
+
+    {
+        std::lock_guard<std::mutex> lock(transaction_mtx_);
+
+        queued_.erase(transaction->key);
+
+        if (transaction->zerocopy && (int32_t)(zerocopy_completed_ - zerocopy_end) < 0) {
+            transaction->zerocopy_end = zerocopy_end;
+            zerocopy_pending_.push_back(transaction);
+            return;
         }
-        active_->packets.clear();
-        free_.push_back(active_);
-        active_ = nullptr;
-        return RTP_OK;
-    }
 
-    /* Deallocate the raw data pointer using the deallocation hook provided by application */
-    if (transaction_it->second->data_raw && transaction_it->second->dealloc_hook) {
-        transaction_it->second->dealloc_hook(transaction_it->second->data_raw);
-        transaction_it->second->data_raw = nullptr;
+        release_transaction_data(transaction, true, returned);
+        recycle_transaction(transaction);
     }
 
-    if (free_.size() >= (size_t)max_queued_) {
-        switch (rtp_->get_payload()) {
-            case RTP_FORMAT_H264:
-                delete (uvgrtp::formats::h264_headers *)transaction_it->second->media_headers;
-                transaction_it->second->media_headers = nullptr;
-                break;
+    return_frames(returned);
+}
 
-            case RTP_FORMAT_H265:
-                delete (uvgrtp::formats::h265_headers *)transaction_it->second->media_headers;
-                transaction_it->second->media_headers = nullptr;
-                break;
+void uvgrtp::frame_queue::reap_zerocopy(uint32_t completed)
+{
+    returned_frames returned;
 
-            case RTP_FORMAT_H266:
-                delete (uvgrtp::formats::h266_headers *)transaction_it->second->media_headers;
-                transaction_it->second->media_headers = nullptr;
-                break;
+    {
+        std::lock_guard<std::mutex> lock(transaction_mtx_);
 
-            default:
+        // the handler may be called by many threads at once so an older value can arrive later
+        if ((int32_t)(completed - zerocopy_completed_) <= 0)
+            return;
+
+        zerocopy_completed_ = completed;
+
+        while (!zerocopy_pending_.empty()) {
+            uvgrtp::transaction_t *t = zerocopy_pending_.front();
+
+            if ((int32_t)(completed - t->zerocopy_end) < 0)
                 break;
+
+            zerocopy_pending_.pop_front();
+            release_transaction_data(t, true, returned);
+            recycle_transaction(t);
         }
+    }
 
-        delete[] transaction_it->second->rtp_auth_tags;
-        delete[] transaction_it->second->headers;
-        delete[] transaction_it->second->chunks;
-        delete[] transaction_it->second->rtp_headers;
-        delete   transaction_it->second;
-    } else {
-        free_.push_back(transaction_it->second);
+    return_frames(returned);
+}
+
+void uvgrtp::frame_queue::prepare_send(uvgrtp::transaction_t *t)
+{
+    t->send_flags = 0;
+    t->zerocopy   = false;
+
+#ifdef MSG_ZEROCOPY
+    /* The frame must stay valid until the kernel has completed the sends, so only frames
+     * that uvgRTP owns or that are given back to the application with the deallocation hook
+     * can be sent without copying */
+    if (!zerocopy_ || !(t->data_smart || (t->data_raw && t->dealloc_hook)))
+        return;
+
+    if (t->frame_size >= zerocopy_threshold_) {
+        t->send_flags = MSG_ZEROCOPY;
+        t->zerocopy   = true;
     }
+#endif
+}
+
+void uvgrtp::frame_queue::set_zerocopy_threshold(size_t threshold)
+{
+    zerocopy_threshold_ = threshold;
+}
+
+rtp_error_t uvgrtp::frame_queue::set_max_packets(size_t packets)
+{
+    if (packets == 0)
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(transaction_mtx_);
+    max_mcount_ = (ssize_t)packets;
 
-    queued_.erase(key);
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::frame_queue::flush_partial()
+{
+    if (!active_ || active_->hdr_ptr == active_->sent_ptr)
+        return RTP_OK;
+
+    /* The payload of the last packet, i.e., everything between the RTP header
+     * and the authentication tag, is merged into one copy */
+    struct msghdr& msg = active_->headers[active_->hdr_ptr - 1].msg_hdr;
+    size_t tag         = (flags_ & RCE_SRTP_AUTHENTICATE_RTP) ? 1 : 0;
+    size_t total       = 0;
+
+    for (size_t i = 1; i < msg.msg_iovlen - tag; ++i)
+        total += msg.msg_iov[i].iov_len;
+
+    uint8_t *mem = new uint8_t[total];
+    uint8_t *ptr = mem;
+
+    for (size_t i = 1; i < msg.msg_iovlen - tag; ++i) {
+        memcpy(ptr, msg.msg_iov[i].iov_base, msg.msg_iov[i].iov_len);
+        ptr += msg.msg_iov[i].iov_len;
+    }
+    active_->copies.emplace_back(mem);
+
+    if (tag)
+        msg.msg_iov[2] = msg.msg_iov[msg.msg_iovlen - 1];
+
+    msg.msg_iov[1].iov_base = mem;
+    msg.msg_iov[1].iov_len  = total;
+    msg.msg_iovlen          = 2 + tag;
+
+    // it's the last packet so the chunks after it are free
+    active_->chunk_ptr = (msg.msg_iov - active_->chunks) + msg.msg_iovlen;
+
+    return send_batch(1);
+}
+
+void uvgrtp::frame_queue::set_marker()
+{
+    if (active_ && active_->rtphdr_ptr > 0)
+        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr - 1])[1] |= (1 << 7);
+}
+
+void uvgrtp::frame_queue::set_batch_size(size_t packets)
+{
+    batch_size_ = packets;
+}
+
+void uvgrtp::frame_queue::set_cache_size(size_t transactions)
+{
+    std::lock_guard<std::mutex> lock(transaction_mtx_);
+    max_queued_ = (ssize_t)transactions;
+
+    while (free_.size() > transactions) {
+        (void)destroy_transaction(free_.back());
+        free_.pop_back();
+    }
+}
+
+bool uvgrtp::frame_queue::reserve(uvgrtp::transaction_t *t, size_t messages, size_t chunks)
+{
+    if (messages > (size_t)max_mcount_)
+        return false;
+
+    if (chunks > t->chunk_capacity) {
+        size_t capacity = std::max(chunks, 2 * t->chunk_capacity);
+        struct iovec *new_chunks = new struct iovec[capacity];
+
+        if (t->chunks) {
+            std::copy(t->chunks, t->chunks + t->chunk_ptr, new_chunks);
+
+            // the packets point to the buffers of the old array
+            for (size_t i = 0; i < t->hdr_ptr; ++i)
+                t->headers[i].msg_hdr.msg_iov = new_chunks + (t->headers[i].msg_hdr.msg_iov - t->chunks);
+
+            delete[] t->chunks;
+        }
+
+        t->chunks         = new_chunks;
+        t->chunk_capacity = capacity;
+    }
+
+    if (messages > t->msg_capacity) {
+        size_t capacity = std::min(std::max(messages, 2 * t->msg_capacity), (size_t)max_mcount_);
+        auto new_headers     = new struct mmsghdr[capacity];
+        auto new_rtp_headers = new uvgrtp::frame::rtp_header[capacity];
+        uint8_t *new_tags    = nullptr;
+
+        if (flags_ & RCE_SRTP_AUTHENTICATE_RTP)
+            new_tags = new uint8_t[UVG_AUTH_TAG_LENGTH * capacity];
+
+        if (t->msg_capacity) {
+            std::copy(t->headers, t->headers + t->hdr_ptr, new_headers);
+            std::copy(t->rtp_headers, t->rtp_headers + t->rtphdr_ptr, new_rtp_headers);
+
+            if (new_tags)
+                memcpy(new_tags, t->rtp_auth_tags, UVG_AUTH_TAG_LENGTH * t->rtpauth_ptr);
+        }
+
+        // the first buffer of each packet is its RTP header and the last one its authentication tag
+        for (size_t i = 0; i < t->hdr_ptr; ++i) {
+            struct msghdr& msg = new_headers[i].msg_hdr;
+
+            msg.msg_iov[0].iov_base = &new_rtp_headers[i];
+
+            if (new_tags)
+                msg.msg_iov[msg.msg_iovlen - 1].iov_base = &new_tags[UVG_AUTH_TAG_LENGTH * i];
+        }
+
+        delete[] t->headers;
+
+        // the sent packets still point to the old RTP headers and authentication tags
+        if (t->zerocopy && t->sent_ptr) {
+            t->old_rtp_headers.emplace_back(t->rtp_headers);
+            if (t->rtp_auth_tags)
+                t->copies.emplace_back(t->rtp_auth_tags);
+        } else {
+            delete[] t->rtp_headers;
+            delete[] t->rtp_auth_tags;
+        }
+
+        t->headers       = new_headers;
+        t->rtp_headers   = new_rtp_headers;
+        t->rtp_auth_tags = new_tags;
+        t->msg_capacity  = capacity;
+    }
+
+    return true;
+}
+
+void uvgrtp::frame_queue::release_transaction_data(uvgrtp::transaction_t *t, bool handed_over,
+    returned_frames& returned)
+{
+    /* free all temporary buffers */
+    t->copies.clear();
+    t->old_rtp_headers.clear();
+
+    /* Deallocate the raw data pointer using the deallocation hook provided by application */
+    if (handed_over && t->data_raw && t->dealloc_hook)
+        returned.emplace_back(t->dealloc_hook, t->data_raw);
+
+    t->data_raw   = nullptr;
+    t->data_smart = nullptr;
+}
+
+void uvgrtp::frame_queue::return_frames(const returned_frames& returned)
+{
+    for (auto& frame : returned)
+        frame.first(frame.second);
+}
+
+void uvgrtp::frame_queue::recycle_transaction(uvgrtp::transaction_t *t)
+{
+    if (free_.size() >= (size_t)max_queued_)
+        (void)destroy_transaction(t);
+    else
+        free_.push_back(t);
+}
+
 rtp_error_t uvgrtp::frame_queue::deinit_transaction()
 {
     if (active_ == nullptr) {
@@ -297,9 +574,12 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
       return RTP_INVALID_VALUE;
     }
 
-    /* Create buffer vector where the full packet is constructed
-     * and which is then pushed to "active_"'s pkt_vec structure */
-    uvgrtp::buf_vec tmp;
+    rtp_error_t ret = make_room(1);
+
+    if (ret != RTP_OK)
+        return ret;
+
+    struct iovec *first = &active_->chunks[active_->chunk_ptr];
 
     /* update the RTP header at "rtpheaders_ptr_" */
     update_rtp_header();
@@ -308,19 +588,19 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
         ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr])[1] |= (1 << 7);
 
     /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
-    });
+    push_chunk((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr], sizeof(active_->rtp_headers[active_->rtphdr_ptr]));
+    ++active_->rtphdr_ptr;
 
     /* If SRTP with proper encryption has been enabled but
      * RCE_SRTP_INPLACE_ENCRYPTION has **not** been enabled, make a copy of the memory block*/
-    if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP)
+    if ((flags_ & (RCE_SRTP | RCE_SRTP_INPLACE_ENCRYPTION | RCE_SRTP_NULL_CIPHER)) == RCE_SRTP) {
         message = (uint8_t *)memdup(message, message_len);
+        active_->copies.emplace_back(message);
+    }
 
-    tmp.push_back({ message_len, message });
+    push_chunk(message, message_len);
 
-    enqueue_finalize(tmp);
+    enqueue_finalize(first);
     return RTP_OK;
 }
 
@@ -330,6 +610,11 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
 }
 
 rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+    return enqueue_message(buffers, false);
+}
+
+rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, uint8_t *>>& buffers, bool transient)
 {
     if (!buffers.size())
     {
@@ -337,22 +622,27 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
         return RTP_INVALID_VALUE;
     }
 
-    /* Create buffer vector where the full packet is constructed
-     * and which is then pushed to "active_"'s pkt_vec structure */
-    uvgrtp::buf_vec tmp;
+    rtp_error_t ret = make_room(buffers.size());
+
+    if (ret != RTP_OK)
+        return ret;
+
+    struct iovec *first = &active_->chunks[active_->chunk_ptr];
 
     /* update the RTP header at "rtpheaders_ptr_" */
     update_rtp_header();
 
     /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
-    });
+    push_chunk((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr], sizeof(active_->rtp_headers[active_->rtphdr_ptr]));
+    ++active_->rtphdr_ptr;
 
     /* If SRTP with proper encryption is used and there are more than one buffer,
      * frame queue must be a copy of the input and  */
-    if ((flags_ & RCE_SRTP) && !(flags_ & RCE_SRTP_NULL_CIPHER) && buffers.size() > 1) {
+    bool srtp_copy = (flags_ & RCE_SRTP) && !(flags_ & RCE_SRTP_NULL_CIPHER) && buffers.size() > 1;
+
+    /* The dispatcher sends the packet after push_frame() has returned
+     * and zero-copy sends may still read it after that */
+    if (srtp_copy || (transient && (dispatcher_ || zerocopy_))) {
         size_t total = 0;
         uint8_t *mem = nullptr;
         uint8_t *ptr = nullptr;
@@ -367,41 +657,58 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(std::vector<std::pair<size_t, u
             ptr += buffer.first;
         }
 
-        tmp.push_back({ total, mem });
+        push_chunk(mem, total);
+        active_->copies.emplace_back(mem);
 
     } else {
         for (auto& buffer : buffers)
-            tmp.push_back({ buffer.first, buffer.second });
+            push_chunk(buffer.second, buffer.first);
     }
 
-    enqueue_finalize(tmp);
+    enqueue_finalize(first);
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::frame_queue::flush_queue()
 {
-    if (active_->packets.empty()) {
+    if (active_->hdr_ptr == active_->sent_ptr) {
         LOG_ERROR("Cannot send an empty packet!");
         (void)deinit_transaction();
         return RTP_INVALID_VALUE;
     }
 
     /* set the marker bit of the last packet to 1 */
-    if (active_->packets.size() > 1)
+    if (active_->flushed + active_->hdr_ptr > 1)
         ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr - 1])[1] |= (1 << 7);
 
+    /* the send flags of a frame sent in batches were decided when the first batch was sent */
+    if (active_->flushed == 0 && active_->sent_ptr == 0)
+        prepare_send(active_);
+
     transaction_mtx_.lock();
     queued_.insert(std::make_pair(active_->key, active_));
     transaction_mtx_.unlock();
 
-    if (socket_->sendto(active_->packets, 0) != RTP_OK) {
+    uvgrtp::transaction_t *transaction = active_;
+    active_ = nullptr;
+
+    /* The dispatcher owns the transaction until it has been sent, see complete_transaction() */
+    if (dispatcher_) {
+        dispatcher_->trigger_send(transaction);
+        return RTP_OK;
+    }
+
+    rtp_error_t ret = RTP_OK;
+
+    if (socket_->sendto(transaction->headers + transaction->sent_ptr, transaction->hdr_ptr - transaction->sent_ptr,
+                        transaction->send_flags) != RTP_OK) {
         LOG_ERROR("Failed to flush the message queue: %s", strerror(errno));
-        (void)deinit_transaction();
-        return RTP_SEND_ERROR;
+        ret = RTP_SEND_ERROR;
     }
 
-    //LOG_DEBUG("full message took %zu chunks and %zu messages", active_->chunk_ptr, active_->hdr_ptr);
-    return deinit_transaction();
+    //LOG_DEBUG("full message took %zu chunks and %zu messages", transaction->chunk_ptr, transaction->hdr_ptr);
+    complete_transaction(transaction);
+    return ret;
 }
 
 void uvgrtp::frame_queue::update_rtp_header()
@@ -444,17 +751,134 @@ void uvgrtp::frame_queue::install_dealloc_hook(void (*dealloc_hook)(void *))
     dealloc_hook_ = dealloc_hook;
 }
 
+bool uvgrtp::frame_queue::has_dealloc_hook() const
+{
+    return dealloc_hook_ != nullptr;
+}
+
+void uvgrtp::frame_queue::set_owned_data(std::unique_ptr<uint8_t[]> data)
+{
+    owned_data_ = std::move(data);
+}
+
+
+rtp_error_t uvgrtp::frame_queue::make_room(size_t nchunks)
+{
+    /* The dispatcher sends whole frames so their packets are not sent in batches */
+    if (batch_size_ && !dispatcher_ && active_->hdr_ptr - active_->sent_ptr >= batch_size_) {
+        if (send_batch(0) != RTP_OK)
+            return RTP_SEND_ERROR;
+    }
+
+    if (!reserve(active_, active_->hdr_ptr + 1, active_->chunk_ptr + nchunks + 2)) {
+        LOG_ERROR("Frame has more than %zd packets, see RCC_MAX_FRAME_PACKETS", max_mcount_);
+        return RTP_MEMORY_ERROR;
+    }
+
+    return RTP_OK;
+}
 
-void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
+rtp_error_t uvgrtp::frame_queue::send_batch(size_t hold)
 {
-    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
-        tmp.push_back({
-            UVG_AUTH_TAG_LENGTH,
-            (uint8_t*)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
-            });
+    size_t end = active_->hdr_ptr - hold;
+
+    if (end <= active_->sent_ptr)
+        return RTP_OK;
+
+    if (active_->flushed == 0 && active_->sent_ptr == 0)
+        prepare_send(active_);
+
+    rtp_error_t ret = socket_->sendto(active_->headers + active_->sent_ptr, end - active_->sent_ptr,
+                                      active_->send_flags);
+
+    if (ret != RTP_OK) {
+        LOG_ERROR("Failed to send a batch of packets: %s", strerror(errno));
+        return ret;
+    }
+
+    /* The kernel may still read the packets sent with MSG_ZEROCOPY so their entries are
+     * kept until the transaction is completed */
+    if (active_->zerocopy) {
+        active_->sent_ptr = end;
+        return RTP_OK;
     }
 
-    active_->packets.push_back(tmp);
+    if (hold) {
+        move_held(hold);
+        return RTP_OK;
+    }
+
+    active_->flushed    += active_->hdr_ptr;
+    active_->hdr_ptr     = 0;
+    active_->chunk_ptr   = 0;
+    active_->rtphdr_ptr  = 0;
+    active_->rtpauth_ptr = 0;
+    active_->sent_ptr    = 0;
+    active_->copies.clear();
+
+    return RTP_OK;
+}
+
+void uvgrtp::frame_queue::move_held(size_t hold)
+{
+    size_t end          = active_->hdr_ptr - hold;
+    size_t tag          = (flags_ & RCE_SRTP_AUTHENTICATE_RTP) ? 1 : 0;
+    struct iovec *first = active_->headers[end].msg_hdr.msg_iov;
+    size_t nchunks      = &active_->chunks[active_->chunk_ptr] - first;
+
+    // the entries of the sent packets are reused the same way reserve() moves them to new arrays
+    std::copy(first, first + nchunks, active_->chunks);
+
+    for (size_t i = 0; i < hold; ++i) {
+        active_->headers[i]     = active_->headers[end + i];
+        active_->rtp_headers[i] = active_->rtp_headers[end + i];
+
+        struct msghdr& msg = active_->headers[i].msg_hdr;
+
+        msg.msg_iov             = active_->chunks + (msg.msg_iov - first);
+        msg.msg_iov[0].iov_base = &active_->rtp_headers[i];
+
+        if (tag) {
+            memcpy(&active_->rtp_auth_tags[UVG_AUTH_TAG_LENGTH * i],
+                   &active_->rtp_auth_tags[UVG_AUTH_TAG_LENGTH * (end + i)], UVG_AUTH_TAG_LENGTH);
+            msg.msg_iov[msg.msg_iovlen - 1].iov_base = &active_->rtp_auth_tags[UVG_AUTH_TAG_LENGTH * i];
+        }
+    }
+
+    // only the merged payloads of the held packets are still needed
+    active_->copies.erase(active_->copies.begin(), active_->copies.end() - std::min(hold, active_->copies.size()));
+
+    active_->flushed    += end;
+    active_->hdr_ptr     = hold;
+    active_->chunk_ptr   = nchunks;
+    active_->rtphdr_ptr  = hold;
+    active_->rtpauth_ptr = tag ? hold : 0;
+    active_->sent_ptr    = 0;
+}
+
+void uvgrtp::frame_queue::push_chunk(uint8_t *data, size_t len)
+{
+    struct iovec& chunk = active_->chunks[active_->chunk_ptr++];
+
+    chunk.iov_base = data;
+    chunk.iov_len  = len;
+}
+
+void uvgrtp::frame_queue::enqueue_finalize(struct iovec *first)
+{
+    if (flags_ & RCE_SRTP_AUTHENTICATE_RTP)
+        push_chunk(&active_->rtp_auth_tags[UVG_AUTH_TAG_LENGTH * active_->rtpauth_ptr++], UVG_AUTH_TAG_LENGTH);
+
+    struct msghdr& msg = active_->headers[active_->hdr_ptr++].msg_hdr;
+
+    msg.msg_name       = (void *)&active_->out_addr;
+    msg.msg_namelen    = sizeof(active_->out_addr);
+    msg.msg_iov        = first;
+    msg.msg_iovlen     = &active_->chunks[active_->chunk_ptr] - first;
+    msg.msg_control    = nullptr;
+    msg.msg_controllen = 0;
+    msg.msg_flags      = 0;
+
     rtp_->inc_sequence();
     rtp_->inc_sent_pkts();
 }
@@ -6,6 +6,7 @@
 #include "uvgrtp/util.hh"
 
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -15,12 +16,20 @@
 typedef SSIZE_T ssize_t;
 #endif
 
+/* Default limits of the packets per frame and the free transactions kept for reuse,
+ * see RCC_MAX_FRAME_PACKETS and RCC_FRAME_CACHE_SIZE */
 const int MAX_MSG_COUNT   = 5000;
 const int MAX_QUEUED_MSGS =  10;
+
+/* Number of buffers reserved for each packet when the packet arrays of a transaction are sized */
 const int MAX_CHUNK_COUNT =   4;
 
+/* Default size of the smallest frame sent with MSG_ZEROCOPY, see RCC_ZEROCOPY_THRESHOLD */
+const size_t ZEROCOPY_THRESHOLD = 16384;
+
 namespace uvgrtp {
     class frame_queue;
+    class dispatcher;
     class rtp;
 
 
@@ -42,23 +51,32 @@ namespace uvgrtp {
          * which are then passed (along with the actual media) to enqueue_message() */
         uvgrtp::buf_vec buffers;
 
-        /* Each RTP frame of a transaction is constructed using buf_vec structure and
-         * each buf_vec structure is pushed to pkt_vec */
-        uvgrtp::pkt_vec packets;
-
         /* All packets of a transaction share the common RTP header only differing in sequence number.
          * Keeping a separate common RTP header and then just copying this is cleaner than initializing
          * RTP header for each packet */
         uvgrtp::frame::rtp_header rtp_common;
         uvgrtp::frame::rtp_header *rtp_headers = nullptr;
 
-#ifndef _WIN32
+        /* Number of packets "headers", "rtp_headers" and "rtp_auth_tags" have room for and
+         * the number of buffers "chunks" has room for. The arrays are sized from the frame
+         * when the transaction is initialized and they grow if the estimate was too small */
+        size_t msg_capacity = 0;
+        size_t chunk_capacity = 0;
+
+        /* Size of the frame given to init_transaction() */
+        size_t frame_size = 0;
+
+        /* When the frame is sent in batches (see RCC_SEND_BATCH_SIZE), "sent_ptr" is the first
+         * packet of the arrays that has not been sent yet and "flushed" the number of sent packets
+         * that have been removed from the arrays so that their entries could be reused */
+        size_t sent_ptr = 0;
+        size_t flushed = 0;
+
+        /* Each RTP packet of a transaction is written directly to these preallocated arrays:
+         * its buffers to "chunks" and a message pointing to them to "headers". The socket sends
+         * the messages as they are so enqueueing a packet does not allocate anything */
         struct mmsghdr *headers = nullptr;
         struct iovec   *chunks = nullptr;
-#else
-        char *headers = nullptr;
-        char *chunks = nullptr;
-#endif
 
         /* Media may need space for additional buffers,
          * this pointer is initialized with uvgrtp::MEDIA_TYPE::media_headers
@@ -89,6 +107,21 @@ namespace uvgrtp {
          * When SCD finishes processing a transaction, it will call this hook with "data_raw" pointer */
         void (*dealloc_hook)(void *);
 
+        /* Copies of buffers that do not live as long as the transaction and
+         * the copies made for SRTP encryption, see enqueue_message() */
+        std::vector<std::unique_ptr<uint8_t[]>> copies;
+
+        /* RTP headers of packets sent with MSG_ZEROCOPY that were left behind when the arrays grew.
+         * The kernel may still read them so they are released with the copies */
+        std::vector<std::unique_ptr<uvgrtp::frame::rtp_header[]>> old_rtp_headers;
+
+        /* Flags given to socket when the packets are sent. If the transaction is sent with
+         * MSG_ZEROCOPY, it is released only after the kernel has completed the sends of all
+         * messages with IDs smaller than "zerocopy_end" */
+        int send_flags = 0;
+        bool zerocopy = false;
+        uint32_t zerocopy_end = 0;
+
     } transaction_t;
 
     class frame_queue {
@@ -96,9 +129,13 @@ namespace uvgrtp {
             frame_queue(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int flags);
             ~frame_queue();
 
-            rtp_error_t init_transaction();
-            rtp_error_t init_transaction(uint8_t *data);
-            rtp_error_t init_transaction(std::unique_ptr<uint8_t[]> data);
+            /* Initialize a transaction for a frame of "frame_size" bytes. The packet arrays of the
+             * transaction are sized so that the frame fits in them without growing the arrays
+             *
+             * Return RTP_OK on success */
+            rtp_error_t init_transaction(size_t frame_size);
+            rtp_error_t init_transaction(uint8_t *data, size_t frame_size);
+            rtp_error_t init_transaction(std::unique_ptr<uint8_t[]> data, size_t frame_size);
 
             /* If there are less than "MAX_QUEUED_MSGS" in the "free_" vector,
              * the transaction is moved there, otherwise it's destroyed
@@ -106,6 +143,10 @@ namespace uvgrtp {
              * If parameter "key" is given, the transaction with that key will be deinitialized
              * Otherwise the active transaction is deinitialized
              *
+             * If some packets of the transaction have already been sent with MSG_ZEROCOPY,
+             * the transaction is released like in complete_transaction(), and its frame
+             * is given to the deallocation hook after the kernel has completed the sends
+             *
              * Return RTP_OK on success
              * Return RTP_INVALID_VALUE if "key" doesn't point to valid transaction */
             rtp_error_t deinit_transaction();
@@ -126,19 +167,57 @@ namespace uvgrtp {
             rtp_error_t enqueue_message(uint8_t *message, size_t message_len, bool set_marker);
 
             /* Cache all messages in "buffers" in order to frame queue
+             *
+             * If "transient" is true, the buffers are not valid after push_frame() has returned
+             * and they are copied to the transaction if it is sent by the system call dispatcher
              *
              * Return RTP_OK on success
              * Return RTP_INVALID_VALUE if one of the parameters is invalid
              * Return RTP_MEMORY_ERROR if the maximum amount of chunks/messages is exceeded */
             rtp_error_t enqueue_message(buf_vec& buffers);
+            rtp_error_t enqueue_message(buf_vec& buffers, bool transient);
 
-            /* Flush the message queue
+            /* Flush the message queue. If RCE_SYSTEM_CALL_DISPATCHER has been given,
+             * the transaction is handed to the dispatcher and this returns without sending
              *
              * Return RTP_OK on success
              * Return RTP_INVALID_VALUE if "sender" is nullptr or message buffer is empty
              * return RTP_SEND_ERROR if send fails */
             rtp_error_t flush_queue();
 
+            /* Send the packets of the active transaction except the last one, which is kept so that
+             * the marker bit can still be set on it. The payload of the kept packet is copied so the
+             * caller may release its buffers. Used to send a frame one NAL unit at a time
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t flush_partial();
+
+            /* Set the marker bit of the last packet of the active transaction */
+            void set_marker();
+
+            /* Called when the packets of "transaction" have been sent. Releases the frame of the
+             * transaction and moves it back to "free_", or if the transaction was sent with
+             * MSG_ZEROCOPY, once the kernel has reported the sends completed */
+            void complete_transaction(uvgrtp::transaction_t *transaction);
+
+            /* Frames of at least "threshold" bytes are sent with MSG_ZEROCOPY
+             * if RCE_ZEROCOPY_SEND has been given */
+            void set_zerocopy_threshold(size_t threshold);
+
+            /* Set the maximum number of packets per frame, see RCC_MAX_FRAME_PACKETS
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "packets" is 0 */
+            rtp_error_t set_max_packets(size_t packets);
+
+            /* Set how many free transactions are kept for reuse, see RCC_FRAME_CACHE_SIZE */
+            void set_cache_size(size_t transactions);
+
+            /* Send the packets of a frame in batches of "packets" packets while the frame is
+             * still being packetized, see RCC_SEND_BATCH_SIZE. 0 sends the frame at once */
+            void set_batch_size(size_t packets);
+
             /* Media may have extra headers (f.ex. NAL and FU headers for HEVC).
              * These headers must be valid until the message is sent (ie. they cannot be saved to
              * caller's stack).
@@ -176,9 +255,69 @@ namespace uvgrtp {
              * significant memory leaks */
             void install_dealloc_hook(void (*dealloc_hook)(void *));
 
+            /* Return true if a deallocation hook has been installed */
+            bool has_dealloc_hook() const;
+
+            /* The next transaction initialized with init_transaction(uint8_t *) takes the ownership
+             * of "data" and it is freed when the transaction has been sent */
+            void set_owned_data(std::unique_ptr<uint8_t[]> data);
+
         private:
 
-            void enqueue_finalize(uvgrtp::buf_vec& tmp);
+            /* Make room to the active transaction for a packet of "nchunks" buffers, counting the
+             * RTP header and authentication tag. The arrays are grown if necessary, or if the frame
+             * is sent in batches and the batch is full, the packets are sent first
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the frame has too many packets
+             * Return RTP_SEND_ERROR if sending the batch failed */
+            rtp_error_t make_room(size_t nchunks);
+
+            /* Send the packets of the active transaction that have not been sent yet,
+             * except the last "hold" packets. Unless the frame is sent with MSG_ZEROCOPY, the held
+             * packets are then moved to the start of the arrays, so their payloads must be in the
+             * last "hold" copies of the transaction (see flush_partial())
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_batch(size_t hold);
+
+            /* Move the last "hold" packets of the active transaction to the start of its arrays
+             * after the packets before them have been sent */
+            void move_held(size_t hold);
+
+            /* Grow the arrays of "t" geometrically so that they have room for at least "messages"
+             * packets and "chunks" buffers. The packets already in "t" are moved to the new arrays
+             *
+             * Return false if the arrays cannot grow that large */
+            bool reserve(uvgrtp::transaction_t *t, size_t messages, size_t chunks);
+
+            /* Add a buffer to the packet being built */
+            void push_chunk(uint8_t *data, size_t len);
+
+            /* Finish the packet whose buffers start from "first" */
+            void enqueue_finalize(struct iovec *first);
+
+            /* Frames to give back to the application with their deallocation hooks */
+            typedef std::vector<std::pair<void (*)(void *), void *>> returned_frames;
+
+            /* Free the temporary buffers of "t" and release the frame it was created from.
+             * If the frame was handed over for sending and the transaction has a deallocation hook,
+             * the frame is added to "returned" instead. The hooks may push the next frame so they
+             * must be called with return_frames() after "transaction_mtx_" has been released */
+            void release_transaction_data(uvgrtp::transaction_t *t, bool handed_over, returned_frames& returned);
+
+            static void return_frames(const returned_frames& returned);
+
+            /* Move "t" to "free_" or destroy it if there are enough free transactions */
+            void recycle_transaction(uvgrtp::transaction_t *t);
+
+            /* Decide the send flags of "t" */
+            void prepare_send(uvgrtp::transaction_t *t);
+
+            /* Called by the socket when the kernel has completed the zero-copy sends with smaller
+             * IDs than "completed". Releases the transactions waiting for them */
+            void reap_zerocopy(uint32_t completed);
 
             /* Both the application and SCD access "free_" and "queued_" structures so the
              * access must be protected by a mutex
@@ -194,9 +333,24 @@ namespace uvgrtp {
             /* Deallocation hook is stored here and copied to transaction upon initialization */
             void (*dealloc_hook_)(void *);
 
+            /* See set_owned_data() */
+            std::unique_ptr<uint8_t[]> owned_data_;
+
+            /* Set if RCE_SYSTEM_CALL_DISPATCHER has been given */
+            std::unique_ptr<uvgrtp::dispatcher> dispatcher_;
+
+            /* Set if RCE_ZEROCOPY_SEND has been given and the socket supports MSG_ZEROCOPY */
+            bool zerocopy_;
+            size_t zerocopy_threshold_;
+
+            /* Transactions sent with MSG_ZEROCOPY, in the order they were sent, that wait for
+             * the kernel to complete the sends. Protected by "transaction_mtx_" */
+            std::deque<transaction_t *> zerocopy_pending_;
+            uint32_t zerocopy_completed_;
+
             ssize_t max_queued_; /* number of queued transactions */
             ssize_t max_mcount_; /* number of messages per transactions */
-            ssize_t max_ccount_; /* number of chunks per message */
+            size_t batch_size_;  /* number of messages sent at once while packetizing, 0 if disabled */
 
             std::shared_ptr<uvgrtp::rtp> rtp_;
             std::shared_ptr<uvgrtp::socket> socket_;
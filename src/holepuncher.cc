@@ -1,5 +1,7 @@
 #include "holepuncher.hh"
 
+#include "io_runtime.hh"
+
 #include "uvgrtp/clock.hh"
 #include "uvgrtp/socket.hh"
 #include "uvgrtp/debug.hh"
@@ -9,13 +11,18 @@
 
 uvgrtp::holepuncher::holepuncher(std::shared_ptr<uvgrtp::socket> socket):
     socket_(socket),
-    last_dgram_sent_(0)
+    last_dgram_sent_(0),
+    active_(false),
+    runner_(nullptr),
+    runtime_(nullptr),
+    runtime_worker_(0),
+    runtime_source_(nullptr)
 {
 }
 
 uvgrtp::holepuncher::~holepuncher()
 {
-    active_ = false;
+    stop();
 
     if (runner_ != nullptr)
     {
@@ -27,8 +34,21 @@ uvgrtp::holepuncher::~holepuncher()
     }
 }
 
+void uvgrtp::holepuncher::set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker)
+{
+    runtime_        = runtime;
+    runtime_worker_ = worker;
+}
+
 rtp_error_t uvgrtp::holepuncher::start()
 {
+    if (runtime_) {
+        active_ = true;
+        runtime_source_ = runtime_->add_timer(runtime_worker_, 0, 500,
+            std::bind(&uvgrtp::holepuncher::check_keepalive, this));
+        return RTP_OK;
+    }
+
     runner_ = std::unique_ptr<std::thread> (new std::thread(&uvgrtp::holepuncher::keepalive, this));
     runner_->detach();
     active_ = true;
@@ -38,6 +58,12 @@ rtp_error_t uvgrtp::holepuncher::start()
 rtp_error_t uvgrtp::holepuncher::stop()
 {
     active_ = false;
+
+    if (runtime_source_) {
+        runtime_->remove(runtime_source_);
+        runtime_source_ = nullptr;
+    }
+
     return RTP_OK;
 }
 
@@ -54,8 +80,16 @@ void uvgrtp::holepuncher::keepalive()
             continue;
         }
 
-        uint8_t payload = 0x00;
-        socket_->sendto(&payload, 1, 0);
-        last_dgram_sent_ = uvgrtp::clock::ntp::now();
+        check_keepalive();
     }
 }
+
+void uvgrtp::holepuncher::check_keepalive()
+{
+    if (uvgrtp::clock::ntp::diff_now(last_dgram_sent_) < THRESHOLD)
+        return;
+
+    uint8_t payload = 0x00;
+    socket_->sendto(&payload, 1, 0);
+    last_dgram_sent_ = uvgrtp::clock::ntp::now();
+}
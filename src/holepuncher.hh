@@ -9,12 +9,18 @@
 namespace uvgrtp {
 
     class socket;
+    class io_runtime;
+    struct io_source;
 
     class holepuncher {
         public:
             holepuncher(std::shared_ptr<uvgrtp::socket> socket);
             ~holepuncher();
 
+            /* Send the keepalive datagrams from worker "worker" of "runtime"
+             * instead of own thread. Must be called before start() */
+            void set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker);
+
             /* Create new thread object and start the holepuncher
              *
              * Return RTP_OK on success
@@ -31,11 +37,18 @@ namespace uvgrtp {
         private:
             void keepalive();
 
+            /* Send a keepalive datagram if the application has not sent anything in a while */
+            void check_keepalive();
+
             std::shared_ptr<uvgrtp::socket> socket_;
             std::atomic<uint64_t> last_dgram_sent_;
 
             bool active_;
             std::unique_ptr<std::thread> runner_;
+
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
+            size_t runtime_worker_;
+            uvgrtp::io_source *runtime_source_;
     };
 }
 
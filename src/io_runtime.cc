@@ -0,0 +1,291 @@
+#include "io_runtime.hh"
+
+#include "uvgrtp/debug.hh"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+constexpr int MAX_EVENTS = 64;
+
+namespace uvgrtp {
+    struct io_worker {
+        int epfd = -1;
+        int evfd = -1;
+
+        std::unique_ptr<std::thread> thread;
+
+        /* Held while the worker runs handlers. Recursive so that handlers
+         * can add and remove sources of their own worker */
+        std::recursive_mutex mtx;
+
+        std::vector<io_source *> sources;
+        std::vector<io_source *> timers;
+
+        /* Removed sources are freed by the worker only after it has dispatched
+         * the events it may have already fetched for them */
+        std::vector<io_source *> graveyard;
+
+        std::atomic<size_t> nsources{0};
+    };
+}
+
+uvgrtp::io_runtime::io_runtime(size_t workers) :
+    workers_(),
+    should_stop_(false)
+{
+    for (size_t i = 0; i < workers; ++i)
+        workers_.emplace_back(new uvgrtp::io_worker());
+}
+
+uvgrtp::io_runtime::~io_runtime()
+{
+    should_stop_ = true;
+
+    for (auto& worker : workers_) {
+        if (worker->thread && worker->thread->joinable()) {
+            wake(worker.get());
+            worker->thread->join();
+        }
+
+        for (auto& source : worker->sources)
+            delete source;
+
+#ifdef __linux__
+        if (worker->evfd != -1)
+            close(worker->evfd);
+
+        if (worker->epfd != -1)
+            close(worker->epfd);
+#endif
+    }
+}
+
+rtp_error_t uvgrtp::io_runtime::start()
+{
+#ifdef __linux__
+    for (auto& worker : workers_) {
+        if ((worker->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            LOG_ERROR("epoll_create1(2) failed: %s", strerror(errno));
+            return RTP_GENERIC_ERROR;
+        }
+
+        if ((worker->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+            LOG_ERROR("eventfd(2) failed: %s", strerror(errno));
+            return RTP_GENERIC_ERROR;
+        }
+
+        // the wakeup event is the only one without a source
+        epoll_event ev = {};
+        ev.events   = EPOLLIN;
+        ev.data.ptr = nullptr;
+
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, worker->evfd, &ev) < 0) {
+            LOG_ERROR("epoll_ctl(2) failed: %s", strerror(errno));
+            return RTP_GENERIC_ERROR;
+        }
+    }
+
+    for (auto& worker : workers_)
+        worker->thread.reset(new std::thread(&uvgrtp::io_runtime::run, this, worker.get()));
+
+    LOG_DEBUG("I/O runtime started with %zu workers", workers_.size());
+    return RTP_OK;
+#else
+    LOG_ERROR("I/O runtime is supported only on Linux");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+size_t uvgrtp::io_runtime::pick_worker()
+{
+    size_t best = 0;
+
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        if (workers_[i]->nsources < workers_[best]->nsources)
+            best = i;
+    }
+
+    return best;
+}
+
+uvgrtp::io_source *uvgrtp::io_runtime::add_socket(size_t worker, socket_t fd, std::function<bool()> handler)
+{
+    io_worker *w = workers_.at(worker).get();
+    io_source *source = new io_source();
+
+    source->fd          = fd;
+    source->on_readable = handler;
+    source->worker      = w;
+    source->active      = true;
+    source->polling     = true;
+    source->interval_ms = 0;
+
+    std::lock_guard<std::recursive_mutex> lk(w->mtx);
+
+#ifdef __linux__
+    epoll_event ev = {};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = source;
+
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR("Failed to add socket to the I/O runtime: %s", strerror(errno));
+        delete source;
+        return nullptr;
+    }
+#endif
+
+    w->sources.push_back(source);
+    ++w->nsources;
+
+    return source;
+}
+
+uvgrtp::io_source *uvgrtp::io_runtime::add_timer(size_t worker, uint32_t delay_ms, uint32_t interval_ms,
+    std::function<void()> handler)
+{
+    io_worker *w = workers_.at(worker).get();
+    io_source *source = new io_source();
+
+    source->fd          = (socket_t)-1;
+    source->on_timer    = handler;
+    source->worker      = w;
+    source->active      = true;
+    source->polling     = false;
+    source->interval_ms = interval_ms;
+    source->due         = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+
+    {
+        std::lock_guard<std::recursive_mutex> lk(w->mtx);
+
+        w->sources.push_back(source);
+        w->timers.push_back(source);
+        ++w->nsources;
+    }
+
+    // the worker may be sleeping longer than the delay of this timer
+    wake(w);
+    return source;
+}
+
+void uvgrtp::io_runtime::remove(uvgrtp::io_source *source)
+{
+    if (!source)
+        return;
+
+    io_worker *w = source->worker;
+    std::lock_guard<std::recursive_mutex> lk(w->mtx);
+
+    source->active = false;
+
+#ifdef __linux__
+    if (source->polling)
+        (void)epoll_ctl(w->epfd, EPOLL_CTL_DEL, source->fd, nullptr);
+#endif
+
+    source->polling = false;
+
+    w->graveyard.push_back(source);
+    --w->nsources;
+}
+
+void uvgrtp::io_runtime::wake(uvgrtp::io_worker *worker)
+{
+#ifdef __linux__
+    uint64_t value = 1;
+
+    if (worker->evfd != -1 && write(worker->evfd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        LOG_ERROR("Failed to wake up I/O runtime worker: %s", strerror(errno));
+#else
+    (void)worker;
+#endif
+}
+
+void uvgrtp::io_runtime::run(uvgrtp::io_worker *worker)
+{
+#ifdef __linux__
+    epoll_event events[MAX_EVENTS];
+
+    while (!should_stop_) {
+        int timeout_ms = -1;
+
+        {
+            std::lock_guard<std::recursive_mutex> lk(worker->mtx);
+            auto now = std::chrono::steady_clock::now();
+
+            for (auto& timer : worker->timers) {
+                if (!timer->active)
+                    continue;
+
+                int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(timer->due - now).count();
+
+                if (left < 0)
+                    left = 0;
+
+                if (timeout_ms == -1 || left < timeout_ms)
+                    timeout_ms = (int)left;
+            }
+        }
+
+        int nfds = epoll_wait(worker->epfd, events, MAX_EVENTS, timeout_ms);
+
+        if (nfds < 0 && errno != EINTR) {
+            LOG_ERROR("epoll_wait(2) failed: %s", strerror(errno));
+            break;
+        }
+
+        std::lock_guard<std::recursive_mutex> lk(worker->mtx);
+
+        for (int i = 0; i < nfds; ++i) {
+            auto source = (io_source *)events[i].data.ptr;
+
+            if (!source) {
+                uint64_t value = 0;
+                (void)read(worker->evfd, &value, sizeof(value));
+                continue;
+            }
+
+            if (!source->active || !source->polling)
+                continue;
+
+            if (!source->on_readable()) {
+                (void)epoll_ctl(worker->epfd, EPOLL_CTL_DEL, source->fd, nullptr);
+                source->polling = false;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        // timers may be added by the handlers so the vector is indexed
+        for (size_t i = 0; i < worker->timers.size(); ++i) {
+            io_source *timer = worker->timers[i];
+
+            if (!timer->active || timer->due > now)
+                continue;
+
+            timer->due += std::chrono::milliseconds(timer->interval_ms);
+
+            // do not try to catch up if the worker has been busy
+            if (timer->due < now)
+                timer->due = now + std::chrono::milliseconds(timer->interval_ms);
+
+            timer->on_timer();
+        }
+
+        for (auto& source : worker->graveyard) {
+            worker->sources.erase(std::remove(worker->sources.begin(), worker->sources.end(), source), worker->sources.end());
+            worker->timers.erase(std::remove(worker->timers.begin(), worker->timers.end(), source), worker->timers.end());
+            delete source;
+        }
+        worker->graveyard.clear();
+    }
+#else
+    (void)worker;
+#endif
+}
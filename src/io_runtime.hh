@@ -0,0 +1,84 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    struct io_worker;
+
+    /* A socket or a timer registered to the I/O runtime */
+    struct io_source {
+        socket_t fd;
+        std::function<bool()> on_readable;
+        std::function<void()> on_timer;
+
+        io_worker *worker;
+        bool active;  /* false once the source has been removed */
+        bool polling; /* true while "fd" is in the epoll instance */
+
+        uint32_t interval_ms;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    /* The I/O runtime is a fixed pool of worker threads that each run an epoll(7) loop over
+     * the sockets and timers of many media streams. It replaces the receiver and processor
+     * threads of reception flow, the RTCP runner and the holepuncher thread of every media
+     * stream when it has been enabled with uvgrtp::context::enable_io_runtime().
+     *
+     * All sources of one media stream are registered to the same worker so that
+     * the handlers of a media stream never run concurrently with each other.
+     *
+     * The runtime is available only on Linux */
+    class io_runtime {
+        public:
+            io_runtime(size_t workers);
+            ~io_runtime();
+
+            /* Create the epoll instances and start the worker threads
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the runtime is not available on this platform
+             * Return RTP_GENERIC_ERROR if creating the epoll instances failed */
+            rtp_error_t start();
+
+            /* Return the index of the worker with the fewest sources */
+            size_t pick_worker();
+
+            /* Call "handler" on worker "worker" whenever "fd" is readable.
+             * If the handler returns false, "fd" is no longer polled
+             *
+             * Return pointer to the source on success
+             * Return nullptr if "fd" could not be added to the epoll instance */
+            io_source *add_socket(size_t worker, socket_t fd, std::function<bool()> handler);
+
+            /* Call "handler" on worker "worker" every "interval_ms" milliseconds,
+             * the first time after "delay_ms" milliseconds
+             *
+             * Return pointer to the source on success */
+            io_source *add_timer(size_t worker, uint32_t delay_ms, uint32_t interval_ms, std::function<void()> handler);
+
+            /* Remove "source" from the runtime. When this returns, the handler of the source
+             * is not running and it will not be called again. This can be called from the
+             * handlers of the same worker */
+            void remove(io_source *source);
+
+        private:
+            void run(io_worker *worker);
+
+            /* Wake "worker" up so that it notices new timers or that it should stop */
+            void wake(io_worker *worker);
+
+            std::vector<std::unique_ptr<io_worker>> workers_;
+            std::atomic<bool> should_stop_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -9,6 +9,8 @@
 #include "zrtp.hh"
 
 #include "holepuncher.hh"
+#include "io_runtime.hh"
+#include "pacer.hh"
 #include "reception_flow.hh"
 #include "uvgrtp/rtcp.hh"
 #include "uvgrtp/socket.hh"
@@ -19,7 +21,8 @@
 #include <cstring>
 #include <errno.h>
 
-uvgrtp::media_stream::media_stream(std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags):
+uvgrtp::media_stream::media_stream(std::string addr, int src_port, int dst_port, rtp_format_t fmt, int flags,
+    std::shared_ptr<uvgrtp::io_runtime> runtime):
     srtp_(nullptr),
     srtcp_(nullptr),
     socket_(nullptr),
@@ -31,7 +34,10 @@ uvgrtp::media_stream::media_stream(std::string addr, int src_port, int dst_port,
     rtp_handler_key_(0),
     reception_flow_(nullptr),
     media_(nullptr),
-    holepuncher_(nullptr)
+    holepuncher_(nullptr),
+    runtime_(runtime),
+    pacer_(nullptr),
+    session_pacer_(nullptr)
 {
     fmt_      = fmt;
     addr_     = addr;
@@ -47,9 +53,10 @@ uvgrtp::media_stream::media_stream(std::string addr, int src_port, int dst_port,
 uvgrtp::media_stream::media_stream(
     std::string remote_addr, std::string local_addr,
     int src_port, int dst_port,
-    rtp_format_t fmt, int flags
+    rtp_format_t fmt, int flags,
+    std::shared_ptr<uvgrtp::io_runtime> runtime
 ):
-    media_stream(remote_addr, src_port, dst_port, fmt, flags)
+    media_stream(remote_addr, src_port, dst_port, fmt, flags, runtime)
 {
     laddr_ = local_addr;
 }
@@ -121,6 +128,9 @@ rtp_error_t uvgrtp::media_stream::init_connection()
     addr_out_ = socket_->create_sockaddr(AF_INET, addr_, dst_port_);
     socket_->set_sockaddr(addr_out_);
 
+    if (pacer_)
+        socket_->set_pacer(pacer_, fmt_ == RTP_FORMAT_OPUS);
+
     return ret;
 }
 
@@ -336,8 +346,23 @@ rtp_error_t uvgrtp::media_stream::start_components()
     if (create_media(fmt_) != RTP_OK)
         return free_resources(RTP_MEMORY_ERROR);
 
+    /* the deadlines of the frames being reassembled expire on the thread that runs the packet handlers */
+    media_->set_timer_wheel(reception_flow_->get_timer_wheel());
+
+    /* all sources of the media stream are served by the same worker */
+    size_t worker = runtime_ ? runtime_->pick_worker() : 0;
+
+    if (runtime_) {
+        reception_flow_->set_io_runtime(runtime_, worker);
+        rtcp_->set_io_runtime(runtime_, worker);
+    }
+
     if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE) {
         holepuncher_ = std::unique_ptr<uvgrtp::holepuncher> (new uvgrtp::holepuncher(socket_));
+
+        if (runtime_)
+            holepuncher_->set_io_runtime(runtime_, worker);
+
         holepuncher_->start();
     }
 
@@ -417,6 +442,91 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     return ret;
 }
 
+rtp_error_t uvgrtp::media_stream::push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, int flags)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE && holepuncher_)
+        holepuncher_->notify();
+
+    return media_->push_frame(nals, nal_count, flags);
+}
+
+rtp_error_t uvgrtp::media_stream::push_frame(const uvgrtp::frame::nal_unit *nals, size_t nal_count, uint32_t ts, int flags)
+{
+    rtp_error_t ret = RTP_GENERIC_ERROR;
+
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE && holepuncher_)
+        holepuncher_->notify();
+
+    rtp_->set_timestamp(ts);
+    ret = media_->push_frame(nals, nal_count, flags);
+    rtp_->set_timestamp(INVALID_TS);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::begin_frame()
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE && holepuncher_)
+        holepuncher_->notify();
+
+    return media_->begin_frame();
+}
+
+rtp_error_t uvgrtp::media_stream::begin_frame(uint32_t ts)
+{
+    rtp_error_t ret = RTP_GENERIC_ERROR;
+
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (ctx_config_.flags & RCE_HOLEPUNCH_KEEPALIVE && holepuncher_)
+        holepuncher_->notify();
+
+    // the timestamp is copied to the transaction of the frame when it's started
+    rtp_->set_timestamp(ts);
+    ret = media_->begin_frame();
+    rtp_->set_timestamp(INVALID_TS);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_nal(uint8_t *data, size_t data_len)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return media_->push_nal(data, data_len);
+}
+
+rtp_error_t uvgrtp::media_stream::end_frame()
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return media_->end_frame();
+}
+
 uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame()
 {
     if (!initialized_) {
@@ -464,15 +574,13 @@ rtp_error_t uvgrtp::media_stream::install_deallocation_hook(void (*hook)(void *)
     if (!hook)
         return RTP_INVALID_VALUE;
 
-    /* TODO:  */
+    media_->install_dealloc_hook(hook);
 
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::media_stream::install_notify_hook(void *arg, void (*hook)(void *, int))
 {
-    (void)arg, (void)hook;
-
     if (!initialized_) {
         LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
         return RTP_NOT_INITIALIZED;
@@ -481,7 +589,7 @@ rtp_error_t uvgrtp::media_stream::install_notify_hook(void *arg, void (*hook)(vo
     if (!hook)
         return RTP_INVALID_VALUE;
 
-    /* TODO:  */
+    media_->install_notify_hook(arg, hook);
 
     return RTP_OK;
 }
@@ -563,10 +671,86 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
             }
 
             rtp_->set_payload_size(value - hdr);
+            reception_flow_->set_mtu_size(value);
 
         }
         break;
 
+        case RCC_UDP_RCV_BATCH_SIZE: {
+            if (value <= 0 || value > UINT16_MAX)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_recv_batch_size(value);
+        }
+        break;
+
+        case RCC_RING_OVERFLOW_POLICY: {
+            if (value != RRO_DROP_NEWEST && value != RRO_DROP_OLDEST && value != RRO_BLOCK)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_overflow_policy((int)value);
+        }
+        break;
+
+        case RCC_PACING_RATE: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            ctx_config_.ctx_values[RCC_PACING_RATE] = value;
+
+            // without its own budget the media stream is paced with the budget of the session, if any
+            if (value == 0)
+                set_pacer(session_pacer_);
+            else
+                set_pacer(std::make_shared<uvgrtp::pacer>((uint64_t)value * 1000,
+                    (size_t)ctx_config_.ctx_values[RCC_PACING_BURST]));
+        }
+        break;
+
+        case RCC_ZEROCOPY_THRESHOLD: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            media_->set_zerocopy_threshold((size_t)value);
+        }
+        break;
+
+        case RCC_MAX_FRAME_PACKETS: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            ret = media_->set_max_frame_packets((size_t)value);
+        }
+        break;
+
+        case RCC_FRAME_CACHE_SIZE: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            media_->set_frame_cache_size((size_t)value);
+        }
+        break;
+
+        case RCC_SEND_BATCH_SIZE: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            media_->set_send_batch_size((size_t)value);
+        }
+        break;
+
+        case RCC_PACING_BURST: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            ctx_config_.ctx_values[RCC_PACING_BURST] = value;
+
+            // the burst size of a budget shared with the session is not changed
+            if (ctx_config_.ctx_values[RCC_PACING_RATE] > 0)
+                pacer_->set_rate((uint64_t)ctx_config_.ctx_values[RCC_PACING_RATE] * 1000, (size_t)value);
+        }
+        break;
+
         default:
             return RTP_INVALID_VALUE;
     }
@@ -574,6 +758,24 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int flag, ssize_t value)
     return ret;
 }
 
+void uvgrtp::media_stream::set_session_pacer(std::shared_ptr<uvgrtp::pacer> pacer)
+{
+    session_pacer_ = pacer;
+
+    if (ctx_config_.ctx_values[RCC_PACING_RATE] > 0)
+        return;
+
+    set_pacer(pacer);
+}
+
+void uvgrtp::media_stream::set_pacer(std::shared_ptr<uvgrtp::pacer> pacer)
+{
+    pacer_ = pacer;
+
+    if (socket_)
+        socket_->set_pacer(pacer_, fmt_ == RTP_FORMAT_OPUS);
+}
+
 uint32_t uvgrtp::media_stream::get_key() const
 {
     return key_;
@@ -584,6 +786,44 @@ uvgrtp::rtcp *uvgrtp::media_stream::get_rtcp()
     return rtcp_.get();
 }
 
+uint64_t uvgrtp::media_stream::get_dropped_packets() const
+{
+    if (!initialized_ || reception_flow_ == nullptr) {
+        LOG_ERROR("RTP context has not been initialized, cannot query dropped packets!");
+        return 0;
+    }
+
+    return reception_flow_->get_dropped_packets();
+}
+
+rtp_error_t uvgrtp::media_stream::add_destination(std::string remote_address, uint16_t remote_port)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    sockaddr_in addr = socket_->create_sockaddr(AF_INET, remote_address, remote_port);
+
+    // create_sockaddr() leaves the address empty if it could not be parsed
+    if (addr.sin_addr.s_addr == INADDR_ANY || remote_port == 0) {
+        LOG_ERROR("Invalid destination address %s:%u", remote_address.c_str(), remote_port);
+        return RTP_INVALID_VALUE;
+    }
+
+    return socket_->add_destination(addr);
+}
+
+rtp_error_t uvgrtp::media_stream::remove_destination(std::string remote_address, uint16_t remote_port)
+{
+    if (!initialized_) {
+        LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    return socket_->remove_destination(socket_->create_sockaddr(AF_INET, remote_address, remote_port));
+}
+
 uint32_t uvgrtp::media_stream::get_ssrc() const
 {
     if (!initialized_ || rtp_ == nullptr) {
@@ -0,0 +1,67 @@
+#include "pacer.hh"
+
+#include "uvgrtp/debug.hh"
+
+#include <algorithm>
+#include <thread>
+
+/* Fixed-point scale of the byte time so that multi-gigabit rates do not round to zero */
+constexpr uint64_t BYTE_SCALE = 1024;
+
+/* The thread is woken up this much before the deadline and it spins the rest of the time */
+constexpr std::chrono::microseconds SPIN_TIME(100);
+
+uvgrtp::pacer::pacer(uint64_t rate, size_t burst):
+    byte_time_(0),
+    tolerance_(0),
+    next_(clock::now())
+{
+    set_rate(rate, burst);
+}
+
+uvgrtp::pacer::~pacer()
+{
+}
+
+void uvgrtp::pacer::set_rate(uint64_t rate, size_t burst)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+
+    if (rate == 0)
+        rate = 1;
+
+    byte_time_ = std::max<uint64_t>(1, 8 * 1000000000ull * BYTE_SCALE / rate);
+
+    if (burst == 0)
+        burst = std::max<size_t>(MIN_BURST, (size_t)(rate / 8 * DEFAULT_BURST_US / 1000000));
+
+    tolerance_ = std::chrono::nanoseconds(burst * byte_time_ / BYTE_SCALE);
+
+    LOG_DEBUG("Pacing rate set to %llu bit/s with a burst of %zu bytes", (unsigned long long)rate, burst);
+}
+
+uvgrtp::pacer::clock::time_point uvgrtp::pacer::reserve(size_t bytes, bool priority)
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto now = clock::now();
+
+    // unused budget does not accumulate beyond the burst size
+    if (next_ < now)
+        next_ = now;
+
+    clock::time_point departure = priority ? now : std::max(now, next_ - tolerance_);
+    next_ += std::chrono::nanoseconds(bytes * byte_time_ / BYTE_SCALE);
+
+    return departure;
+}
+
+void uvgrtp::pacer::wait_until(clock::time_point deadline)
+{
+    auto now = clock::now();
+
+    if (deadline - now > SPIN_TIME)
+        std::this_thread::sleep_until(deadline - SPIN_TIME);
+
+    while (clock::now() < deadline)
+        std::this_thread::yield();
+}
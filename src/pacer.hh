@@ -0,0 +1,58 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace uvgrtp {
+
+    /* Token bucket that spreads the packets of the media streams using it over time so
+     * that a large frame does not leave the host as one burst. The bucket refills at
+     * "rate" bits per second and holds at most "burst" bytes. The same pacer can be
+     * shared by many sockets, in which case they share the bitrate budget.
+     *
+     * The pacer itself never sleeps, it only tells when each packet may depart.
+     * The socket either waits until then or gives the departure time to the kernel with SO_TXTIME */
+    class pacer {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            /* If "burst" is 0, the bucket holds as many bytes as are sent
+             * in DEFAULT_BURST_US microseconds, but at least one full packet */
+            static constexpr uint32_t DEFAULT_BURST_US = 2000;
+            static constexpr size_t   MIN_BURST        = 1500;
+
+            pacer(uint64_t rate, size_t burst);
+            ~pacer();
+
+            /* Change the rate (bits per second) and burst size (bytes) of the bucket */
+            void set_rate(uint64_t rate, size_t burst);
+
+            /* Reserve "bytes" bytes from the budget and return the time when they may depart.
+             *
+             * Priority traffic (audio) is never delayed but it still consumes the budget
+             * so the packets reserved after it are delayed instead */
+            clock::time_point reserve(size_t bytes, bool priority);
+
+            /* Wait until "deadline". The thread sleeps for most of the time and spins
+             * the last moments so that the departure times are kept accurately */
+            static void wait_until(clock::time_point deadline);
+
+        private:
+            std::mutex mtx_;
+
+            /* Nanoseconds it takes to send one byte, scaled by BYTE_SCALE */
+            uint64_t byte_time_;
+
+            /* How much ahead of the current time the budget can be used */
+            clock::duration tolerance_;
+
+            /* The time when all bytes reserved so far have been sent at the pacing rate */
+            clock::time_point next_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,6 +1,10 @@
 #include "reception_flow.hh"
 
+#include "frame_pool.hh"
+#include "io_runtime.hh"
 #include "random.hh"
+#include "timer_wheel.hh"
+#include "uring.hh"
 
 #include "uvgrtp/util.hh"
 #include "uvgrtp/frame.hh"
@@ -17,30 +21,88 @@
 #define MSG_DONTWAIT 0
 #endif
 
+#include <algorithm>
 #include <cstring>
+#include <new>
 
 constexpr size_t RECV_BUFFER_SIZE = 0xffff - IPV4_HDR_SIZE - UDP_HDR_SIZE;
 
 constexpr size_t DEFAULT_INITIAL_BUFFER_SIZE = 4194304;
 
+constexpr ssize_t DEFAULT_RECV_BATCH_SIZE = 32;
+
+constexpr size_t MIN_RING_CAPACITY = 2;
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+constexpr ssize_t DEFAULT_MTU_SIZE = 1500;
+
+constexpr int MAX_BATCHES_PER_WAKEUP = 8;
+
+// how often the I/O runtime expires the timers of the timer wheel
+constexpr int TIMER_TICK_MS = 10;
+
+// every datagram of a GRO batch needs its own 64 KB overflow area
+constexpr size_t GRO_BATCH_SIZE = 8;
+
+// every datagram of a batch needs its own overflow area so the batches are limited
+// to bound the address space reserved for the overflow areas
+constexpr size_t MAX_RECV_BATCH_SIZE = 256;
+
+constexpr unsigned URING_RECV_ENTRIES = 8;
+constexpr unsigned URING_MAX_BUFFERS  = 32768;
+constexpr uint64_t URING_RECV_TAG     = 1;
+constexpr uint64_t URING_CANCEL_TAG   = 2;
+
+// the kernel writes the header of the multishot receive to the end of the buffer header
+static_assert(sizeof(uvgrtp::recv_buffer_header) + uvgrtp::uring::RECVMSG_OUT_SIZE <= uvgrtp::RECV_BUFFER_HEADER_SIZE,
+    "reception buffer header has no room for the io_uring receive header");
+
 
 uvgrtp::reception_flow::reception_flow() :
+    frame_pool_(new uvgrtp::frame_pool()),
+    timers_(new uvgrtp::timer_wheel()),
     recv_hook_arg_(nullptr),
     recv_hook_(nullptr),
     should_stop_(true),
     receiver_(nullptr),
-    ring_buffer_(),
-    ring_read_index_(-1), // invalid first index that will increase to a valid one
-    last_ring_write_index_(-1),
-    buffer_size_kbytes_(DEFAULT_INITIAL_BUFFER_SIZE)
+    processor_(nullptr),
+    socket_(nullptr),
+    flags_(0),
+    ring_(nullptr),
+    free_(nullptr),
+    ring_mask_(0),
+    arena_(nullptr),
+    slot_size_(0),
+    scratch_(nullptr),
+    gro_buffers_(nullptr),
+    ring_head_(0),
+    ring_tail_(0),
+    free_head_(0),
+    free_tail_(0),
+    dropped_packets_(0),
+    blocked_count_(0),
+    overflow_policy_(RRO_DROP_NEWEST),
+    receiver_waiting_(false),
+    buffer_size_kbytes_(DEFAULT_INITIAL_BUFFER_SIZE),
+    mtu_size_(DEFAULT_MTU_SIZE),
+    recv_batch_size_(DEFAULT_RECV_BATCH_SIZE),
+    runtime_(nullptr),
+    runtime_worker_(0),
+    runtime_source_(nullptr),
+    runtime_timer_(nullptr)
 {
     create_ring_buffer();
 }
 
 uvgrtp::reception_flow::~reception_flow()
 {
+    stop_threads();
     destroy_ring_buffer();
     clear_frames();
+
+    delete[] gro_buffers_;
+    frame_pool_->unref();
 }
 
 void uvgrtp::reception_flow::clear_frames()
@@ -48,7 +110,7 @@ void uvgrtp::reception_flow::clear_frames()
     frames_mtx_.lock();
     for (auto& frame : frames_)
     {
-        delete[] frame;
+        (void)uvgrtp::frame::dealloc_frame(frame);
     }
 
     frames_.clear();
@@ -58,36 +120,168 @@ void uvgrtp::reception_flow::clear_frames()
 void uvgrtp::reception_flow::create_ring_buffer()
 {
     destroy_ring_buffer();
-    size_t elements = buffer_size_kbytes_ / RECV_BUFFER_SIZE;
 
-    for (int i = 0; i < elements; ++i)
+    // every slot holds one MTU-sized datagram and starts on a cache line boundary
+    slot_size_ = (mtu_size_ - IPV4_HDR_SIZE - UDP_HDR_SIZE + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+    // the capacity is rounded down to a power of two so ring positions can be masked
+    size_t elements = buffer_size_kbytes_ / slot_size_;
+    size_t capacity = MIN_RING_CAPACITY;
+
+    while (capacity * 2 <= elements)
+        capacity *= 2;
+
+    ring_      = std::unique_ptr<ring_entry[]>(new ring_entry[capacity]);
+    free_      = std::unique_ptr<uint8_t *[]>(new uint8_t *[capacity]);
+    ring_mask_ = capacity - 1;
+    scratch_   = new uint8_t[RECV_BUFFER_SIZE];
+
+    // all slots are carved from one contiguous allocation
+    arena_ = new uvgrtp::reception_arena(capacity, slot_size_);
+
+    for (size_t i = 0; i < capacity; ++i)
     {
-        ring_buffer_.push_back({ new uint8_t[RECV_BUFFER_SIZE] , 0 });
+        ring_[i].data = nullptr;
+        ring_[i].read = 0;
+        free_[i]      = arena_->get_slot(i);
     }
+
+    ring_head_ = 0;
+    ring_tail_ = 0;
+    free_head_ = capacity;
+    free_tail_ = 0;
+
+    LOG_DEBUG("Reception ring has %zu slots of %zu bytes", capacity, slot_size_);
 }
 
 void uvgrtp::reception_flow::destroy_ring_buffer()
 {
-    for (int i = 0; i < ring_buffer_.size(); ++i)
+    // jumbo datagrams that were never processed are the only buffers not in the arena
+    if (ring_)
     {
-        delete[] ring_buffer_.at(i).data;
+        for (uint64_t i = ring_tail_; i != ring_head_; ++i)
+            release_buffer_if_jumbo(ring_[i & ring_mask_].data);
     }
-    ring_buffer_.clear();
+
+    // frames returned to the user may still reference the arena
+    if (arena_)
+        arena_->unref();
+    arena_ = nullptr;
+
+    delete[] scratch_;
+    scratch_ = nullptr;
+
+    ring_ = nullptr;
+    free_ = nullptr;
+}
+
+uint8_t *uvgrtp::reception_flow::alloc_jumbo_buffer(size_t len)
+{
+    uint8_t *mem = new uint8_t[RECV_BUFFER_HEADER_SIZE + len];
+    auto header  = (uvgrtp::recv_buffer_header *)mem;
+
+    new (header) uvgrtp::recv_buffer_header;
+    header->refs  = 0;
+    header->arena = nullptr;
+
+    return mem + RECV_BUFFER_HEADER_SIZE;
+}
+
+bool uvgrtp::reception_flow::release_buffer_if_jumbo(uint8_t *buffer)
+{
+    if (uvgrtp::get_recv_buffer_header(buffer)->arena)
+        return false;
+
+    delete[] (buffer - RECV_BUFFER_HEADER_SIZE);
+    return true;
 }
 
 void uvgrtp::reception_flow::set_buffer_size(const ssize_t& value)
 {
+    // the threads own the ring buffer while they are running so they must be
+    // stopped for the duration of the reallocation. Unprocessed packets are lost
+    bool running = !should_stop_;
+
+    if (running)
+        stop_threads();
+
     buffer_size_kbytes_ = value;
     create_ring_buffer();
+
+    if (running)
+        start_threads();
+}
+
+void uvgrtp::reception_flow::set_recv_batch_size(const ssize_t& value)
+{
+    recv_batch_size_ = value;
+}
+
+void uvgrtp::reception_flow::set_overflow_policy(int policy)
+{
+    overflow_policy_ = policy;
+}
+
+void uvgrtp::reception_flow::set_mtu_size(const ssize_t& value)
+{
+    bool running = !should_stop_;
+
+    if (running)
+        stop_threads();
+
+    mtu_size_ = value;
+    create_ring_buffer();
+
+    if (running)
+        start_threads();
+}
+
+uint64_t uvgrtp::reception_flow::get_dropped_packets() const
+{
+    return dropped_packets_;
 }
 
 rtp_error_t uvgrtp::reception_flow::start(std::shared_ptr<uvgrtp::socket> socket, int flags)
+{
+    socket_ = socket;
+    flags_  = flags;
+
+    start_threads();
+
+    return RTP_ERROR::RTP_OK;
+}
+
+void uvgrtp::reception_flow::set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker)
+{
+    runtime_        = runtime;
+    runtime_worker_ = worker;
+}
+
+std::shared_ptr<uvgrtp::timer_wheel> uvgrtp::reception_flow::get_timer_wheel()
+{
+    return timers_;
+}
+
+void uvgrtp::reception_flow::start_threads()
 {
     should_stop_ = false;
 
+    if (runtime_) {
+        if (flags_ & RCE_UDP_GRO)
+            enable_gro(socket_);
+
+        // buffers left over from the previous run belonged to the old ring
+        runtime_state_ = receive_state();
+        runtime_source_ = runtime_->add_socket(runtime_worker_, socket_->get_raw_socket(),
+            std::bind(&uvgrtp::reception_flow::on_socket_readable, this));
+        runtime_timer_ = runtime_->add_timer(runtime_worker_, TIMER_TICK_MS, TIMER_TICK_MS,
+            std::bind(&uvgrtp::reception_flow::on_timer_tick, this));
+        return;
+    }
+
     LOG_DEBUG("Creating receiving threads and setting priorities");
-    processor_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::process_packet, this, flags));
-    receiver_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::receiver, this, socket, flags));
+    processor_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::process_packet, this, flags_));
+    receiver_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::receiver, this, socket_, flags_));
 
     // set receiver thread priority to maximum
 #ifndef WIN32
@@ -102,14 +296,23 @@ rtp_error_t uvgrtp::reception_flow::start(std::shared_ptr<uvgrtp::socket> socket
     SetThreadPriority(processor_->native_handle(), ABOVE_NORMAL_PRIORITY_CLASS);
 
 #endif
-
-    return RTP_ERROR::RTP_OK;
 }
 
-rtp_error_t uvgrtp::reception_flow::stop()
+void uvgrtp::reception_flow::stop_threads()
 {
     should_stop_ = true;
     process_cond_.notify_all();
+    free_cond_.notify_all();
+
+    if (runtime_source_) {
+        runtime_->remove(runtime_source_);
+        runtime_source_ = nullptr;
+    }
+
+    if (runtime_timer_) {
+        runtime_->remove(runtime_timer_);
+        runtime_timer_ = nullptr;
+    }
 
     if (receiver_ != nullptr && receiver_->joinable())
     {
@@ -121,6 +324,16 @@ rtp_error_t uvgrtp::reception_flow::stop()
         processor_->join();
     }
 
+    if (blocked_count_)
+    {
+        LOG_DEBUG("Receiver was blocked %lu times because the reception ring was full", (uint64_t)blocked_count_);
+    }
+}
+
+rtp_error_t uvgrtp::reception_flow::stop()
+{
+    stop_threads();
+    wake_frame_waiters();
     clear_frames();
 
     return RTP_OK;
@@ -142,44 +355,43 @@ rtp_error_t uvgrtp::reception_flow::install_receive_hook(
 
 uvgrtp::frame::rtp_frame *uvgrtp::reception_flow::pull_frame()
 {
-    while (frames_.empty() && !should_stop_)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
-    }
+    std::unique_lock<std::mutex> lk(frames_mtx_);
 
-    if (should_stop_)
+    frames_cond_.wait(lk, [this] { return !frames_.empty() || should_stop_; });
+
+    if (frames_.empty())
         return nullptr;
 
-    frames_mtx_.lock();
     auto frame = frames_.front();
-    frames_.erase(frames_.begin());
-    frames_mtx_.unlock();
+    frames_.pop_front();
 
     return frame;
 }
 
 uvgrtp::frame::rtp_frame *uvgrtp::reception_flow::pull_frame(size_t timeout_ms)
 {
-    auto start_time = std::chrono::high_resolution_clock::now();
+    std::unique_lock<std::mutex> lk(frames_mtx_);
 
-    while (frames_.empty() && 
-        !should_stop_ &&
-        timeout_ms > std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count())
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    frames_cond_.wait_for(lk, std::chrono::milliseconds(timeout_ms), [this] {
+        return !frames_.empty() || should_stop_;
+    });
 
-    if (should_stop_ || frames_.empty())
+    if (frames_.empty())
         return nullptr;
 
-    frames_mtx_.lock();
     auto frame = frames_.front();
-    frames_.erase(frames_.begin());
-    frames_mtx_.unlock();
+    frames_.pop_front();
 
     return frame;
 }
 
+void uvgrtp::reception_flow::wake_frame_waiters()
+{
+    // take the lock so that a puller cannot miss the wakeup between checking the predicate and going to sleep
+    std::lock_guard<std::mutex> lk(frames_mtx_);
+    frames_cond_.notify_all();
+}
+
 uint32_t uvgrtp::reception_flow::install_handler(uvgrtp::packet_handler handler)
 {
     uint32_t key;
@@ -237,9 +449,12 @@ void uvgrtp::reception_flow::return_frame(uvgrtp::frame::rtp_frame *frame)
     if (recv_hook_) {
         recv_hook_(recv_hook_arg_, frame);
     } else {
-        frames_mtx_.lock();
-        frames_.push_back(frame);
-        frames_mtx_.unlock();
+        {
+            std::lock_guard<std::mutex> lk(frames_mtx_);
+            frames_.push_back(frame);
+        }
+
+        frames_cond_.notify_one();
     }
 }
 
@@ -326,166 +541,773 @@ void uvgrtp::reception_flow::call_aux_handlers(uint32_t key, int flags, uvgrtp::
     }
 }
 
+uint8_t *uvgrtp::reception_flow::pop_free_buffer()
+{
+    uint64_t tail = free_tail_.load(std::memory_order_relaxed);
+
+    if (tail == free_head_.load(std::memory_order_acquire))
+        return nullptr;
+
+    uint8_t *buffer = free_[tail & ring_mask_];
+    free_tail_.store(tail + 1, std::memory_order_release);
+
+    return buffer;
+}
+
+uint8_t *uvgrtp::reception_flow::drop_oldest_packet()
+{
+    uint64_t head = ring_head_.load(std::memory_order_relaxed);
+    uint64_t tail = ring_tail_.load(std::memory_order_acquire);
+
+    // compete with the processor for the oldest packet. If the processor wins,
+    // it has claimed the packet and we try again with the next one
+    while (tail != head) {
+        uint8_t *buffer = ring_[tail & ring_mask_].data.load(std::memory_order_relaxed);
+
+        if (ring_tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            ++dropped_packets_;
+
+            // a jumbo buffer does not give us a slot so keep dropping
+            if (release_buffer_if_jumbo(buffer)) {
+                ++tail;
+                continue;
+            }
+            return buffer;
+        }
+    }
+
+    return nullptr;
+}
+
 void uvgrtp::reception_flow::receiver(std::shared_ptr<uvgrtp::socket> socket, int flags)
 {
-    while (!should_stop_) {
+    receive_state state;
 
-        // First we wait using poll until there is data in the socket
+    if ((flags & RCE_IO_URING) && uring_receiver(socket, flags, state))
+        return;
 
-#ifdef _WIN32
-        LPWSAPOLLFD pfds = new pollfd();
-#else
-        pollfd* pfds = new pollfd();
-#endif
+    if (flags & RCE_UDP_GRO)
+        enable_gro(socket);
+
+    pollfd pfds;
+    pfds.fd     = socket->get_raw_socket();
+    pfds.events = POLLIN;
 
-        int read_fds = socket->get_raw_socket();
-        pfds->fd = read_fds;
-        pfds->events = POLLIN;
+    while (!should_stop_) {
+
+        // First we wait using poll until there is data in the socket
+        pfds.revents = 0;
 
         // exits after this time if no data has been received to check whether we should exit
         int timeout_ms = 100; 
 
 #ifdef _WIN32
-        if (WSAPoll(pfds, 1, timeout_ms) < 0) {
+        if (WSAPoll(&pfds, 1, timeout_ms) < 0) {
 #else
-        if (poll(pfds, 1, timeout_ms) < 0) {
+        if (poll(&pfds, 1, timeout_ms) < 0) {
 #endif
             LOG_ERROR("poll(2) failed");
-            if (pfds)
-            {
-                delete pfds;
-                pfds = nullptr;
-            }
             break;
         }
 
-        if (pfds->revents & POLLIN) {
+        // completions of zero-copy sends are kept in the error queue which keeps the socket polling
+        if (pfds.revents & POLLERR)
+            socket->process_zerocopy();
+
+        if (pfds.revents & POLLIN) {
 
             // we write as many packets as socket has in the buffer
-            while (!should_stop_)
+            while (!should_stop_ && read_packets(socket, flags, state, true))
+                ;
+
+            // start processing the packets by waking the processing thread
             {
-                // get the potential next write. To make sure processing doesn't start reading 
-                // incomplete/old packets, we only update the index after buffer has the data
-                int next_write_index = next_buffer_location(last_ring_write_index_);
-
-                // create new buffer spaces if the process/read hasn't freed any spots on the ring buffer
-                if (next_write_index == ring_read_index_)
-                {
-                    LOG_DEBUG("Reception buffer ran out, increasing the buffer size ...");
-
-                    // increase the buffer size by 25%
-                    int increase = ring_buffer_.size()/4;
-                    if (increase == 0) // just so there is some increase
-                        ++increase;
-
-                    ring_mutex_.lock();
-                    for (unsigned int i = 0; i < increase; ++i)
-                    {
-                        ring_buffer_.insert(ring_buffer_.begin() + next_write_index, { new uint8_t[RECV_BUFFER_SIZE] , 0 });
-                    }
-                    ring_read_index_ += increase; // move read ahead because of the new empty indexes
+                std::lock_guard<std::mutex> lk(wait_mtx_);
+            }
+            process_cond_.notify_one();
+        }
+    }
 
-                    ring_mutex_.unlock();
-                }
+    // NOTE: buffers still in "owned" are not returned to the free list because the processor may
+    // be writing to it. The threads are only restarted after the ring has been recreated
+}
+
+bool uvgrtp::reception_flow::uring_receiver(std::shared_ptr<uvgrtp::socket> socket, int flags,
+    receive_state& state)
+{
+    uvgrtp::uring ring;
+    size_t capacity = ring_mask_ + 1;
 
-                rtp_error_t ret = RTP_OK;
-                // get the potential packet
-                ret = socket->recvfrom(ring_buffer_[next_write_index].data, RECV_BUFFER_SIZE,
-                    MSG_DONTWAIT, &ring_buffer_[next_write_index].read);
+    if (capacity > URING_MAX_BUFFERS ||
+        ring.init(URING_RECV_ENTRIES, (unsigned)capacity * 2) != RTP_OK ||
+        ring.register_buffer_ring(0, (unsigned)capacity) != RTP_OK)
+    {
+        LOG_WARN("io_uring is not available, falling back to recvmmsg(2)");
+        return false;
+    }
 
-                if (ret == RTP_INTERRUPTED)
-                {
-                    break;
+    // which slots the kernel currently owns, indexed by buffer ID
+    std::vector<uint8_t> in_kernel(capacity, 0);
+    size_t nkernel = 0;
+
+    bool armed    = false;
+    bool received = false;
+    bool stalled  = false;
+
+    auto provide = [&](uint8_t *buffer) {
+        size_t bid = arena_->get_index(buffer);
+
+        ring.provide_buffer(buffer, (uint32_t)slot_size_, (uint16_t)bid);
+        in_kernel[bid] = 1;
+        ++nkernel;
+    };
+
+    while (!should_stop_) {
+        int policy = overflow_policy_;
+
+        // give the kernel every buffer the receiver owns
+        for (auto& buffer : state.owned)
+            provide(buffer);
+        state.owned.clear();
+
+        for (uint8_t *buffer = nullptr; (buffer = pop_free_buffer()) != nullptr; )
+            provide(buffer);
+
+        if (arena_->has_returned()) {
+            arena_->take_returned(state.owned, capacity);
+
+            for (auto& buffer : state.owned)
+                provide(buffer);
+            state.owned.clear();
+        }
+
+        // the multishot receive stopped because it ran out of buffers so the socket has packets waiting
+        if (!armed && !nkernel && received) {
+            if (policy == RRO_DROP_OLDEST) {
+                for (size_t i = 0; i < (size_t)recv_batch_size_; ++i) {
+                    uint8_t *buffer = drop_oldest_packet();
+
+                    if (!buffer)
+                        break;
+                    provide(buffer);
                 }
-                else if (ring_buffer_[next_write_index].read == 0)
-                {
-                    LOG_WARN("Failed to read anything from socket");
-                    break;
+            } else if (policy == RRO_DROP_NEWEST) {
+                (void)read_packets(socket, flags, state, false);
+            } else if (!stalled) {
+                ++blocked_count_;
+            }
+        }
+        ring.commit_buffers();
+
+        if (!armed && nkernel) {
+            if (ring.queue_multishot_recv(socket->get_raw_socket(), 0, URING_RECV_TAG) == RTP_OK)
+                armed = true;
+        }
+        stalled = !armed;
+
+        // poll frequently for free buffers while stalled
+        rtp_error_t ret = ring.submit_and_wait(1, stalled ? 1 : 100);
+
+        if (ret == RTP_GENERIC_ERROR) {
+            LOG_ERROR("io_uring failed! Reception flow cannot continue!");
+            should_stop_ = true;
+            wake_frame_waiters();
+            break;
+        }
+
+        uint64_t head = ring_head_.load(std::memory_order_relaxed);
+        uint64_t next = head;
+
+        uint64_t user_data = 0;
+        int res = 0, bid = -1;
+        bool more = false;
+
+        while (ring.next_completion(user_data, res, bid, more)) {
+            if (user_data != URING_RECV_TAG)
+                continue;
+
+            if (!more)
+                armed = false;
+
+            if (bid >= 0) {
+                in_kernel[bid] = 0;
+                --nkernel;
+            }
+
+            if (res < 0) {
+                // the receive is armed again when there are buffers
+                if (res == -ENOBUFS) {
+                    received = true;
+                    continue;
                 }
-                else if (ret != RTP_OK) {
-                    LOG_ERROR("recvfrom(2) failed! Reception flow cannot continue %d!", ret);
-                    should_stop_ = true;
-                    break;
+
+                // multishot receive is not supported (Linux < 6.0), nothing has been received yet
+                if (!received && res == -EINVAL) {
+                    LOG_WARN("io_uring multishot receive is not supported, falling back to recvmmsg(2)");
+
+                    for (size_t i = 0; i < capacity; ++i) {
+                        if (in_kernel[i])
+                            state.owned.push_back(arena_->get_slot(i));
+                    }
+                    return false;
                 }
 
-                // finally we update the ring buffer so processing (reading) knows that there is a new frame
-                last_ring_write_index_ = next_write_index;
+                LOG_ERROR("io_uring receive failed: %s", strerror(-res));
+                should_stop_ = true;
+                wake_frame_waiters();
+                break;
             }
 
-            // start processing the packets by waking the processing thread
+            if (bid < 0)
+                continue;
+
+            uint8_t *data  = arena_->get_slot(bid);
+            bool truncated = false;
+            uint32_t len   = uvgrtp::uring::received_length(data, truncated);
+
+            received = true;
+
+            // datagrams larger than a slot cannot be received with io_uring
+            if (truncated) {
+                LOG_DEBUG("Dropped a datagram larger than the MTU (%u bytes)", len);
+                ++dropped_packets_;
+                state.owned.push_back(data);
+                continue;
+            }
+
+            ring_[next & ring_mask_].data.store(data, std::memory_order_relaxed);
+            ring_[next & ring_mask_].read.store((int)len, std::memory_order_relaxed);
+            ++next;
+        }
+
+        if (next != head) {
+            ring_head_.store(next, std::memory_order_release);
+
+            {
+                std::lock_guard<std::mutex> lk(wait_mtx_);
+            }
             process_cond_.notify_one();
         }
+    }
 
-        if (pfds)
-        {
-            delete pfds;
-            pfds = nullptr;
+    // the kernel must not write to the buffers after the ring has been destroyed
+    // so the receive is cancelled before the io_uring instance is closed
+    if (armed && ring.queue_cancel(URING_RECV_TAG, URING_CANCEL_TAG) == RTP_OK) {
+        for (int i = 0; i < 10 && armed; ++i) {
+            (void)ring.submit_and_wait(1, 10);
+
+            uint64_t user_data = 0;
+            int res = 0, bid = -1;
+            bool more = false;
+
+            while (ring.next_completion(user_data, res, bid, more)) {
+                if (user_data == URING_RECV_TAG && !more)
+                    armed = false;
+            }
         }
     }
+
+    // NOTE: like with recvmmsg(2), the buffers owned by the receiver are not returned to the free list
+    return true;
+}
+
+void uvgrtp::reception_flow::enable_gro(std::shared_ptr<uvgrtp::socket> socket)
+{
+    if (gro_buffers_)
+        return;
+
+    if (socket->enable_gro() != RTP_OK) {
+        LOG_WARN("UDP GRO is not supported, receiving packets one by one");
+        return;
+    }
+
+    gro_buffers_ = new uint8_t[GRO_BATCH_SIZE * RECV_BUFFER_SIZE];
+}
+
+// copy "len" bytes starting from "offset" of a datagram that was received to "slot" and "overflow"
+static void copy_datagram(uint8_t *dst, const uint8_t *slot, const uint8_t *overflow, size_t slot_size,
+    size_t offset, size_t len)
+{
+    if (offset < slot_size) {
+        size_t chunk = std::min(len, slot_size - offset);
+
+        memcpy(dst, slot + offset, chunk);
+        dst    += chunk;
+        offset += chunk;
+        len    -= chunk;
+    }
+
+    if (len)
+        memcpy(dst, overflow + offset - slot_size, len);
+}
+
+uint8_t *uvgrtp::reception_flow::take_spare_buffer(receive_state& state, size_t used, int policy)
+{
+    // buffers collected for the batch but not filled by it
+    if (state.owned.size() <= used && arena_->has_returned())
+        arena_->take_returned(state.owned, 1);
+
+    if (state.owned.size() > used) {
+        uint8_t *buffer = state.owned.back();
+        state.owned.pop_back();
+        return buffer;
+    }
+
+    uint8_t *buffer = pop_free_buffer();
+
+    if (!buffer && policy == RRO_DROP_OLDEST)
+        buffer = drop_oldest_packet();
+
+    return buffer;
+}
+
+uint64_t uvgrtp::reception_flow::split_gro_datagram(receive_state& state, size_t index, size_t used,
+    int segment, uint64_t next, int policy)
+{
+    uint8_t *slot     = state.owned[index];
+    uint8_t *overflow = gro_buffers_ + index * RECV_BUFFER_SIZE;
+    size_t size       = state.sizes[index];
+    size_t seg_size   = segment;
+    size_t segments   = (size + seg_size - 1) / seg_size;
+    bool slot_used    = false;
+
+    for (size_t i = 0; i < segments; ++i) {
+        size_t offset = i * seg_size;
+        size_t len    = std::min(seg_size, size - offset);
+        uint8_t *data = nullptr;
+
+        // jumbo and coalesced datagrams do not take slots so the ring may be full while slots are free
+        if (next - ring_tail_.load(std::memory_order_acquire) > ring_mask_ && policy == RRO_DROP_OLDEST) {
+            if (uint8_t *buffer = drop_oldest_packet())
+                state.unused.push_back(buffer);
+        }
+
+        if (next - ring_tail_.load(std::memory_order_acquire) > ring_mask_) {
+            dropped_packets_ += segments - i;
+            break;
+        }
+
+        if (len > slot_size_) {
+            data = alloc_jumbo_buffer(len);
+            copy_datagram(data, slot, overflow, slot_size_, offset, len);
+        } else if (i == 0) {
+            // the first segment is already in place
+            data      = slot;
+            slot_used = true;
+        } else if ((data = take_spare_buffer(state, used, policy))) {
+            copy_datagram(data, slot, overflow, slot_size_, offset, len);
+        } else {
+            // the rest of the segments are lost like any packet that does not fit into the ring
+            dropped_packets_ += segments - i;
+            break;
+        }
+
+        ring_[next & ring_mask_].data.store(data, std::memory_order_relaxed);
+        ring_[next & ring_mask_].read.store((int)len, std::memory_order_relaxed);
+        ++next;
+    }
+
+    // the slot was not used if the first segment did not fit into it or the ring was full
+    if (!slot_used)
+        state.unused.push_back(slot);
+
+    return next;
+}
+
+bool uvgrtp::reception_flow::read_packets(std::shared_ptr<uvgrtp::socket> socket, int flags,
+    receive_state& state, bool can_block)
+{
+    size_t batch_size = recv_batch_size_;
+    int policy        = overflow_policy_;
+
+    if (flags & RCE_NO_SYSTEM_CALL_CLUSTERING)
+        batch_size = 1;
+
+    if (gro_buffers_ && batch_size > GRO_BATCH_SIZE)
+        batch_size = GRO_BATCH_SIZE;
+
+    if (batch_size > MAX_RECV_BATCH_SIZE)
+        batch_size = MAX_RECV_BATCH_SIZE;
+
+    // collect buffers for the batch. Buffers left over from the previous
+    // batch are still owned by us and are used first
+    while (state.owned.size() < batch_size) {
+        uint8_t *buffer = pop_free_buffer();
+
+        // slots released by the application (see RCE_ZERO_COPY_RECEIVE)
+        if (!buffer && arena_->has_returned()) {
+            arena_->take_returned(state.owned, batch_size - state.owned.size());
+            continue;
+        }
+
+        if (!buffer && policy == RRO_DROP_OLDEST)
+            buffer = drop_oldest_packet();
+
+        if (!buffer)
+            break;
+
+        state.owned.push_back(buffer);
+    }
+
+    // a worker of the I/O runtime cannot block so then the packets are discarded as with RRO_DROP_NEWEST
+    if (state.owned.empty() && policy == RRO_BLOCK && can_block)
+    {
+        ++blocked_count_;
+
+        // wait until the processor has returned buffers to the free list
+        std::unique_lock<std::mutex> lk(free_mtx_);
+        receiver_waiting_ = true;
+        free_cond_.wait_for(lk, std::chrono::milliseconds(10), [this] {
+            return should_stop_ || free_tail_.load() != free_head_.load() || arena_->has_returned();
+        });
+        receiver_waiting_ = false;
+        return true;
+    }
+
+    // there are no free buffers so the incoming packets are read to scratch and discarded
+    bool discard = state.owned.empty();
+    size_t count = discard ? batch_size : state.owned.size();
+
+    state.buffers.resize(count);
+    state.sizes.resize(count);
+    state.segments.resize(count);
+
+    size_t overflow_len = slot_size_ < RECV_BUFFER_SIZE ? RECV_BUFFER_SIZE - slot_size_ : 0;
+
+    if (!gro_buffers_ && !discard && overflow_len &&
+        (state.overflow_count < count || state.overflow_len != overflow_len)) {
+        state.overflow.reset(new uint8_t[count * overflow_len]);
+        state.overflow_count = count;
+        state.overflow_len   = overflow_len;
+    }
+
+    // datagrams larger than a slot overflow to the area of their batch entry. This should be
+    // rare because the slot size follows the MTU, see the jumbo datagram handling below
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t *overflow = gro_buffers_ ? gro_buffers_ + i * RECV_BUFFER_SIZE
+                                         : state.overflow.get() + i * overflow_len;
+
+        if (discard) {
+            state.buffers[i].assign(1, { RECV_BUFFER_SIZE, scratch_ });
+        } else {
+            state.buffers[i].assign(1, { slot_size_, state.owned[i] });
+
+            if (slot_size_ < RECV_BUFFER_SIZE)
+                state.buffers[i].push_back({ RECV_BUFFER_SIZE - slot_size_, overflow });
+        }
+    }
+
+    // get the potential packets
+    int npkts = 0;
+    rtp_error_t ret = socket->recvfrom(state.buffers, MSG_DONTWAIT, state.sizes.data(), &npkts,
+        gro_buffers_ ? state.segments.data() : nullptr);
+
+    if (ret == RTP_INTERRUPTED)
+    {
+        return false;
+    }
+    else if (ret != RTP_OK) {
+        LOG_ERROR("recvfrom(2) failed! Reception flow cannot continue %d!", ret);
+        should_stop_ = true;
+        wake_frame_waiters();
+        return false;
+    }
+    else if (npkts == 0)
+    {
+        LOG_WARN("Failed to read anything from socket");
+        return false;
+    }
+
+    if (discard)
+    {
+        for (int i = 0; i < npkts; ++i) {
+            if (gro_buffers_ && state.segments[i] > 0)
+                dropped_packets_ += (state.sizes[i] + state.segments[i] - 1) / state.segments[i];
+            else
+                ++dropped_packets_;
+        }
+    }
+    else
+    {
+        // write the entries first and only then publish them to the processor
+        uint64_t head = ring_head_.load(std::memory_order_relaxed);
+        uint64_t next = head;
+
+        state.unused.clear();
+
+        for (int i = 0; i < npkts; ++i) {
+            uint8_t *data = state.owned[i];
+            uint8_t *overflow = gro_buffers_ ? gro_buffers_ + i * RECV_BUFFER_SIZE
+                                             : state.overflow.get() + i * overflow_len;
+
+            // the kernel coalesced many packets to this datagram, see RCE_UDP_GRO
+            if (gro_buffers_ && state.segments[i] > 0 && state.sizes[i] > state.segments[i]) {
+                next = split_gro_datagram(state, i, npkts, state.segments[i], next, policy);
+                continue;
+            }
+
+            if ((size_t)state.sizes[i] > slot_size_) {
+                state.unused.push_back(state.owned[i]);
+
+                LOG_DEBUG("Received a datagram larger than the MTU (%d bytes)", state.sizes[i]);
+
+                // the slot is given back so the ring may not have an entry left for the datagram
+                if (next - ring_tail_.load(std::memory_order_acquire) > ring_mask_ && policy == RRO_DROP_OLDEST) {
+                    if (uint8_t *buffer = drop_oldest_packet())
+                        state.unused.push_back(buffer);
+                }
+
+                if (next - ring_tail_.load(std::memory_order_acquire) > ring_mask_) {
+                    ++dropped_packets_;
+                    continue;
+                }
+
+                data = alloc_jumbo_buffer(state.sizes[i]);
+                memcpy(data, state.owned[i], slot_size_);
+                memcpy(data + slot_size_, overflow, state.sizes[i] - slot_size_);
+            }
+
+            ring_[next & ring_mask_].data.store(data, std::memory_order_relaxed);
+            ring_[next & ring_mask_].read.store(state.sizes[i], std::memory_order_relaxed);
+            ++next;
+        }
+        ring_head_.store(next, std::memory_order_release);
+
+        // slots of the jumbo datagrams were not consumed and can be reused
+        state.owned.erase(state.owned.begin(), state.owned.begin() + npkts);
+        state.owned.insert(state.owned.end(), state.unused.begin(), state.unused.end());
+    }
+
+    // if the socket did not have more packets than what was asked, it has been drained
+    return npkts == (int)count;
 }
 
 void uvgrtp::reception_flow::process_packet(int flags)
 {
     std::unique_lock<std::mutex> lk(wait_mtx_);
 
+    uvgrtp::frame_pool::bind(frame_pool_);
+
     while (!should_stop_)
     {
-        // go to sleep waiting for something to process
-        process_cond_.wait(lk); 
+        // go to sleep waiting for something to process, but not past the next timer
+        process_cond_.wait_for(lk, std::chrono::milliseconds(timers_->next_timeout(100)), [this] {
+            return should_stop_ || ring_tail_.load() != ring_head_.load();
+        });
 
         if (should_stop_)
         {
             break;
         }
 
-        ring_mutex_.lock();
+        process_packets(flags);
+        timers_->advance();
+    }
 
-        // process all available reads in one go
-        while (ring_read_index_ != last_ring_write_index_)
-        {
-            // first update the read location
-            ring_read_index_ = next_buffer_location(ring_read_index_);
+    uvgrtp::frame_pool::bind(nullptr);
+}
+
+void uvgrtp::reception_flow::process_packets(int flags)
+{
+    // process all available packets in one go
+    while (!should_stop_)
+    {
+        uint64_t tail = ring_tail_.load(std::memory_order_acquire);
 
-            rtp_error_t ret = RTP_OK;
+        if (tail == ring_head_.load(std::memory_order_acquire))
+            break;
 
-            // process the ring buffer location through all the handlers
-            for (auto& handler : packet_handlers_) {
-                uvgrtp::frame::rtp_frame* frame = nullptr;
+        uint8_t *data = ring_[tail & ring_mask_].data.load(std::memory_order_relaxed);
+        int read      = ring_[tail & ring_mask_].read.load(std::memory_order_relaxed);
 
-                // Here we don't lock ring mutex because the chaging is only done above. 
-                // NOTE: If there is a need for multiple processing threads, the read should be guarded
-                switch ((ret = (*handler.second.primary)(ring_buffer_[ring_read_index_].read,
-                    ring_buffer_[ring_read_index_].data, flags, &frame))) {
-                    /* packet was handled successfully */
-                case RTP_OK:
-                    break;
+        // claim the packet. This fails only if the receiver dropped it in the meantime
+        if (!ring_tail_.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+            continue;
 
-                    /* packet was not handled by this primary handlers, proceed to the next one */
-                case RTP_PKT_NOT_HANDLED:
-                    continue;
+        rtp_error_t ret = RTP_OK;
 
-                    /* packet was handled by the primary handler
-                     * and should be dispatched to the auxiliary handler(s) */
-                case RTP_PKT_MODIFIED:
-                    this->call_aux_handlers(handler.first, flags, &frame);
-                    break;
+        // the reference of the processor, frames may take more of them
+        uvgrtp::recv_buffer_header *header = uvgrtp::get_recv_buffer_header(data);
+        header->refs.store(1, std::memory_order_relaxed);
 
-                case RTP_GENERIC_ERROR:
-                    LOG_DEBUG("Received a corrupted packet!");
-                    break;
+        // process the packet through all the handlers
+        for (auto& handler : packet_handlers_) {
+            uvgrtp::frame::rtp_frame* frame = nullptr;
 
-                default:
-                    LOG_ERROR("Unknown error code from packet handler: %d", ret);
-                    break;
-                }
+            switch ((ret = (*handler.second.primary)(read, data, flags, &frame))) {
+                /* packet was handled successfully */
+            case RTP_OK:
+                break;
+
+                /* packet was not handled by this primary handlers, proceed to the next one */
+            case RTP_PKT_NOT_HANDLED:
+                continue;
+
+                /* packet was handled by the primary handler
+                 * and should be dispatched to the auxiliary handler(s) */
+            case RTP_PKT_MODIFIED:
+                this->call_aux_handlers(handler.first, flags, &frame);
+                break;
+
+            case RTP_GENERIC_ERROR:
+                LOG_DEBUG("Received a corrupted packet!");
+                break;
+
+            default:
+                LOG_ERROR("Unknown error code from packet handler: %d", ret);
+                break;
             }
         }
 
-        ring_mutex_.unlock();
+        // return the buffer to the receiver unless a frame still references it. In that case
+        // the buffer is given back to the arena when the last frame is deallocated
+        if (header->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            continue;
+
+        if (!release_buffer_if_jumbo(data)) {
+            uint64_t head = free_head_.load(std::memory_order_relaxed);
+            free_[head & ring_mask_] = data;
+            free_head_.store(head + 1, std::memory_order_release);
+        }
+
+        if (receiver_waiting_)
+            free_cond_.notify_one();
+    }
+}
+
+void uvgrtp::reception_flow::on_timer_tick()
+{
+    if (should_stop_)
+        return;
+
+    uvgrtp::frame_pool::bind(frame_pool_);
+    timers_->advance();
+    uvgrtp::frame_pool::bind(nullptr);
+}
+
+bool uvgrtp::reception_flow::on_socket_readable()
+{
+    if (should_stop_)
+        return false;
+
+    // the socket is also polled when completions of zero-copy sends are in its error queue
+    socket_->process_zerocopy();
+
+    uvgrtp::frame_pool::bind(frame_pool_);
+
+    // read and process a limited number of batches so that one busy stream cannot starve
+    // the other streams of the worker. The socket is polled again if it still has packets
+    for (int i = 0; i < MAX_BATCHES_PER_WAKEUP && !should_stop_; ++i) {
+        bool more = read_packets(socket_, flags_, runtime_state_, false);
+        process_packets(flags_);
+        timers_->advance();
+
+        if (!more)
+            break;
+    }
+
+    uvgrtp::frame_pool::bind(nullptr);
+
+    // stop polling the socket if reading it failed fatally
+    return !should_stop_;
+}
+
+uvgrtp::reception_arena::reception_arena(size_t capacity, size_t slot_size) :
+    mem_(nullptr),
+    base_(nullptr),
+    capacity_(capacity),
+    pitch_(RECV_BUFFER_HEADER_SIZE + slot_size),
+    refs_(1),
+    returned_(),
+    nreturned_(0)
+{
+    mem_  = new uint8_t[capacity_ * pitch_ + CACHE_LINE_SIZE];
+    base_ = (uint8_t *)(((uintptr_t)mem_ + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+
+    for (size_t i = 0; i < capacity_; ++i) {
+        auto header = new (base_ + i * pitch_) uvgrtp::recv_buffer_header;
+
+        header->refs  = 0;
+        header->arena = this;
+    }
+
+    returned_.reserve(capacity_);
+}
+
+uvgrtp::reception_arena::~reception_arena()
+{
+    delete[] mem_;
+}
+
+uint8_t *uvgrtp::reception_arena::get_slot(size_t index) const
+{
+    return base_ + index * pitch_ + RECV_BUFFER_HEADER_SIZE;
+}
+
+size_t uvgrtp::reception_arena::get_index(const uint8_t *slot) const
+{
+    return (slot - RECV_BUFFER_HEADER_SIZE - base_) / pitch_;
+}
+
+void uvgrtp::reception_arena::ref()
+{
+    refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void uvgrtp::reception_arena::unref()
+{
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+void uvgrtp::reception_arena::give_back(uint8_t *slot)
+{
+    std::lock_guard<std::mutex> lock(returned_mtx_);
+
+    returned_.push_back(slot);
+    nreturned_.store(returned_.size(), std::memory_order_release);
+}
+
+void uvgrtp::reception_arena::take_returned(std::vector<uint8_t *>& out, size_t max)
+{
+    std::lock_guard<std::mutex> lock(returned_mtx_);
+
+    while (!returned_.empty() && max--) {
+        out.push_back(returned_.back());
+        returned_.pop_back();
     }
+    nreturned_.store(returned_.size(), std::memory_order_release);
 }
 
-int uvgrtp::reception_flow::next_buffer_location(int current_location)
+bool uvgrtp::reception_arena::has_returned() const
 {
-    return (current_location + 1) % ring_buffer_.size();
-}
\ No newline at end of file
+    return nreturned_.load(std::memory_order_acquire) != 0;
+}
+
+void *uvgrtp::ref_recv_buffer(uint8_t *dgram)
+{
+    uvgrtp::recv_buffer_header *header = uvgrtp::get_recv_buffer_header(dgram);
+
+    header->refs.fetch_add(1, std::memory_order_relaxed);
+
+    if (header->arena)
+        header->arena->ref();
+
+    return header;
+}
+
+void uvgrtp::release_recv_buffer(void *ref)
+{
+    auto header  = (uvgrtp::recv_buffer_header *)ref;
+    auto arena   = header->arena;
+
+    if (header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (arena)
+            arena->give_back((uint8_t *)header + RECV_BUFFER_HEADER_SIZE);
+        else
+            delete[] (uint8_t *)header;
+    }
+
+    if (arena)
+        arena->unref();
+}
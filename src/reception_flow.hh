@@ -1,7 +1,9 @@
 #pragma once
 
 #include "uvgrtp/util.hh"
+#include "uvgrtp/socket.hh"
 
+#include <deque>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -18,6 +20,8 @@ namespace uvgrtp {
     }
 
     class socket;
+    class io_runtime;
+    struct io_source;
 
     typedef rtp_error_t (*packet_handler)(ssize_t, void *, int, uvgrtp::frame::rtp_frame **);
     typedef rtp_error_t (*packet_handler_aux)(void *, int, uvgrtp::frame::rtp_frame **);
@@ -40,6 +44,75 @@ namespace uvgrtp {
         std::vector<auxiliary_handler_cpp> auxiliary_cpp;
     };
 
+    class reception_arena;
+    class frame_pool;
+    class timer_wheel;
+
+    /* Every reception buffer is preceded by this header. The processor holds one reference
+     * while the packet goes through the handlers and with RCE_ZERO_COPY_RECEIVE each frame
+     * pointing to the buffer holds another. When the last reference is released,
+     * the buffer is returned to the reception ring */
+    struct recv_buffer_header {
+        std::atomic<uint32_t> refs;
+        reception_arena *arena; /* nullptr if the buffer was allocated for a jumbo datagram */
+    };
+
+    constexpr size_t RECV_BUFFER_HEADER_SIZE = 64;
+
+    static inline recv_buffer_header *get_recv_buffer_header(uint8_t *data)
+    {
+        return (recv_buffer_header *)(data - RECV_BUFFER_HEADER_SIZE);
+    }
+
+    /* Take a reference to the reception buffer holding "dgram"
+     *
+     * Return the reference that must later be given to release_recv_buffer() */
+    void *ref_recv_buffer(uint8_t *dgram);
+
+    /* Release a reference taken with ref_recv_buffer(). This can be called from any thread */
+    void release_recv_buffer(void *ref);
+
+    /* The reception arena is one contiguous allocation that is split into MTU-sized slots.
+     *
+     * Frames returned to the user may outlive the reception flow (or the ring may be
+     * recreated with a different size) so the arena is reference counted: the reception
+     * flow holds one reference and every frame referencing a slot holds another */
+    class reception_arena {
+        public:
+            reception_arena(size_t capacity, size_t slot_size);
+
+            uint8_t *get_slot(size_t index) const;
+
+            /* Return the index of "slot" */
+            size_t get_index(const uint8_t *slot) const;
+
+            void ref();
+            void unref();
+
+            /* Give a slot back after the last frame referencing it was deallocated.
+             * This can be called from any thread */
+            void give_back(uint8_t *slot);
+
+            /* Move slots given back by the application to "out", at most "max" slots */
+            void take_returned(std::vector<uint8_t *>& out, size_t max);
+
+            bool has_returned() const;
+
+        private:
+            ~reception_arena();
+
+            uint8_t *mem_;
+            uint8_t *base_;
+            size_t capacity_;
+            size_t pitch_;
+
+            std::atomic<size_t> refs_;
+
+            std::mutex returned_mtx_;
+            std::vector<uint8_t *> returned_;
+            std::atomic<size_t> nreturned_;
+    };
+
     /* This class handles the reception processing of received RTP packets. It 
      * utilizes function dispatching to other classes to achieve this.
 
@@ -145,15 +218,92 @@ namespace uvgrtp {
             uvgrtp::frame::rtp_frame *pull_frame();
             uvgrtp::frame::rtp_frame *pull_frame(size_t timeout_ms);
 
+            /* Set the memory budget of the reception ring. If the reception flow is
+             * running, it is stopped for the duration of the reallocation and restarted */
             void set_buffer_size(const ssize_t& value);
 
+            /* Set the MTU size which determines the size of the reception ring slots.
+             * The reception flow is restarted if it is running */
+            void set_mtu_size(const ssize_t& value);
+
+            /* Set what the receiver does when the reception ring is full, see RTP_RING_OVERFLOW_POLICY */
+            void set_overflow_policy(int policy);
+
+            /* Return the number of packets dropped because the reception ring was full */
+            uint64_t get_dropped_packets() const;
+
+            /* Set how many datagrams the receiver tries to read with one system call */
+            void set_recv_batch_size(const ssize_t& value);
+
+            /* Receive and process the packets on worker "worker" of "runtime" instead of
+             * own receiver and processor threads. Must be called before start() */
+            void set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker);
+
+            /* Return the timer wheel advanced on the thread that runs the packet handlers.
+             * The handlers use it for the deadlines of the frames they are reassembling */
+            std::shared_ptr<uvgrtp::timer_wheel> get_timer_wheel();
+
         private:
+            /* Scatter lists, sizes and buffers of one recvmmsg(2) call. Buffers in "owned"
+             * have been taken from the free list but not yet filled */
+            struct receive_state {
+                uvgrtp::pkt_vec buffers;
+                std::vector<int> sizes;
+                std::vector<int> segments; /* UDP GRO segment sizes, see RCE_UDP_GRO */
+                std::vector<uint8_t *> owned;
+                std::vector<uint8_t *> unused;
+
+                /* without GRO each datagram of the batch overflows to its own area of "overflow_len"
+                 * bytes, allocated for "overflow_count" datagrams. The areas are touched only by
+                 * datagrams larger than a slot so the memory of unused areas is never committed */
+                std::unique_ptr<uint8_t[]> overflow;
+                size_t overflow_count = 0;
+                size_t overflow_len   = 0;
+            };
+
             /* RTP packet receiver thread */
             void receiver(std::shared_ptr<uvgrtp::socket> socket, int flags);
 
+            /* Receive packets with io_uring until the reception flow is stopped
+             *
+             * Return true when the reception flow has stopped
+             * Return false if io_uring is not available and the packets must be received otherwise */
+            bool uring_receiver(std::shared_ptr<uvgrtp::socket> socket, int flags, receive_state& state);
+
+            /* Read one batch of packets from "socket" to the reception ring.
+             * If "can_block" is false, the receiver does not wait for free buffers with RRO_BLOCK
+             *
+             * Return true if the socket may have more packets to read */
+            bool read_packets(std::shared_ptr<uvgrtp::socket> socket, int flags, receive_state& state, bool can_block);
+
+            /* Enable UDP GRO for "socket" and allocate the overflow areas of the coalesced datagrams */
+            void enable_gro(std::shared_ptr<uvgrtp::socket> socket);
+
+            /* Split datagram "index" of the batch, coalesced by the kernel from segments of "segment"
+             * bytes, to individual packets that are written to the reception ring starting from "next".
+             * "used" is the number of owned buffers consumed by the batch
+             *
+             * Return the ring position following the last written packet */
+            uint64_t split_gro_datagram(receive_state& state, size_t index, size_t used, int segment,
+                uint64_t next, int policy);
+
+            /* Take a buffer for a packet split from a coalesced datagram, return nullptr if there are none */
+            uint8_t *take_spare_buffer(receive_state& state, size_t used, int policy);
+
             /* RTP packet dispatcher thread */
             void process_packet(int flags);
 
+            /* Run the packets of the reception ring through the packet handlers */
+            void process_packets(int flags);
+
+            /* Called periodically by the I/O runtime to expire the timers of the timer wheel */
+            void on_timer_tick();
+
+            /* Called by the I/O runtime when the socket is readable
+             *
+             * Return false if the socket should no longer be polled */
+            bool on_socket_readable();
+
             /* Return a processed RTP frame to user either through frame queue or receive hook */
             void return_frame(uvgrtp::frame::rtp_frame *frame);
 
@@ -163,44 +313,113 @@ namespace uvgrtp {
             /* Primary handlers for the socket */
             std::unordered_map<uint32_t, packet_handlers> packet_handlers_;
 
-            inline int next_buffer_location(int current_location);
-
             void create_ring_buffer();
             void destroy_ring_buffer();
 
+            /* Start and stop the receiver and processor threads without touching the frame queue */
+            void start_threads();
+            void stop_threads();
+
+            /* Take a buffer the receiver can write to from the free list, return nullptr if there are none */
+            uint8_t *pop_free_buffer();
+
+            /* Allocate a buffer for a datagram that does not fit into an arena slot */
+            uint8_t *alloc_jumbo_buffer(size_t len);
+
+            /* Free "buffer" if it was allocated for a jumbo datagram and return true.
+             * Return false if "buffer" is a slot of the reception arena */
+            bool release_buffer_if_jumbo(uint8_t *buffer);
+
+            /* Drop the oldest packet that the processor has not yet claimed and return its buffer
+             * to the receiver. Return nullptr if there are no unclaimed packets in the ring */
+            uint8_t *drop_oldest_packet();
+
             void clear_frames();
 
+            /* Wake up threads blocked in pull_frame() so they notice that the reception flow has stopped */
+            void wake_frame_waiters();
+
             /* If receive hook has not been installed, frames are pushed to "frames_"
-             * and they can be retrieved using pull_frame() */
-            std::vector<uvgrtp::frame::rtp_frame *> frames_;
+             * and they can be retrieved using pull_frame() which sleeps on "frames_cond_"
+             * until a frame is pushed, the timeout expires or the reception flow is stopped */
+            std::deque<uvgrtp::frame::rtp_frame *> frames_;
             std::mutex frames_mtx_;
+            std::condition_variable frames_cond_;
+
+            /* Frames and payload buffers allocated by the handlers on the processor thread
+             * are recycled through this pool */
+            frame_pool *frame_pool_;
+
+            std::shared_ptr<uvgrtp::timer_wheel> timers_;
 
             void *recv_hook_arg_;
             void (*recv_hook_)(void *arg, uvgrtp::frame::rtp_frame *frame);
 
-            bool should_stop_;
+            std::atomic<bool> should_stop_;
 
             std::unique_ptr<std::thread> receiver_;
             std::unique_ptr<std::thread> processor_;
 
-            struct Buffer
-            {
-                uint8_t* data;
-                int read;
+            std::shared_ptr<uvgrtp::socket> socket_;
+            int flags_;
+
+            /* The reception ring is a fixed-capacity single-producer/single-consumer queue
+             * between the receiver and the processor. Buffers circulate from the free list to the
+             * receiver, through the ring to the processor and back to the free list. There are as
+             * many buffers as there are ring entries so neither queue can ever overflow.
+             *
+             * The processor claims a packet by advancing the tail with compare-and-swap so that
+             * the receiver can drop the oldest unclaimed packet when the overflow policy says so */
+            struct ring_entry {
+                std::atomic<uint8_t *> data;
+                std::atomic<int> read;
             };
 
-            std::vector<Buffer> ring_buffer_;
+            std::unique_ptr<ring_entry[]> ring_;
+            std::unique_ptr<uint8_t *[]>  free_;
+            size_t ring_mask_;
 
-            // these uphold the ring buffer details in a thread safe manner
-            std::atomic<int> ring_read_index_;
-            std::atomic<int> last_ring_write_index_;
+            /* The buffers are MTU-sized slots of one contiguous arena. A datagram larger
+             * than a slot is copied to a separately allocated buffer that the processor frees */
+            reception_arena *arena_;
+            size_t slot_size_;
 
-            std::mutex wait_mtx_;
-            std::mutex ring_mutex_;
+            /* Used by the receiver to discard packets when there are no free buffers */
+            uint8_t *scratch_;
 
+            /* With RCE_UDP_GRO each datagram of the batch overflows to its own area
+             * because coalesced datagrams are almost always larger than a slot */
+            uint8_t *gro_buffers_;
+
+            /* Indices are free-running counters, each on its own cache line to avoid false sharing */
+            alignas(64) std::atomic<uint64_t> ring_head_; // written by the receiver
+            alignas(64) std::atomic<uint64_t> ring_tail_; // claimed by the processor (or the receiver when dropping)
+            alignas(64) std::atomic<uint64_t> free_head_; // written by the processor
+            alignas(64) std::atomic<uint64_t> free_tail_; // written by the receiver
+
+            alignas(64) std::atomic<uint64_t> dropped_packets_;
+            std::atomic<uint64_t> blocked_count_;
+            std::atomic<int> overflow_policy_;
+
+            std::mutex wait_mtx_;
             std::condition_variable process_cond_;
 
+            /* Used by the receiver to wait for free buffers with RRO_BLOCK */
+            std::mutex free_mtx_;
+            std::condition_variable free_cond_;
+            std::atomic<bool> receiver_waiting_;
+
             ssize_t buffer_size_kbytes_;
+            ssize_t mtu_size_;
+
+            std::atomic<ssize_t> recv_batch_size_;
+
+            /* Set if the reception is done by the I/O runtime of the context */
+            std::shared_ptr<uvgrtp::io_runtime> runtime_;
+            size_t runtime_worker_;
+            io_source *runtime_source_;
+            io_source *runtime_timer_;
+            receive_state runtime_state_;
     };
 }
 
@@ -1,6 +1,7 @@
 #include "uvgrtp/rtcp.hh"
 
 #include "hostname.hh"
+#include "io_runtime.hh"
 #include "poll.hh"
 #include "rtp.hh"
 #include "srtp/srtcp.hh"
@@ -54,6 +55,9 @@ uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, int flags):
     sdes_hook_u_(nullptr),
     app_hook_f_(nullptr),
     app_hook_u_(nullptr),
+    runtime_(nullptr),
+    runtime_worker_(0),
+    runtime_sources_(),
     active_(false)
 {
     clock_rate_   = rtp->get_clock_rate();
@@ -115,11 +119,57 @@ rtp_error_t uvgrtp::rtcp::start()
     }
     active_ = true;
 
+    if (runtime_) {
+        // RFC 3550 says to wait half interval before sending first report
+        runtime_sources_.push_back(runtime_->add_timer(runtime_worker_, MIN_TIMEOUT_MS / 2, MIN_TIMEOUT_MS,
+            std::bind(&uvgrtp::rtcp::on_report_timer, this)));
+
+        for (size_t i = 0; i < sockets_.size(); ++i) {
+            runtime_sources_.push_back(runtime_->add_socket(runtime_worker_, sockets_[i].get_raw_socket(),
+                std::bind(&uvgrtp::rtcp::on_socket_readable, this, i)));
+        }
+
+        return RTP_OK;
+    }
+
     report_generator_.reset(new std::thread(rtcp_runner, this));
 
     return RTP_OK;
 }
 
+void uvgrtp::rtcp::set_io_runtime(std::shared_ptr<uvgrtp::io_runtime> runtime, size_t worker)
+{
+    runtime_        = runtime;
+    runtime_worker_ = worker;
+}
+
+void uvgrtp::rtcp::on_report_timer()
+{
+    rtp_error_t ret = RTP_OK;
+
+    if ((ret = generate_report()) != RTP_OK && ret != RTP_NOT_READY)
+    {
+        LOG_ERROR("Failed to send RTCP status report!");
+    }
+}
+
+bool uvgrtp::rtcp::on_socket_readable(size_t index)
+{
+    uint8_t buffer[MAX_PACKET];
+    int nread = 0;
+
+    rtp_error_t ret = sockets_[index].recvfrom(buffer, MAX_PACKET, MSG_DONTWAIT, &nread);
+
+    if (ret == RTP_OK && nread > 0)
+    {
+        (void)handle_incoming_packet(buffer, (size_t)nread);
+    } else if (ret != RTP_INTERRUPTED) {
+        LOG_ERROR("recvfrom failed, %d", ret);
+    }
+
+    return true;
+}
+
 rtp_error_t uvgrtp::rtcp::stop()
 {
     // TODO: Make thread safe. I think this kind of works, but not in a flexible way
@@ -143,6 +193,12 @@ rtp_error_t uvgrtp::rtcp::stop()
 
     active_ = false;
 
+    for (auto& source : runtime_sources_)
+    {
+        runtime_->remove(source);
+    }
+    runtime_sources_.clear();
+
     if (report_generator_ && report_generator_->joinable())
     {
         report_generator_->join();
@@ -913,13 +969,13 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     return RTP_PKT_NOT_HANDLED;
 }
 
-rtp_error_t uvgrtp::rtcp::send_packet_handler_vec(void *arg, uvgrtp::buf_vec& buffers)
+rtp_error_t uvgrtp::rtcp::send_packet_handler_vec(void *arg, struct iovec *buffers, size_t count)
 {
     ssize_t pkt_size = -uvgrtp::frame::HEADER_SIZE_RTP;
 
-    for (auto& buffer : buffers)
+    for (size_t i = 0; i < count; ++i)
     {
-        pkt_size += buffer.first;
+        pkt_size += buffers[i].iov_len;
     }
 
     if (pkt_size < 0)
@@ -1,6 +1,8 @@
 #include "rtp.hh"
 
+#include "frame_pool.hh"
 #include "random.hh"
+#include "reception_flow.hh"
 
 #include "uvgrtp/frame.hh"
 #include "uvgrtp/debug.hh"
@@ -11,6 +13,7 @@
 #endif
 
 #include <chrono>
+#include <cstring>
 
 
 
@@ -159,8 +162,6 @@ size_t uvgrtp::rtp::get_pkt_max_delay() const
 
 rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, uvgrtp::frame::rtp_frame **out)
 {
-    (void)flags;
-
     /* not an RTP frame */
     if (size < 12)
     {
@@ -177,7 +178,7 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
         return RTP_PKT_NOT_HANDLED;
     }
 
-    if (!(*out = uvgrtp::frame::alloc_rtp_frame()))
+    if (!(*out = uvgrtp::frame_pool::alloc_frame()))
         return RTP_GENERIC_ERROR;
 
     (*out)->header.version   = (ptr[0] >> 6) & 0x03;
@@ -215,13 +216,43 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
         }
     }
 
+    /* With RCE_ZERO_COPY_RECEIVE the frame points to the reception buffer
+     * and holds a reference to it until the frame is deallocated */
+    bool zero_copy = (flags & RCE_ZERO_COPY_RECEIVE);
+
+    /* The reference is taken before the extension is made to point to the reception buffer
+     * so that dealloc_frame() knows not to free the extension if the packet is rejected */
+    (*out)->dgram      = (uint8_t *)packet;
+    (*out)->dgram_size = size;
+
+    if (zero_copy)
+        (*out)->dgram_ref = uvgrtp::ref_recv_buffer((*out)->dgram);
+
     if ((*out)->header.ext) {
         LOG_DEBUG("Frame contains extension information");
+
+        if ((*out)->payload_len < 2 * sizeof(uint16_t)) {
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
         (*out)->ext = new uvgrtp::frame::ext_header;
 
         (*out)->ext->type    = ntohs(*(uint16_t *)&ptr[0]);
         (*out)->ext->len     = ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t);
-        (*out)->ext->data    = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), (*out)->ext->len);
+
+        if ((*out)->payload_len < 2 * sizeof(uint16_t) + (*out)->ext->len) {
+            LOG_DEBUG("Invalid extension length %u, total length %zu", (*out)->ext->len, (*out)->payload_len);
+            (*out)->ext->data = nullptr;
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        if (zero_copy)
+            (*out)->ext->data = ptr + 2 * sizeof(uint16_t);
+        else
+            (*out)->ext->data = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), (*out)->ext->len);
+
         (*out)->payload_len -= 2 * sizeof(uint16_t) + (*out)->ext->len;
         ptr                 += 2 * sizeof(uint16_t) + (*out)->ext->len;
     }
@@ -231,7 +262,13 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
      * valid and subtract the amount of padding bytes from payload length */
     if ((*out)->header.padding) {
         LOG_DEBUG("Frame contains padding");
-        uint8_t padding_len = (*out)->payload[(*out)->payload_len - 1];
+
+        if (!(*out)->payload_len) {
+            uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        uint8_t padding_len = ptr[(*out)->payload_len - 1];
 
         if (!padding_len || (*out)->payload_len <= padding_len) {
             uvgrtp::frame::dealloc_frame(*out);
@@ -242,9 +279,12 @@ rtp_error_t uvgrtp::rtp::packet_handler(ssize_t size, void *packet, int flags, u
         (*out)->padding_len  = padding_len;
     }
 
-    (*out)->payload    = (uint8_t *)memdup(ptr, (*out)->payload_len);
-    (*out)->dgram      = (uint8_t *)packet;
-    (*out)->dgram_size = size;
+    if (zero_copy) {
+        (*out)->payload = ptr;
+    } else {
+        size_t payload_len = (*out)->payload_len;
+        std::memcpy(uvgrtp::frame_pool::alloc_payload(*out, payload_len), ptr, payload_len);
+    }
 
     return RTP_PKT_MODIFIED;
 }
@@ -1,22 +1,24 @@
 #include "uvgrtp/session.hh"
 
 #include "uvgrtp/media_stream.hh"
+#include "pacer.hh"
 #include "zrtp.hh"
 #include "uvgrtp/crypto.hh"
 #include "uvgrtp/debug.hh"
 
 
-uvgrtp::session::session(std::string addr):
+uvgrtp::session::session(std::string addr, std::shared_ptr<uvgrtp::io_runtime> runtime):
 #ifdef __RTP_CRYPTO__
     zrtp_(new uvgrtp::zrtp()),
 #endif
     addr_(addr),
-    laddr_("")
+    laddr_(""),
+    runtime_(runtime)
 {
 }
 
-uvgrtp::session::session(std::string remote_addr, std::string local_addr):
-    session(remote_addr)
+uvgrtp::session::session(std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::io_runtime> runtime):
+    session(remote_addr, runtime)
 {
     laddr_ = local_addr;
 }
@@ -35,16 +37,13 @@ uvgrtp::media_stream *uvgrtp::session::create_stream(int r_port, int s_port, rtp
 
     uvgrtp::media_stream *stream = nullptr;
 
-    if (flags & RCE_SYSTEM_CALL_DISPATCHER) {
-        LOG_ERROR("SCD is no longer supported!");
-        rtp_errno = RTP_NOT_SUPPORTED;
-        return nullptr;
-    }
-
     if (laddr_ == "")
-        stream = new uvgrtp::media_stream(addr_, r_port, s_port, fmt, flags);
+        stream = new uvgrtp::media_stream(addr_, r_port, s_port, fmt, flags, runtime_);
     else
-        stream = new uvgrtp::media_stream(addr_, laddr_, r_port, s_port, fmt, flags);
+        stream = new uvgrtp::media_stream(addr_, laddr_, r_port, s_port, fmt, flags, runtime_);
+
+    if (pacer_)
+        stream->set_session_pacer(pacer_);
 
     if (flags & RCE_SRTP) {
         if (!uvgrtp::crypto::enabled()) {
@@ -106,6 +105,23 @@ rtp_error_t uvgrtp::session::destroy_stream(uvgrtp::media_stream *stream)
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::session::enable_pacing(size_t rate, size_t burst)
+{
+    std::lock_guard<std::mutex> m(session_mtx_);
+
+    if (rate == 0)
+        pacer_ = nullptr;
+    else
+        pacer_ = std::make_shared<uvgrtp::pacer>((uint64_t)rate * 1000, burst);
+
+    for (auto& stream : streams_) {
+        if (stream.second)
+            stream.second->set_session_pacer(pacer_);
+    }
+
+    return RTP_OK;
+}
+
 std::string& uvgrtp::session::get_key()
 {
     return addr_;
@@ -3,6 +3,9 @@
 #include "uvgrtp/debug.hh"
 #include "uvgrtp/util.hh"
 
+#include "pacer.hh"
+#include "uring.hh"
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <Ws2tcpip.h>
@@ -11,6 +14,13 @@
 #include <unistd.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <netinet/udp.h>
+#endif
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <time.h>
 #endif
 
 #if defined(__MINGW32__) || defined(__MINGW64__)
@@ -19,20 +29,61 @@ using namespace uvgrtp;
 using namespace mingw;
 #endif
 
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <map>
+#include <mutex>
 
 
 #define WSABUF_SIZE 256
 
+/* How many messages are submitted with one io_uring_enter(2) */
+constexpr unsigned URING_SEND_ENTRIES = 256;
+
+/* UDP_MAX_SEGMENTS of the oldest kernels with UDP GSO */
+constexpr size_t GSO_MAX_SEGMENTS = 64;
+constexpr size_t GSO_MAX_SIZE     = 0xffff - IPV4_HDR_SIZE - UDP_HDR_SIZE;
+
+namespace uvgrtp {
+    /* Bookkeeping of the messages sent with MSG_ZEROCOPY. Shared by the copies of the socket */
+    struct zerocopy_state {
+        std::mutex mtx;
+
+        /* ID of the next message sent with MSG_ZEROCOPY */
+        uint32_t next = 0;
+
+        /* All messages with a smaller ID have been completed */
+        uint32_t completed = 0;
+
+        /* Completed ranges [first, last] that are not yet contiguous with "completed" */
+        std::map<uint32_t, uint32_t> ranges;
+
+        bool copied = false;
+
+        /* The handler is called without "mtx" so that it can send. Recursive because
+         * the handler may return a frame whose deallocation hook pushes the next one */
+        std::recursive_mutex handler_mtx;
+        std::function<void(uint32_t)> handler;
+    };
+}
+
 uvgrtp::socket::socket(int flags):
     socket_(-1),
-    flags_(flags)
+    flags_(flags),
+    send_ring_(nullptr),
+    send_ring_failed_(false),
+    pacer_(nullptr),
+    pacer_priority_(false),
+    txtime_(false),
+    zerocopy_(nullptr),
+    send_mtx_(std::make_shared<std::mutex>())
 {}
 
 uvgrtp::socket::~socket()
 {
-    LOG_DEBUG("Socket total sent packets is %lu and received packets is %lu", sent_packets_, received_packets_);
+    LOG_DEBUG("Socket total sent packets is %lu and received packets is %lu (%lu receive system calls)",
+              sent_packets_, received_packets_, recv_syscalls_);
 
 #ifndef _WIN32
     close(socket_);
@@ -215,14 +266,17 @@ rtp_error_t uvgrtp::socket::__sendtov(
     int flags, int *bytes_sent
 )
 {
-#ifndef _WIN32
-    int sent_bytes = 0;
+    if (buffers.size() > MAX_BUFFER_COUNT) {
+        LOG_ERROR("Input vector to __sendtov() has more than %d elements!", MAX_BUFFER_COUNT);
+        set_bytes(bytes_sent, -1);
+        return RTP_INVALID_VALUE;
+    }
 
-    for (size_t i = 0; i < buffers.size(); ++i) {
-        chunks_[i].iov_len  = buffers.at(i).first;
-        chunks_[i].iov_base = buffers.at(i).second;
+    std::lock_guard<std::mutex> lock(*send_mtx_);
 
-        sent_bytes += buffers.at(i).first;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        chunks_[i].iov_len  = buffers[i].first;
+        chunks_[i].iov_base = buffers[i].second;
     }
 
     header_.msg_hdr.msg_name       = (void *)&addr;
@@ -231,267 +285,667 @@ rtp_error_t uvgrtp::socket::__sendtov(
     header_.msg_hdr.msg_iovlen     = buffers.size();
     header_.msg_hdr.msg_control    = 0;
     header_.msg_hdr.msg_controllen = 0;
+    header_.msg_hdr.msg_flags      = 0;
 
-    if (sendmmsg(socket_, &header_, 1, flags) < 0) {
-        LOG_ERROR("Failed to send RTP frame: %s!", strerror(errno));
-        set_bytes(bytes_sent, -1);
-        return RTP_SEND_ERROR;
-    }
-#else
-    DWORD sent_bytes = 0;
-
-    // DWORD corresponds to uint16 on most platforms
-    if (buffers.size() > UINT16_MAX)
-    {
-        LOG_ERROR("Trying to send too large buffer");
-        return RTP_INVALID_VALUE;
-    }
+    return __sendmsgs_locked(&header_, 1, flags, bytes_sent, false);
+}
 
-    /* create WSABUFs from input buffers and send them at once */
-    for (size_t i = 0; i < buffers.size(); ++i) {
-        buffers_[i].len = (ULONG)buffers.at(i).first;
-        buffers_[i].buf = (char *)buffers.at(i).second;
-    }
+rtp_error_t uvgrtp::socket::sendto(buf_vec& buffers, int flags)
+{
+    return __sendtov(addr_, buffers, flags, nullptr);
+}
 
-    if (WSASendTo(socket_, buffers_, (DWORD)buffers.size(), &sent_bytes, flags, 
-                  (SOCKADDR *)&addr, sizeof(addr_), nullptr, nullptr) == -1) {
-        win_get_last_error();
+rtp_error_t uvgrtp::socket::sendto(buf_vec& buffers, int flags, int *bytes_sent)
+{
+    return __sendtov(addr_, buffers, flags, bytes_sent);
+}
 
-        set_bytes(bytes_sent, -1);
-        return RTP_SEND_ERROR;
-    }
+rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, buf_vec& buffers, int flags)
+{
+    return __sendtov(addr, buffers, flags, nullptr);
+}
 
+rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, buf_vec& buffers, int flags, int *bytes_sent)
+{
+    return __sendtov(addr, buffers, flags, bytes_sent);
+}
 
-#endif
+rtp_error_t uvgrtp::socket::sendto(struct mmsghdr *headers, size_t count, int flags)
+{
+    return __sendtov(headers, count, flags, nullptr, true);
+}
 
-#ifndef NDEBUG
-    sent_packets_ += buffers.size();
-#endif // !NDEBUG
+rtp_error_t uvgrtp::socket::sendto(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent)
+{
+    return __sendtov(headers, count, flags, bytes_sent, true);
+}
 
-    set_bytes(bytes_sent, sent_bytes);
-    return RTP_OK;
+static bool same_address(const sockaddr_in& a, const sockaddr_in& b)
+{
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
 }
 
-rtp_error_t uvgrtp::socket::sendto(buf_vec& buffers, int flags)
+rtp_error_t uvgrtp::socket::add_destination(const sockaddr_in& addr)
 {
-    rtp_error_t ret = RTP_OK;
+    auto current = std::atomic_load(&destinations_);
+    std::shared_ptr<const std::vector<sockaddr_in>> updated;
 
-    for (auto& handler : vec_handlers_) {
-        if ((ret = (*handler.handler)(handler.arg, buffers)) != RTP_OK) {
-            LOG_ERROR("Malformed packet");
-            return ret;
+    do {
+        auto destinations = current ? std::vector<sockaddr_in>(*current) : std::vector<sockaddr_in>();
+
+        for (auto& destination : destinations) {
+            if (same_address(destination, addr))
+                return RTP_INVALID_VALUE;
         }
-    }
 
-    return __sendtov(addr_, buffers, flags, nullptr);
+        destinations.push_back(addr);
+        updated = std::make_shared<const std::vector<sockaddr_in>>(std::move(destinations));
+    } while (!std::atomic_compare_exchange_strong(&destinations_, &current, updated));
+
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(buf_vec& buffers, int flags, int *bytes_sent)
+rtp_error_t uvgrtp::socket::remove_destination(const sockaddr_in& addr)
 {
-    rtp_error_t ret = RTP_OK;
+    auto current = std::atomic_load(&destinations_);
+    std::shared_ptr<const std::vector<sockaddr_in>> updated;
 
-    for (auto& handler : vec_handlers_) {
-        if ((ret = (*handler.handler)(handler.arg, buffers)) != RTP_OK) {
-            LOG_ERROR("Malformed packet");
-            return ret;
-        }
-    }
+    do {
+        if (!current)
+            return RTP_INVALID_VALUE;
 
-    return __sendtov(addr_, buffers, flags, bytes_sent);
-}
+        std::vector<sockaddr_in> destinations(*current);
+        auto it = std::find_if(destinations.begin(), destinations.end(),
+            [&addr](const sockaddr_in& destination) { return same_address(destination, addr); });
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, buf_vec& buffers, int flags)
-{
-    rtp_error_t ret = RTP_OK;
+        if (it == destinations.end())
+            return RTP_INVALID_VALUE;
 
-    for (auto& handler : vec_handlers_) {
-        if ((ret = (*handler.handler)(handler.arg, buffers)) != RTP_OK) {
-            LOG_ERROR("Malformed packet");
-            return ret;
-        }
-    }
+        destinations.erase(it);
 
-    return __sendtov(addr, buffers, flags, nullptr);
+        if (!destinations.empty())
+            updated = std::make_shared<const std::vector<sockaddr_in>>(std::move(destinations));
+        else
+            updated = nullptr;
+    } while (!std::atomic_compare_exchange_strong(&destinations_, &current, updated));
+
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(
-    sockaddr_in& addr,
-    buf_vec& buffers,
-    int flags, int *bytes_sent
-)
+rtp_error_t uvgrtp::socket::__sendtov(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent, bool fan_out)
 {
-    rtp_error_t ret = RTP_OK;
+    std::lock_guard<std::mutex> lock(*send_mtx_);
 
-    for (auto& handler : vec_handlers_) {
-        if ((ret = (*handler.handler)(handler.arg, buffers)) != RTP_OK) {
-            LOG_ERROR("Malformed packet");
-            return ret;
-        }
-    }
-
-    auto buf = { buffers };
-    return __sendtov(addr, buffers, flags, bytes_sent);
+    return __sendmsgs_locked(headers, count, flags, bytes_sent, fan_out);
 }
 
-rtp_error_t uvgrtp::socket::__sendtov(
-    sockaddr_in& addr,
-    uvgrtp::pkt_vec& buffers,
-    int flags, int *bytes_sent
-)
+rtp_error_t uvgrtp::socket::__sendmsgs_locked(struct mmsghdr *headers, size_t count, int flags, int *bytes_sent,
+    bool fan_out)
 {
-#ifndef _WIN32
+    rtp_error_t ret = RTP_OK;
+
+    if (send_sizes_.size() < count)
+        send_sizes_.resize(count);
+
+    size_t *sizes = send_sizes_.data();
     int sent_bytes = 0;
-    struct mmsghdr *headers = new struct mmsghdr[buffers.size()];
-    struct mmsghdr *hptr = headers;
 
-    for (size_t i = 0; i < buffers.size(); ++i) {
-        headers[i].msg_hdr.msg_iov        = new struct iovec[buffers[i].size()];
-        headers[i].msg_hdr.msg_iovlen     = buffers[i].size();
-        headers[i].msg_hdr.msg_name       = (void *)&addr;
-        headers[i].msg_hdr.msg_namelen    = sizeof(addr);
-        headers[i].msg_hdr.msg_control    = 0;
-        headers[i].msg_hdr.msg_controllen = 0;
-
-        for (size_t k = 0; k < buffers[i].size(); ++k) {
-            headers[i].msg_hdr.msg_iov[k].iov_len   = buffers[i][k].first;
-            headers[i].msg_hdr.msg_iov[k].iov_base  = buffers[i][k].second;
-            sent_bytes                             += buffers[i][k].first;
+    for (size_t i = 0; i < count; ++i) {
+        struct msghdr& msg = headers[i].msg_hdr;
+
+        for (auto& handler : vec_handlers_) {
+            if ((ret = (*handler.handler)(handler.arg, msg.msg_iov, msg.msg_iovlen)) != RTP_OK) {
+                LOG_ERROR("Malformed packet");
+                set_bytes(bytes_sent, -1);
+                return ret;
+            }
         }
-    }
 
-    ssize_t npkts = (flags_ & RCE_NO_SYSTEM_CALL_CLUSTERING) ? 1 : 1024;
-    ssize_t bptr  = buffers.size();
+        sizes[i] = 0;
 
-    while (bptr > npkts) {
-        if (sendmmsg(socket_, hptr, npkts, flags) < 0) {
-            log_platform_error("sendmmsg(2) failed");
-            return RTP_SEND_ERROR;
-        }
+        for (size_t k = 0; k < msg.msg_iovlen; ++k)
+            sizes[i] += msg.msg_iov[k].iov_len;
 
-        bptr -= npkts;
-        hptr += npkts;
+        sent_bytes += (int)sizes[i];
     }
 
-    if (sendmmsg(socket_, hptr, bptr, flags) < 0) {
-        log_platform_error("sendmmsg(2) failed");
-        return RTP_SEND_ERROR;
+    std::shared_ptr<uvgrtp::pacer> pacer = std::atomic_load(&pacer_);
+    bool priority = pacer_priority_;
+
+#ifdef MSG_ZEROCOPY
+    if (!zerocopy_)
+        flags &= ~MSG_ZEROCOPY;
+#endif
+
+    /* The same messages are sent to the remote address of each message first and then to every
+     * added destination. Only the remote addresses change between the rounds so the packets are
+     * built and encrypted once no matter how many destinations there are */
+    std::shared_ptr<const std::vector<sockaddr_in>> destinations;
+
+    if (fan_out)
+        destinations = std::atomic_load(&destinations_);
+
+    size_t rounds = destinations ? destinations->size() + 1 : 1;
+
+    if (rounds > 1) {
+        if (send_names_.size() < count)
+            send_names_.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            send_names_[i] = headers[i].msg_hdr.msg_name;
     }
 
-    for (size_t i = 0; i < buffers.size(); ++i)
-        delete[] headers[i].msg_hdr.msg_iov;
-    delete[] headers;
+    for (size_t round = 0; round < rounds; ++round) {
+        if (round > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                headers[i].msg_hdr.msg_name    = (void *)&(*destinations)[round - 1];
+                headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            }
+        }
+
+#ifndef _WIN32
+        rtp_error_t status = RTP_OK;
 
+        if (pacer)
+            status = __sendmsgs_paced(pacer.get(), priority, headers, sizes, count, flags);
+        else
+            status = __sendmsgs(headers, sizes, count, flags, true);
+
+        // an unreachable destination does not prevent sending to the others
+        if (status != RTP_OK)
+            ret = status;
 #else
-    INT ret = 0;
-    DWORD sent_bytes = 0;
-    WSABUF wsa_bufs[WSABUF_SIZE];
+        INT status = 0;
+        DWORD sent = 0;
+        WSABUF wsa_bufs[WSABUF_SIZE];
 
-    for (auto& buffer : buffers) {
+        for (size_t i = 0; i < count; ++i) {
+            struct msghdr& msg = headers[i].msg_hdr;
 
-        if (buffer.size() > WSABUF_SIZE) {
-            LOG_ERROR("Input vector to __sendtov() has more than %u elements!", WSABUF_SIZE);
-            return RTP_GENERIC_ERROR;
-        }
-        /* create WSABUFs from input buffer and send them at once */
-        for (size_t i = 0; i < buffer.size(); ++i) {
-            wsa_bufs[i].len = (ULONG)buffer.at(i).first;
-            wsa_bufs[i].buf = (char *)buffer.at(i).second;
-        }
+            if (msg.msg_iovlen > WSABUF_SIZE) {
+                LOG_ERROR("Input vector to __sendtov() has more than %u elements!", WSABUF_SIZE);
+                ret = RTP_GENERIC_ERROR;
+                break;
+            }
+
+            /* create WSABUFs from the chunks of the message and send them at once */
+            for (size_t k = 0; k < msg.msg_iovlen; ++k) {
+                wsa_bufs[k].len = (ULONG)msg.msg_iov[k].iov_len;
+                wsa_bufs[k].buf = (char *)msg.msg_iov[k].iov_base;
+            }
+
+            if (pacer)
+                uvgrtp::pacer::wait_until(pacer->reserve(sizes[i], priority));
 
 send_:
-        ret = WSASendTo(
-            socket_,
-            wsa_bufs,
-            (DWORD)buffer.size(),
-            &sent_bytes,
-            flags,
-            (SOCKADDR *)&addr,
-            sizeof(addr_),
-            nullptr,
-            nullptr
-        );
-
-        if (ret == -1) {
-            if (WSAGetLastError() == WSAEWOULDBLOCK)
-                goto send_;
-            log_platform_error("WSASendTo() failed");
-            set_bytes(bytes_sent, -1);
-            return RTP_SEND_ERROR;
+            status = WSASendTo(
+                socket_,
+                wsa_bufs,
+                (DWORD)msg.msg_iovlen,
+                &sent,
+                flags,
+                (SOCKADDR *)msg.msg_name,
+                (int)msg.msg_namelen,
+                nullptr,
+                nullptr
+            );
+
+            if (status == -1) {
+                if (WSAGetLastError() == WSAEWOULDBLOCK)
+                    goto send_;
+                log_platform_error("WSASendTo() failed");
+                ret = RTP_SEND_ERROR;
+                break;
+            }
         }
+#endif
+    }
 
+    if (rounds > 1) {
+        for (size_t i = 0; i < count; ++i) {
+            headers[i].msg_hdr.msg_name    = send_names_[i];
+            headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+    }
+
+    if (ret != RTP_OK) {
+        set_bytes(bytes_sent, -1);
+        return ret;
     }
-#endif
 
 #ifndef NDEBUG
-    sent_packets_ += buffers.size();
+    sent_packets_ += count * rounds;
 #endif // !NDEBUG
 
     set_bytes(bytes_sent, sent_bytes);
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags)
+#ifndef _WIN32
+rtp_error_t uvgrtp::socket::__sendmsgs_uring(struct mmsghdr *headers, size_t count, int flags, size_t *failed_index)
 {
-    rtp_error_t ret = RTP_OK;
+    if (!send_ring_) {
+        if (send_ring_failed_)
+            return RTP_NOT_SUPPORTED;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
+        send_ring_.reset(new uvgrtp::uring());
+
+        if (send_ring_->init(URING_SEND_ENTRIES, URING_SEND_ENTRIES) != RTP_OK) {
+            LOG_WARN("io_uring is not available, falling back to sendmmsg(2)");
+            send_ring_        = nullptr;
+            send_ring_failed_ = true;
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+
+    bool failed = false;
+
+    for (size_t sent = 0; sent < count && !failed; ) {
+        size_t n = count - sent;
+
+        if (n > URING_SEND_ENTRIES)
+            n = URING_SEND_ENTRIES;
+
+        // the messages are linked so that the datagrams leave in order
+        for (size_t i = 0; i < n; ++i)
+            (void)send_ring_->queue_sendmsg(socket_, &headers[sent + i].msg_hdr, flags, sent + i, i + 1 < n);
+
+        uint64_t user_data = 0;
+        int res = 0, bid = -1;
+        bool more = false;
+
+        for (size_t done = 0; done < n; ) {
+            if (!send_ring_->next_completion(user_data, res, bid, more)) {
+                if (send_ring_->submit_and_wait((unsigned)(n - done), -1) == RTP_GENERIC_ERROR)
+                    return RTP_SEND_ERROR;
+                continue;
             }
+
+            // the messages after a failed one are cancelled so the first failed one is the lowest
+            if (res < 0) {
+                if (!failed || user_data < *failed_index)
+                    *failed_index = user_data;
+
+                if (!failed)
+                    LOG_ERROR("Failed to send RTP frame: %s!", strerror(-res));
+                failed = true;
+            }
+            ++done;
         }
+
+        sent += n;
     }
 
-    return __sendtov(addr_, buffers, flags, nullptr);
+    return failed ? RTP_SEND_ERROR : RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(pkt_vec& buffers, int flags, int *bytes_sent)
+size_t uvgrtp::socket::__coalesce_gso(struct mmsghdr *headers, const size_t *sizes, size_t count, bool copy)
 {
-    rtp_error_t ret = RTP_OK;
+    gso_headers_.clear();
+    gso_ranges_.clear();
+    gso_chunks_.clear();
+
+#ifdef UDP_SEGMENT
+    size_t copied  = 0;
+    size_t nchunks = 0;
+
+    // find the runs first so that the buffers are not reallocated while they are pointed to.
+    // All segments of a datagram must have the same size except the last one which may be shorter
+    for (size_t i = 0; i < count; ) {
+        size_t total = sizes[i];
+        size_t end   = i + 1;
+
+        while (end < count && end - i < GSO_MAX_SEGMENTS && sizes[end] <= sizes[i] &&
+               total + sizes[end] <= GSO_MAX_SIZE) {
+            total += sizes[end++];
+
+            if (sizes[end - 1] < sizes[i])
+                break;
+        }
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
+        if (end - i > 1) {
+            copied += total;
+
+            for (size_t k = i; k < end; ++k)
+                nchunks += headers[k].msg_hdr.msg_iovlen;
+        }
+
+        gso_ranges_.push_back({ i, end - i });
+        i = end;
+    }
+
+    const size_t control_len = CMSG_SPACE(sizeof(uint16_t));
+
+    if (copy && gso_buffer_.size() < copied)
+        gso_buffer_.resize(copied);
+
+    if (gso_control_.size() < gso_ranges_.size() * control_len)
+        gso_control_.resize(gso_ranges_.size() * control_len);
+
+    gso_headers_.resize(gso_ranges_.size());
+    gso_chunks_.resize(copy ? gso_ranges_.size() : nchunks);
+
+    uint8_t *ptr       = gso_buffer_.data();
+    struct iovec *iovs = gso_chunks_.data();
+
+    for (size_t i = 0; i < gso_ranges_.size(); ++i) {
+        size_t first  = gso_ranges_[i].first;
+        size_t npkts  = gso_ranges_[i].second;
+
+        if (npkts == 1) {
+            gso_headers_[i] = headers[first];
+            continue;
+        }
+
+        struct iovec *datagram = iovs;
+
+        if (copy) {
+            // the segments are laid out back to back in one buffer
+            iovs->iov_base = ptr;
+
+            for (size_t k = first; k < first + npkts; ++k) {
+                for (size_t c = 0; c < headers[k].msg_hdr.msg_iovlen; ++c) {
+                    memcpy(ptr, headers[k].msg_hdr.msg_iov[c].iov_base, headers[k].msg_hdr.msg_iov[c].iov_len);
+                    ptr += headers[k].msg_hdr.msg_iov[c].iov_len;
+                }
+            }
+            iovs->iov_len = ptr - (uint8_t *)iovs->iov_base;
+            ++iovs;
+        } else {
+            // the kernel splits the datagram at segment boundaries regardless of the buffers
+            for (size_t k = first; k < first + npkts; ++k) {
+                for (size_t c = 0; c < headers[k].msg_hdr.msg_iovlen; ++c)
+                    *iovs++ = headers[k].msg_hdr.msg_iov[c];
             }
         }
+
+        uint8_t *control = gso_control_.data() + i * control_len;
+        memset(control, 0, control_len);
+
+        struct cmsghdr *cmsg = (struct cmsghdr *)control;
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type  = UDP_SEGMENT;
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+
+        uint16_t segment = (uint16_t)sizes[first];
+        memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+        gso_headers_[i] = headers[first];
+        gso_headers_[i].msg_hdr.msg_iov        = datagram;
+        gso_headers_[i].msg_hdr.msg_iovlen     = iovs - datagram;
+        gso_headers_[i].msg_hdr.msg_control    = control;
+        gso_headers_[i].msg_hdr.msg_controllen = control_len;
     }
 
-    return __sendtov(addr_, buffers, flags, bytes_sent);
+    return gso_headers_.size();
+#else
+    for (size_t i = 0; i < count; ++i) {
+        gso_headers_.push_back(headers[i]);
+        gso_ranges_.push_back({ i, 1 });
+    }
+
+    (void)sizes;
+    (void)copy;
+    return count;
+#endif
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flags)
+rtp_error_t uvgrtp::socket::__sendmsgs(struct mmsghdr *headers, const size_t *sizes, size_t count, int flags, bool gso)
 {
+    size_t npkts = (flags_ & RCE_NO_SYSTEM_CALL_CLUSTERING) ? 1 : 1024;
+    struct mmsghdr *out = headers;
+    size_t nout = count;
+    size_t sent = 0;
     rtp_error_t ret = RTP_OK;
+    bool zerocopy = false;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
+#ifdef MSG_ZEROCOPY
+    zerocopy = (flags & MSG_ZEROCOPY);
+#endif
+
+    // runs of equally sized packets (the FUs of a frame) are sent as UDP GSO datagrams.
+    // Zero-copy datagrams point to the original buffers as they are not copied by the kernel either
+    if (gso && (flags_ & RCE_UDP_GSO) && !gso_failed_ && nout > 1) {
+        nout = __coalesce_gso(headers, sizes, nout, !zerocopy);
+        out  = gso_headers_.data();
+    }
+
+    // io_uring has its own zero-copy send which is not used
+    if ((flags_ & RCE_IO_URING) && !zerocopy) {
+        size_t failed = nout;
+        ret = __sendmsgs_uring(out, nout, flags, &failed);
+
+        // the kernel only reports a failed GSO datagram in the completion, then the messages
+        // of the failed datagram and the ones after it are sent without GSO as below
+        if (ret == RTP_SEND_ERROR && out != headers && failed < nout && gso_ranges_[failed].second > 1) {
+            LOG_WARN("UDP GSO failed, sending the packets one by one");
+            gso_failed_ = true;
+
+            sent = gso_ranges_[failed].first;
+            out  = headers;
+            nout = count;
+            ret  = __sendmsgs_uring(out + sent, nout - sent, flags, &failed);
+        }
+
+        // everything was sent (or failed) with io_uring
+        if (ret != RTP_NOT_SUPPORTED)
+            sent = nout;
+        else
+            ret = RTP_OK;
+    }
+
+    while (sent < nout) {
+        int n = sendmmsg(socket_, out + sent, (unsigned)std::min(nout - sent, npkts), flags);
+
+        if (n >= 0) {
+            // the kernel gives every sent message an ID for the completion notifications
+            if (zerocopy) {
+                std::lock_guard<std::mutex> lk(zerocopy_->mtx);
+                zerocopy_->next += (uint32_t)n;
             }
+
+            sent += n;
+            continue;
         }
+
+        // the network device may not be able to segment the datagrams, then the
+        // messages of the failed datagram and the ones after it are sent without GSO
+        if (out != headers && gso_ranges_[sent].second > 1) {
+            LOG_WARN("UDP GSO failed, falling back to sendmmsg(2): %s", strerror(errno));
+            gso_failed_ = true;
+
+            sent = gso_ranges_[sent].first;
+            out  = headers;
+            nout = count;
+            continue;
+        }
+
+        log_platform_error("sendmmsg(2) failed");
+        ret = RTP_SEND_ERROR;
+        break;
     }
 
-    return __sendtov(addr, buffers, flags, nullptr);
+    return ret;
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, pkt_vec& buffers, int flags, int *bytes_sent)
+rtp_error_t uvgrtp::socket::__sendmsgs_paced(uvgrtp::pacer *pacer, bool priority, struct mmsghdr *headers,
+    const size_t *sizes, size_t count, int flags)
 {
+    if (departures_.size() < count)
+        departures_.resize(count);
+
+    auto departures = departures_.data();
+
+    // the whole batch is reserved at once so that the packets of other
+    // streams sharing the pacer do not get in between them
+    for (size_t i = 0; i < count; ++i)
+        departures[i] = pacer->reserve(sizes[i], priority);
+
+#if defined(__linux__) && defined(SCM_TXTIME)
+    if (txtime_) {
+        const size_t control_len = CMSG_SPACE(sizeof(uint64_t));
+
+        if (txtime_control_.size() < count * control_len)
+            txtime_control_.resize(count * control_len);
+
+        // steady_clock is CLOCK_MONOTONIC which is also the clock given to SO_TXTIME
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t *control = txtime_control_.data() + i * control_len;
+            memset(control, 0, control_len);
+
+            struct cmsghdr *cmsg = (struct cmsghdr *)control;
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_TXTIME;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint64_t));
+
+            uint64_t txtime = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                departures[i].time_since_epoch()).count();
+            memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+
+            headers[i].msg_hdr.msg_control    = control;
+            headers[i].msg_hdr.msg_controllen = control_len;
+        }
+
+        // a GSO datagram would leave at the departure time of its first segment
+        return __sendmsgs(headers, sizes, count, flags, false);
+    }
+#endif
+
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
-                LOG_ERROR("Malformed packet");
-                return ret;
+    // the packets whose departure time has passed while waiting are sent together
+    for (size_t i = 0; i < count && ret == RTP_OK; ) {
+        uvgrtp::pacer::wait_until(departures[i]);
+
+        auto now   = uvgrtp::pacer::clock::now();
+        size_t end = i + 1;
+
+        while (end < count && departures[end] <= now)
+            ++end;
+
+        ret = __sendmsgs(headers + i, sizes + i, end - i, flags, true);
+        i   = end;
+    }
+
+    return ret;
+}
+#endif
+
+void uvgrtp::socket::set_pacer(std::shared_ptr<uvgrtp::pacer> pacer, bool priority)
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    if (pacer && (flags_ & RCE_PACE_TXTIME) && !txtime_) {
+        struct sock_txtime config;
+        config.clockid = CLOCK_MONOTONIC;
+        config.flags   = 0;
+
+        if (::setsockopt(socket_, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) < 0)
+            LOG_WARN("SO_TXTIME is not available, pacing in the sending thread: %s", strerror(errno));
+        else
+            txtime_ = true;
+    }
+#endif
+
+    pacer_priority_ = priority;
+    std::atomic_store(&pacer_, pacer);
+}
+
+rtp_error_t uvgrtp::socket::enable_zerocopy()
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    if (zerocopy_)
+        return RTP_OK;
+
+    int enable = 1;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) < 0) {
+        LOG_WARN("MSG_ZEROCOPY is not available: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    zerocopy_ = std::make_shared<uvgrtp::zerocopy_state>();
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t uvgrtp::socket::get_zerocopy_id()
+{
+    if (!zerocopy_)
+        return 0;
+
+    std::lock_guard<std::mutex> lk(zerocopy_->mtx);
+    return zerocopy_->next;
+}
+
+void uvgrtp::socket::install_zerocopy_handler(std::function<void(uint32_t completed)> handler)
+{
+    if (!zerocopy_)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lk(zerocopy_->handler_mtx);
+    zerocopy_->handler = handler;
+}
+
+void uvgrtp::socket::process_zerocopy()
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    if (!zerocopy_)
+        return;
+
+    std::unique_lock<std::mutex> lk(zerocopy_->mtx);
+    uint32_t completed = zerocopy_->completed;
+
+    uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+    struct msghdr msg;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+                continue;
+
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0)
+                continue;
+
+            // the kernel had to copy the data after all, for example when sending to a local address
+            if ((err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && !zerocopy_->copied) {
+                LOG_DEBUG("The kernel copied data sent with MSG_ZEROCOPY");
+                zerocopy_->copied = true;
             }
+
+            // notifications of consecutive messages are merged to one range [ee_info, ee_data]
+            zerocopy_->ranges[err.ee_info] = err.ee_data;
         }
     }
 
-    return __sendtov(addr, buffers, flags, bytes_sent);
+    // looked up by value and not by order so that the IDs can wrap around
+    for (auto it = zerocopy_->ranges.find(completed); it != zerocopy_->ranges.end();
+         it = zerocopy_->ranges.find(zerocopy_->completed)) {
+        zerocopy_->completed = it->second + 1;
+        zerocopy_->ranges.erase(it);
+    }
+
+    if (zerocopy_->completed == completed)
+        return;
+
+    completed = zerocopy_->completed;
+    lk.unlock();
+
+    std::lock_guard<std::recursive_mutex> handler_lk(zerocopy_->handler_mtx);
+    if (zerocopy_->handler)
+        zerocopy_->handler(completed);
+#endif
 }
 
 rtp_error_t uvgrtp::socket::__recv(uint8_t *buf, size_t buf_len, int flags, int *bytes_read)
@@ -627,6 +1081,179 @@ rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int flags)
     return __recvfrom(buf, buf_len, flags, nullptr, nullptr);
 }
 
+rtp_error_t uvgrtp::socket::__recvmmsg(uvgrtp::pkt_vec& buffers, int flags, int *bytes_read, int *packets_read,
+    int *segment_sizes)
+{
+    if (buffers.empty() || !bytes_read) {
+        set_bytes(packets_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+#ifndef _WIN32
+    size_t nchunks = 0;
+
+    for (auto& buffer : buffers)
+        nchunks += buffer.size();
+
+    if (recv_headers_.size() < buffers.size())
+        recv_headers_.resize(buffers.size());
+
+    if (recv_chunks_.size() < nchunks)
+        recv_chunks_.resize(nchunks);
+
+#ifdef UDP_GRO
+    const size_t control_len = CMSG_SPACE(sizeof(int));
+
+    if (segment_sizes && recv_control_.size() < buffers.size() * control_len)
+        recv_control_.resize(buffers.size() * control_len);
+#endif
+
+    struct iovec *chunk = recv_chunks_.data();
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        struct msghdr& hdr = recv_headers_[i].msg_hdr;
+
+        hdr.msg_name       = nullptr;
+        hdr.msg_namelen    = 0;
+        hdr.msg_iov        = chunk;
+        hdr.msg_iovlen     = buffers[i].size();
+        hdr.msg_control    = nullptr;
+        hdr.msg_controllen = 0;
+        hdr.msg_flags      = 0;
+
+#ifdef UDP_GRO
+        if (segment_sizes) {
+            hdr.msg_control    = recv_control_.data() + i * control_len;
+            hdr.msg_controllen = control_len;
+        }
+#endif
+
+        for (auto& buffer : buffers[i]) {
+            chunk->iov_base = buffer.second;
+            chunk->iov_len  = buffer.first;
+            ++chunk;
+        }
+    }
+
+    int ret = ::recvmmsg(socket_, recv_headers_.data(), (unsigned)buffers.size(), flags, nullptr);
+
+#ifndef NDEBUG
+    ++recv_syscalls_;
+#endif // !NDEBUG
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            set_bytes(packets_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        log_platform_error("recvmmsg(2) failed");
+
+        set_bytes(packets_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    for (int i = 0; i < ret; ++i)
+        bytes_read[i] = (int)recv_headers_[i].msg_len;
+
+    if (segment_sizes) {
+        for (int i = 0; i < ret; ++i) {
+            segment_sizes[i] = 0;
+
+#ifdef UDP_GRO
+            struct msghdr *hdr = &recv_headers_[i].msg_hdr;
+
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    std::memcpy(&segment_sizes[i], CMSG_DATA(cmsg), sizeof(int));
+            }
+#endif
+        }
+    }
+#else
+    /* Windows does not have a counterpart for recvmmsg(2) so read the datagrams one by one
+     * until the socket is drained or all buffers have been filled */
+    int ret = 0;
+    WSABUF wsa_bufs[WSABUF_SIZE];
+
+    for (auto& buffer : buffers) {
+        if (buffer.size() > WSABUF_SIZE) {
+            LOG_ERROR("Input vector to __recvmmsg() has more than %u elements!", WSABUF_SIZE);
+            set_bytes(packets_read, -1);
+            return RTP_INVALID_VALUE;
+        }
+
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            wsa_bufs[i].len = (ULONG)buffer.at(i).first;
+            wsa_bufs[i].buf = (char *)buffer.at(i).second;
+        }
+
+        DWORD bytes_received = 0, flags_ = 0;
+        int rc = ::WSARecvFrom(socket_, wsa_bufs, (DWORD)buffer.size(), &bytes_received, &flags_, NULL, NULL, NULL, NULL);
+
+#ifndef NDEBUG
+        ++recv_syscalls_;
+#endif // !NDEBUG
+
+        if (rc == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+
+            if (err == WSAEWOULDBLOCK || err == WSA_IO_PENDING)
+                break;
+
+            if (ret == 0) {
+                log_platform_error("WSARecvFrom() failed");
+                set_bytes(packets_read, -1);
+                return RTP_GENERIC_ERROR;
+            }
+            break;
+        }
+
+        if (segment_sizes)
+            segment_sizes[ret] = 0;
+
+        bytes_read[ret++] = (int)bytes_received;
+    }
+
+    if (ret == 0) {
+        set_bytes(packets_read, 0);
+        return RTP_INTERRUPTED;
+    }
+#endif
+
+#ifndef NDEBUG
+    received_packets_ += ret;
+#endif // !NDEBUG
+
+    set_bytes(packets_read, ret);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(pkt_vec& buffers, int flags, int *bytes_read, int *packets_read)
+{
+    return __recvmmsg(buffers, flags, bytes_read, packets_read, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(pkt_vec& buffers, int flags, int *bytes_read, int *packets_read, int *segment_sizes)
+{
+    return __recvmmsg(buffers, flags, bytes_read, packets_read, segment_sizes);
+}
+
+rtp_error_t uvgrtp::socket::enable_gro()
+{
+#if defined(__linux__) && defined(UDP_GRO)
+    int enable = 1;
+
+    if (::setsockopt(socket_, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) < 0) {
+        LOG_DEBUG("Failed to enable UDP GRO: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
 sockaddr_in& uvgrtp::socket::get_out_address()
 {
     return addr_;
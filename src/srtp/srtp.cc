@@ -113,13 +113,13 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void *arg, int flags, frame::rtp_f
     return RTP_PKT_MODIFIED;
 }
 
-rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffers)
+rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, struct iovec *buffers, size_t count)
 {
     auto srtp       = (uvgrtp::srtp *)arg;
-    auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
+    auto frame      = (uvgrtp::frame::rtp_frame *)buffers[0].iov_base;
     auto ctx        = srtp->get_ctx();
     auto off        = srtp->authenticate_rtp() ? 2 : 1;
-    auto data       = buffers.at(buffers.size() - off);
+    auto& data      = buffers[count - off];
     auto hmac_sha1  = uvgrtp::crypto::hmac::sha1(ctx->key_ctx.local.auth_key, UVG_AUTH_LENGTH);
     rtp_error_t ret = RTP_OK;
 
@@ -129,8 +129,8 @@ rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffer
     ret = srtp->encrypt(
         ntohl(frame->header.ssrc),
         ntohs(frame->header.seq),
-        data.second,
-        data.first
+        (uint8_t *)data.iov_base,
+        data.iov_len
     );
 
     if (ret != RTP_OK) {
@@ -142,11 +142,11 @@ authenticate:
     if (!srtp->authenticate_rtp())
         return RTP_OK;
 
-    for (size_t i = 0; i < buffers.size() - 1; ++i)
-        hmac_sha1.update((uint8_t *)buffers[i].second, buffers[i].first);
+    for (size_t i = 0; i < count - 1; ++i)
+        hmac_sha1.update((uint8_t *)buffers[i].iov_base, buffers[i].iov_len);
 
     hmac_sha1.update((uint8_t *)&ctx->roc, sizeof(ctx->roc));
-    hmac_sha1.final((uint8_t *)buffers[buffers.size() - 1].second, UVG_AUTH_TAG_LENGTH);
+    hmac_sha1.final((uint8_t *)buffers[count - 1].iov_base, UVG_AUTH_TAG_LENGTH);
 
     return ret;
 }
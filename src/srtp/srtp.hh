@@ -2,6 +2,8 @@
 
 #include "base.hh"
 
+#include "uvgrtp/socket.hh"
+
 namespace uvgrtp {
 
     namespace frame {
@@ -16,8 +18,10 @@ namespace uvgrtp {
             /* Decrypt the payload of an RTP packet and verify authentication tag (if enabled) */
             static rtp_error_t recv_packet_handler(void *arg, int flags, frame::rtp_frame **out);
 
-            /* Encrypt the payload of an RTP packet and add authentication tag (if enabled) */
-            static rtp_error_t send_packet_handler(void *arg, buf_vec& buffers);
+            /* Encrypt the payload of an RTP packet and add authentication tag (if enabled).
+             * The payload is the last of the "count" buffers, or the second last if authentication
+             * is enabled in which case the last buffer receives the authentication tag */
+            static rtp_error_t send_packet_handler(void *arg, struct iovec *buffers, size_t count);
 
         private:
             /* TODO:  */
@@ -0,0 +1,158 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+
+static inline bool is_empty(const uvgrtp::timer_wheel::timer& head)
+{
+    return head.next == &head;
+}
+
+uvgrtp::timer_wheel::timer_wheel():
+    start_(clock::now()),
+    now_(0),
+    pending_(0)
+{
+    for (auto& level : slots_) {
+        for (auto& head : level) {
+            head.next = &head;
+            head.prev = &head;
+        }
+    }
+}
+
+uvgrtp::timer_wheel::~timer_wheel()
+{
+    // leave the timers that are still pending in a consistent state
+    for (auto& level : slots_) {
+        for (auto& head : level) {
+            while (!is_empty(head))
+                cancel(head.next);
+        }
+    }
+}
+
+uint64_t uvgrtp::timer_wheel::current_tick() const
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start_).count();
+}
+
+void uvgrtp::timer_wheel::insert(uvgrtp::timer_wheel::timer *t)
+{
+    uint64_t delta = t->expires - now_;
+    size_t level   = 0;
+
+    // the slot of the level whose period covers the expiration time
+    while (level < LEVELS - 1 && delta >= ((uint64_t)1 << ((level + 1) * LEVEL_BITS)))
+        ++level;
+
+    timer& head = slots_[level][(t->expires >> (level * LEVEL_BITS)) & (LEVEL_SLOTS - 1)];
+
+    t->next = &head;
+    t->prev = head.prev;
+    head.prev->next = t;
+    head.prev = t;
+}
+
+void uvgrtp::timer_wheel::schedule(uvgrtp::timer_wheel::timer *t, uint64_t delay_ms)
+{
+    cancel(t);
+
+    /* The timer must expire after a tick that has not been processed yet so the delay is at least one tick.
+     * The wheel may be behind the clock, so the ticks it has yet to process are added to the delay */
+    uint64_t lag = current_tick() - now_;
+
+    t->expires = now_ + std::min(lag + std::max<uint64_t>(1, delay_ms), MAX_DELAY);
+
+    insert(t);
+    ++pending_;
+}
+
+void uvgrtp::timer_wheel::cancel(uvgrtp::timer_wheel::timer *t)
+{
+    if (!t->pending())
+        return;
+
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = nullptr;
+    t->prev = nullptr;
+
+    --pending_;
+}
+
+void uvgrtp::timer_wheel::cascade(size_t level)
+{
+    timer& head = slots_[level][(now_ >> (level * LEVEL_BITS)) & (LEVEL_SLOTS - 1)];
+
+    while (!is_empty(head)) {
+        timer *t = head.next;
+
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+
+        insert(t);
+    }
+}
+
+void uvgrtp::timer_wheel::advance()
+{
+    uint64_t target = current_tick();
+
+    // nothing can expire, catch up with the clock right away
+    if (!pending_) {
+        now_ = std::max(now_, target);
+        return;
+    }
+
+    while (now_ < target) {
+        ++now_;
+
+        // when a level has gone around, the next slot of the level above it is distributed to it
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if ((now_ & (((uint64_t)1 << (level * LEVEL_BITS)) - 1)) != 0)
+                break;
+
+            cascade(level);
+        }
+
+        timer& head = slots_[0][now_ & (LEVEL_SLOTS - 1)];
+
+        while (!is_empty(head)) {
+            timer *t = head.next;
+
+            cancel(t);
+            t->callback(t->arg, t->tag);
+        }
+
+        if (!pending_) {
+            now_ = target;
+            break;
+        }
+    }
+}
+
+uint64_t uvgrtp::timer_wheel::next_timeout(uint64_t max_ms) const
+{
+    if (!pending_)
+        return max_ms;
+
+    uint64_t elapsed = current_tick() - now_;
+
+    // the wheel is behind the clock and timers may have expired already
+    if (elapsed > 0)
+        return 0;
+
+    /* A timer may expire in one of the slots of the first level before it goes around.
+     * After that the timers are cascaded from the levels above so it's checked again then */
+    for (uint64_t i = 1; i < LEVEL_SLOTS; ++i) {
+        uint64_t tick = now_ + i;
+
+        if (!is_empty(slots_[0][tick & (LEVEL_SLOTS - 1)]))
+            return std::min(i, max_ms);
+
+        if ((tick & (LEVEL_SLOTS - 1)) == 0)
+            return std::min(i, max_ms);
+    }
+
+    return std::min<uint64_t>(LEVEL_SLOTS, max_ms);
+}
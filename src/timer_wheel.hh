@@ -0,0 +1,85 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* Hierarchical timer wheel with millisecond ticks.
+     *
+     * The first level has a slot for each of the next LEVEL_SLOTS milliseconds and every
+     * following level covers LEVEL_SLOTS times longer period with the same number of slots.
+     * When the first level has gone around, the timers of the next slot of the second level
+     * are moved to the first level and so on. Scheduling, cancelling and expiring a timer
+     * are constant time operations and the timers are linked to the slots through the
+     * timer itself so the wheel never allocates.
+     *
+     * The wheel is not thread-safe. The reception flow owns one and advances it on the
+     * thread that runs the packet handlers, which are the ones scheduling the timers */
+    class timer_wheel {
+        public:
+            typedef std::chrono::steady_clock clock;
+
+            struct timer {
+                timer *next = nullptr;
+                timer *prev = nullptr;
+
+                /* the tick when the timer expires */
+                uint64_t expires = 0;
+
+                /* called when the timer expires, the timer is not pending anymore at that point */
+                void (*callback)(void *arg, size_t tag) = nullptr;
+                void *arg = nullptr;
+                size_t tag = 0;
+
+                bool pending() const { return prev != nullptr; }
+            };
+
+            static constexpr size_t LEVEL_BITS  = 6;
+            static constexpr size_t LEVEL_SLOTS = (size_t)1 << LEVEL_BITS;
+            static constexpr size_t LEVELS      = 4;
+
+            /* The longest delay, longer delays are shortened to this (about 4.6 hours) */
+            static constexpr uint64_t MAX_DELAY = ((uint64_t)1 << (LEVELS * LEVEL_BITS)) - 1;
+
+            timer_wheel();
+            ~timer_wheel();
+
+            /* Call the callback of "t" after "delay_ms" milliseconds. A pending timer is rescheduled */
+            void schedule(timer *t, uint64_t delay_ms);
+
+            /* Stop "t" if it's pending */
+            void cancel(timer *t);
+
+            /* Expire the timers whose time has come */
+            void advance();
+
+            /* Return how many milliseconds the caller can sleep before calling advance() again.
+             * If no timers are pending, "max_ms" is returned */
+            uint64_t next_timeout(uint64_t max_ms) const;
+
+        private:
+            uint64_t current_tick() const;
+
+            /* Link "t" to the slot matching its expiration time */
+            void insert(timer *t);
+
+            /* Move the timers of the current slot of "level" to lower levels */
+            void cascade(size_t level);
+
+            clock::time_point start_;
+
+            /* the tick up to which the timers have been expired */
+            uint64_t now_;
+
+            size_t pending_;
+
+            /* list heads of the slots */
+            timer slots_[LEVELS][LEVEL_SLOTS];
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
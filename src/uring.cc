@@ -0,0 +1,403 @@
+#include "uring.hh"
+
+#include "uvgrtp/debug.hh"
+
+#ifdef UVGRTP_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <signal.h>
+#include <linux/time_types.h>
+
+#include <cerrno>
+#include <cstring>
+
+static_assert(sizeof(struct io_uring_recvmsg_out) == uvgrtp::uring::RECVMSG_OUT_SIZE,
+    "io_uring_recvmsg_out has unexpected size");
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags, const void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
+uvgrtp::uring::uring() :
+    fd_(-1),
+    sq_ring_(nullptr),
+    cq_ring_(nullptr),
+    sqes_(nullptr),
+    sq_ring_size_(0),
+    cq_ring_size_(0),
+    sqes_size_(0),
+    sq_head_(nullptr),
+    sq_tail_(nullptr),
+    sq_mask_(nullptr),
+    sq_array_(nullptr),
+    cq_head_(nullptr),
+    cq_tail_(nullptr),
+    cq_mask_(nullptr),
+    cqes_(nullptr),
+    sq_local_tail_(0),
+    sq_entries_(0),
+    buf_ring_(nullptr),
+    buf_ring_size_(0),
+    buf_ring_mask_(0),
+    buf_ring_tail_(0)
+{
+}
+
+uvgrtp::uring::~uring()
+{
+    release();
+}
+
+void uvgrtp::uring::release()
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    // closing the instance cancels all operations still in flight
+    if (fd_ != -1)
+        close(fd_);
+
+    if (buf_ring_)
+        munmap(buf_ring_, buf_ring_size_);
+
+    if (sqes_)
+        munmap(sqes_, sqes_size_);
+
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+
+    if (sq_ring_)
+        munmap(sq_ring_, sq_ring_size_);
+#endif
+
+    fd_       = -1;
+    buf_ring_ = nullptr;
+    sqes_     = nullptr;
+    cq_ring_  = nullptr;
+    sq_ring_  = nullptr;
+}
+
+rtp_error_t uvgrtp::uring::init(unsigned entries, unsigned cq_entries)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    params.flags      = IORING_SETUP_CQSIZE;
+    params.cq_entries = cq_entries;
+
+    if ((fd_ = sys_io_uring_setup(entries, &params)) < 0) {
+        LOG_DEBUG("io_uring_setup(2) failed: %s", strerror(errno));
+        fd_ = -1;
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // the timeout of submit_and_wait() needs IORING_FEAT_EXT_ARG
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        LOG_DEBUG("The kernel is too old for the io_uring backend");
+        release();
+        return RTP_NOT_SUPPORTED;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (cq_ring_size_ > sq_ring_size_)
+        sq_ring_size_ = cq_ring_size_;
+    cq_ring_size_ = sq_ring_size_;
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+
+    if (sq_ring_ == MAP_FAILED) {
+        LOG_ERROR("Failed to map the io_uring rings: %s", strerror(errno));
+        sq_ring_ = nullptr;
+        release();
+        return RTP_NOT_SUPPORTED;
+    }
+    cq_ring_ = sq_ring_;
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_      = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+
+    if (sqes_ == MAP_FAILED) {
+        LOG_ERROR("Failed to map the io_uring submission queue: %s", strerror(errno));
+        sqes_ = nullptr;
+        release();
+        return RTP_NOT_SUPPORTED;
+    }
+
+    uint8_t *sq = (uint8_t *)sq_ring_;
+    uint8_t *cq = (uint8_t *)cq_ring_;
+
+    sq_head_  = (unsigned *)(sq + params.sq_off.head);
+    sq_tail_  = (unsigned *)(sq + params.sq_off.tail);
+    sq_mask_  = (unsigned *)(sq + params.sq_off.ring_mask);
+    sq_array_ = (unsigned *)(sq + params.sq_off.array);
+    cq_head_  = (unsigned *)(cq + params.cq_off.head);
+    cq_tail_  = (unsigned *)(cq + params.cq_off.tail);
+    cq_mask_  = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes_     = cq + params.cq_off.cqes;
+
+    sq_entries_    = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+
+    return RTP_OK;
+#else
+    (void)entries, (void)cq_entries;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::uring::register_buffer_ring(uint16_t group, unsigned entries)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    if (!entries || (entries & (entries - 1)) || entries > 32768)
+        return RTP_INVALID_VALUE;
+
+    buf_ring_size_ = entries * sizeof(struct io_uring_buf);
+    buf_ring_      = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buf_ring_ == MAP_FAILED) {
+        LOG_ERROR("Failed to allocate the provided buffer ring: %s", strerror(errno));
+        buf_ring_ = nullptr;
+        return RTP_MEMORY_ERROR;
+    }
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+
+    reg.ring_addr    = (uint64_t)(uintptr_t)buf_ring_;
+    reg.ring_entries = entries;
+    reg.bgid         = group;
+
+    if (sys_io_uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_DEBUG("Failed to register the provided buffer ring: %s", strerror(errno));
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+        return RTP_NOT_SUPPORTED;
+    }
+
+    buf_ring_mask_ = entries - 1;
+    buf_ring_tail_ = 0;
+
+    return RTP_OK;
+#else
+    (void)group, (void)entries;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+void uvgrtp::uring::provide_buffer(uint8_t *buffer, uint32_t len, uint16_t bid)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    // not ring->bufs, the empty struct of __DECLARE_FLEX_ARRAY shifts the array in C++
+    struct io_uring_buf *buf = (struct io_uring_buf *)buf_ring_ + (buf_ring_tail_ & buf_ring_mask_);
+
+    buf->addr = (uint64_t)(uintptr_t)(buffer - RECVMSG_OUT_SIZE);
+    buf->len  = len + RECVMSG_OUT_SIZE;
+    buf->bid  = bid;
+
+    ++buf_ring_tail_;
+#else
+    (void)buffer, (void)len, (void)bid;
+#endif
+}
+
+void uvgrtp::uring::commit_buffers()
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    auto ring = (struct io_uring_buf_ring *)buf_ring_;
+    __atomic_store_n(&ring->tail, buf_ring_tail_, __ATOMIC_RELEASE);
+#endif
+}
+
+#ifdef UVGRTP_HAVE_IO_URING
+struct io_uring_sqe *uvgrtp::uring::get_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    if (sq_local_tail_ - head >= sq_entries_)
+        return nullptr;
+
+    unsigned index = sq_local_tail_ & *sq_mask_;
+    auto sqe = &((struct io_uring_sqe *)sqes_)[index];
+
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+
+    return sqe;
+}
+#endif
+
+rtp_error_t uvgrtp::uring::queue_multishot_recv(int fd, uint16_t group, uint64_t user_data)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    // the name and control data are not needed so the header of the multishot
+    // receive is the only thing the kernel writes in front of the datagram
+    static const struct msghdr msg = {};
+
+    struct io_uring_sqe *sqe = get_sqe();
+
+    if (!sqe)
+        return RTP_NOT_READY;
+
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)&msg;
+    sqe->len       = 1;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+
+    return RTP_OK;
+#else
+    (void)fd, (void)group, (void)user_data;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::uring::queue_sendmsg(int fd, const struct msghdr *msg, int flags, uint64_t user_data, bool link)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    struct io_uring_sqe *sqe = get_sqe();
+
+    if (!sqe)
+        return RTP_NOT_READY;
+
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)msg;
+    sqe->len       = 1;
+    sqe->msg_flags = (uint32_t)flags;
+    sqe->flags     = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = user_data;
+
+    return RTP_OK;
+#else
+    (void)fd, (void)msg, (void)flags, (void)user_data, (void)link;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::uring::queue_cancel(uint64_t target, uint64_t user_data)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    struct io_uring_sqe *sqe = get_sqe();
+
+    if (!sqe)
+        return RTP_NOT_READY;
+
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->fd        = -1;
+    sqe->addr      = target;
+    sqe->user_data = user_data;
+
+    return RTP_OK;
+#else
+    (void)target, (void)user_data;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t uvgrtp::uring::received_length(const uint8_t *buffer, bool& truncated)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    auto out = (const struct io_uring_recvmsg_out *)(buffer - RECVMSG_OUT_SIZE);
+
+    truncated = out->flags & MSG_TRUNC;
+    return out->payloadlen;
+#else
+    (void)buffer;
+    truncated = true;
+    return 0;
+#endif
+}
+
+unsigned uvgrtp::uring::pending() const
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    return sq_local_tail_ - *sq_tail_;
+#else
+    return 0;
+#endif
+}
+
+rtp_error_t uvgrtp::uring::submit_and_wait(unsigned wait_nr, int timeout_ms)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    unsigned to_submit = pending();
+
+    // publish the queued entries to the kernel
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+
+    if (wait_nr && timeout_ms >= 0) {
+        ts.tv_sec  = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts         = (uint64_t)(uintptr_t)&ts;
+        flags         |= IORING_ENTER_EXT_ARG;
+    }
+
+    int ret = sys_io_uring_enter(fd_, to_submit, wait_nr, flags,
+        (flags & IORING_ENTER_EXT_ARG) ? &arg : nullptr,
+        (flags & IORING_ENTER_EXT_ARG) ? sizeof(arg) : 0);
+
+    if (ret < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            return RTP_INTERRUPTED;
+
+        LOG_ERROR("io_uring_enter(2) failed: %s", strerror(errno));
+        return RTP_GENERIC_ERROR;
+    }
+
+    return RTP_OK;
+#else
+    (void)wait_nr, (void)timeout_ms;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+bool uvgrtp::uring::next_completion(uint64_t& user_data, int& res, int& buffer_id, bool& more)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    unsigned head = *cq_head_;
+
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        return false;
+
+    auto cqe = &((struct io_uring_cqe *)cqes_)[head & *cq_mask_];
+
+    user_data = cqe->user_data;
+    res       = cqe->res;
+    buffer_id = (cqe->flags & IORING_CQE_F_BUFFER) ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    more      = cqe->flags & IORING_CQE_F_MORE;
+
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    (void)user_data, (void)res, (void)buffer_id, (void)more;
+    return false;
+#endif
+}
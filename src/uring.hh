@@ -0,0 +1,126 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#if defined(__linux__) && !defined(__RTP_NO_IO_URING__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+
+/* multishot receive is the newest feature the backend needs */
+#ifdef IORING_RECV_MULTISHOT
+#define UVGRTP_HAVE_IO_URING 1
+#endif
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+struct msghdr;
+
+namespace uvgrtp {
+
+    /* Minimal io_uring(7) instance driven with raw system calls, used by the socket
+     * to send packets and by reception flow to receive packets when RCE_IO_URING is given.
+     *
+     * The instance is not thread safe, it must be used from one thread at a time.
+     *
+     * If uvgRTP has been compiled without io_uring support (or with -D__RTP_NO_IO_URING__),
+     * init() returns RTP_NOT_SUPPORTED and the callers fall back to the regular system calls */
+    class uring {
+        public:
+            /* Buffers of the provided buffer ring are given to the kernel with this size
+             * prefix so that the received datagram starts exactly at the buffer pointer */
+            static const size_t RECVMSG_OUT_SIZE = 16;
+
+            uring();
+            ~uring();
+
+            /* Create the io_uring instance with "entries" submission queue entries
+             * and "cq_entries" completion queue entries
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if io_uring is not available */
+            rtp_error_t init(unsigned entries, unsigned cq_entries);
+
+            /* Register a ring of "entries" provided buffers as buffer group "group".
+             * "entries" must be a power of two
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the kernel does not support provided buffer rings */
+            rtp_error_t register_buffer_ring(uint16_t group, unsigned entries);
+
+            /* Give "buffer" to the kernel for receiving. The kernel writes a
+             * RECVMSG_OUT_SIZE-byte header in front of "buffer" so that many bytes
+             * before it must be writable. Buffers are published with commit_buffers() */
+            void provide_buffer(uint8_t *buffer, uint32_t len, uint16_t bid);
+            void commit_buffers();
+
+            /* Queue a multishot recvmsg(2) of "fd" that receives to the provided buffers of "group" */
+            rtp_error_t queue_multishot_recv(int fd, uint16_t group, uint64_t user_data);
+
+            /* Queue a sendmsg(2) of "msg" to "fd" with "flags". If "link" is true,
+             * the next queued operation is not started until this one has completed
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_READY if the submission queue is full */
+            rtp_error_t queue_sendmsg(int fd, const struct msghdr *msg, int flags, uint64_t user_data, bool link);
+
+            /* Submit the queued operations and wait until "wait_nr" operations have completed
+             * or "timeout_ms" milliseconds have passed. Negative "timeout_ms" waits forever
+             *
+             * Return RTP_OK on success
+             * Return RTP_INTERRUPTED if the wait timed out or was interrupted
+             * Return RTP_GENERIC_ERROR on error */
+            rtp_error_t submit_and_wait(unsigned wait_nr, int timeout_ms);
+
+            /* Fetch the next completion. Returns false if there are none.
+             * "buffer_id" is set if the completion consumed a provided buffer, otherwise it's -1 and
+             * "more" tells whether a multishot operation stays armed */
+            bool next_completion(uint64_t& user_data, int& res, int& buffer_id, bool& more);
+
+            /* Queue cancellation of the operation identified by "target" */
+            rtp_error_t queue_cancel(uint64_t target, uint64_t user_data);
+
+            /* Return how many operations have been queued but not yet submitted */
+            unsigned pending() const;
+
+            /* Return the length of the datagram received to provided buffer "buffer"
+             * and set "truncated" if it did not fit into the buffer */
+            static uint32_t received_length(const uint8_t *buffer, bool& truncated);
+
+        private:
+            void release();
+
+#ifdef UVGRTP_HAVE_IO_URING
+            struct io_uring_sqe *get_sqe();
+#endif
+
+            int fd_;
+
+            void *sq_ring_;
+            void *cq_ring_;
+            void *sqes_;
+            size_t sq_ring_size_;
+            size_t cq_ring_size_;
+            size_t sqes_size_;
+
+            unsigned *sq_head_;
+            unsigned *sq_tail_;
+            unsigned *sq_mask_;
+            unsigned *sq_array_;
+            unsigned *cq_head_;
+            unsigned *cq_tail_;
+            unsigned *cq_mask_;
+            void *cqes_;
+
+            unsigned sq_local_tail_;
+            unsigned sq_entries_;
+
+            /* provided buffer ring */
+            void *buf_ring_;
+            size_t buf_ring_size_;
+            unsigned buf_ring_mask_;
+            uint16_t buf_ring_tail_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
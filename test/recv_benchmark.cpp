@@ -0,0 +1,149 @@
+/* Measures how many packets per second the receiver reads from a UDP socket and how many
+ * receive system calls it needs per packet when the datagrams are read one at a time and
+ * in batches of RCC_UDP_RCV_BATCH_SIZE. The socket is read the same way the reception
+ * flow reads it: poll(2) and then recvfrom() with MSG_DONTWAIT until the socket is drained.
+ *
+ * Usage: uvgrtp_recv_benchmark [packets] [batch size]
+ *
+ * The packets are sent over the loopback interface as fast as possible by another thread */
+
+#include "uvgrtp/socket.hh"
+
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+constexpr size_t DEFAULT_PACKETS    = 1000000;
+constexpr size_t DEFAULT_BATCH_SIZE = 32; // default of RCC_UDP_RCV_BATCH_SIZE
+constexpr size_t PACKET_SIZE        = 1200;
+constexpr size_t SEND_BATCH_SIZE    = 64;
+constexpr int    RECV_BUFFER_SIZE   = 8 * 1024 * 1024;
+constexpr short  BENCHMARK_PORT     = 9400;
+
+struct result {
+    size_t received = 0;
+    size_t syscalls = 0;
+    double elapsed  = 0; // seconds from the first to the last received packet
+};
+
+static void send_packets(size_t packets)
+{
+    uvgrtp::socket sender(0);
+
+    if (sender.init(AF_INET, SOCK_DGRAM, 0) != RTP_OK)
+        return;
+
+    sockaddr_in addr = sender.create_sockaddr(AF_INET, "127.0.0.1", BENCHMARK_PORT);
+    std::vector<uint8_t> payload(PACKET_SIZE, 'a');
+    std::vector<struct iovec> chunks(SEND_BATCH_SIZE);
+    std::vector<struct mmsghdr> headers(SEND_BATCH_SIZE);
+
+    for (size_t i = 0; i < SEND_BATCH_SIZE; ++i) {
+        chunks[i].iov_base = payload.data();
+        chunks[i].iov_len  = payload.size();
+
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_name    = &addr;
+        headers[i].msg_hdr.msg_namelen = sizeof(addr);
+        headers[i].msg_hdr.msg_iov     = &chunks[i];
+        headers[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    for (size_t sent = 0; sent < packets; sent += SEND_BATCH_SIZE)
+        (void)sender.sendto(headers.data(), std::min(SEND_BATCH_SIZE, packets - sent), 0);
+}
+
+static bool benchmark(size_t packets, size_t batch_size, result& res)
+{
+    uvgrtp::socket receiver(0);
+
+    if (receiver.init(AF_INET, SOCK_DGRAM, 0) != RTP_OK ||
+        receiver.setsockopt(SOL_SOCKET, SO_RCVBUF, &RECV_BUFFER_SIZE, sizeof(RECV_BUFFER_SIZE)) != RTP_OK ||
+        receiver.bind(AF_INET, INADDR_ANY, BENCHMARK_PORT) != RTP_OK)
+        return false;
+
+    std::vector<uint8_t> memory(batch_size * PACKET_SIZE);
+    uvgrtp::pkt_vec buffers(batch_size);
+    std::vector<int> sizes(batch_size);
+
+    for (size_t i = 0; i < batch_size; ++i)
+        buffers[i].emplace_back(PACKET_SIZE, memory.data() + i * PACKET_SIZE);
+
+    std::atomic<bool> done(false);
+    std::thread sender([&]() {
+        send_packets(packets);
+        done = true;
+    });
+
+    struct pollfd pfds;
+    pfds.fd     = receiver.get_raw_socket();
+    pfds.events = POLLIN;
+
+    std::chrono::steady_clock::time_point first, last;
+
+    for (;;) {
+        pfds.revents = 0;
+
+        // the sender has finished and the socket stayed empty, nothing more is coming
+        if (poll(&pfds, 1, 100) <= 0) {
+            if (done)
+                break;
+            continue;
+        }
+
+        for (;;) {
+            int npkts = 0;
+            rtp_error_t ret = receiver.recvfrom(buffers, MSG_DONTWAIT, sizes.data(), &npkts);
+
+            ++res.syscalls;
+
+            if (ret != RTP_OK || npkts <= 0)
+                break;
+
+            last = std::chrono::steady_clock::now();
+            if (res.received == 0)
+                first = last;
+
+            res.received += (size_t)npkts;
+        }
+    }
+
+    sender.join();
+    res.elapsed = std::chrono::duration<double>(last - first).count();
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t packets    = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_PACKETS;
+    size_t batch_size = argc > 2 ? strtoul(argv[2], nullptr, 10) : DEFAULT_BATCH_SIZE;
+
+    if (!packets || !batch_size) {
+        fprintf(stderr, "Usage: %s [packets] [batch size]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu packets of %zu bytes\n", packets, PACKET_SIZE);
+
+    for (size_t size : { (size_t)1, batch_size }) {
+        result res;
+
+        if (!benchmark(packets, size, res)) {
+            fprintf(stderr, "Failed to create the receiving socket\n");
+            return EXIT_FAILURE;
+        }
+
+        printf("  batch %-4zu %10.0f packets/s %6.3f receive system calls/packet (%zu dropped)\n",
+               size, res.elapsed > 0 ? res.received / res.elapsed : 0.0,
+               res.received ? (double)res.syscalls / res.received : 0.0, packets - res.received);
+    }
+
+    return EXIT_SUCCESS;
+}
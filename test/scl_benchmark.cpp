@@ -0,0 +1,129 @@
+/* Measures how fast the start code lookup (SCL) implementations find the NAL units of
+ * Annex B streams and checks that all of them find the same NAL units.
+ *
+ * Usage: uvgrtp_scl_benchmark [stream.264|stream.265|stream.266 ...]
+ *
+ * Without arguments a synthetic intra-only stream is generated */
+
+#include "formats/scl.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr size_t SYNTHETIC_STREAM_SIZE = 64 * 1024 * 1024;
+constexpr double MIN_MEASUREMENT_TIME = 0.5; // seconds
+
+static std::vector<uint8_t> read_stream(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/* Large slices with a few parameter sets between them, emulation prevention applied to the payload */
+static std::vector<uint8_t> synthetic_stream()
+{
+    std::mt19937 rng(1337);
+    std::uniform_int_distribution<size_t> slice_size(16 * 1024, 512 * 1024);
+    std::vector<uint8_t> stream;
+
+    stream.reserve(SYNTHETIC_STREAM_SIZE + 1024 * 1024);
+
+    while (stream.size() < SYNTHETIC_STREAM_SIZE) {
+        size_t nal_size = (rng() % 8 == 0) ? 32 : slice_size(rng);
+        size_t zeros    = 0;
+
+        stream.insert(stream.end(), { 0, 0, 0, 1 });
+
+        for (size_t i = 0; i < nal_size; ++i) {
+            // random payload has a realistic amount of zero bytes
+            uint8_t byte = (rng() % 16 == 0) ? 0 : (uint8_t)rng();
+
+            if (zeros >= 2 && byte <= 3) {
+                stream.push_back(3);
+                zeros = 0;
+            }
+
+            stream.push_back(byte);
+            zeros = (byte == 0) ? zeros + 1 : 0;
+        }
+
+        // a NAL unit never ends with a zero byte
+        if (stream.back() == 0)
+            stream.back() = 0x80;
+    }
+
+    return stream;
+}
+
+static std::vector<ssize_t> find_nal_units(uvgrtp::formats::scl::finder_t find, const std::vector<uint8_t>& stream)
+{
+    std::vector<ssize_t> nals;
+    uint8_t start_len = 0;
+    ssize_t offset    = find(stream.data(), stream.size(), 0, start_len);
+
+    while (offset > -1) {
+        nals.push_back(offset * 8 + start_len);
+        offset = find(stream.data(), stream.size(), (size_t)offset, start_len);
+    }
+
+    return nals;
+}
+
+static bool benchmark(const std::string& name, const std::vector<uint8_t>& stream)
+{
+    auto impls = uvgrtp::formats::scl::implementations();
+    auto reference = find_nal_units(impls.front().find, stream);
+    bool ok = true;
+
+    printf("%s: %zu bytes, %zu NAL units\n", name.c_str(), stream.size(), reference.size());
+
+    for (auto& impl : impls) {
+        if (find_nal_units(impl.find, stream) != reference) {
+            printf("  %-8s found different NAL units than %s!\n", impl.name, impls.front().name);
+            ok = false;
+            continue;
+        }
+
+        size_t rounds = 0;
+        double elapsed = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        do {
+            (void)find_nal_units(impl.find, stream);
+            ++rounds;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < MIN_MEASUREMENT_TIME);
+
+        printf("  %-8s %8.2f GB/s\n", impl.name, (double)stream.size() * rounds / elapsed / 1e9);
+    }
+
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    bool ok = true;
+
+    if (argc < 2)
+        ok = benchmark("synthetic", synthetic_stream());
+
+    for (int i = 1; i < argc; ++i) {
+        std::vector<uint8_t> stream = read_stream(argv[i]);
+
+        if (stream.empty()) {
+            fprintf(stderr, "Failed to read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        ok = benchmark(argv[i], stream) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+/* Measures the cost of building and sending the packets of a fragmented frame per packet
+ * with the packet arrays of the transaction and with the vectors used before them, where each
+ * packet was built into its own buf_vec and the socket translated the frame into freshly
+ * allocated message headers when it was sent.
+ *
+ * Usage: uvgrtp_send_benchmark [packets per frame]
+ *
+ * The packets are sent to a port nobody listens to on the loopback interface */
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/socket.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr size_t DEFAULT_PACKETS = 100;
+constexpr size_t PAYLOAD_SIZE    = 1000;
+constexpr double MIN_MEASUREMENT_TIME = 0.5; // seconds
+constexpr short  BENCHMARK_PORT  = 9500;
+
+// the last message built, so that building the messages without sending them is not optimized away
+static void *volatile last_message = nullptr;
+
+struct frame_data {
+    std::vector<uint8_t> payload;
+    std::vector<uvgrtp::frame::rtp_header> rtp_headers;
+    sockaddr_in addr;
+
+    /* kept from frame to frame like the arrays of a recycled transaction */
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> chunks;
+};
+
+/* Before: a buf_vec per packet collected into a pkt_vec, translated to message headers when sent */
+static void send_vectors(uvgrtp::socket& socket, frame_data& frame, bool send)
+{
+    uvgrtp::pkt_vec packets;
+
+    for (size_t i = 0; i < frame.rtp_headers.size(); ++i) {
+        uvgrtp::buf_vec tmp;
+
+        tmp.push_back({ sizeof(frame.rtp_headers[i]), (uint8_t *)&frame.rtp_headers[i] });
+        tmp.push_back({ PAYLOAD_SIZE, frame.payload.data() + i * PAYLOAD_SIZE });
+        packets.push_back(tmp);
+    }
+
+    struct mmsghdr *headers = new struct mmsghdr[packets.size()];
+
+    for (size_t i = 0; i < packets.size(); ++i) {
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_iov     = new struct iovec[packets[i].size()];
+        headers[i].msg_hdr.msg_iovlen  = packets[i].size();
+        headers[i].msg_hdr.msg_name    = (void *)&frame.addr;
+        headers[i].msg_hdr.msg_namelen = sizeof(frame.addr);
+
+        for (size_t k = 0; k < packets[i].size(); ++k) {
+            headers[i].msg_hdr.msg_iov[k].iov_len  = packets[i][k].first;
+            headers[i].msg_hdr.msg_iov[k].iov_base = packets[i][k].second;
+        }
+    }
+
+    last_message = &headers[packets.size() - 1];
+
+    if (send)
+        (void)socket.sendto(headers, packets.size(), 0);
+
+    for (size_t i = 0; i < packets.size(); ++i)
+        delete[] headers[i].msg_hdr.msg_iov;
+    delete[] headers;
+}
+
+/* Now: the packets are written to arrays that the transaction keeps from frame to frame */
+static void send_arrays(uvgrtp::socket& socket, frame_data& frame, bool send)
+{
+    size_t packets = frame.rtp_headers.size();
+
+    for (size_t i = 0; i < packets; ++i) {
+        struct iovec *first = &frame.chunks[2 * i];
+
+        first[0].iov_base = &frame.rtp_headers[i];
+        first[0].iov_len  = sizeof(frame.rtp_headers[i]);
+        first[1].iov_base = frame.payload.data() + i * PAYLOAD_SIZE;
+        first[1].iov_len  = PAYLOAD_SIZE;
+
+        struct msghdr& msg = frame.headers[i].msg_hdr;
+
+        msg.msg_name       = (void *)&frame.addr;
+        msg.msg_namelen    = sizeof(frame.addr);
+        msg.msg_iov        = first;
+        msg.msg_iovlen     = 2;
+        msg.msg_control    = nullptr;
+        msg.msg_controllen = 0;
+        msg.msg_flags      = 0;
+    }
+
+    last_message = &frame.headers[packets - 1];
+
+    if (send)
+        (void)socket.sendto(frame.headers.data(), packets, 0);
+}
+
+/* Return the time per packet in nanoseconds */
+static double measure(void (*build)(uvgrtp::socket&, frame_data&, bool), uvgrtp::socket& socket,
+    frame_data& frame, bool send)
+{
+    size_t rounds  = 0;
+    double elapsed = 0;
+    auto start     = std::chrono::steady_clock::now();
+
+    do {
+        build(socket, frame, send);
+        ++rounds;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < MIN_MEASUREMENT_TIME);
+
+    return elapsed * 1e9 / (rounds * frame.rtp_headers.size());
+}
+
+int main(int argc, char **argv)
+{
+    size_t packets = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_PACKETS;
+
+    if (!packets) {
+        fprintf(stderr, "Usage: %s [packets per frame]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uvgrtp::socket socket(0);
+
+    if (socket.init(AF_INET, SOCK_DGRAM, 0) != RTP_OK) {
+        fprintf(stderr, "Failed to create the socket\n");
+        return EXIT_FAILURE;
+    }
+
+    frame_data frame;
+    frame.payload.assign(packets * PAYLOAD_SIZE, 'a');
+    frame.rtp_headers.resize(packets);
+    frame.headers.resize(packets);
+    frame.chunks.resize(2 * packets);
+    frame.addr = socket.create_sockaddr(AF_INET, "127.0.0.1", BENCHMARK_PORT);
+
+    printf("Frames of %zu packets of %zu bytes, ns per packet\n", packets, PAYLOAD_SIZE);
+    printf("  %-8s %10s %14s\n", "", "build", "build + send");
+
+    printf("  %-8s %10.1f %14.1f\n", "vectors",
+           measure(send_vectors, socket, frame, false), measure(send_vectors, socket, frame, true));
+    printf("  %-8s %10.1f %14.1f\n", "arrays",
+           measure(send_arrays, socket, frame, false), measure(send_arrays, socket, frame, true));
+
+    return EXIT_SUCCESS;
+}
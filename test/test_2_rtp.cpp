@@ -1,5 +1,7 @@
 #include "test_common.hh"
 
+#include <atomic>
+
 
 // TODO: 1) Test only sending, 2) test sending with different configuration, 3) test receiving with different configurations, and 
 // 4) test sending and receiving within same test while checking frame size
@@ -171,12 +173,68 @@ TEST(RTPTests, rtp_poll)
     cleanup_sess(ctx, sess);
 }
 
-TEST(RTPTests, send_too_much)
+TEST(RTPTests, rtp_pull_frame_blocking)
 {
-    // Tests sending large amounts of data to make sure nothing breaks because of it
+    // Tests that pull_frame() without a timeout wakes up for a frame and that frames are pulled in order
+    std::cout << "Starting RTP blocking pull_frame test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-    // TODO: Everything should actually be received even in this case but it probably isn't at the moment
-    std::cout << "Starting RTP send too much test" << std::endl;
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        const int test_packets = 10;
+        std::vector<uvgrtp::frame::rtp_frame*> received;
+
+        std::thread puller([&] {
+            for (int i = 0; i < test_packets; ++i)
+            {
+                uvgrtp::frame::rtp_frame* frame = receiver->pull_frame();
+                EXPECT_NE(nullptr, frame);
+
+                if (frame)
+                    received.push_back(frame);
+            }
+        });
+
+        // make sure the puller is already waiting when the frames arrive
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        send_packets(sess, sender, test_packets, 1000, 1, true, false);
+        puller.join();
+
+        EXPECT_EQ(test_packets, received.size());
+        for (size_t i = 0; i < received.size(); ++i)
+        {
+            if (i > 0)
+            {
+                EXPECT_EQ((uint16_t)(received[i - 1]->header.seq + 1), received[i]->header.seq);
+            }
+        }
+
+        for (auto& frame : received)
+        {
+            process_rtp_frame(frame);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_recv_batch)
+{
+    // Tests receiving with different amounts of datagrams read per system call
+    std::cout << "Starting RTP receive batch test" << std::endl;
     uvgrtp::context ctx;
     uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
@@ -184,23 +242,1462 @@ TEST(RTPTests, send_too_much)
     uvgrtp::media_stream* receiver = nullptr;
 
     int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
 
-    EXPECT_NE(nullptr, sess);
+    EXPECT_NE(nullptr, receiver);
+    if (receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_UDP_RCV_BATCH_SIZE, 0));
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BATCH_SIZE, 1));
+        test_packet_size(10, 5000, sess, sender, receiver);
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BATCH_SIZE, 256));
+        test_packet_size(10, 5000, sess, sender, receiver);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_larger_than_mtu)
+{
+    // Tests that datagrams larger than the MTU configured for the receiver are still received
+    std::cout << "Starting RTP larger than MTU test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_NO_FLAGS;
     if (sess)
     {
         sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
         receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
     }
 
-    add_hook(nullptr, receiver, rtp_receive_hook);
+    EXPECT_NE(nullptr, receiver);
+    if (receiver)
+    {
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, 500));
+        test_packet_size(10, 1000, sess, sender, receiver);
+        test_packet_size(10, 1400, sess, sender, receiver);
+    }
 
-    // send 10000 small packets
-    send_packets(sess, sender, 10000, 1000, 0, true, true);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
 
-    // send 2000 large packets
-    send_packets(sess, sender, 2000, 20000, 2, true, true);
+void slow_receive_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    // simulates an application that does too much work in the receive hook
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    rtp_receive_hook(arg, frame);
+}
+
+TEST(RTPTests, rtp_ring_overflow)
+{
+    // Tests that packets are dropped and counted according to the overflow policy of the reception ring
+    std::cout << "Starting RTP ring overflow test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_NO_FLAGS;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, 3));
+
+        // a ring of only a few jumbo slots. The socket buffer is still large enough to hold all test packets
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, 65507));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 262144));
+        add_hook(nullptr, receiver, slow_receive_hook);
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, RRO_DROP_NEWEST));
+        send_packets(sess, sender, 100, 100, 0, false, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        uint64_t dropped = receiver->get_dropped_packets();
+        EXPECT_GT(dropped, 0u);
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, RRO_DROP_OLDEST));
+        send_packets(sess, sender, 100, 100, 0, false, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        EXPECT_GT(receiver->get_dropped_packets(), dropped);
+        dropped = receiver->get_dropped_packets();
+
+        Test_receiver* tester = new Test_receiver(100);
+        add_hook(tester, receiver, slow_receive_hook);
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, RRO_BLOCK));
+        send_packets(sess, sender, 100, 100, 0, false, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        EXPECT_EQ(dropped, receiver->get_dropped_packets());
+        tester->gotAll();
+        delete tester;
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_zero_copy_receive)
+{
+    // Tests that frames received without copying stay intact while the application holds them
+    // and that their reception buffers are reused once they are deallocated
+    std::cout << "Starting RTP zero-copy receive test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_ZERO_COPY_RECEIVE);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        // a ring of four slots so that the held frames leave only one slot for new packets
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, 65507));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 262144));
+
+        const int held_packets = 3;
+        std::vector<uvgrtp::frame::rtp_frame*> held;
+
+        send_packets(sess, sender, held_packets, 1000, 0, true, false);
+
+        for (int i = 0; i < held_packets; ++i)
+        {
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+            EXPECT_NE(nullptr, frame);
+
+            if (frame)
+                held.push_back(frame);
+        }
+
+        // the remaining slot is enough when frames are released right away
+        test_packet_size(10, 1000, sess, sender, receiver);
+
+        for (auto& frame : held)
+        {
+            EXPECT_EQ(1000, frame->payload_len);
+            EXPECT_EQ('b', frame->payload[frame->payload_len - 1]);
+
+            // the payload lives in the datagram so the datagram must not have been overwritten
+            EXPECT_EQ(frame->header.seq, (frame->dgram[2] << 8) | frame->dgram[3]);
+            process_rtp_frame(frame);
+        }
+
+        EXPECT_EQ(0, receiver->get_dropped_packets());
+        test_packet_size(10, 1000, sess, sender, receiver);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_frames_outlive_stream)
+{
+    // Tests that received frames can still be used and deallocated after the receiving stream is destroyed
+    std::cout << "Starting RTP frames outlive stream test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    std::vector<uvgrtp::frame::rtp_frame*> held;
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        send_packets(sess, sender, 10, 1000, 0, true, false);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while ((frame = receiver->pull_frame(100)) != nullptr)
+        {
+            held.push_back(frame);
+        }
+
+        EXPECT_EQ(10, held.size());
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+
+    for (auto& frame : held)
+    {
+        EXPECT_EQ(1000, frame->payload_len);
+        EXPECT_EQ('b', frame->payload[frame->payload_len - 1]);
+        process_rtp_frame(frame);
+    }
+}
+
+TEST(RTPTests, rtp_io_runtime)
+{
+    // Tests that media streams can be served by the shared I/O runtime of the context
+    std::cout << "Starting RTP I/O runtime test" << std::endl;
+    uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.enable_io_runtime(0));
+    EXPECT_EQ(RTP_OK, ctx.enable_io_runtime(2));
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.enable_io_runtime(2));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    if (sess)
+    {
+        sender1 = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver1 = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        sender2 = sess->create_stream(RECEIVE_PORT + 4, SEND_PORT + 4, RTP_FORMAT_GENERIC, RCE_RTCP);
+        receiver2 = sess->create_stream(SEND_PORT + 4, RECEIVE_PORT + 4, RTP_FORMAT_GENERIC, RCE_RTCP);
+    }
+
+    test_packet_size(10, 5000, sess, sender1, receiver1);
+    test_packet_size(10, 1000, sess, sender2, receiver2);
+
+    cleanup_ms(sess, sender1);
+    cleanup_ms(sess, receiver1);
+    cleanup_ms(sess, sender2);
+    cleanup_ms(sess, receiver2);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_io_uring)
+{
+    // Tests sending and receiving with io_uring, falls back to regular system calls if it's not available
+    std::cout << "Starting RTP io_uring test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_IO_URING | RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags | RCE_ZERO_COPY_RECEIVE);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        send_packets(sess, sender, 10, 1000, 0, true, false);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        int received = 0;
+
+        while ((frame = receiver->pull_frame(100)) != nullptr)
+        {
+            EXPECT_EQ(1000, frame->payload_len);
+            process_rtp_frame(frame);
+            ++received;
+        }
+
+        EXPECT_EQ(10, received);
+    }
+
+    test_packet_size(10, 5000, sess, sender, receiver);
 
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
-}
\ No newline at end of file
+}
+
+#ifdef __linux__
+TEST(RTPTests, rtp_udp_gro)
+{
+    // Tests that packets the kernel has coalesced with UDP GRO are split back to RTP packets.
+    // The packets are sent as one UDP GSO datagram which loopback delivers to the receiver as is
+    std::cout << "Starting RTP UDP GRO test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_UDP_GRO);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    int segment = 1000;
+    bool gso = raw.set_segment_size(segment);
+
+    if (receiver && gso)
+    {
+        const int packets = 20;
+        const size_t last_size = 500;
+        std::vector<uint8_t> datagram;
+
+        for (int i = 0; i < packets; ++i)
+        {
+            size_t size = (i == packets - 1) ? last_size : (size_t)segment;
+            std::vector<uint8_t> packet = create_rtp_packet((uint16_t)(1000 + i), 90000, false,
+                std::vector<uint8_t>(size - uvgrtp::frame::HEADER_SIZE_RTP, (uint8_t)i));
+
+            datagram.insert(datagram.end(), packet.begin(), packet.end());
+        }
+
+        raw.send(datagram);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        int received = 0;
+
+        while ((frame = receiver->pull_frame(100)) != nullptr)
+        {
+            size_t size = (received == packets - 1) ? last_size : (size_t)segment;
+
+            EXPECT_EQ(1000 + received, frame->header.seq);
+            EXPECT_EQ(size - uvgrtp::frame::HEADER_SIZE_RTP, frame->payload_len);
+            EXPECT_EQ(received, frame->payload[frame->payload_len - 1]);
+
+            process_rtp_frame(frame);
+            ++received;
+        }
+
+        EXPECT_EQ(packets, received);
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+#endif
+
+TEST(RTPTests, rtp_udp_gso)
+{
+    // Tests sending fragmented frames with UDP GSO, both to a receiver that gets the packets
+    // one by one and to one that gets them coalesced with UDP GRO
+    std::cout << "Starting RTP UDP GSO test" << std::endl;
+
+    for (int receiver_flags : { 0, (int)RCE_UDP_GRO })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+        uvgrtp::media_stream* sender = nullptr;
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_UDP_GSO | RCE_FRAGMENT_GENERIC);
+            receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC,
+                receiver_flags | RCE_FRAGMENT_GENERIC);
+        }
+
+        EXPECT_NE(nullptr, receiver);
+        if (sender && receiver)
+        {
+            send_packets(sess, sender, 10, 20000, 0, true, false);
+
+            uvgrtp::frame::rtp_frame* frame = nullptr;
+            int received = 0;
+
+            while ((frame = receiver->pull_frame(100)) != nullptr)
+            {
+                EXPECT_EQ(20000, frame->payload_len);
+                process_rtp_frame(frame);
+                ++received;
+            }
+
+            EXPECT_EQ(10, received);
+        }
+
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+
+TEST(RTPTests, rtp_pacing)
+{
+    // Tests that the packets are spread over time at the pacing rate, both with a budget
+    // of the media stream and with a budget shared by the session, and that a media stream
+    // whose own budget is cleared is paced with the budget of the session again
+    std::cout << "Starting RTP pacing test" << std::endl;
+
+    for (int mode : { 0, 1, 2 })
+    {
+        bool shared = mode > 0;
+
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+        uvgrtp::media_stream* sender = nullptr;
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            if (shared)
+            {
+                EXPECT_EQ(RTP_OK, sess->enable_pacing(8000));
+            }
+
+            sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+            receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        }
+
+        EXPECT_NE(nullptr, receiver);
+        if (sender && receiver)
+        {
+            if (!shared)
+            {
+                EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PACING_RATE, -1));
+                EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PACING_RATE, 8000));
+            }
+            else if (mode == 2)
+            {
+                EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PACING_RATE, 800000));
+                EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PACING_RATE, 0));
+            }
+
+            // 200 kB at 8 Mbit/s takes 200 ms
+            auto start = std::chrono::steady_clock::now();
+            send_packets(sess, sender, 10, 20000, 0, true, false);
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+            EXPECT_GE(elapsed, 180);
+
+            uvgrtp::frame::rtp_frame* frame = nullptr;
+            int received = 0;
+
+            while ((frame = receiver->pull_frame(100)) != nullptr)
+            {
+                EXPECT_EQ(20000, frame->payload_len);
+                process_rtp_frame(frame);
+                ++received;
+            }
+
+            EXPECT_EQ(10, received);
+        }
+
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+
+static std::atomic<int> dispatched_frames(0);
+
+static void dispatcher_dealloc_hook(void* mem)
+{
+    delete[] (uint8_t*)mem;
+    ++dispatched_frames;
+}
+
+TEST(RTPTests, rtp_system_call_dispatcher)
+{
+    // Tests that push_frame() hands the frames to the dispatcher thread and that
+    // raw frames are given to the deallocation hook once they have been sent
+    std::cout << "Starting RTP system call dispatcher test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC,
+            RCE_SYSTEM_CALL_DISPATCHER | RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        const size_t size = 5000;
+        uint8_t stack_frame[size];
+        memset(stack_frame, 'a', size);
+
+        // uvgRTP cannot know when it can release a raw frame without a deallocation hook
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->push_frame(stack_frame, size, RTP_NO_FLAGS));
+
+        // unless it makes a copy of it
+        EXPECT_EQ(RTP_OK, sender->push_frame(stack_frame, size, RTP_COPY));
+        memset(stack_frame, 0, size);
+
+        dispatched_frames = 0;
+        EXPECT_EQ(RTP_OK, sender->install_deallocation_hook(dispatcher_dealloc_hook));
+
+        for (int i = 0; i < 10; ++i)
+        {
+            uint8_t* frame = new uint8_t[size];
+            memset(frame, 'a', size);
+
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame, size, RTP_NO_FLAGS));
+        }
+
+        send_packets(sess, sender, 10, size, 0, false, false);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        int received = 0;
+
+        while ((frame = receiver->pull_frame(100)) != nullptr)
+        {
+            EXPECT_EQ(size, frame->payload_len);
+            EXPECT_EQ(received < 11 ? 'a' : 'b', frame->payload[0]);
+            EXPECT_EQ(frame->payload[0], frame->payload[size - 1]);
+
+            process_rtp_frame(frame);
+            ++received;
+        }
+
+        EXPECT_EQ(21, received);
+        EXPECT_EQ(10, dispatched_frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+static std::atomic<int> zerocopy_frames(0);
+
+static void zerocopy_dealloc_hook(void* mem)
+{
+    delete[] (uint8_t*)mem;
+    ++zerocopy_frames;
+}
+
+TEST(RTPTests, rtp_zerocopy_send)
+{
+    // Tests that large frames sent with MSG_ZEROCOPY arrive intact and that they are given to the
+    // deallocation hook only after the kernel is done with them, with and without UDP GSO
+    std::cout << "Starting RTP zero-copy send test" << std::endl;
+
+    for (int gso_flags : { 0, (int)RCE_UDP_GSO })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+        uvgrtp::media_stream* sender = nullptr;
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC,
+                gso_flags | RCE_ZEROCOPY_SEND | RCE_FRAGMENT_GENERIC);
+            receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        }
+
+        EXPECT_NE(nullptr, sender);
+        EXPECT_NE(nullptr, receiver);
+        if (sender && receiver)
+        {
+            const size_t size = 50000;
+            zerocopy_frames = 0;
+
+            EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_ZEROCOPY_THRESHOLD, -1));
+            EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_ZEROCOPY_THRESHOLD, 20000));
+
+            // frames below the threshold and raw frames without a deallocation hook are copied
+            uint8_t small_frame[1000];
+            memset(small_frame, 'a', sizeof(small_frame));
+            EXPECT_EQ(RTP_OK, sender->push_frame(small_frame, sizeof(small_frame), RTP_NO_FLAGS));
+
+            EXPECT_EQ(RTP_OK, sender->install_deallocation_hook(zerocopy_dealloc_hook));
+
+            for (int i = 0; i < 10; ++i)
+            {
+                uint8_t* frame = new uint8_t[size];
+                memset(frame, 'a' + i, size);
+
+                EXPECT_EQ(RTP_OK, sender->push_frame(frame, size, RTP_NO_FLAGS));
+            }
+
+            send_packets(sess, sender, 10, size, 0, false, false);
+
+            uvgrtp::frame::rtp_frame* frame = nullptr;
+            int received = 0;
+
+            while ((frame = receiver->pull_frame(100)) != nullptr)
+            {
+                if (received == 0)
+                {
+                    EXPECT_EQ(sizeof(small_frame), frame->payload_len);
+                }
+                else
+                {
+                    uint8_t expected = received <= 10 ? (uint8_t)('a' + received - 1) : 'b';
+
+                    EXPECT_EQ(size, frame->payload_len);
+                    EXPECT_EQ(expected, frame->payload[0]);
+                    EXPECT_EQ(expected, frame->payload[size - 1]);
+                }
+
+                process_rtp_frame(frame);
+                ++received;
+            }
+
+            EXPECT_EQ(21, received);
+        }
+
+        // the frames still waiting for the kernel are released when the media stream is destroyed
+        cleanup_ms(sess, sender);
+        EXPECT_EQ(10, zerocopy_frames);
+
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+
+static std::atomic<int> chained_frames(0);
+static uvgrtp::media_stream* chained_sender = nullptr;
+
+static void chained_dealloc_hook(void* mem)
+{
+    delete[] (uint8_t*)mem;
+
+    // the hook is called without any locks of uvgRTP held so it can push the next frame
+    if (++chained_frames < 10)
+    {
+        const size_t size = 50000;
+        uint8_t* frame = new uint8_t[size];
+        memset(frame, 'a' + chained_frames, size);
+
+        EXPECT_EQ(RTP_OK, chained_sender->push_frame(frame, size, RTP_NO_FLAGS));
+    }
+}
+
+TEST(RTPTests, rtp_dealloc_hook_push)
+{
+    // Tests that the deallocation hook can push the next frame, both when the frames are sent
+    // by the dispatcher thread and when they are released after the kernel completes MSG_ZEROCOPY
+    std::cout << "Starting RTP deallocation hook push test" << std::endl;
+
+    for (int send_flags : { (int)RCE_SYSTEM_CALL_DISPATCHER, (int)RCE_ZEROCOPY_SEND })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+        uvgrtp::media_stream* sender = nullptr;
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC,
+                send_flags | RCE_FRAGMENT_GENERIC);
+            receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        }
+
+        EXPECT_NE(nullptr, sender);
+        EXPECT_NE(nullptr, receiver);
+        if (sender && receiver)
+        {
+            const size_t size = 50000;
+            chained_frames = 0;
+            chained_sender = sender;
+
+            EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_ZEROCOPY_THRESHOLD, 20000));
+            EXPECT_EQ(RTP_OK, sender->install_deallocation_hook(chained_dealloc_hook));
+
+            uint8_t* first = new uint8_t[size];
+            memset(first, 'a', size);
+            EXPECT_EQ(RTP_OK, sender->push_frame(first, size, RTP_NO_FLAGS));
+
+            uvgrtp::frame::rtp_frame* frame = nullptr;
+            int received = 0;
+
+            // with MSG_ZEROCOPY, the completions are processed when the next frame is pushed
+            for (int i = 0; i < 20 && chained_frames < 10; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+                uint8_t* filler = new uint8_t[size];
+                memset(filler, 'z', size);
+                EXPECT_EQ(RTP_OK, sender->push_frame(filler, size, RTP_NO_FLAGS));
+            }
+
+            while ((frame = receiver->pull_frame(100)) != nullptr)
+            {
+                EXPECT_EQ(size, frame->payload_len);
+                process_rtp_frame(frame);
+                ++received;
+            }
+
+            EXPECT_LE(10, chained_frames);
+            EXPECT_LE(10, received);
+        }
+
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+
+TEST(RTPTests, rtp_frame_limits)
+{
+    // Tests that frames are limited to RCC_MAX_FRAME_PACKETS packets and that
+    // the frames within the limit are sent without keeping any packet arrays for reuse
+    std::cout << "Starting RTP frame limits test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    const size_t payload_size = 1000;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        // the payload size is the MTU without the Ethernet, IPv4, UDP and RTP headers
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_MAX_FRAME_PACKETS, 0));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MAX_FRAME_PACKETS, 20));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FRAME_CACHE_SIZE, 0));
+
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[payload_size * 21]);
+        memset(frame.get(), 'a', payload_size * 21);
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), 100, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), payload_size * 20, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_MEMORY_ERROR, sender->push_frame(frame.get(), payload_size * 20 + 1, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), payload_size * 5, RTP_NO_FLAGS));
+
+        size_t expected[] = { 100, payload_size * 20, payload_size * 5 };
+        uvgrtp::frame::rtp_frame* received = nullptr;
+        int frames = 0;
+
+        while ((received = receiver->pull_frame(100)) != nullptr)
+        {
+            if (frames < 3)
+            {
+                EXPECT_EQ(expected[frames], received->payload_len);
+            }
+            process_rtp_frame(received);
+            ++frames;
+        }
+
+        EXPECT_EQ(3, frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_send_batches)
+{
+    // Tests sending frames with more packets than RCC_MAX_FRAME_PACKETS in batches
+    std::cout << "Starting RTP send batches test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    const size_t payload_size = 1000;
+    const size_t frame_size = payload_size * 100 + 1;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MAX_FRAME_PACKETS, 20));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_SEND_BATCH_SIZE, -1));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_SEND_BATCH_SIZE, 16));
+
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+
+        for (size_t i = 0; i < frame_size; ++i)
+            frame[i] = (uint8_t)(i % 251);
+
+        for (int i = 0; i < 5; ++i)
+        {
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, RTP_NO_FLAGS));
+        }
+
+        uvgrtp::frame::rtp_frame* received = nullptr;
+        int frames = 0;
+
+        while ((received = receiver->pull_frame(100)) != nullptr)
+        {
+            EXPECT_EQ(frame_size, received->payload_len);
+            if (received->payload_len == frame_size)
+            {
+                EXPECT_EQ(0, memcmp(frame.get(), received->payload, frame_size));
+            }
+            process_rtp_frame(received);
+            ++frames;
+        }
+
+        EXPECT_EQ(5, frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_zerocopy_send_batches)
+{
+    // Tests frames sent in batches with MSG_ZEROCOPY. The packet arrays grow after the first batches
+    // have been sent and the RTP headers of those packets must stay valid until the kernel is done
+    std::cout << "Starting RTP zero-copy send batches test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    const size_t payload_size = 1000;
+    const size_t frame_size = payload_size * 100 + 1;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC,
+            RCE_ZEROCOPY_SEND | RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, (ssize_t)payload_size + 54));
+
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_ZEROCOPY_THRESHOLD, 20000));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_SEND_BATCH_SIZE, 16));
+        EXPECT_EQ(RTP_OK, sender->install_deallocation_hook(zerocopy_dealloc_hook));
+
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+
+        for (size_t i = 0; i < frame_size; ++i)
+            frame[i] = (uint8_t)(i % 251);
+
+        zerocopy_frames = 0;
+
+        for (int i = 0; i < 5; ++i)
+        {
+            uint8_t* raw = new uint8_t[frame_size];
+            memcpy(raw, frame.get(), frame_size);
+
+            EXPECT_EQ(RTP_OK, sender->push_frame(raw, frame_size, RTP_NO_FLAGS));
+        }
+
+        uvgrtp::frame::rtp_frame* received = nullptr;
+        int frames = 0;
+
+        while ((received = receiver->pull_frame(100)) != nullptr)
+        {
+            EXPECT_EQ(frame_size, received->payload_len);
+            if (received->payload_len == frame_size)
+            {
+                EXPECT_EQ(0, memcmp(frame.get(), received->payload, frame_size));
+            }
+            process_rtp_frame(received);
+            ++frames;
+        }
+
+        EXPECT_EQ(5, frames);
+    }
+
+    cleanup_ms(sess, sender);
+    EXPECT_EQ(5, zerocopy_frames);
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, send_too_much)
+{
+    // Tests sending large amounts of data to make sure nothing breaks because of it
+
+    // TODO: Everything should actually be received even in this case but it probably isn't at the moment
+    std::cout << "Starting RTP send too much test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    add_hook(nullptr, receiver, rtp_receive_hook);
+
+    // send 10000 small packets
+    send_packets(sess, sender, 10000, 1000, 0, true, true);
+
+    // send 2000 large packets
+    send_packets(sess, sender, 2000, 20000, 2, true, true);
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_fan_out)
+{
+    // Tests sending the packets of one media stream to additional destinations
+    std::cout << "Starting RTP fan-out test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t VIEWER_PORTS[] = { RECEIVE_PORT + 2, RECEIVE_PORT + 4 };
+    const size_t frame_size = 5000;
+
+    uvgrtp::media_stream* sender = nullptr;
+    std::vector<uvgrtp::media_stream*> receivers;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receivers.push_back(sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC));
+
+        for (uint16_t port : VIEWER_PORTS)
+            receivers.push_back(sess->create_stream(port, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC));
+    }
+
+    EXPECT_NE(nullptr, sender);
+    if (sender)
+    {
+        for (uint16_t port : VIEWER_PORTS)
+            EXPECT_EQ(RTP_OK, sender->add_destination(REMOTE_ADDRESS, port));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_destination(REMOTE_ADDRESS, VIEWER_PORTS[0]));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_destination("not an address", VIEWER_PORTS[0]));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->remove_destination(REMOTE_ADDRESS, SEND_PORT));
+
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+
+        for (size_t i = 0; i < frame_size; ++i)
+            frame[i] = (uint8_t)(i % 251);
+
+        auto receive = [&](uvgrtp::media_stream* receiver) {
+            int frames = 0;
+            uvgrtp::frame::rtp_frame* received = nullptr;
+
+            while (receiver && (received = receiver->pull_frame(100)) != nullptr)
+            {
+                EXPECT_EQ(frame_size, received->payload_len);
+                if (received->payload_len == frame_size)
+                {
+                    EXPECT_EQ(0, memcmp(frame.get(), received->payload, frame_size));
+                }
+                process_rtp_frame(received);
+                ++frames;
+            }
+
+            return frames;
+        };
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, RTP_NO_FLAGS));
+        }
+
+        for (auto receiver : receivers)
+            EXPECT_EQ(3, receive(receiver));
+
+        // the removed viewer does not get the following frames
+        EXPECT_EQ(RTP_OK, sender->remove_destination(REMOTE_ADDRESS, VIEWER_PORTS[0]));
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, RTP_NO_FLAGS));
+
+        EXPECT_EQ(1, receive(receivers[0]));
+        EXPECT_EQ(0, receive(receivers[1]));
+        EXPECT_EQ(1, receive(receivers[2]));
+    }
+
+    cleanup_ms(sess, sender);
+    for (auto receiver : receivers)
+        cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+#ifdef __linux__
+TEST(RTPTests, rtp_generic_reassembly)
+{
+    // Tests that a fragmented generic frame is reassembled when its fragments arrive out of order
+    // and duplicated, and that incomplete frames do not prevent receiving the frames after them
+    std::cout << "Starting RTP generic reassembly test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        uint16_t seq = 65000;
+
+        auto send_fragment = [&](uint16_t fseq, uint32_t timestamp, bool marker, size_t size, uint8_t value)
+        {
+            raw.send(create_rtp_packet(fseq, timestamp, marker, std::vector<uint8_t>(size, value)));
+        };
+
+        // frames whose other fragments never arrive, more than the receiver reassembles at a time
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            send_fragment(seq, 3000 * i, true, 1000, 0xaa);
+            seq += 10;
+        }
+
+        const std::vector<size_t> sizes = { 1000, 1000, 1000, 1000, 300 };
+        const std::vector<size_t> order = { 0, 0, 3, 2, 4, 1 };
+        std::vector<uint8_t> expected;
+
+        for (size_t i = 0; i < sizes.size(); ++i)
+            expected.insert(expected.end(), sizes[i], (uint8_t)i);
+
+        for (auto i : order)
+            send_fragment((uint16_t)(seq + i), 3000 * 100, i == 0 || i == sizes.size() - 1, sizes[i], (uint8_t)i);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        int received = 0;
+
+        while ((frame = receiver->pull_frame(100)) != nullptr)
+        {
+            EXPECT_EQ(3000u * 100, frame->header.timestamp);
+            EXPECT_TRUE(std::vector<uint8_t>(frame->payload, frame->payload + frame->payload_len) == expected);
+
+            process_rtp_frame(frame);
+            ++received;
+        }
+
+        EXPECT_EQ(1, received);
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_generic_frame_deadline)
+{
+    // Tests that incomplete fragmented frames are dropped after RCC_PKT_MAX_DELAY even if no more
+    // packets arrive, and that the drops are reported to the notify hook
+    std::cout << "Starting RTP generic frame deadline test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+    std::atomic<int> dropped(0);
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PKT_MAX_DELAY, 50));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->install_notify_hook(nullptr, nullptr));
+        EXPECT_EQ(RTP_OK, receiver->install_notify_hook(&dropped, [](void* arg, int reason)
+        {
+            if (reason == NR_FRAME_DROPPED)
+                ++*(std::atomic<int>*)arg;
+        }));
+
+        // the first fragment of each frame, the rest never arrive
+        for (uint32_t i = 0; i < 3; ++i)
+            raw.send(create_rtp_packet((uint16_t)(100 + 10 * i), 3000 * i, true, std::vector<uint8_t>(1000, 0xaa)));
+
+        for (int i = 0; i < 50 && dropped.load() < 3; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        EXPECT_EQ(3, dropped.load());
+        EXPECT_EQ(nullptr, receiver->pull_frame(10));
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_zero_copy_malformed)
+{
+    // Tests that packets with an extension and invalid padding are rejected without freeing
+    // the reception buffer the extension points to when frames are received without copying
+    std::cout << "Starting RTP zero-copy malformed packet test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_ZERO_COPY_RECEIVE);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        // the padding length is zero, larger than the payload and the payload is empty
+        for (size_t padding : { 0, 200, 1 })
+        {
+            // extension of one 32-bit word
+            std::vector<uint8_t> payload = { 0xbe, 0xde, 0, 1, 0x10, 0x20, 0x30, 0x40 };
+
+            if (padding != 1)
+            {
+                payload.insert(payload.end(), 10, 0xaa);
+                payload.back() = (uint8_t)padding;
+            }
+
+            std::vector<uint8_t> packet = create_rtp_packet((uint16_t)(100 + padding), 1000, false, payload);
+            packet[0] |= (1 << 5) | (1 << 4); // padding and extension
+
+            raw.send(packet);
+        }
+
+        raw.send(create_rtp_packet(400, 2000, false, std::vector<uint8_t>(100, 'b')));
+
+        // only the valid packet is received
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+        EXPECT_NE(nullptr, frame);
+
+        if (frame)
+        {
+            EXPECT_EQ(400, frame->header.seq);
+            EXPECT_EQ(100, frame->payload_len);
+            process_rtp_frame(frame);
+        }
+
+        EXPECT_EQ(nullptr, receiver->pull_frame(10));
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_recv_oversized_burst)
+{
+    // Tests that a burst of datagrams larger than the MTU is received completely
+    // when many of them are read with one system call
+    std::cout << "Starting RTP oversized datagram burst test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_ZERO_COPY_RECEIVE);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 262144));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, RRO_BLOCK));
+
+        uint16_t seq = 0;
+
+        auto send_packet = [&](size_t payload_len)
+        {
+            raw.send(create_rtp_packet(seq, 1000 * seq, false, std::vector<uint8_t>(payload_len, (uint8_t)seq)));
+            ++seq;
+        };
+
+        // hold the frames until the receiver has no buffers left and stops reading the socket
+        std::vector<uvgrtp::frame::rtp_frame*> held;
+
+        while (held.size() < 10000)
+        {
+            send_packet(100);
+
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(50);
+
+            if (!frame)
+                break;
+
+            held.push_back(frame);
+        }
+
+        // the burst waits in the socket and is read in batches once the buffers are released
+        const int oversized = 30;
+        const size_t payload_len = 5000;
+        uint16_t first = seq;
+
+        for (int i = 0; i < oversized; ++i)
+            send_packet(payload_len);
+
+        for (auto& frame : held)
+            process_rtp_frame(frame);
+
+        int received = 0;
+
+        while (uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100))
+        {
+            // the packet that found the receiver without buffers
+            if (frame->header.seq == first - 1)
+            {
+                process_rtp_frame(frame);
+                continue;
+            }
+
+            EXPECT_EQ(first + received, frame->header.seq);
+            EXPECT_EQ(payload_len, frame->payload_len);
+            EXPECT_EQ((uint8_t)frame->header.seq, frame->payload[0]);
+            EXPECT_EQ((uint8_t)frame->header.seq, frame->payload[payload_len - 1]);
+
+            ++received;
+            process_rtp_frame(frame);
+        }
+
+        EXPECT_EQ(oversized, received);
+        EXPECT_EQ(0, receiver->get_dropped_packets());
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+struct stalled_receiver {
+    std::atomic<bool> stalled{ true };
+    std::atomic<int> frames{ 0 };
+    std::atomic<int> out_of_order{ 0 };
+    uint16_t last_seq = 0;
+};
+
+static void stalled_receive_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    auto state = (stalled_receiver*)arg;
+
+    // the first frame keeps the processing thread busy so that nothing is taken from the ring
+    while (state->frames == 0 && state->stalled)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    if (state->frames > 0 && (uint16_t)(state->last_seq + 1) != frame->header.seq)
+        ++state->out_of_order;
+
+    state->last_seq = frame->header.seq;
+    ++state->frames;
+    process_rtp_frame(frame);
+}
+
+TEST(RTPTests, rtp_recv_oversized_ring_full)
+{
+    // Tests that datagrams larger than the MTU are dropped when the reception ring is full
+    // even though they do not take a slot of the ring, instead of overwriting unprocessed packets
+    std::cout << "Starting RTP oversized datagram ring full test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    stalled_receiver state;
+
+    if (receiver && raw.is_open())
+    {
+        // a ring of 32 slots of 1472 bytes, the socket can hold more datagrams than that
+        const int ring_capacity = 32;
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 94000));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(&state, stalled_receive_hook));
+
+        const size_t payload_len = 1500;
+        const int oversized = 48;
+
+        for (uint16_t seq = 0; seq <= oversized; ++seq)
+        {
+            raw.send(create_rtp_packet(seq, 1000 * seq, false,
+                std::vector<uint8_t>(seq ? payload_len : 100, (uint8_t)seq)));
+
+            // the processing thread gets stuck with the first packet and the receiver waits for
+            // it, so the rest of the packets are queued in the socket and read at once later
+            if (seq == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        state.stalled = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+        // the first packet, possibly an oversized one read before the receiver started waiting
+        // and at most a full ring of the oversized ones. The newest ones are dropped
+        EXPECT_LT(1, state.frames);
+        EXPECT_GE(2 + ring_capacity, state.frames);
+        EXPECT_EQ(0, state.out_of_order);
+        EXPECT_LT(0, receiver->get_dropped_packets());
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_udp_gro_ring_full)
+{
+    // Tests that coalesced datagrams which find the reception ring full give their slots back.
+    // Segments larger than a slot fill the ring without taking slots, and the coalesced
+    // datagrams that come after them must not use up the slots so that reception continues
+    std::cout << "Starting RTP UDP GRO ring full test" << std::endl;
+
+    for (int policy : { (int)RRO_DROP_NEWEST, (int)RRO_DROP_OLDEST })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_UDP_GRO);
+        }
+
+        EXPECT_NE(nullptr, receiver);
+
+        Raw_sender raw(REMOTE_ADDRESS, SEND_PORT);
+        int segment = 1500;
+        bool gso = raw.set_segment_size(segment);
+
+        stalled_receiver state;
+
+        if (receiver && gso)
+        {
+            // a ring of 32 slots of 1472 bytes
+            const int ring_capacity = 32;
+            EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 94000));
+            EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_OVERFLOW_POLICY, policy));
+            EXPECT_EQ(RTP_OK, receiver->install_receive_hook(&state, stalled_receive_hook));
+
+            // "packets" packets of "size" bytes coalesced to one datagram
+            auto send_datagram = [&](uint16_t seq, int packets, int size) {
+                EXPECT_TRUE(raw.set_segment_size(size));
+
+                std::vector<uint8_t> datagram;
+
+                for (uint16_t i = 0; i < packets; ++i)
+                {
+                    std::vector<uint8_t> packet = create_rtp_packet(seq + i, 1000 * (seq + i), false,
+                        std::vector<uint8_t>(size - uvgrtp::frame::HEADER_SIZE_RTP, 0));
+
+                    datagram.insert(datagram.end(), packet.begin(), packet.end());
+                }
+
+                raw.send(datagram);
+            };
+
+            // the processing thread gets stuck with the first packet and the receiver waits for it
+            // after the second one. Both are larger than a slot so that all slots stay with the receiver
+            send_datagram(0, 1, segment);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            send_datagram(1, 1, segment);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            // segments larger than a slot fill the ring, followed by more coalesced datagrams
+            // than there are slots. These are queued in the socket and read at once later
+            send_datagram(2, ring_capacity, segment);
+
+            for (uint16_t seq = 100; seq < 100 + 4 * ring_capacity; seq += 2)
+                send_datagram(seq, 2, 200);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            state.stalled = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+            EXPECT_LT(0, receiver->get_dropped_packets());
+            int frames = state.frames;
+
+            // packets sent after the ring has been emptied are received
+            for (uint16_t seq = 1000; seq < 1010; ++seq)
+                send_datagram(seq, 1, 100);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            EXPECT_EQ(frames + 10, state.frames);
+        }
+
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+#endif
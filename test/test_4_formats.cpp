@@ -1,5 +1,11 @@
 #include "test_common.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+
 constexpr uint16_t SEND_PORT = 9100;
 constexpr char LOCAL_ADDRESS[] = "127.0.0.1";
 constexpr uint16_t RECEIVE_PORT = 9102;
@@ -55,6 +61,31 @@ TEST(FormatTests, h264)
     cleanup_sess(ctx, sess);
 }
 
+TEST(FormatTests, h264_system_call_dispatcher)
+{
+    // Tests sending h264 frames given as std::unique_ptr from the dispatcher thread
+    std::cout << "Starting h264 system call dispatcher test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H264, RCE_SYSTEM_CALL_DISPATCHER);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H264, RCE_H26X_PREPEND_SC);
+    }
+
+    test_packet_size(10, 1000, sess, sender, receiver);
+    test_packet_size(10, 1446 * 2, sess, sender, receiver);
+    test_packet_size(10, 50000, sess, sender, receiver);
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
 TEST(FormatTests, h265)
 {
     std::cout << "Starting h265 test" << std::endl;
@@ -175,4 +206,796 @@ TEST(FormatTests, h266)
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
-}
\ No newline at end of file
+}
+
+TEST(FormatTests, h265_nal_units)
+{
+    // Tests sending a frame one NAL unit at a time
+    std::cout << "Starting h265 NAL unit test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    ASSERT_NE(sender, nullptr);
+    ASSERT_NE(receiver, nullptr);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_nal(nullptr, 0));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->end_frame());
+
+    const size_t nal_sizes[] = { 100, 5000, 1500 };
+    std::vector<std::unique_ptr<uint8_t[]>> nals;
+
+    for (size_t i = 0; i < 3; ++i) {
+        nals.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[nal_sizes[i]]));
+        uint8_t* nal = nals.back().get();
+
+        // start code followed by a TRAIL_R NAL unit header
+        nal[0] = 0; nal[1] = 0; nal[2] = 0; nal[3] = 1;
+        nal[4] = 1 << 1; nal[5] = 1;
+
+        for (size_t j = 6; j < nal_sizes[i]; ++j)
+            nal[j] = (uint8_t)(i + j);
+    }
+
+    for (int frame = 0; frame < 5; ++frame) {
+        EXPECT_EQ(RTP_OK, sender->begin_frame());
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->begin_frame());
+
+        for (size_t i = 0; i < 3; ++i)
+            EXPECT_EQ(RTP_OK, sender->push_nal(nals[i].get(), nal_sizes[i]));
+
+        EXPECT_EQ(RTP_OK, sender->end_frame());
+
+        uint32_t timestamp = 0;
+
+        for (size_t i = 0; i < 3; ++i) {
+            uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+            ASSERT_NE(received, nullptr);
+
+            // the start code is not sent
+            EXPECT_EQ(nal_sizes[i] - 4, received->payload_len);
+            EXPECT_EQ(0, memcmp(received->payload, nals[i].get() + 4, nal_sizes[i] - 4));
+
+            if (i == 0)
+                timestamp = received->header.timestamp;
+
+            EXPECT_EQ(timestamp, received->header.timestamp);
+            EXPECT_EQ(i == 2, received->header.marker != 0);
+
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_nal_units_many)
+{
+    // Tests that a frame sent one NAL unit at a time may have more packets than RCC_MAX_FRAME_PACKETS
+    // since the packets of the previous NAL units no longer take space once they have been sent
+    std::cout << "Starting h265 many NAL units test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    ASSERT_NE(sender, nullptr);
+    ASSERT_NE(receiver, nullptr);
+
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MAX_FRAME_PACKETS, 20));
+
+    const size_t nal_count = 60;
+    const size_t nal_size = 200;
+    uint8_t nal[nal_size];
+
+    for (int frame = 0; frame < 2; ++frame) {
+        EXPECT_EQ(RTP_OK, sender->begin_frame());
+
+        for (size_t i = 0; i < nal_count; ++i) {
+            // start code followed by a TRAIL_R NAL unit header
+            nal[0] = 0; nal[1] = 0; nal[2] = 0; nal[3] = 1;
+            nal[4] = 1 << 1; nal[5] = 1;
+            memset(nal + 6, (int)i, nal_size - 6);
+
+            EXPECT_EQ(RTP_OK, sender->push_nal(nal, nal_size));
+        }
+
+        EXPECT_EQ(RTP_OK, sender->end_frame());
+
+        for (size_t i = 0; i < nal_count; ++i) {
+            uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+            ASSERT_NE(received, nullptr);
+
+            EXPECT_EQ(nal_size - 4, received->payload_len);
+            EXPECT_EQ((uint8_t)i, received->payload[received->payload_len - 1]);
+            EXPECT_EQ(i == nal_count - 1, received->header.marker != 0);
+
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_access_units)
+{
+    // Tests that the NAL units of a frame are received as one access unit with start codes
+    // whether they are sent in aggregation packets, in their own packets or fragmented
+    std::cout << "Starting h265 access unit test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+    }
+
+    ASSERT_NE(sender, nullptr);
+    ASSERT_NE(receiver, nullptr);
+
+    // VPS, SPS and PPS are aggregated, the IDR slice is fragmented and the last slice,
+    // too large to be aggregated, is sent in its own packet
+    const std::vector<std::pair<uint8_t, size_t>> nals = { { 32, 20 }, { 33, 40 }, { 34, 10 }, { 19, 10000 }, { 1, 1420 } };
+
+    for (int i = 0; i < 5; ++i) {
+        std::vector<uint8_t> frame;
+
+        for (size_t j = (i == 0 ? 0 : 3); j < nals.size(); ++j) {
+            frame.insert(frame.end(), { 0, 0, 0, 1, (uint8_t)(nals[j].first << 1), 1 });
+
+            for (size_t k = 2; k < nals[j].second; ++k)
+                frame.push_back((uint8_t)(i + j + k) | 0x80);
+        }
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+        ASSERT_NE(received, nullptr);
+
+        EXPECT_TRUE(std::vector<uint8_t>(received->payload, received->payload + received->payload_len) == frame);
+        EXPECT_NE(0, received->header.marker);
+
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    EXPECT_EQ(nullptr, receiver->pull_frame(10));
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+static std::vector<std::vector<uint8_t>> receive_nal_units(uvgrtp::media_stream* receiver)
+{
+    std::vector<std::vector<uint8_t>> received;
+
+    while (uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100)) {
+        received.emplace_back(frame->payload, frame->payload + frame->payload_len);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    return received;
+}
+
+TEST(FormatTests, h264_nal_unit_list)
+{
+    // Tests that a frame given as a list of NAL units is sent the same way as
+    // the same NAL units concatenated with start codes
+    std::cout << "Starting h264 NAL unit list test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H264, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H264, RCE_NO_FLAGS);
+    }
+
+    ASSERT_NE(sender, nullptr);
+    ASSERT_NE(receiver, nullptr);
+
+    // two small NAL units that are aggregated and one that is fragmented
+    const size_t nal_sizes[] = { 20, 30, 5000 };
+    std::vector<std::unique_ptr<uint8_t[]>> nals;
+    std::vector<uvgrtp::frame::nal_unit> units;
+    std::vector<uint8_t> frame;
+
+    for (size_t i = 0; i < 3; ++i) {
+        nals.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[nal_sizes[i]]));
+        uint8_t* nal = nals.back().get();
+
+        nal[0] = (3 << 5) | 1; // non-IDR slice
+
+        for (size_t j = 1; j < nal_sizes[i]; ++j)
+            nal[j] = (uint8_t)(i + j) | 0x80;
+
+        units.push_back({ nal, nal_sizes[i] });
+
+        frame.insert(frame.end(), { 0, 0, 0, 1 });
+        frame.insert(frame.end(), nal, nal + nal_sizes[i]);
+    }
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_frame((uvgrtp::frame::nal_unit*)nullptr, 3, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_frame(units.data(), 0, RTP_NO_FLAGS));
+
+    EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), RTP_NO_FLAGS));
+    std::vector<std::vector<uint8_t>> expected = receive_nal_units(receiver);
+    EXPECT_FALSE(expected.empty());
+
+    EXPECT_EQ(RTP_OK, sender->push_frame(units.data(), units.size(), RTP_NO_FLAGS));
+    EXPECT_EQ(expected, receive_nal_units(receiver));
+
+    // the NAL units may also have start codes
+    units.back() = { frame.data() + frame.size() - nal_sizes[2] - 4, nal_sizes[2] + 4 };
+    EXPECT_EQ(RTP_OK, sender->push_frame(units.data(), units.size(), RTP_NO_FLAGS));
+    EXPECT_EQ(expected, receive_nal_units(receiver));
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_start_code_lookup)
+{
+    // Tests that the start code lookup finds the same NAL units that are given as a list,
+    // including short NAL units at the end of the frame and both start code lengths
+    std::cout << "Starting h265 start code lookup test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    ASSERT_NE(sender, nullptr);
+    ASSERT_NE(receiver, nullptr);
+
+    const size_t nal_sizes[] = { 4000, 3, 40, 1447, 100, 67, 5, 3 };
+    std::vector<uint8_t> frame;
+    std::vector<size_t> offsets;
+
+    for (size_t i = 0; i < sizeof(nal_sizes) / sizeof(nal_sizes[0]); ++i) {
+        if (i % 2)
+            frame.insert(frame.end(), { 0, 0, 1 });
+        else
+            frame.insert(frame.end(), { 0, 0, 0, 1 });
+
+        offsets.push_back(frame.size());
+
+        // TRAIL_R NAL unit header, the payload has zeros but no start codes
+        frame.insert(frame.end(), { 1 << 1, 1 });
+
+        for (size_t j = 2; j < nal_sizes[i]; ++j)
+            frame.push_back((j % 3) ? 0 : (uint8_t)(i + j) | 0x80);
+
+        // a NAL unit never ends with a zero byte
+        frame.back() |= 0x80;
+    }
+
+    std::vector<uvgrtp::frame::nal_unit> units;
+
+    for (size_t i = 0; i < offsets.size(); ++i)
+        units.push_back({ frame.data() + offsets[i], nal_sizes[i] });
+
+    EXPECT_EQ(RTP_OK, sender->push_frame(units.data(), units.size(), RTP_NO_FLAGS));
+    std::vector<std::vector<uint8_t>> expected = receive_nal_units(receiver);
+    EXPECT_FALSE(expected.empty());
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), RTP_NO_FLAGS));
+        EXPECT_EQ(expected, receive_nal_units(receiver));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+#ifdef __linux__
+TEST(FormatTests, h265_reordered_fragments)
+{
+    // Tests that fragmented frames are reassembled correctly when the fragments arrive out of order,
+    // are duplicated, are of different sizes, when the sequence number wraps around in the middle
+    // of a frame and when the frame is larger than the buffer reserved for it at first
+    std::cout << "Starting h265 reordered fragments test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_PREPEND_SC);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(LOCAL_ADDRESS, RECEIVE_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        const uint8_t nal_type = 1;
+
+        struct test_frame {
+            uint32_t timestamp;
+            uint16_t first_seq;
+            std::vector<size_t> sizes;
+            std::vector<size_t> order;
+        };
+
+        const std::vector<test_frame> frames = {
+            { 1000, 65530, { 500, 1200, 800, 1400, 1400, 300, 1000, 1400, 700, 90 },
+                { 9, 2, 0, 1, 1, 5, 4, 3, 8, 6, 7 } },
+            { 2000, 4, std::vector<size_t>(40, 1000), {} },
+        };
+
+        std::vector<std::vector<uint8_t>> expected;
+
+        for (auto& frame : frames)
+        {
+            std::vector<std::vector<uint8_t>> packets;
+            std::vector<uint8_t> nal = { 0, 0, 0, 1, (uint8_t)(nal_type << 1), 1 };
+
+            for (size_t i = 0; i < frame.sizes.size(); ++i)
+            {
+                // fragmentation unit
+                std::vector<uint8_t> payload = { 49 << 1, 1, nal_type };
+
+                if (i == 0)
+                    payload[2] |= 0x80;
+                else if (i == frame.sizes.size() - 1)
+                    payload[2] |= 0x40;
+
+                for (size_t j = 0; j < frame.sizes[i]; ++j)
+                    payload.push_back((uint8_t)(i * 7 + j));
+
+                nal.insert(nal.end(), payload.begin() + 3, payload.end());
+                packets.push_back(create_rtp_packet((uint16_t)(frame.first_seq + i), frame.timestamp, false, payload));
+            }
+
+            expected.push_back(nal);
+
+            std::vector<size_t> order = frame.order;
+
+            if (order.empty())
+            {
+                for (size_t i = 0; i < packets.size(); ++i)
+                    order.push_back(i);
+            }
+
+            for (auto i : order)
+                raw.send(packets[i]);
+        }
+
+        std::vector<std::vector<uint8_t>> received = receive_nal_units(receiver);
+
+        EXPECT_EQ(expected.size(), received.size());
+        EXPECT_TRUE(expected == received);
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_access_units_reordered)
+{
+    // Tests that an access unit is returned only when all of its packets have been received, with
+    // the NAL units in the order of their sequence numbers, when the packets are reordered and duplicated
+    // and when the first packets of an access unit are lost after a dropped access unit
+    std::cout << "Starting h265 reordered access unit test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(LOCAL_ADDRESS, RECEIVE_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PKT_MAX_DELAY, 50));
+
+        std::map<uint16_t, std::vector<uint8_t>> packets;
+
+        auto make_packet = [&](uint16_t seq, uint32_t timestamp, bool marker, std::vector<uint8_t> payload)
+        {
+            packets[seq] = create_rtp_packet(seq, timestamp, marker, payload);
+        };
+
+        auto nal = [](uint8_t type, size_t size)
+        {
+            std::vector<uint8_t> data = { (uint8_t)(type << 1), 1 };
+
+            for (size_t i = 2; i < size; ++i)
+                data.push_back((uint8_t)(type + i));
+
+            return data;
+        };
+
+        auto append = [](std::vector<uint8_t>& au, const std::vector<uint8_t>& data)
+        {
+            au.insert(au.end(), { 0, 0, 0, 1 });
+            au.insert(au.end(), data.begin(), data.end());
+        };
+
+        std::vector<uint8_t> vps = nal(32, 20), sps = nal(33, 30), pps = nal(34, 10), idr = nal(19, 3000);
+        std::vector<uint8_t> trail1 = nal(1, 500), trail2 = nal(1, 600), trail3 = nal(1, 700);
+
+        // the first access unit: VPS, aggregation packet with SPS and PPS, and three fragments of an IDR slice
+        make_packet(100, 1000, false, vps);
+
+        std::vector<uint8_t> aggregate = { 48 << 1, 1 };
+
+        for (auto* unit : { &sps, &pps }) {
+            aggregate.push_back((uint8_t)(unit->size() >> 8));
+            aggregate.push_back((uint8_t)unit->size());
+            aggregate.insert(aggregate.end(), unit->begin(), unit->end());
+        }
+
+        make_packet(101, 1000, false, aggregate);
+
+        for (size_t i = 0; i < 3; ++i) {
+            std::vector<uint8_t> fragment = { 49 << 1, 1, (uint8_t)(19 | (i == 0 ? 0x80 : 0) | (i == 2 ? 0x40 : 0)) };
+            fragment.insert(fragment.end(), idr.begin() + 2 + i * 1000, idr.begin() + std::min<size_t>(2 + (i + 1) * 1000, idr.size()));
+
+            make_packet((uint16_t)(102 + i), 1000, i == 2, fragment);
+        }
+
+        // the second access unit has one NAL unit and the third one has two
+        make_packet(105, 2000, true, trail1);
+        make_packet(106, 3000, false, trail2);
+        make_packet(107, 3000, true, trail3);
+
+        std::vector<std::vector<uint8_t>> expected(3);
+
+        for (auto* unit : { &vps, &sps, &pps, &idr })
+            append(expected[0], *unit);
+
+        append(expected[1], trail1);
+        append(expected[2], trail2);
+        append(expected[2], trail3);
+
+        for (uint16_t seq : { 101, 100, 104, 102, 102, 103, 105, 107, 107, 106 })
+            raw.send(packets[seq]);
+
+        std::vector<std::vector<uint8_t>> received = receive_nal_units(receiver);
+
+        EXPECT_EQ(expected.size(), received.size());
+        EXPECT_TRUE(expected == received);
+
+        // the first packets of the fifth access unit are lost after the fourth one has been dropped.
+        // The fourth one ended with its marker packet so the fifth one is known to be incomplete
+        std::vector<uint8_t> trail4 = nal(1, 400), trail5 = nal(1, 300), trail6 = nal(1, 200), trail7 = nal(1, 100);
+
+        make_packet(109, 4000, true, trail4);
+        make_packet(111, 5000, true, trail5);
+        make_packet(112, 6000, true, trail6);
+
+        // the marker packet of the seventh access unit is lost so the packets after it may belong
+        // to it. The eighth access unit is then complete with the packets received for it
+        make_packet(113, 7000, false, trail7);
+        make_packet(115, 8000, true, trail7);
+
+        expected.assign(2, {});
+        append(expected[0], trail6);
+        append(expected[1], trail7);
+
+        for (uint16_t seq : { 109, 111, 112, 113, 115 }) {
+            raw.send(packets[seq]);
+
+            // the access units are dropped after RCC_PKT_MAX_DELAY
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+
+        received = receive_nal_units(receiver);
+
+        EXPECT_EQ(expected.size(), received.size());
+        EXPECT_TRUE(expected == received);
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_access_units_dropped_fragment)
+{
+    // Tests that an access unit whose fragmented NAL unit has been dropped by the reassembly
+    // is released at once and the drop is reported only once, also when a late fragment arrives
+    std::cout << "Starting h265 access unit dropped fragment test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+    std::atomic<int> dropped(0);
+
+    if (sess)
+    {
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(LOCAL_ADDRESS, RECEIVE_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PKT_MAX_DELAY, 50));
+        EXPECT_EQ(RTP_OK, receiver->install_notify_hook(&dropped, [](void* arg, int reason)
+        {
+            if (reason == NR_FRAME_DROPPED)
+                ++*(std::atomic<int>*)arg;
+        }));
+
+        // a fragment of an IDR slice, the first one if "start" is true
+        auto send_fragment = [&](uint16_t seq, uint32_t timestamp, bool start)
+        {
+            std::vector<uint8_t> fragment = { 49 << 1, 1, (uint8_t)(19 | (start ? 0x80 : 0)) };
+            fragment.resize(1000, 0xaa);
+
+            raw.send(create_rtp_packet(seq, timestamp, false, fragment));
+        };
+
+        // the second IDR picture makes the reassembly drop the first one, then a late fragment of it arrives
+        send_fragment(10, 1000, true);
+        send_fragment(20, 2000, true);
+        send_fragment(11, 1000, false);
+
+        // the second picture is dropped after the intra timeout
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+        EXPECT_EQ(2, dropped.load());
+
+        // access units are still received after the drops
+        std::vector<uint8_t> nal = { 1 << 1, 1 };
+        nal.resize(100, 0xbb);
+
+        raw.send(create_rtp_packet(30, 3000, true, nal));
+
+        std::vector<uint8_t> expected = { 0, 0, 0, 1 };
+        expected.insert(expected.end(), nal.begin(), nal.end());
+
+        std::vector<std::vector<uint8_t>> received = receive_nal_units(receiver);
+
+        EXPECT_EQ(1u, received.size());
+        EXPECT_TRUE(received.size() == 1 && received[0] == expected);
+        EXPECT_EQ(2, dropped.load());
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_drop_undecodable)
+{
+    // Tests that the frames depending on a dropped frame are discarded until the next IDR picture,
+    // that the loss of a non-reference picture only affects the temporal sub-layers above it,
+    // that the pictures before a lost picture are not affected by the loss
+    // and that the loss of a base sub-layer picture is reported once with NR_KEYFRAME_NEEDED
+    std::cout << "Starting h265 drop undecodable test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* receiver = nullptr;
+    std::atomic<int> dropped(0);
+    std::atomic<int> keyframes(0);
+
+    if (sess)
+    {
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_DROP_UNDECODABLE);
+    }
+
+    EXPECT_NE(nullptr, receiver);
+
+    Raw_sender raw(LOCAL_ADDRESS, RECEIVE_PORT);
+    EXPECT_TRUE(raw.is_open());
+
+    if (receiver && raw.is_open())
+    {
+        std::pair<std::atomic<int>*, std::atomic<int>*> counters(&dropped, &keyframes);
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PKT_MAX_DELAY, 50));
+        EXPECT_EQ(RTP_OK, receiver->install_notify_hook(&counters, [](void* arg, int reason)
+        {
+            auto counters = (std::pair<std::atomic<int>*, std::atomic<int>*>*)arg;
+
+            if (reason == NR_FRAME_DROPPED)
+                ++*counters->first;
+            else if (reason == NR_KEYFRAME_NEEDED)
+                ++*counters->second;
+        }));
+
+        std::vector<std::vector<uint8_t>> expected;
+        uint16_t seq = 10;
+        uint32_t timestamp = 1000;
+
+        auto send_packet = [&](const std::vector<uint8_t>& payload)
+        {
+            raw.send(create_rtp_packet(seq, timestamp, true, payload));
+
+            ++seq;
+            timestamp += 1000;
+        };
+
+        // a picture in a single NAL unit packet, the second byte of the NAL unit header is temporal ID + 1
+        auto send_picture = [&](uint8_t type, uint8_t temporal_id, bool decodable)
+        {
+            std::vector<uint8_t> nal = { (uint8_t)(type << 1), (uint8_t)(temporal_id + 1) };
+
+            for (size_t i = 0; i < 100; ++i)
+                nal.push_back((uint8_t)(seq + i));
+
+            if (decodable)
+                expected.push_back(nal);
+
+            send_packet(nal);
+        };
+
+        // only the first fragment of a picture is sent so the picture is dropped after RCC_PKT_MAX_DELAY
+        auto lose_picture = [&](uint8_t type, uint8_t temporal_id)
+        {
+            std::vector<uint8_t> fragment = { 49 << 1, (uint8_t)(temporal_id + 1), (uint8_t)(0x80 | type) };
+            fragment.resize(1000, 0xaa);
+
+            send_packet(fragment);
+            ++seq; // the rest of the fragments
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        };
+
+        send_picture(19, 0, true); // IDR
+        send_picture(1, 0, true);  // TRAIL_R
+
+        // a non-reference picture of sub-layer 1 breaks only the sub-layers above it
+        lose_picture(0, 1);
+        send_picture(1, 1, true);
+        send_picture(0, 2, false);
+        send_picture(1, 0, true);
+
+        // a reference picture of the base sub-layer breaks every sub-layer until the next IDR picture
+        lose_picture(1, 0);
+        send_picture(1, 0, false);
+        send_picture(0, 1, false);
+        send_picture(19, 0, true);
+        send_picture(1, 0, true);
+        send_picture(0, 2, true);
+
+        // a picture before the lost picture in decoding order does not depend on it even if it is
+        // completed after the lost picture has been dropped, here because its packet arrives late
+        uint16_t early_seq = seq;
+        uint32_t early_timestamp = timestamp;
+
+        ++seq;
+        timestamp += 1000;
+        lose_picture(1, 0);
+
+        uint16_t next_seq = seq;
+        uint32_t next_timestamp = timestamp;
+
+        seq = early_seq;
+        timestamp = early_timestamp;
+        send_picture(1, 0, true);
+
+        seq = next_seq;
+        timestamp = next_timestamp;
+        send_picture(1, 0, false);
+        send_picture(19, 0, true);
+
+        std::vector<std::vector<uint8_t>> received = receive_nal_units(receiver);
+
+        EXPECT_EQ(expected.size(), received.size());
+        EXPECT_TRUE(expected == received);
+        EXPECT_EQ(3, dropped.load());
+        EXPECT_EQ(2, keyframes.load());
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+TEST(FormatTests, h265_zero_copy_extension)
+{
+    // Tests that the start code prepended to a NAL unit received without copying does not
+    // overwrite the header extension the frame points to, also when the NAL unit is an access unit
+    std::cout << "Starting h265 zero-copy header extension test" << std::endl;
+
+    for (int flags : { (int)RCE_H26X_PREPEND_SC, (int)RCE_H26X_ACCESS_UNITS })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265,
+                RCE_ZERO_COPY_RECEIVE | flags);
+        }
+
+        EXPECT_NE(nullptr, receiver);
+
+        Raw_sender raw(LOCAL_ADDRESS, RECEIVE_PORT);
+        EXPECT_TRUE(raw.is_open());
+
+        if (receiver && raw.is_open())
+        {
+            const std::vector<uint8_t> extension = { 0x10, 0x20, 0x30, 0x40 };
+            std::vector<uint8_t> nal = { 1 << 1, 1 };
+
+            for (size_t i = 0; i < 100; ++i)
+                nal.push_back((uint8_t)i);
+
+            // extension of one 32-bit word before the NAL unit
+            std::vector<uint8_t> payload = { 0xbe, 0xde, 0, 1 };
+            payload.insert(payload.end(), extension.begin(), extension.end());
+            payload.insert(payload.end(), nal.begin(), nal.end());
+
+            std::vector<uint8_t> packet = create_rtp_packet(100, 1000, true, payload);
+            packet[0] |= 1 << 4;
+
+            raw.send(packet);
+
+            std::vector<uint8_t> expected = { 0, 0, 0, 1 };
+            expected.insert(expected.end(), nal.begin(), nal.end());
+
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(100);
+            EXPECT_NE(nullptr, frame);
+
+            if (frame)
+            {
+                EXPECT_NE(nullptr, frame->ext);
+
+                if (frame->ext)
+                {
+                    EXPECT_EQ(0xbede, frame->ext->type);
+                    EXPECT_EQ(extension.size(), frame->ext->len);
+                    EXPECT_TRUE(std::vector<uint8_t>(frame->ext->data, frame->ext->data + frame->ext->len) == extension);
+                }
+
+                EXPECT_TRUE(std::vector<uint8_t>(frame->payload, frame->payload + frame->payload_len) == expected);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            }
+        }
+
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+    }
+}
+#endif
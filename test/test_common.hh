@@ -3,6 +3,16 @@
 #include <gtest/gtest.h>
 #include "uvgrtp/lib.hh"
 
+#include <vector>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 class Test_receiver;
 
 void wait_until_next_frame(std::chrono::steady_clock::time_point& start, 
@@ -75,7 +85,7 @@ inline void send_packets(uvgrtp::session* sess, uvgrtp::media_stream* sender,
                 return;
             }
 
-            if (i % (packets / 10) == packets / 10 - 1 && print_progress)
+            if (print_progress && packets >= 10 && i % (packets / 10) == packets / 10 - 1)
             {
                 std::cout << "Sent " << (i + 1) * 100 / packets << " % of data" << std::endl;
             }
@@ -179,4 +189,63 @@ inline void process_rtp_frame(uvgrtp::frame::rtp_frame* frame)
     EXPECT_NE(0, frame->payload_len);
     EXPECT_EQ(2, frame->header.version);
     (void)uvgrtp::frame::dealloc_frame(frame);
-}
\ No newline at end of file
+}
+
+#ifdef __linux__
+/* Build an RTP packet of payload type 96 and SSRC 0x1234 with "payload" after the fixed header */
+inline std::vector<uint8_t> create_rtp_packet(uint16_t seq, uint32_t timestamp, bool marker,
+    const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> packet(uvgrtp::frame::HEADER_SIZE_RTP);
+
+    packet[0] = 2 << 6;
+    packet[1] = 96 | (marker ? 0x80 : 0);
+    *(uint16_t*)&packet[2] = htons(seq);
+    *(uint32_t*)&packet[4] = htonl(timestamp);
+    *(uint32_t*)&packet[8] = htonl(0x1234);
+
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    return packet;
+}
+
+/* Sends hand-built datagrams to the stream listening on "port" of "address" */
+class Raw_sender
+{
+public:
+    Raw_sender(const char* address, uint16_t port) :
+        fd_(socket(AF_INET, SOCK_DGRAM, 0)),
+        addr_()
+    {
+        addr_.sin_family = AF_INET;
+        addr_.sin_port = htons(port);
+        addr_.sin_addr.s_addr = inet_addr(address);
+    }
+
+    ~Raw_sender()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    bool is_open() const
+    {
+        return fd_ >= 0;
+    }
+
+    /* Send the following datagrams as UDP GSO datagrams of "size"-byte segments, false if it's not supported */
+    bool set_segment_size(int size)
+    {
+        return fd_ >= 0 && setsockopt(fd_, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == 0;
+    }
+
+    void send(const std::vector<uint8_t>& datagram)
+    {
+        EXPECT_EQ((ssize_t)datagram.size(),
+            sendto(fd_, datagram.data(), datagram.size(), 0, (sockaddr*)&addr_, sizeof(addr_)));
+    }
+
+private:
+    int fd_;
+    sockaddr_in addr_;
+};
+#endif
@@ -42,6 +42,7 @@ SOURCES += \
 	src/clock.cc \
 	src/crypto.cc \
 	src/frame.cc \
+	src/frame_pool.cc \
 	src/hostname.cc \
 	src/context.cc \
 	src/media_stream.cc \
@@ -54,14 +55,23 @@ SOURCES += \
 	src/rtp.cc \
 	src/session.cc \
 	src/socket.cc \
+	src/timer_wheel.cc \
 	src/holepuncher.cc \
+	src/io_runtime.cc \
+	src/uring.cc \
+	src/dispatch.cc \
+	src/pacer.cc \
 	src/version_qt.cpp \
 	src/zrtp.cc \
 	src/formats/media.cc \
+	src/formats/access_unit.cc \
 	src/formats/h26x.cc \
 	src/formats/h264.cc \
 	src/formats/h265.cc \
 	src/formats/h266.cc \
+	src/formats/reassembly.cc \
+	src/formats/references.cc \
+	src/formats/scl.cc \
 	src/zrtp/zrtp_message.cc \
 	src/zrtp/zrtp_receiver.cc \
 	src/zrtp/hello.cc \
@@ -89,18 +99,28 @@ HEADERS += \
 	include/uvgrtp/util.hh \
 	include/version.hh \
 	src/holepuncher.hh \
+	src/io_runtime.hh \
+	src/uring.hh \
+	src/dispatch.hh \
+	src/pacer.hh \
 	src/hostname.hh \
 	src/mingw_inet.hh \
+	src/frame_pool.hh \
 	src/reception_flow.hh \
+	src/timer_wheel.hh \
 	src/poll.hh \
 	src/frame_queue.hh \
 	src/random.hh \
 	src/rtp.hh \
 	src/zrtp.hh \
 	src/formats/media.hh \
+	src/formats/reassembly.hh \
+	src/formats/references.hh \
+	src/formats/access_unit.hh \
 	src/formats/h26x.hh \
 	src/formats/h264.hh \
 	src/formats/h265.hh \
+	src/formats/scl.hh \
 	src/zrtp/zrtp_receiver.hh \
 	src/zrtp/zrtp_message.hh \
 	src/zrtp/hello.hh \